@@ -0,0 +1,118 @@
+# Copyright 2020 Edwin Yung. All Rights Reserved
+"""Reads match telemetry written by AMatchTelemetryRecorder (servers started with -MatchTelemetry=<path>).
+
+The file is memory-mapped and every column of every chunk is returned as a numpy array viewing the mapping, so nothing
+is parsed per row. Works in the editor's Python (Content/Python is on its path) and standalone, with numpy installed.
+
+    import match_telemetry
+    with match_telemetry.open_telemetry(path) as telemetry:
+        events = telemetry.columns()
+        fires = events['type'] == match_telemetry.FIRE
+        print(fires.sum(), 'shots')
+
+Events from different server threads are not in time order within a chunk; sort by 'time' where that matters.
+'actor_id' and 'other_id' are player ids for players, and match-long counters with ACTOR_ID_FLAG set for other actors.
+"""
+
+import mmap
+import struct
+
+import numpy
+
+FIRE, IMPACT, DAMAGE, POSITION = range(4)
+
+# Must match AMatchTelemetryRecorder::ActorIdFlag.
+ACTOR_ID_FLAG = 0x80000000
+
+FILE_MAGIC = 0x544D5054
+CHUNK_MAGIC = 0x434D5054
+VERSION = 1
+
+# In file order. Must match the column writes in MatchTelemetryRecorder.cpp.
+COLUMNS = (
+    ('time', numpy.dtype('<f4')),
+    ('type', numpy.dtype('u1')),
+    ('actor_id', numpy.dtype('<u4')),
+    ('other_id', numpy.dtype('<u4')),
+    ('x', numpy.dtype('<f4')),
+    ('y', numpy.dtype('<f4')),
+    ('z', numpy.dtype('<f4')),
+    ('value', numpy.dtype('<f4')),
+)
+
+_FILE_HEADER = struct.Struct('<4I')
+_CHUNK_HEADER = struct.Struct('<4I')
+
+
+def _align(size):
+    return (size + 7) & ~7
+
+
+class MatchTelemetry(object):
+    """A mapped telemetry file. Arrays it returns keep the mapping alive until they are released."""
+
+    def __init__(self, path):
+        self._file = open(path, 'rb')
+        self._map = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+
+        magic, version, chunk_header_size, num_columns = _FILE_HEADER.unpack_from(self._map, 0)
+        if magic != FILE_MAGIC or version != VERSION or chunk_header_size != _CHUNK_HEADER.size or num_columns != len(COLUMNS):
+            self.close()
+            raise ValueError('%s is not a version %d match telemetry file' % (path, VERSION))
+
+        self._chunks = self._find_chunks()
+
+    def _find_chunks(self):
+        """Returns (offset, rows) for each complete chunk. Only the chunk headers are read."""
+        chunks = []
+        offset = _FILE_HEADER.size
+        size = len(self._map)
+        while offset + _CHUNK_HEADER.size <= size:
+            magic, rows, _, _ = _CHUNK_HEADER.unpack_from(self._map, offset)
+            chunk_size = _CHUNK_HEADER.size + sum(_align(rows * dtype.itemsize) for _, dtype in COLUMNS)
+            if magic != CHUNK_MAGIC or offset + chunk_size > size:
+                # a server that did not shut down cleanly can leave a partial chunk at the end
+                break
+            chunks.append((offset + _CHUNK_HEADER.size, rows))
+            offset += chunk_size
+        return chunks
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info):
+        self.close()
+
+    def close(self):
+        try:
+            self._map.close()
+        except BufferError:
+            # arrays still view the mapping; it is unmapped once they are gone
+            pass
+        self._file.close()
+
+    @property
+    def num_rows(self):
+        return sum(rows for _, rows in self._chunks)
+
+    def chunks(self):
+        """Yields a dict of column name to array for each chunk. The arrays view the mapped file without copying."""
+        for offset, rows in self._chunks:
+            columns = {}
+            for name, dtype in COLUMNS:
+                columns[name] = numpy.frombuffer(self._map, dtype=dtype, count=rows, offset=offset)
+                offset += _align(rows * dtype.itemsize)
+            yield columns
+
+    def columns(self, names=None):
+        """Returns a dict of column name to array over the whole match. Views the file if it has one chunk; otherwise
+        each column is joined with one bulk copy."""
+        names = [name for name, _ in COLUMNS] if names is None else names
+        chunks = list(self.chunks())
+        if len(chunks) == 1:
+            return dict((name, chunks[0][name]) for name in names)
+        return dict((name, numpy.concatenate([chunk[name] for chunk in chunks]) if chunks else numpy.empty(0, dict(COLUMNS)[name])) for name in names)
+
+
+def open_telemetry(path):
+    return MatchTelemetry(path)
@@ -0,0 +1,46 @@
+#!/usr/bin/env bash
+# Runs the deterministic server benchmark (ABenchmarkRunner) on a Linux dedicated server a number of times, and prints
+# the summary of each run. Runs of the same build should agree closely, so a difference between two builds larger than
+# the spread between runs is a real change. Requires a packaged Linux build containing the ThirdPersonMPServer target.
+#
+# Usage: Scripts/Benchmark.sh <PackagedLinuxDir> [InputScript=Scripts/BenchmarkInput.csv] [Runs=3] [OutputDir=Saved/Benchmark]
+#
+# Writes <OutputDir>/run<N>.json for each run: per-frame game thread, physics and net tick milliseconds, and their summary.
+# Extra server arguments can be passed in SERVER_EXTRA_ARGS, e.g. '-BenchmarkFrames=6000 -BenchmarkSeed=7'.
+
+set -euo pipefail
+
+BUILD_DIR=${1:?usage: Benchmark.sh <PackagedLinuxDir> [InputScript] [Runs] [OutputDir]}
+INPUT_SCRIPT=$(realpath "${2:-$(dirname "$0")/BenchmarkInput.csv}")
+RUNS=${3:-3}
+OUTPUT_DIR=$(realpath -m "${4:-Saved/Benchmark}")
+
+MAP=/Game/ThirdPersonCPP/Maps/ThirdPersonExampleMap
+SERVER_BIN="$BUILD_DIR/LinuxServer/ThirdPersonMP/Binaries/Linux/ThirdPersonMPServer"
+SERVER_EXTRA_ARGS=${SERVER_EXTRA_ARGS:-}
+
+mkdir -p "$OUTPUT_DIR"
+
+for ((run = 1; run <= RUNS; run++)); do
+	echo "Benchmark run $run of $RUNS"
+
+	# The runner fixes the time step and seeds, measures its frames, writes the JSON and exits.
+	"$SERVER_BIN" "$MAP" -nullrhi -log -unattended -nosound \
+		"-BenchmarkScript=$INPUT_SCRIPT" "-BenchmarkOutput=$OUTPUT_DIR/run$run.json" \
+		${SERVER_EXTRA_ARGS:+"$SERVER_EXTRA_ARGS"} \
+		> "$OUTPUT_DIR/run${run}_server.log" 2>&1
+done
+
+python3 - "$OUTPUT_DIR" "$RUNS" <<'PYTHON'
+import json, os, sys
+
+output_dir, runs = sys.argv[1], int(sys.argv[2])
+print("Run, GameThreadMsMean, GameThreadMsP99, PhysicsMsMean, NetTickMsMean")
+for run in range(1, runs + 1):
+    with open(os.path.join(output_dir, "run%d.json" % run)) as f:
+        summary = json.load(f)["summary"]
+    print("%d, %.4f, %.4f, %.4f, %.4f" % (run, summary["gameThreadMs"]["mean"], summary["gameThreadMs"]["p99"],
+                                          summary["physicsMs"]["mean"], summary["netTickMs"]["mean"]))
+PYTHON
+
+echo "Benchmark results written to $OUTPUT_DIR"
@@ -0,0 +1,46 @@
+#!/usr/bin/env bash
+# Compares server frame times through bursts of fire with deferred work off and on (ThirdPersonMP.DeferWork), using the
+# deterministic benchmark: 32 bots that all fire at once for a second every ten seconds (Scripts/BurstBenchmarkInput.csv).
+# Runs Scripts/Benchmark.sh once per setting and prints the game thread percentiles of each against the tick budget, the
+# benchmark's fixed time step. Needs the same packaged build as Benchmark.sh.
+#
+# Usage: Scripts/BurstBenchmark.sh <PackagedLinuxDir> [Runs=3] [OutputDir=Saved/BurstBenchmark]
+#
+# With deferral on, the damage over time, listen server impact effects and pool growth of a burst run in the frames
+# after it, within the AFrameBudgetScheduler budget, so the p99 should drop below the tick budget while the mean stays
+# about the same. With it off, the pool grows one shot at a time as it did before the scheduler.
+
+set -euo pipefail
+
+BUILD_DIR=${1:?usage: BurstBenchmark.sh <PackagedLinuxDir> [Runs] [OutputDir]}
+RUNS=${2:-3}
+OUTPUT_DIR=$(realpath -m "${3:-Saved/BurstBenchmark}")
+
+SCRIPT_DIR=$(dirname "$(realpath "$0")")
+
+for DEFER_WORK in 0 1; do
+	echo "Burst benchmark: ThirdPersonMP.DeferWork=$DEFER_WORK"
+	SERVER_EXTRA_ARGS="-ExecCmds=ThirdPersonMP.DeferWork $DEFER_WORK" \
+		"$SCRIPT_DIR/Benchmark.sh" "$BUILD_DIR" "$SCRIPT_DIR/BurstBenchmarkInput.csv" "$RUNS" "$OUTPUT_DIR/defer$DEFER_WORK"
+done
+
+python3 - "$OUTPUT_DIR" "$RUNS" <<'PYTHON'
+import json, os, sys
+
+output_dir, runs = sys.argv[1], int(sys.argv[2])
+
+def mean_summary(defer_work):
+    reports = []
+    for run in range(1, runs + 1):
+        with open(os.path.join(output_dir, "defer%d" % defer_work, "run%d.json" % run)) as f:
+            reports.append(json.load(f))
+    game_thread = [report["summary"]["gameThreadMs"] for report in reports]
+    budget_ms = 1000.0 * reports[0]["fixedDeltaSeconds"]
+    return budget_ms, [sum(summary[key] for summary in game_thread) / len(game_thread) for key in ("mean", "p50", "p99", "max")]
+
+print("DeferWork, TickBudgetMs, GameThreadMsMean, GameThreadMsP50, GameThreadMsP99, GameThreadMsMax, P99UnderBudget")
+for defer_work in (0, 1):
+    budget_ms, (mean, p50, p99, worst) = mean_summary(defer_work)
+    print("%s, %.2f, %.4f, %.4f, %.4f, %.4f, %s" % ("off" if defer_work == 0 else "on", budget_ms, mean, p50, p99, worst,
+                                                    "yes" if p99 < budget_ms else "no"))
+PYTHON
@@ -0,0 +1,106 @@
+#!/usr/bin/env bash
+# Measures how many matches one Linux host can run. For each instance count, starts Scripts/ServerHost.py with that
+# many server instances behind the session router, joins PlayersPerMatch headless bots per instance through the router,
+# and records every instance's reports. Requires the same packaged build as Scripts/LoadTest.sh.
+#
+# Usage: Scripts/HostBenchmark.sh <PackagedLinuxDir> [InstanceCounts="1 2 4 8"] [PlayersPerMatch=16] [DurationSeconds=120] [OutputDir=Saved/HostBenchmark]
+#
+# For each instance count, writes <OutputDir>/<N>instances.csv (every report the router received) and the instance
+# logs. At the end prints, per instance count, the mean and worst-instance p99 game thread frame time after the warm up,
+# the proportional set size per instance (shared pak pages are split between the instances mapping them) and whether
+# every instance stayed within the frame budget. The largest count that stays within it is the matches per host.
+#
+# FRAME_BUDGET_MS sets the budget (default 33.3, a 30 Hz server). Bots run on this machine too, like LoadTest.sh; for
+# a clean number run them elsewhere and point them at the router with ROUTER=<ip:port>.
+
+set -euo pipefail
+
+BUILD_DIR=${1:?usage: HostBenchmark.sh <PackagedLinuxDir> [InstanceCounts] [PlayersPerMatch] [DurationSeconds] [OutputDir]}
+INSTANCE_COUNTS=${2:-"1 2 4 8"}
+PLAYERS_PER_MATCH=${3:-16}
+DURATION=${4:-120}
+OUTPUT_DIR=$(realpath -m "${5:-Saved/HostBenchmark}")
+
+SCRIPT_DIR=$(dirname "$(realpath "$0")")
+ROUTER_PORT=7900
+ROUTER=${ROUTER:-127.0.0.1:$ROUTER_PORT}
+FRAME_BUDGET_MS=${FRAME_BUDGET_MS:-33.3}
+CLIENT_BIN="$BUILD_DIR/LinuxNoEditor/ThirdPersonMP/Binaries/Linux/ThirdPersonMP"
+# Reports from the first seconds cover map load and bots joining.
+WARMUP=30
+
+CLIENT_ARGS=(-game -nullrhi -nosound -unattended -nosplash -LoadTestBot "-ExecCmds=t.MaxFPS 30")
+
+mkdir -p "$OUTPUT_DIR"
+
+CLIENT_PIDS=()
+stop_clients() {
+	if [ ${#CLIENT_PIDS[@]} -gt 0 ]; then
+		kill "${CLIENT_PIDS[@]}" 2>/dev/null || true
+		wait "${CLIENT_PIDS[@]}" 2>/dev/null || true
+	fi
+	CLIENT_PIDS=()
+}
+trap stop_clients EXIT
+
+for NUM_INSTANCES in $INSTANCE_COUNTS; do
+	echo "Host benchmark: $NUM_INSTANCES instances, $PLAYERS_PER_MATCH players each, for $DURATION seconds"
+
+	"$SCRIPT_DIR/ServerHost.py" "$BUILD_DIR" --instances "$NUM_INSTANCES" --router-port $ROUTER_PORT \
+		--duration $((DURATION + WARMUP)) --log-dir "$OUTPUT_DIR/${NUM_INSTANCES}instances_logs" \
+		--router-log "$OUTPUT_DIR/${NUM_INSTANCES}instances.csv" \
+		> "$OUTPUT_DIR/${NUM_INSTANCES}instances_host.log" 2>&1 &
+	HOST_PID=$!
+
+	# Give the instances time to load the map and report in.
+	sleep 15
+
+	for ((i = 0; i < NUM_INSTANCES * PLAYERS_PER_MATCH; i++)); do
+		ADDRESS=$("$SCRIPT_DIR/SessionRouter.py" join --router "$ROUTER") || { echo "Router is full after $i players"; break; }
+		"$CLIENT_BIN" "$ADDRESS" "${CLIENT_ARGS[@]}" "-BotSeed=$i" > /dev/null 2>&1 &
+		CLIENT_PIDS+=($!)
+		sleep 0.2
+	done
+
+	# Halfway through, after every bot has joined.
+	sleep $((DURATION / 2))
+	PSS_KB=0
+	for PID in $(pgrep -f 'ThirdPersonMPServer.*-SessionRouter=' || true); do
+		PSS_KB=$((PSS_KB + $(awk '/^Pss:/ { print $2 }' "/proc/$PID/smaps_rollup" 2>/dev/null || echo 0)))
+	done
+	echo "$PSS_KB" > "$OUTPUT_DIR/${NUM_INSTANCES}instances_pss.txt"
+
+	wait $HOST_PID || true
+	stop_clients
+done
+
+python3 - "$OUTPUT_DIR" "$FRAME_BUDGET_MS" "$WARMUP" $INSTANCE_COUNTS <<'EOF'
+import csv, os, sys
+output_dir, budget, warmup = sys.argv[1], float(sys.argv[2]), float(sys.argv[3])
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(int(len(values) * p / 100.0), len(values) - 1)] if values else 0.0
+
+print('%10s %12s %16s %14s %10s' % ('Instances', 'FrameMsMean', 'WorstP99FrameMs', 'PssMBPerInst', 'InBudget'))
+matches_per_host = 0
+for count in sys.argv[4:]:
+    means, p99s = {}, {}
+    with open(os.path.join(output_dir, '%sinstances.csv' % count)) as f:
+        for row in csv.DictReader(f):
+            if float(row['Time']) >= warmup:
+                means.setdefault(row['Instance'], []).append(float(row['FrameMs']))
+                p99s.setdefault(row['Instance'], []).append(float(row['FrameMsP99']))
+    frames = [ms for values in means.values() for ms in values]
+    mean = sum(frames) / len(frames) if frames else 0.0
+    # Each report carries the p99 of its own interval's frames; an instance's figure is the p99 of those, so one bad
+    # second in a hundred is enough to show.
+    worst_p99 = max([percentile(values, 99) for values in p99s.values()] or [0.0])
+    with open(os.path.join(output_dir, '%sinstances_pss.txt' % count)) as f:
+        pss_mb = int(f.read().strip() or 0) / 1024.0 / int(count)
+    in_budget = len(means) == int(count) and worst_p99 <= budget
+    if in_budget:
+        matches_per_host = max(matches_per_host, int(count))
+    print('%10s %12.2f %16.2f %14.1f %10s' % (count, mean, worst_p99, pss_mb, 'yes' if in_budget else 'no'))
+print('Matches per host within %.1f ms: %d' % (budget, matches_per_host))
+EOF
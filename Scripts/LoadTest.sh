@@ -0,0 +1,72 @@
+#!/usr/bin/env bash
+# Runs a Linux dedicated server and a number of headless bot clients on this machine over loopback, and collects the
+# server's metrics CSVs. Requires a packaged Linux build containing both the ThirdPersonMP (client) and
+# ThirdPersonMPServer (dedicated server, needs a source-built engine) targets.
+#
+# Usage: Scripts/LoadTest.sh <PackagedLinuxDir> [ClientCounts="8 16 32 64 128"] [DurationSeconds=120] [OutputDir=Saved/LoadTest]
+#
+# For each client count, writes <OutputDir>/<N>clients.csv (one row per second: frame time and net tick percentiles,
+# bandwidth totals, projectile counts) and <OutputDir>/<N>clients_connections.csv (one row per connection per second,
+# with the replication graph's bandwidth estimate and bytes per category).
+#
+# Extra server arguments can be passed in SERVER_EXTRA_ARGS, e.g. to compare serial and parallel character work:
+#   SERVER_EXTRA_ARGS='-ExecCmds=ThirdPersonMP.ParallelCharacterWork 1' Scripts/LoadTest.sh <PackagedLinuxDir>
+# (Scripts/ParallelCharacterWorkBenchmark.sh runs both settings and compares them),
+# or to add NPC targets for the bots to shoot at:
+#   SERVER_EXTRA_ARGS='-CrowdAgents=1000' Scripts/LoadTest.sh <PackagedLinuxDir>
+# or to record each run as a replay, for Scripts/PlayReplay.sh:
+#   SERVER_EXTRA_ARGS='-RecordReplay' Scripts/LoadTest.sh <PackagedLinuxDir>
+
+set -euo pipefail
+
+BUILD_DIR=${1:?usage: LoadTest.sh <PackagedLinuxDir> [ClientCounts] [DurationSeconds] [OutputDir]}
+CLIENT_COUNTS=${2:-"8 16 32 64 128"}
+DURATION=${3:-120}
+OUTPUT_DIR=$(realpath -m "${4:-Saved/LoadTest}")
+
+MAP=/Game/ThirdPersonCPP/Maps/ThirdPersonExampleMap
+PORT=7777
+SERVER_BIN="$BUILD_DIR/LinuxServer/ThirdPersonMP/Binaries/Linux/ThirdPersonMPServer"
+CLIENT_BIN="$BUILD_DIR/LinuxNoEditor/ThirdPersonMP/Binaries/Linux/ThirdPersonMP"
+SERVER_EXTRA_ARGS=${SERVER_EXTRA_ARGS:-}
+
+# Bots only need to simulate and send input, so keep them cheap: no rendering, no audio, 30 fps.
+CLIENT_ARGS=(-game -nullrhi -nosound -unattended -nosplash -LoadTestBot "-ExecCmds=t.MaxFPS 30")
+
+mkdir -p "$OUTPUT_DIR"
+
+CLIENT_PIDS=()
+stop_clients() {
+	if [ ${#CLIENT_PIDS[@]} -gt 0 ]; then
+		kill "${CLIENT_PIDS[@]}" 2>/dev/null || true
+		wait "${CLIENT_PIDS[@]}" 2>/dev/null || true
+	fi
+	CLIENT_PIDS=()
+}
+trap stop_clients EXIT
+
+for NUM_CLIENTS in $CLIENT_COUNTS; do
+	echo "Load test: $NUM_CLIENTS clients for $DURATION seconds"
+
+	# The server stops itself after the duration, which ends the run.
+	"$SERVER_BIN" "$MAP" -log -unattended -port=$PORT \
+		"-LoadTestMetrics=$OUTPUT_DIR/${NUM_CLIENTS}clients.csv" "-LoadTestDuration=$DURATION" \
+		${SERVER_EXTRA_ARGS:+"$SERVER_EXTRA_ARGS"} \
+		> "$OUTPUT_DIR/${NUM_CLIENTS}clients_server.log" 2>&1 &
+	SERVER_PID=$!
+
+	# Give the server time to load the map and start listening.
+	sleep 10
+
+	for ((i = 0; i < NUM_CLIENTS; i++)); do
+		"$CLIENT_BIN" 127.0.0.1:$PORT "${CLIENT_ARGS[@]}" "-BotSeed=$i" > /dev/null 2>&1 &
+		CLIENT_PIDS+=($!)
+		# Stagger joins so the server is not hit by every login in the same frame.
+		sleep 0.2
+	done
+
+	wait $SERVER_PID || true
+	stop_clients
+done
+
+echo "Load test results written to $OUTPUT_DIR"
@@ -0,0 +1,47 @@
+#!/usr/bin/env bash
+# Compares the server's game thread frame time with per-character work serial and parallel
+# (ThirdPersonMP.ParallelCharacterWork 0 and 1), at 128 connected bots. Runs Scripts/LoadTest.sh once per setting and
+# prints the mean per-second frame time percentiles of each, taken once every bot has joined. Needs the same packaged
+# build as LoadTest.sh.
+#
+# Usage: Scripts/ParallelCharacterWorkBenchmark.sh <PackagedLinuxDir> [Clients=128] [DurationSeconds=120] [OutputDir=Saved/ParallelCharacterWorkBenchmark]
+#
+# ThirdPersonMP.ParallelCharacterWork.Benchmark times the lag compensation capture, health resolution and significance
+# scoring on their own; this measures whole frames, so it also shows what the task dispatch and the rest of the frame
+# make of the difference.
+
+set -euo pipefail
+
+BUILD_DIR=${1:?usage: ParallelCharacterWorkBenchmark.sh <PackagedLinuxDir> [Clients] [DurationSeconds] [OutputDir]}
+CLIENTS=${2:-128}
+DURATION=${3:-120}
+OUTPUT_DIR=$(realpath -m "${4:-Saved/ParallelCharacterWorkBenchmark}")
+
+SCRIPT_DIR=$(dirname "$(realpath "$0")")
+
+for PARALLEL in 0 1; do
+	echo "Parallel character work benchmark: ThirdPersonMP.ParallelCharacterWork=$PARALLEL"
+	SERVER_EXTRA_ARGS="-ExecCmds=ThirdPersonMP.ParallelCharacterWork $PARALLEL" \
+		"$SCRIPT_DIR/LoadTest.sh" "$BUILD_DIR" "$CLIENTS" "$DURATION" "$OUTPUT_DIR/parallel$PARALLEL"
+done
+
+python3 - "$OUTPUT_DIR" "$CLIENTS" <<'PYTHON'
+import csv, os, sys
+
+output_dir, clients = sys.argv[1], int(sys.argv[2])
+
+def mean_frame(parallel):
+    with open(os.path.join(output_dir, "parallel%d" % parallel, "%dclients.csv" % clients)) as f:
+        rows = [row for row in csv.DictReader(f) if int(row["Connections"]) >= clients]
+    if not rows:
+        return 0, 0.0, 0.0
+    return (len(rows), sum(float(row["FrameMsP50"]) for row in rows) / len(rows),
+            sum(float(row["FrameMsP99"]) for row in rows) / len(rows))
+
+serial, parallel = mean_frame(0), mean_frame(1)
+print("ParallelCharacterWork, Seconds, FrameMsP50, FrameMsP99")
+print("off, %d, %.4f, %.4f" % serial)
+print("on, %d, %.4f, %.4f" % parallel)
+if serial[1] > 0.0 and serial[2] > 0.0:
+    print("Reduction: %.1f%% at p50, %.1f%% at p99" % (100.0 * (1.0 - parallel[1] / serial[1]), 100.0 * (1.0 - parallel[2] / serial[2])))
+PYTHON
@@ -0,0 +1,42 @@
+#!/usr/bin/env bash
+# Plays a recorded match back through a headless Linux client and collects a CSV profile of the playback, to re-run a
+# match's traffic through an instrumented build. Requires a packaged Linux build containing the ThirdPersonMP (client)
+# target. Replays are recorded by servers started with -RecordReplay[=<Name>] (see LoadTest.sh), under
+# <ServerDir>/ThirdPersonMP/Saved/Demos.
+#
+# Usage: Scripts/PlayReplay.sh <PackagedLinuxDir> <ReplayFile> [OutputDir=Saved/ReplayPlayback]
+#
+# Writes <OutputDir>/<Name>.log, and the client's CSV profile of the whole playback to <OutputDir>/Profiling.
+# Extra client arguments can be passed in CLIENT_EXTRA_ARGS, e.g. '-trace=cpu' for an Unreal Insights capture.
+
+set -euo pipefail
+
+BUILD_DIR=${1:?usage: PlayReplay.sh <PackagedLinuxDir> <ReplayFile> [OutputDir]}
+REPLAY_FILE=$(realpath "${2:?usage: PlayReplay.sh <PackagedLinuxDir> <ReplayFile> [OutputDir]}")
+OUTPUT_DIR=$(realpath -m "${3:-Saved/ReplayPlayback}")
+
+CLIENT_DIR="$BUILD_DIR/LinuxNoEditor/ThirdPersonMP"
+CLIENT_BIN="$CLIENT_DIR/Binaries/Linux/ThirdPersonMP"
+CLIENT_EXTRA_ARGS=${CLIENT_EXTRA_ARGS:-}
+REPLAY_NAME=$(basename "$REPLAY_FILE" .replay)
+
+# The local file streamer looks replays up by name in the client's own demo folder.
+mkdir -p "$CLIENT_DIR/Saved/Demos" "$OUTPUT_DIR"
+if [ "$REPLAY_FILE" != "$(realpath -m "$CLIENT_DIR/Saved/Demos/$REPLAY_NAME.replay")" ]; then
+	cp "$REPLAY_FILE" "$CLIENT_DIR/Saved/Demos/"
+fi
+
+echo "Playing replay $REPLAY_NAME"
+
+# No rendering or audio, and no frame cap, so the profile shows the cost of the game code the replay drives.
+"$CLIENT_BIN" -game -nullrhi -nosound -unattended -nosplash -ReplayExitOnEnd \
+	"-ExecCmds=csvprofile start, demoplay $REPLAY_NAME" \
+	${CLIENT_EXTRA_ARGS:+"$CLIENT_EXTRA_ARGS"} \
+	> "$OUTPUT_DIR/$REPLAY_NAME.log" 2>&1 || true
+
+# The client ends the CSV capture when the replay finishes, which writes the file.
+if [ -d "$CLIENT_DIR/Saved/Profiling" ]; then
+	cp -r "$CLIENT_DIR/Saved/Profiling" "$OUTPUT_DIR/"
+fi
+
+echo "Replay playback results written to $OUTPUT_DIR"
@@ -0,0 +1,45 @@
+#!/usr/bin/env bash
+# Compares the server's net tick time with push-model replication off and on, at 100 connected bots (so 100 replicated
+# characters, plus their projectiles and player states). Runs Scripts/LoadTest.sh once per setting and prints the mean
+# per-second net tick percentiles of each, taken once every bot has joined. Needs the same packaged build as LoadTest.sh.
+#
+# Usage: Scripts/PushModelBenchmark.sh <PackagedLinuxDir> [Clients=100] [DurationSeconds=120] [OutputDir=Saved/PushModelBenchmark]
+#
+# The net tick covers receiving and sending, so the difference between the runs is the property comparisons the net
+# broadcast tick no longer does for push-based properties.
+
+set -euo pipefail
+
+BUILD_DIR=${1:?usage: PushModelBenchmark.sh <PackagedLinuxDir> [Clients] [DurationSeconds] [OutputDir]}
+CLIENTS=${2:-100}
+DURATION=${3:-120}
+OUTPUT_DIR=$(realpath -m "${4:-Saved/PushModelBenchmark}")
+
+SCRIPT_DIR=$(dirname "$(realpath "$0")")
+
+for PUSH_MODEL in 0 1; do
+	echo "Push model benchmark: net.IsPushModelEnabled=$PUSH_MODEL"
+	SERVER_EXTRA_ARGS="-ExecCmds=net.IsPushModelEnabled $PUSH_MODEL" \
+		"$SCRIPT_DIR/LoadTest.sh" "$BUILD_DIR" "$CLIENTS" "$DURATION" "$OUTPUT_DIR/push$PUSH_MODEL"
+done
+
+python3 - "$OUTPUT_DIR" "$CLIENTS" <<'PYTHON'
+import csv, os, sys
+
+output_dir, clients = sys.argv[1], int(sys.argv[2])
+
+def mean_net_tick(push_model):
+    with open(os.path.join(output_dir, "push%d" % push_model, "%dclients.csv" % clients)) as f:
+        rows = [row for row in csv.DictReader(f) if int(row["Connections"]) >= clients]
+    if not rows:
+        return 0, 0.0, 0.0
+    return (len(rows), sum(float(row["NetTickMsP50"]) for row in rows) / len(rows),
+            sum(float(row["NetTickMsP99"]) for row in rows) / len(rows))
+
+off, on = mean_net_tick(0), mean_net_tick(1)
+print("PushModel, Seconds, NetTickMsP50, NetTickMsP99")
+print("off, %d, %.4f, %.4f" % off)
+print("on, %d, %.4f, %.4f" % on)
+if off[1] > 0.0 and off[2] > 0.0:
+    print("Reduction: %.1f%% at p50, %.1f%% at p99" % (100.0 * (1.0 - on[1] / off[1]), 100.0 * (1.0 - on[2] / off[2])))
+PYTHON
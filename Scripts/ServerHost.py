@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Runs several ThirdPersonMP dedicated server instances on one Linux host, with a local session router in front.
+
+Every instance runs from the same packaged build, so they all read the same cooked pak files and the OS page cache
+keeps one copy of the content for all of them. Each instance is pinned to its own core, reports its load to the
+router (Scripts/SessionRouter.py), and is restarted if it exits before the host is stopped. Clients ask the router
+where to connect: `Scripts/SessionRouter.py join`.
+
+Usage:
+    Scripts/ServerHost.py <PackagedLinuxDir> [--instances N] [--first-port 7777] [--router-port 7900]
+                          [--cores 1,2,3] [--duration SECONDS] [--log-dir Saved/ServerHost] [--router-log reports.csv]
+                          [-- extra server arguments]
+
+Instances default to one per core, leaving core 0 for the router and the OS.
+"""
+
+import argparse
+import os
+import signal
+import subprocess
+import sys
+import time
+
+MAP = '/Game/ThirdPersonCPP/Maps/ThirdPersonExampleMap'
+# Seconds to wait before restarting an instance that exited, doubled for each exit in a row up to a minute.
+RESTART_DELAY = 2.0
+
+
+class ServerInstance(object):
+    def __init__(self, index, port, core, args):
+        self.index = index
+        self.port = port
+        self.core = core
+        self.args = args
+        self.process = None
+        self.log = None
+        self.restart_delay = RESTART_DELAY
+        self.restart_at = 0.0
+
+    def start(self):
+        server_bin = os.path.join(self.args.build_dir, 'LinuxServer', 'ThirdPersonMP', 'Binaries', 'Linux', 'ThirdPersonMPServer')
+        command = [server_bin, MAP, '-log', '-unattended', '-nosound', '-port=%d' % self.port,
+                   '-SessionRouter=127.0.0.1:%d' % self.args.router_port, '-InstanceId=%d' % self.index] + self.args.server_args
+        self.log = open(os.path.join(self.args.log_dir, 'instance%d.log' % self.index), 'a')
+        # Pinned in the child before exec, so every thread the server ever creates inherits the mask. Pinning after
+        # Popen would leave threads started in the meantime free to run on any core.
+        core = self.core
+        preexec_fn = (lambda: os.sched_setaffinity(0, {core})) if core is not None else None
+        self.process = subprocess.Popen(command, stdout=self.log, stderr=subprocess.STDOUT, preexec_fn=preexec_fn)
+        print('Instance %d: pid %d, port %d, core %s' % (self.index, self.process.pid, self.port, self.core))
+
+    def supervise(self, now):
+        if self.process is not None and self.process.poll() is not None:
+            print('Instance %d exited with %d, restarting in %.0f s' % (self.index, self.process.returncode, self.restart_delay))
+            self.log.close()
+            self.process = None
+            self.restart_at = now + self.restart_delay
+            self.restart_delay = min(self.restart_delay * 2.0, 60.0)
+        elif self.process is None and now >= self.restart_at:
+            self.start()
+        elif self.process is not None and now - self.restart_at > 60.0:
+            self.restart_delay = RESTART_DELAY
+
+    def stop(self):
+        if self.process is not None and self.process.poll() is None:
+            self.process.send_signal(signal.SIGINT)
+            try:
+                self.process.wait(timeout=15)
+            except subprocess.TimeoutExpired:
+                self.process.kill()
+                self.process.wait()
+        if self.log:
+            self.log.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Runs and supervises several server instances behind a session router.')
+    parser.add_argument('build_dir', help='packaged build directory containing LinuxServer')
+    parser.add_argument('--instances', type=int, default=max(os.cpu_count() - 1, 1))
+    parser.add_argument('--first-port', type=int, default=7777)
+    parser.add_argument('--router-port', type=int, default=7900)
+    parser.add_argument('--cores', help='comma separated cores to pin instances to, in order; default 1, 2, ...')
+    parser.add_argument('--duration', type=float, default=0.0, help='stop everything after this many seconds; 0 runs until interrupted')
+    parser.add_argument('--log-dir', default='Saved/ServerHost')
+    parser.add_argument('--router-log', help='CSV file the router writes every report to')
+    parser.add_argument('server_args', nargs=argparse.REMAINDER, help='extra server arguments, after --')
+    args = parser.parse_args()
+    args.server_args = [a for a in args.server_args if a != '--']
+
+    os.makedirs(args.log_dir, exist_ok=True)
+    available = sorted(os.sched_getaffinity(0))
+    cores = [int(c) for c in args.cores.split(',')] if args.cores else [c for c in available if c != 0] or available
+
+    router_command = [sys.executable, '-u', os.path.join(os.path.dirname(os.path.abspath(__file__)), 'SessionRouter.py'),
+                      'serve', '--port', str(args.router_port)]
+    if args.router_log:
+        router_command += ['--log', args.router_log]
+    router = subprocess.Popen(router_command)
+    if available:
+        os.sched_setaffinity(router.pid, {available[0]})
+
+    instances = [ServerInstance(i, args.first_port + i, cores[i % len(cores)] if cores else None, args) for i in range(args.instances)]
+    if args.instances > len(cores):
+        print('Warning: %d instances share %d cores' % (args.instances, len(cores)))
+
+    stopping = []
+    signal.signal(signal.SIGTERM, lambda *_: stopping.append(True))
+    start_time = time.time()
+    try:
+        while not stopping and (args.duration <= 0.0 or time.time() - start_time < args.duration):
+            now = time.time()
+            for instance in instances:
+                instance.supervise(now)
+            if router.poll() is not None:
+                print('Router exited with %d, restarting' % router.returncode)
+                router = subprocess.Popen(router_command)
+            time.sleep(1.0)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        for instance in instances:
+            instance.stop()
+        router.terminate()
+        router.wait()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,224 @@
+#!/usr/bin/env python3
+"""Local session router for several ThirdPersonMP server instances on one host.
+
+Servers started with -SessionRouter=<ip:port> (see AServerInstanceReporter) send a UDP report every second with their
+player count and game thread frame time. Clients ask the router where to play over TCP, one line per request:
+
+    JOIN    -> "<ip>:<port>" of the least loaded instance with room, or "FULL"
+    STATUS  -> one line of JSON describing every live instance
+
+An instance's load is the larger of its player fill and its frame time against the frame budget; players the router
+has just sent to an instance count until they show up in its reports. This stands in for a matchmaking service, so
+everything runs locally without one.
+
+Usage:
+    SessionRouter.py serve [--port 7900] [--public-host 127.0.0.1] [--frame-budget-ms 33.3] [--log reports.csv]
+    SessionRouter.py join [--router 127.0.0.1:7900]
+    SessionRouter.py status [--router 127.0.0.1:7900]
+"""
+
+import argparse
+import csv
+import json
+import selectors
+import socket
+import sys
+import time
+
+# Seconds without a report after which an instance is considered gone.
+STALE_SECONDS = 5.0
+# Seconds a player sent to an instance is counted against it before its reports are trusted to include them.
+PENDING_SECONDS = 15.0
+
+
+class Instance(object):
+    def __init__(self, instance_id, port):
+        self.instance_id = instance_id
+        self.port = port
+        self.players = 0
+        self.max_players = 0
+        self.frame_ms = 0.0
+        self.frame_ms_p99 = 0.0
+        self.frame_ms_max = 0.0
+        self.last_report = 0.0
+        self.reported_players_at_assign = []  # (time, players reported when the player was sent)
+
+    def effective_players(self, now):
+        pending = [(t, p) for t, p in self.reported_players_at_assign if now - t < PENDING_SECONDS]
+        # Players who showed up since an assignment account for it and the ones before it, so retire oldest first, and
+        # only as many as arrived: one arrival must not clear a whole burst of assignments made at the same count.
+        retired = 0
+        for index, (t, p) in enumerate(pending):
+            retired = max(retired, min(self.players - p, index + 1))
+        self.reported_players_at_assign = pending[retired:]
+        return self.players + len(self.reported_players_at_assign)
+
+    def load(self, now, frame_budget_ms):
+        fill = self.effective_players(now) / float(self.max_players) if self.max_players > 0 else 0.0
+        return max(fill, self.frame_ms / frame_budget_ms)
+
+    def has_room(self, now):
+        return self.max_players <= 0 or self.effective_players(now) < self.max_players
+
+    def to_json(self, now, frame_budget_ms):
+        return {
+            'instance': self.instance_id,
+            'port': self.port,
+            'players': self.players,
+            'pending': self.effective_players(now) - self.players,
+            'maxPlayers': self.max_players,
+            'frameMs': self.frame_ms,
+            'frameMsP99': self.frame_ms_p99,
+            'frameMsMax': self.frame_ms_max,
+            'load': round(self.load(now, frame_budget_ms), 3),
+        }
+
+
+class Router(object):
+    def __init__(self, args):
+        self.args = args
+        self.instances = {}
+        self.start_time = time.time()
+        self.log_writer = None
+        if args.log:
+            self.log_file = open(args.log, 'w', newline='')
+            self.log_writer = csv.writer(self.log_file)
+            self.log_writer.writerow(['Time', 'Instance', 'Port', 'Players', 'MaxPlayers', 'FrameMs', 'FrameMsP99', 'FrameMsMax'])
+
+    def on_report(self, data):
+        try:
+            report = json.loads(data.decode('utf-8'))
+        except ValueError:
+            return
+
+        now = time.time()
+        instance_id = report.get('instance')
+        if report.get('stopping'):
+            self.instances.pop(instance_id, None)
+            return
+
+        instance = self.instances.get(instance_id)
+        if instance is None:
+            instance = self.instances[instance_id] = Instance(instance_id, report.get('port', 0))
+            print('Instance %s on port %d is up' % (instance_id, instance.port))
+        instance.port = report.get('port', instance.port)
+        instance.players = report.get('players', 0)
+        instance.max_players = report.get('maxPlayers', 0)
+        instance.frame_ms = report.get('frameMs', 0.0)
+        instance.frame_ms_p99 = report.get('frameMsP99', 0.0)
+        instance.frame_ms_max = report.get('frameMsMax', 0.0)
+        instance.last_report = now
+
+        if self.log_writer:
+            self.log_writer.writerow(['%.2f' % (now - self.start_time), instance_id, instance.port, instance.players,
+                                      instance.max_players, instance.frame_ms, instance.frame_ms_p99, instance.frame_ms_max])
+            self.log_file.flush()
+
+    def live_instances(self, now):
+        for instance_id in [i for i, instance in self.instances.items() if now - instance.last_report > STALE_SECONDS]:
+            print('Instance %s stopped reporting' % instance_id)
+            del self.instances[instance_id]
+        return list(self.instances.values())
+
+    def on_request(self, line):
+        now = time.time()
+        command = line.strip().upper()
+        if command == 'JOIN':
+            candidates = [i for i in self.live_instances(now) if i.has_room(now)]
+            if not candidates:
+                return 'FULL'
+            best = min(candidates, key=lambda i: (i.load(now, self.args.frame_budget_ms), i.effective_players(now)))
+            best.reported_players_at_assign.append((now, best.players))
+            return '%s:%d' % (self.args.public_host, best.port)
+        if command == 'STATUS':
+            return json.dumps([i.to_json(now, self.args.frame_budget_ms) for i in self.live_instances(now)])
+        return 'ERROR unknown command'
+
+    def serve(self):
+        selector = selectors.DefaultSelector()
+
+        reports = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        reports.bind(('127.0.0.1', self.args.port))
+        reports.setblocking(False)
+        selector.register(reports, selectors.EVENT_READ, 'reports')
+
+        requests = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        requests.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        requests.bind((self.args.bind, self.args.port))
+        requests.listen(64)
+        requests.setblocking(False)
+        selector.register(requests, selectors.EVENT_READ, 'listen')
+
+        print('Session router listening on port %d' % self.args.port)
+        buffers = {}
+        while True:
+            for key, _ in selector.select(timeout=1.0):
+                if key.data == 'reports':
+                    while True:
+                        try:
+                            data, _ = reports.recvfrom(2048)
+                        except BlockingIOError:
+                            break
+                        self.on_report(data)
+                elif key.data == 'listen':
+                    connection, _ = requests.accept()
+                    connection.setblocking(False)
+                    buffers[connection] = b''
+                    selector.register(connection, selectors.EVENT_READ, 'client')
+                else:
+                    connection = key.fileobj
+                    try:
+                        data = connection.recv(1024)
+                    except ConnectionError:
+                        data = b''
+                    buffers[connection] += data
+                    while b'\n' in buffers[connection]:
+                        line, buffers[connection] = buffers[connection].split(b'\n', 1)
+                        connection.sendall((self.on_request(line.decode('utf-8', 'replace')) + '\n').encode('utf-8'))
+                    if not data:
+                        selector.unregister(connection)
+                        connection.close()
+                        del buffers[connection]
+
+
+def request(router, command):
+    host, port = router.rsplit(':', 1)
+    with socket.create_connection((host, int(port)), timeout=5.0) as connection:
+        connection.sendall((command + '\n').encode('utf-8'))
+        reply = b''
+        while not reply.endswith(b'\n'):
+            data = connection.recv(4096)
+            if not data:
+                break
+            reply += data
+    return reply.decode('utf-8').strip()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Assigns clients to the least loaded local server instance.')
+    subparsers = parser.add_subparsers(dest='mode')
+    serve = subparsers.add_parser('serve')
+    serve.add_argument('--port', type=int, default=7900, help='UDP port for reports and TCP port for requests')
+    serve.add_argument('--bind', default='0.0.0.0', help='address clients connect to the router on')
+    serve.add_argument('--public-host', default='127.0.0.1', help='address handed to clients for the instances')
+    serve.add_argument('--frame-budget-ms', type=float, default=33.3, help='game thread milliseconds an instance may use per frame')
+    serve.add_argument('--log', help='CSV file to append every report to')
+    for name in ('join', 'status'):
+        client = subparsers.add_parser(name)
+        client.add_argument('--router', default='127.0.0.1:7900')
+    args = parser.parse_args()
+
+    if args.mode == 'serve':
+        Router(args).serve()
+    elif args.mode in ('join', 'status'):
+        reply = request(args.router, args.mode.upper())
+        print(reply)
+        return 1 if reply in ('FULL', '') else 0
+    else:
+        parser.print_help()
+        return 2
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
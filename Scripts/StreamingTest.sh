@@ -0,0 +1,48 @@
+#!/usr/bin/env bash
+# Flies across a grid-streamed map headlessly (AWorldStreamingFlythrough) as a client and as a dedicated server, and
+# prints the streaming stalls and hitches of each. Requires a packaged Linux build containing both the ThirdPersonMP
+# (client) and ThirdPersonMPServer (dedicated server) targets, and a map whose AMyWorldSettings enables grid streaming.
+#
+# Usage: Scripts/StreamingTest.sh <PackagedLinuxDir> <Map> [FlySpeed=2000] [OutputDir=Saved/StreamingTest]
+#
+# Writes <OutputDir>/client.json and <OutputDir>/server.json: every stall (time, cell, seconds waited), the frames over
+# the hitch threshold, the most cells loaded at once and the peak memory. Exits nonzero if either run stalled.
+
+set -euo pipefail
+
+BUILD_DIR=${1:?usage: StreamingTest.sh <PackagedLinuxDir> <Map> [FlySpeed] [OutputDir]}
+MAP=${2:?usage: StreamingTest.sh <PackagedLinuxDir> <Map> [FlySpeed] [OutputDir]}
+FLY_SPEED=${3:-2000}
+OUTPUT_DIR=$(realpath -m "${4:-Saved/StreamingTest}")
+
+SERVER_BIN="$BUILD_DIR/LinuxServer/ThirdPersonMP/Binaries/Linux/ThirdPersonMPServer"
+CLIENT_BIN="$BUILD_DIR/LinuxNoEditor/ThirdPersonMP/Binaries/Linux/ThirdPersonMP"
+
+mkdir -p "$OUTPUT_DIR"
+
+# A standalone game streams whole cells like a client; nothing is rendered, but every level is loaded and added.
+echo "Streaming flythrough: client"
+"$CLIENT_BIN" "$MAP" -game -nullrhi -nosound -unattended -nosplash -log \
+	"-StreamingFlythrough=$OUTPUT_DIR/client.json" "-StreamingFlythroughSpeed=$FLY_SPEED" \
+	> "$OUTPUT_DIR/client.log" 2>&1
+
+echo "Streaming flythrough: dedicated server"
+"$SERVER_BIN" "$MAP" -nullrhi -nosound -unattended -log \
+	"-StreamingFlythrough=$OUTPUT_DIR/server.json" "-StreamingFlythroughSpeed=$FLY_SPEED" \
+	> "$OUTPUT_DIR/server.log" 2>&1
+
+python3 - "$OUTPUT_DIR" <<'PYTHON'
+import json, os, sys
+
+output_dir = sys.argv[1]
+print("Run, Stalls, StallSeconds, HitchFrames, FrameMsP99, FrameMsMax, PeakLoadedCells, PeakUsedPhysicalMB")
+stalled = False
+for run in ("client", "server"):
+    with open(os.path.join(output_dir, run + ".json")) as f:
+        summary = json.load(f)["summary"]
+    stalled = stalled or summary["stalls"] > 0
+    print("%s, %d, %.3f, %d, %.3f, %.3f, %d, %.1f" % (run, summary["stalls"], summary["stallSeconds"], summary["hitchFrames"],
+                                                   summary["frameMsP99"], summary["frameMsMax"], summary["peakLoadedCells"],
+                                                   summary["peakUsedPhysicalMB"]))
+sys.exit(1 if stalled else 0)
+PYTHON
@@ -9,6 +9,7 @@ public class ThirdPersonMPTarget : TargetRules
 	{
 		Type = TargetType.Game;
 		DefaultBuildSettings = BuildSettingsVersion.V2;
+
 		ExtraModuleNames.Add("ThirdPersonMP");
 	}
 }
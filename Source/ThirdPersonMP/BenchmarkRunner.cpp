@@ -0,0 +1,387 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "BenchmarkRunner.h"
+#include "ThirdPersonMP.h"
+#include "ThirdPersonMPCharacter.h"
+#include "LoadTestMetricsRecorder.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/PlayerStart.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+
+void FBenchmarkPhysicsTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Runner)
+	{
+		Runner->OnPhysicsMarker(bEndOfPhysics);
+	}
+}
+
+FString FBenchmarkPhysicsTickFunction::DiagnosticMessage()
+{
+	return bEndOfPhysics ? TEXT("FBenchmarkPhysicsTickFunction[End]") : TEXT("FBenchmarkPhysicsTickFunction[Start]");
+}
+
+ABenchmarkRunner::ABenchmarkRunner()
+{
+	//Bots' input has to be in place before their movement ticks.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	bReplicates = false;
+
+	FixedTickRate = 30.0f;
+	WarmupFrames = 60;
+	NumFrames = 3000;
+	Seed = 1;
+
+	NextInput = 0;
+	FrameStartTime = 0.0;
+	PhysicsStartTime = 0.0;
+	PostActorTickTime = 0.0;
+	PhysicsTime = 0.0;
+	NetTickTime = 0.0;
+	FrameNumber = 0;
+	FramesToMeasure = 0;
+	ActiveSeed = 0;
+}
+
+bool ABenchmarkRunner::GetScriptPath(FString& OutPath)
+{
+	return FParse::Value(FCommandLine::Get(), TEXT("BenchmarkScript="), OutPath) && !OutPath.IsEmpty();
+}
+
+void ABenchmarkRunner::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	if (!GetScriptPath(ScriptPath) || !LoadScript(ScriptPath))
+	{
+		UE_LOG(LogThirdPersonMP, Error, TEXT("Benchmark: could not read input script %s."), *ScriptPath);
+		Inputs.Reset();
+	}
+
+	if (!FParse::Value(FCommandLine::Get(), TEXT("BenchmarkOutput="), OutputPath) || OutputPath.IsEmpty())
+	{
+		OutputPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmark.json"));
+	}
+
+	FramesToMeasure = NumFrames;
+	FParse::Value(FCommandLine::Get(), TEXT("BenchmarkFrames="), FramesToMeasure);
+	FramesToMeasure = FMath::Max(FramesToMeasure, 1);
+
+	ActiveSeed = Seed;
+	FParse::Value(FCommandLine::Get(), TEXT("BenchmarkSeed="), ActiveSeed);
+
+	//Spawned by the game mode before anything else has begun play, so everything that seeds itself from the global
+	//streams (the crowd, for one) gets the same numbers every run. The fixed step also runs frames back to back, with no
+	//wait for the server's tick rate.
+	FMath::RandInit(ActiveSeed);
+	FMath::SRandInit(ActiveSeed);
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(1.0 / FMath::Max(FixedTickRate, 1.0f));
+}
+
+bool ABenchmarkRunner::LoadScript(const FString& Path)
+{
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *Path))
+	{
+		return false;
+	}
+
+	TArray<FString> Fields;
+	for (const FString& Line : Lines)
+	{
+		//Skips blank lines, comments and the header, none of which start with a frame number.
+		const FString Trimmed = Line.TrimStartAndEnd();
+		if (Trimmed.IsEmpty() || !FChar::IsDigit(Trimmed[0]))
+		{
+			continue;
+		}
+
+		Trimmed.ParseIntoArray(Fields, TEXT(","), false);
+		if (Fields.Num() < 7)
+		{
+			UE_LOG(LogThirdPersonMP, Warning, TEXT("Benchmark: skipping malformed input row '%s'."), *Trimmed);
+			continue;
+		}
+
+		FScriptedInput& Input = Inputs.AddDefaulted_GetRef();
+		Input.Frame = FCString::Atoi(*Fields[0]);
+		Input.Bot = FMath::Max(FCString::Atoi(*Fields[1]), 0);
+		Input.Forward = FCString::Atof(*Fields[2]);
+		Input.Right = FCString::Atof(*Fields[3]);
+		Input.TurnRate = FCString::Atof(*Fields[4]);
+		Input.LookUpRate = FCString::Atof(*Fields[5]);
+		Input.bFire = FCString::Atoi(*Fields[6]) != 0;
+	}
+
+	//Stable, so rows for the same bot and frame keep their order and the last one wins.
+	Inputs.StableSort([](const FScriptedInput& A, const FScriptedInput& B) { return A.Frame < B.Frame; });
+	return true;
+}
+
+void ABenchmarkRunner::BeginPlay()
+{
+	Super::BeginPlay();
+
+	int32 NumBots = 0;
+	for (const FScriptedInput& Input : Inputs)
+	{
+		NumBots = FMath::Max(NumBots, Input.Bot + 1);
+	}
+	SpawnBots(NumBots);
+
+	//Physics runs between these two markers: the start one before the world's start physics tick, the end one after its end physics tick.
+	UWorld* World = GetWorld();
+	StartPhysicsMarker.Runner = this;
+	StartPhysicsMarker.bEndOfPhysics = false;
+	StartPhysicsMarker.bCanEverTick = true;
+	StartPhysicsMarker.bHighPriority = true;
+	StartPhysicsMarker.TickGroup = TG_StartPhysics;
+	StartPhysicsMarker.RegisterTickFunction(GetLevel());
+	World->StartPhysicsTickFunction.AddPrerequisite(this, StartPhysicsMarker);
+
+	EndPhysicsMarker.Runner = this;
+	EndPhysicsMarker.bEndOfPhysics = true;
+	EndPhysicsMarker.bCanEverTick = true;
+	EndPhysicsMarker.TickGroup = TG_EndPhysics;
+	EndPhysicsMarker.RegisterTickFunction(GetLevel());
+	EndPhysicsMarker.AddPrerequisite(World, World->EndPhysicsTickFunction);
+
+	GameThreadTimes.Reserve(FramesToMeasure);
+	PhysicsTimes.Reserve(FramesToMeasure);
+	NetTickTimes.Reserve(FramesToMeasure);
+
+	TickStartHandle = FWorldDelegates::OnWorldTickStart.AddUObject(this, &ABenchmarkRunner::OnWorldTickStart);
+	TickDispatchHandle = World->TickDispatchEvent.AddUObject(this, &ABenchmarkRunner::OnTickDispatch);
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &ABenchmarkRunner::OnWorldPostActorTick);
+	TickFlushHandle = World->TickFlushEvent.AddUObject(this, &ABenchmarkRunner::OnTickFlush);
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &ABenchmarkRunner::OnEndFrame);
+
+	UE_LOG(LogThirdPersonMP, Log, TEXT("Benchmark: %d bots, %d input rows, seed %d, %.0f Hz fixed step, %d warmup and %d measured frames."),
+		Bots.Num(), Inputs.Num(), ActiveSeed, FixedTickRate, WarmupFrames, FramesToMeasure);
+}
+
+void ABenchmarkRunner::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UWorld* World = GetWorld();
+	if (StartPhysicsMarker.IsTickFunctionRegistered())
+	{
+		World->StartPhysicsTickFunction.RemovePrerequisite(this, StartPhysicsMarker);
+		StartPhysicsMarker.UnRegisterTickFunction();
+		EndPhysicsMarker.UnRegisterTickFunction();
+	}
+
+	FWorldDelegates::OnWorldTickStart.Remove(TickStartHandle);
+	World->TickDispatchEvent.Remove(TickDispatchHandle);
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+	World->TickFlushEvent.Remove(TickFlushHandle);
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ABenchmarkRunner::SpawnBots(int32 NumBots)
+{
+	//The game mode's pawn class is the character blueprint, with the mesh and settings players get.
+	UClass* BotClass = AThirdPersonMPCharacter::StaticClass();
+	AGameModeBase* GameMode = GetWorld()->GetAuthGameMode();
+	if (GameMode && GameMode->DefaultPawnClass && GameMode->DefaultPawnClass->IsChildOf(AThirdPersonMPCharacter::StaticClass()))
+	{
+		BotClass = GameMode->DefaultPawnClass;
+	}
+
+	TActorIterator<APlayerStart> PlayerStart(GetWorld());
+	const FVector Origin = PlayerStart ? PlayerStart->GetActorLocation() : GetActorLocation();
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+	SpawnParameters.ObjectFlags |= RF_Transient;
+
+	BotInputs.Init(INDEX_NONE, NumBots);
+	for (int32 Index = 0; Index < NumBots; ++Index)
+	{
+		const FVector Location = Origin + FVector((Index % 8) * 200.0f, (Index / 8) * 200.0f, 0.0f);
+		AThirdPersonMPCharacter* Bot = GetWorld()->SpawnActor<AThirdPersonMPCharacter>(BotClass, Location, FRotator::ZeroRotator, SpawnParameters);
+		if (Bot)
+		{
+			Bot->SpawnDefaultController();
+			Bot->GetCharacterMovement()->PrimaryComponentTick.AddPrerequisite(this, PrimaryActorTick);
+		}
+		Bots.Add(Bot);
+	}
+}
+
+void ABenchmarkRunner::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	while (Inputs.IsValidIndex(NextInput) && Inputs[NextInput].Frame <= FrameNumber)
+	{
+		BotInputs[Inputs[NextInput].Bot] = NextInput;
+		++NextInput;
+	}
+
+	for (int32 Index = 0; Index < Bots.Num(); ++Index)
+	{
+		AThirdPersonMPCharacter* Bot = Bots[Index];
+		if (Bot == nullptr || Bot->Controller == nullptr || BotInputs[Index] == INDEX_NONE)
+		{
+			continue;
+		}
+
+		//AddControllerYawInput only reaches player controllers, so turn the bot's controller here, scaled by the fixed step as TurnAtRate would.
+		const FScriptedInput& Input = Inputs[BotInputs[Index]];
+		FRotator Rotation = Bot->Controller->GetControlRotation();
+		Rotation.Yaw = FRotator::ClampAxis(Rotation.Yaw + Input.TurnRate * Bot->BaseTurnRate * DeltaSeconds);
+		Rotation.Pitch = FMath::ClampAngle(Rotation.Pitch + Input.LookUpRate * Bot->BaseLookUpRate * DeltaSeconds, -89.0f, 89.0f);
+		Bot->Controller->SetControlRotation(Rotation);
+
+		Bot->MoveForward(Input.Forward);
+		Bot->MoveRight(Input.Right);
+		if (Input.bFire)
+		{
+			Bot->StartFire();
+		}
+	}
+}
+
+void ABenchmarkRunner::OnPhysicsMarker(bool bEndOfPhysics)
+{
+	if (!bEndOfPhysics)
+	{
+		PhysicsStartTime = FPlatformTime::Seconds();
+	}
+	else if (PhysicsStartTime > 0.0)
+	{
+		PhysicsTime = FPlatformTime::Seconds() - PhysicsStartTime;
+		PhysicsStartTime = 0.0;
+	}
+}
+
+void ABenchmarkRunner::OnWorldTickStart(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds)
+{
+	if (InWorld == GetWorld())
+	{
+		FrameStartTime = FPlatformTime::Seconds();
+		PostActorTickTime = 0.0;
+		PhysicsTime = 0.0;
+		NetTickTime = 0.0;
+	}
+}
+
+void ABenchmarkRunner::OnTickDispatch(float DeltaSeconds)
+{
+	if (FrameStartTime > 0.0)
+	{
+		NetTickTime += FPlatformTime::Seconds() - FrameStartTime;
+	}
+}
+
+void ABenchmarkRunner::OnWorldPostActorTick(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds)
+{
+	if (InWorld == GetWorld())
+	{
+		PostActorTickTime = FPlatformTime::Seconds();
+	}
+}
+
+void ABenchmarkRunner::OnTickFlush(float DeltaSeconds)
+{
+	if (PostActorTickTime > 0.0)
+	{
+		NetTickTime += FPlatformTime::Seconds() - PostActorTickTime;
+	}
+}
+
+void ABenchmarkRunner::OnEndFrame()
+{
+	if (FrameStartTime <= 0.0)
+	{
+		return;
+	}
+
+	if (FrameNumber >= WarmupFrames && GameThreadTimes.Num() < FramesToMeasure)
+	{
+		GameThreadTimes.Add((FPlatformTime::Seconds() - FrameStartTime) * 1000.0);
+		PhysicsTimes.Add(PhysicsTime * 1000.0);
+		NetTickTimes.Add(NetTickTime * 1000.0);
+
+		if (GameThreadTimes.Num() == FramesToMeasure)
+		{
+			WriteResults();
+			UE_LOG(LogThirdPersonMP, Log, TEXT("Benchmark: %d frames measured, results written to %s, exiting."), FramesToMeasure, *OutputPath);
+			FPlatformMisc::RequestExit(false);
+		}
+	}
+
+	FrameStartTime = 0.0;
+	++FrameNumber;
+}
+
+void ABenchmarkRunner::WriteResults() const
+{
+	//Summary first, then one array per cost with an entry per measured frame, so runs diff and load easily.
+	auto WriteSummary = [](const TArray<float>& Times)
+	{
+		TArray<float> Sorted = Times;
+		Sorted.Sort();
+
+		double Total = 0.0;
+		for (const float Time : Sorted)
+		{
+			Total += Time;
+		}
+
+		return FString::Printf(TEXT("{ \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }"),
+			Sorted.Num() > 0 ? Total / Sorted.Num() : 0.0,
+			LoadTestMetrics::Percentile(Sorted, 0.5f), LoadTestMetrics::Percentile(Sorted, 0.9f), LoadTestMetrics::Percentile(Sorted, 0.99f), LoadTestMetrics::Percentile(Sorted, 1.0f));
+	};
+
+	auto WriteFrames = [](const TArray<float>& Times)
+	{
+		FString Values;
+		for (int32 Index = 0; Index < Times.Num(); ++Index)
+		{
+			Values += FString::Printf(Index == 0 ? TEXT("%.4f") : TEXT(", %.4f"), Times[Index]);
+		}
+		return FString::Printf(TEXT("[%s]"), *Values);
+	};
+
+	FString Json;
+	Json += TEXT("{\n");
+	Json += FString::Printf(TEXT("\t\"map\": \"%s\",\n"), *GetWorld()->GetMapName());
+	Json += FString::Printf(TEXT("\t\"script\": \"%s\",\n"), *FPaths::GetCleanFilename(ScriptPath));
+	Json += FString::Printf(TEXT("\t\"seed\": %d,\n"), ActiveSeed);
+	Json += FString::Printf(TEXT("\t\"fixedDeltaSeconds\": %.6f,\n"), FApp::GetFixedDeltaTime());
+	Json += FString::Printf(TEXT("\t\"bots\": %d,\n"), Bots.Num());
+	Json += FString::Printf(TEXT("\t\"warmupFrames\": %d,\n"), WarmupFrames);
+	Json += FString::Printf(TEXT("\t\"frames\": %d,\n"), GameThreadTimes.Num());
+	Json += TEXT("\t\"summary\": {\n");
+	Json += FString::Printf(TEXT("\t\t\"gameThreadMs\": %s,\n"), *WriteSummary(GameThreadTimes));
+	Json += FString::Printf(TEXT("\t\t\"physicsMs\": %s,\n"), *WriteSummary(PhysicsTimes));
+	Json += FString::Printf(TEXT("\t\t\"netTickMs\": %s\n"), *WriteSummary(NetTickTimes));
+	Json += TEXT("\t},\n");
+	Json += TEXT("\t\"perFrame\": {\n");
+	Json += FString::Printf(TEXT("\t\t\"gameThreadMs\": %s,\n"), *WriteFrames(GameThreadTimes));
+	Json += FString::Printf(TEXT("\t\t\"physicsMs\": %s,\n"), *WriteFrames(PhysicsTimes));
+	Json += FString::Printf(TEXT("\t\t\"netTickMs\": %s\n"), *WriteFrames(NetTickTimes));
+	Json += TEXT("\t}\n");
+	Json += TEXT("}\n");
+
+	if (!FFileHelper::SaveStringToFile(Json, *OutputPath, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+	{
+		UE_LOG(LogThirdPersonMP, Error, TEXT("Benchmark: could not write %s."), *OutputPath);
+	}
+}
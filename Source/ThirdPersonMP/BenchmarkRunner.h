@@ -0,0 +1,159 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "GameFramework/Info.h"
+#include "BenchmarkRunner.generated.h"
+
+class ABenchmarkRunner;
+class AThirdPersonMPCharacter;
+
+/** Marks the start or end of the physics tick groups for ABenchmarkRunner. */
+USTRUCT()
+struct FBenchmarkPhysicsTickFunction : public FTickFunction
+{
+	GENERATED_BODY()
+
+	ABenchmarkRunner* Runner;
+
+	/** False for the marker that runs before physics starts, true for the one that runs once it has ended. */
+	bool bEndOfPhysics;
+
+	FBenchmarkPhysicsTickFunction()
+		: Runner(nullptr)
+		, bEndOfPhysics(false)
+	{
+	}
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FBenchmarkPhysicsTickFunction> : public TStructOpsTypeTraitsBase2<FBenchmarkPhysicsTickFunction>
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
+
+/**
+ * Deterministic server benchmark, for comparing frame costs between commits. Spawned by AThirdPersonMPGameMode on
+ * servers started with -BenchmarkScript=<path>; run it on a -nullrhi dedicated server with no clients.
+ *
+ * The world steps at a fixed 1 / FixedTickRate with no wait between frames, the global random streams are seeded with
+ * Seed (-BenchmarkSeed=), and server-side bot characters are driven by the scripted input in the file: CSV rows of
+ * Frame,Bot,Forward,Right,TurnRate,LookUpRate,Fire, each holding that bot's input from Frame until its next row. Bots
+ * move and fire through the same functions as a player's input. After WarmupFrames, NumFrames frames (-BenchmarkFrames=)
+ * are measured, written as JSON to -BenchmarkOutput=<path> (Saved/Benchmark.json by default), and the server exits.
+ *
+ * Each frame records game thread time (from the start of the world tick to the end of the frame), physics time (from
+ * just before physics starts to just after it has ended, including the wait for the simulation), and net tick time
+ * (measured as in ALoadTestMetricsRecorder).
+ */
+UCLASS(config=Game, notplaceable)
+class THIRDPERSONMP_API ABenchmarkRunner : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	ABenchmarkRunner();
+
+	/** Returns true and the input script path if this server was started with -BenchmarkScript=<path>. */
+	static bool GetScriptPath(FString& OutPath);
+
+	virtual void PostInitializeComponents() override;
+	virtual void Tick(float DeltaSeconds) override;
+
+	/** Called by the physics markers. */
+	void OnPhysicsMarker(bool bEndOfPhysics);
+
+	/** Simulated frames per second. */
+	UPROPERTY(Config, EditAnywhere, Category = "Benchmark")
+	float FixedTickRate;
+
+	/** Frames run before measuring starts, so that loading and first-use costs are left out. */
+	UPROPERTY(Config, EditAnywhere, Category = "Benchmark")
+	int32 WarmupFrames;
+
+	/** Frames measured when -BenchmarkFrames= is not given. */
+	UPROPERTY(Config, EditAnywhere, Category = "Benchmark")
+	int32 NumFrames;
+
+	/** Random seed used when -BenchmarkSeed= is not given. */
+	UPROPERTY(Config, EditAnywhere, Category = "Benchmark")
+	int32 Seed;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	/** One row of the input script. */
+	struct FScriptedInput
+	{
+		int32 Frame;
+		int32 Bot;
+		float Forward;
+		float Right;
+		float TurnRate;
+		float LookUpRate;
+		bool bFire;
+	};
+
+	/** Reads the input script into Inputs, sorted by frame. Returns false if the file could not be read. */
+	bool LoadScript(const FString& Path);
+
+	/** Spawns a possessed bot character for every bot the script uses, in a grid at the first player start. */
+	void SpawnBots(int32 NumBots);
+
+	void OnWorldTickStart(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds);
+	void OnTickDispatch(float DeltaSeconds);
+	void OnWorldPostActorTick(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds);
+	void OnTickFlush(float DeltaSeconds);
+	void OnEndFrame();
+
+	/** Writes the measured frames to OutputPath. */
+	void WriteResults() const;
+
+	TArray<FScriptedInput> Inputs;
+
+	/** Next row of Inputs to apply, and the row currently applied to each bot (INDEX_NONE before its first). */
+	int32 NextInput;
+	TArray<int32> BotInputs;
+
+	UPROPERTY(Transient)
+	TArray<AThirdPersonMPCharacter*> Bots;
+
+	FBenchmarkPhysicsTickFunction StartPhysicsMarker;
+	FBenchmarkPhysicsTickFunction EndPhysicsMarker;
+
+	/** Per-frame times, in milliseconds, of the measured frames. */
+	TArray<float> GameThreadTimes;
+	TArray<float> PhysicsTimes;
+	TArray<float> NetTickTimes;
+
+	/** Platform times, in seconds, marking the phases of the current frame. Zero when a phase has not started. */
+	double FrameStartTime;
+	double PhysicsStartTime;
+	double PostActorTickTime;
+	double PhysicsTime;
+	double NetTickTime;
+
+	/** Frames ticked so far, including warmup. */
+	int32 FrameNumber;
+	int32 FramesToMeasure;
+	int32 ActiveSeed;
+
+	FString ScriptPath;
+	FString OutputPath;
+
+	FDelegateHandle TickStartHandle;
+	FDelegateHandle TickDispatchHandle;
+	FDelegateHandle PostActorTickHandle;
+	FDelegateHandle TickFlushHandle;
+	FDelegateHandle EndFrameHandle;
+};
@@ -0,0 +1,55 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "CosmeticAssetLoader.h"
+#include "ThirdPersonMP.h"
+#include "Engine/AssetManager.h"
+#include "HAL/PlatformMemory.h"
+#include "CoreGlobals.h"
+
+bool UCosmeticAssetLoader::ShouldLoadCosmetics()
+{
+#if UE_SERVER
+	return false;
+#else
+	return !IsRunningDedicatedServer();
+#endif
+}
+
+void UCosmeticAssetLoader::Request(const FSoftObjectPath& Asset, FStreamableDelegate OnLoaded)
+{
+	if (!ShouldLoadCosmetics() || Asset.IsNull())
+	{
+		return;
+	}
+
+	if (Asset.ResolveObject())
+	{
+		OnLoaded.ExecuteIfBound();
+		return;
+	}
+
+	//Managed, so the streamable manager keeps the asset loaded even though nothing holds a hard reference to it.
+	UAssetManager::GetStreamableManager().RequestAsyncLoad(Asset, OnLoaded, FStreamableManager::AsyncLoadHighPriority, true);
+}
+
+TSharedPtr<FStreamableHandle> UCosmeticAssetLoader::StartPreload()
+{
+	const UCosmeticAssetLoader* Settings = GetDefault<UCosmeticAssetLoader>();
+	if (!ShouldLoadCosmetics() || Settings->PreloadAssets.Num() == 0)
+	{
+		return nullptr;
+	}
+
+	const int32 NumAssets = Settings->PreloadAssets.Num();
+	return UAssetManager::GetStreamableManager().RequestAsyncLoad(Settings->PreloadAssets, FStreamableDelegate::CreateLambda([NumAssets]()
+	{
+		LogStartupMilestone(*FString::Printf(TEXT("%d cosmetic assets preloaded"), NumAssets));
+	}));
+}
+
+void UCosmeticAssetLoader::LogStartupMilestone(const TCHAR* Milestone)
+{
+	const FPlatformMemoryStats MemoryStats = FPlatformMemory::GetStats();
+	UE_LOG(LogThirdPersonMP, Log, TEXT("Startup: %s after %.2f s, %.1f MB resident."), Milestone, FPlatformTime::Seconds() - GStartTime, MemoryStats.UsedPhysical / (1024.0 * 1024.0));
+}
@@ -0,0 +1,41 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "UObject/SoftObjectPath.h"
+#include "Engine/StreamableManager.h"
+#include "CosmeticAssetLoader.generated.h"
+
+/**
+ * Loads cosmetic assets (meshes and effects that only matter to a machine that renders) through the asset manager's
+ * FStreamableManager instead of hard references, so that a dedicated server never loads them. PreloadAssets are
+ * requested in the background as soon as the engine has initialized; actors request what they reference softly and
+ * usually find it already loaded.
+ */
+UCLASS(config=Game)
+class THIRDPERSONMP_API UCosmeticAssetLoader : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Returns true if this process loads cosmetic assets. Always false in server builds and on dedicated servers. */
+	static bool ShouldLoadCosmetics();
+
+	/**
+	 * Calls OnLoaded once Asset is in memory: right away if it already is, otherwise when the async load completes.
+	 * The asset then stays loaded for the rest of the session. Does nothing when ShouldLoadCosmetics is false.
+	 */
+	static void Request(const FSoftObjectPath& Asset, FStreamableDelegate OnLoaded = FStreamableDelegate());
+
+	/** Starts loading every PreloadAssets entry in the background. Returns the handle that keeps them loaded, or nullptr when cosmetics are not loaded. */
+	static TSharedPtr<FStreamableHandle> StartPreload();
+
+	/** Logs Milestone with the time since the process started and the resident memory. */
+	static void LogStartupMilestone(const TCHAR* Milestone);
+
+	/** Assets loaded in the background after engine init. */
+	UPROPERTY(Config)
+	TArray<FSoftObjectPath> PreloadAssets;
+};
@@ -0,0 +1,327 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "CrowdManager.h"
+#include "ThirdPersonMP.h"
+#include "MyPawn.h"
+#include "CosmeticAssetLoader.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/PlayerStart.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "Net/UnrealNetwork.h"
+
+DECLARE_CYCLE_STAT(TEXT("StepCrowd"), STAT_ThirdPersonMP_StepCrowd, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Crowd Agents"), STAT_ThirdPersonMP_CrowdAgents, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Crowd Segments Started"), STAT_ThirdPersonMP_CrowdSegmentsStarted, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Crowd Instances Updated"), STAT_ThirdPersonMP_CrowdInstancesUpdated, STATGROUP_ThirdPersonMP);
+
+ACrowdManager::ACrowdManager()
+{
+	//Move the agents' capsules before anything that ticks this frame can collide with them.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	//Segments only change when an agent turns, and clients extrapolate in between, so a low rate is enough.
+	bReplicates = true;
+	bAlwaysRelevant = true;
+	NetUpdateFrequency = 10.0f;
+
+	InstancedMesh = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("InstancedMesh"));
+	InstancedMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	InstancedMesh->SetMobility(EComponentMobility::Movable);
+	InstancedMesh->SetCastShadow(false);
+	RootComponent = InstancedMesh;
+
+	AgentMesh = TSoftObjectPtr<UStaticMesh>(FSoftObjectPath(TEXT("/Game/StarterContent/Shapes/Shape_NarrowCapsule.Shape_NarrowCapsule")));
+	AgentMeshOffset = FVector(0.0f, 0.0f, -96.0f);
+	AgentPawnClass = AMyPawn::StaticClass();
+
+	NumAgents = 0;
+	WanderRadius = 3000.0f;
+	MinSpeed = 100.0f;
+	MaxSpeed = 300.0f;
+	MinTurnInterval = 2.0f;
+	MaxTurnInterval = 6.0f;
+	AgentHealth = 100.0f;
+	VisualUpdateDistance = 2.0f;
+
+	WanderCenter = FVector::ZeroVector;
+	AgentHalfHeight = 96.0f;
+}
+
+void ACrowdManager::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(ACrowdManager, AgentArray);
+}
+
+void ACrowdManager::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	if (GetNetMode() == NM_DedicatedServer)
+	{
+		InstancedMesh->SetVisibility(false);
+	}
+
+	UCosmeticAssetLoader::Request(AgentMesh.ToSoftObjectPath(), FStreamableDelegate::CreateUObject(this, &ACrowdManager::OnAgentMeshLoaded));
+}
+
+void ACrowdManager::OnAgentMeshLoaded()
+{
+	InstancedMesh->SetStaticMesh(AgentMesh.Get());
+}
+
+int32 ACrowdManager::GetNumAgentsToSpawn() const
+{
+	int32 Count = NumAgents;
+	FParse::Value(FCommandLine::Get(), TEXT("CrowdAgents="), Count);
+
+	if (Count > MaxAgents)
+	{
+		UE_LOG(LogThirdPersonMP, Warning, TEXT("Crowd: %d agents requested, but a crowd replicates at most %d."), Count, MaxAgents);
+	}
+	return FMath::Clamp(Count, 0, MaxAgents);
+}
+
+void ACrowdManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (HasAuthority())
+	{
+		TActorIterator<APlayerStart> PlayerStart(GetWorld());
+		WanderCenter = PlayerStart ? PlayerStart->GetActorLocation() : GetActorLocation();
+
+		if (AgentPawnClass)
+		{
+			AgentHalfHeight = AgentPawnClass->GetDefaultObject<AMyPawn>()->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+		}
+
+		Random.GenerateNewSeed();
+		SpawnAgents(GetNumAgentsToSpawn());
+	}
+}
+
+void ACrowdManager::SpawnAgents(int32 Count)
+{
+	SegmentStarts.Reserve(Count);
+	SegmentDirections.Reserve(Count);
+	SegmentSpeeds.Reserve(Count);
+	SegmentStartTimes.Reserve(Count);
+	TimesToTurn.Reserve(Count);
+	Healths.Reserve(Count);
+	Positions.Reserve(Count);
+	AgentPawns.Reserve(Count);
+	AgentArray.Items.Reserve(Count);
+
+	FActorSpawnParameters SpawnInfo;
+	SpawnInfo.Owner = this;
+	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnInfo.ObjectFlags |= RF_Transient;
+
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		const int32 AgentIndex = Positions.Num();
+		const FVector Location = FindSpawnLocation();
+
+		SegmentStarts.Add(Location);
+		SegmentDirections.Add(FVector::ForwardVector);
+		SegmentSpeeds.Add(0.0f);
+		SegmentStartTimes.Add(0.0f);
+		TimesToTurn.Add(0.0f);
+		Healths.Add(AgentHealth);
+		Positions.Add(Location);
+		AgentArray.Items.AddDefaulted();
+
+		AMyPawn* Pawn = AgentPawnClass ? GetWorld()->SpawnActor<AMyPawn>(AgentPawnClass, Location, FRotator::ZeroRotator, SpawnInfo) : nullptr;
+		if (Pawn)
+		{
+			Pawn->InitAgent(this, AgentIndex);
+		}
+		AgentPawns.Add(Pawn);
+
+		StartSegment(AgentIndex, Location);
+	}
+
+	UE_LOG(LogThirdPersonMP, Log, TEXT("Crowd: spawned %d agents within %.0f of %s."), Count, WanderRadius, *WanderCenter.ToString());
+}
+
+void ACrowdManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (HasAuthority())
+	{
+		StepServer(DeltaSeconds);
+
+		if (GetNetMode() != NM_DedicatedServer)
+		{
+			UpdateVisuals(Positions);
+		}
+	}
+	else
+	{
+		const float ServerTime = GetServerTime();
+		ClientPositions.SetNumUninitialized(AgentArray.Items.Num(), false);
+		for (int32 Index = 0; Index < ClientPositions.Num(); ++Index)
+		{
+			ClientPositions[Index] = AgentArray.Items[Index].GetLocation(ServerTime);
+		}
+		UpdateVisuals(ClientPositions);
+	}
+}
+
+void ACrowdManager::StepServer(float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ThirdPersonMP_StepCrowd);
+	CSV_SCOPED_TIMING_STAT(ThirdPersonMP, StepCrowd);
+
+	const float ServerTime = GetServerTime();
+	for (int32 Index = 0; Index < Positions.Num(); ++Index)
+	{
+		Positions[Index] = SegmentStarts[Index] + SegmentDirections[Index] * (SegmentSpeeds[Index] * (ServerTime - SegmentStartTimes[Index]));
+	}
+
+	//Turns are rare, so handling them in a second pass keeps the first one a straight run over the arrays.
+	for (int32 Index = 0; Index < TimesToTurn.Num(); ++Index)
+	{
+		TimesToTurn[Index] -= DeltaSeconds;
+		if (TimesToTurn[Index] <= 0.0f)
+		{
+			StartSegment(Index, Positions[Index]);
+		}
+	}
+
+	//Teleport, so moving a capsule neither sweeps nor wakes physics.
+	for (int32 Index = 0; Index < AgentPawns.Num(); ++Index)
+	{
+		if (AgentPawns[Index])
+		{
+			AgentPawns[Index]->SetActorLocation(Positions[Index], false, nullptr, ETeleportType::TeleportPhysics);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_ThirdPersonMP_CrowdAgents, Positions.Num());
+}
+
+void ACrowdManager::StartSegment(int32 AgentIndex, const FVector& Location)
+{
+	FVector Start = Location;
+	SnapToGround(Start);
+
+	//Wander at random, but head back towards the centre once near the edge of the area.
+	float Yaw = Random.FRandRange(0.0f, 360.0f);
+	const FVector ToCenter = WanderCenter - Start;
+	if (ToCenter.Size2D() > WanderRadius * 0.8f)
+	{
+		Yaw = ToCenter.Rotation().Yaw + Random.FRandRange(-45.0f, 45.0f);
+	}
+
+	//The server walks the quantized segment it replicates, so clients extrapolate exactly the same path.
+	FCrowdAgentItem& Item = AgentArray.Items[AgentIndex];
+	Item.Start = FVector(FMath::RoundToFloat(Start.X), FMath::RoundToFloat(Start.Y), FMath::RoundToFloat(Start.Z));
+	Item.StartTime = GetServerTime();
+	Item.Yaw = FRotator::CompressAxisToShort(Yaw);
+	Item.Speed = (uint16)FMath::Clamp(FMath::RoundToInt(Random.FRandRange(MinSpeed, MaxSpeed)), 0, (int32)MAX_uint16);
+	AgentArray.MarkItemDirty(Item);
+
+	SegmentStarts[AgentIndex] = Item.Start;
+	SegmentDirections[AgentIndex] = Item.GetDirection();
+	SegmentSpeeds[AgentIndex] = Item.Speed;
+	SegmentStartTimes[AgentIndex] = Item.StartTime;
+	TimesToTurn[AgentIndex] = Random.FRandRange(MinTurnInterval, MaxTurnInterval);
+	Positions[AgentIndex] = Item.Start;
+
+	INC_DWORD_STAT(STAT_ThirdPersonMP_CrowdSegmentsStarted);
+}
+
+void ACrowdManager::DamageAgent(int32 AgentIndex, float Damage)
+{
+	if (!HasAuthority() || !Healths.IsValidIndex(AgentIndex))
+	{
+		return;
+	}
+
+	Healths[AgentIndex] -= Damage;
+	if (Healths[AgentIndex] <= 0.0f)
+	{
+		Healths[AgentIndex] = AgentHealth;
+		StartSegment(AgentIndex, FindSpawnLocation());
+
+		//Move the pawn now, so the rest of this frame's shots cannot hit it where it died.
+		if (AgentPawns[AgentIndex])
+		{
+			AgentPawns[AgentIndex]->SetActorLocation(Positions[AgentIndex], false, nullptr, ETeleportType::TeleportPhysics);
+		}
+	}
+}
+
+FVector ACrowdManager::FindSpawnLocation()
+{
+	const float Angle = Random.FRandRange(0.0f, 2.0f * PI);
+	const float Distance = WanderRadius * FMath::Sqrt(Random.FRand());
+
+	FVector Location = WanderCenter + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.0f) * Distance;
+	SnapToGround(Location);
+	return Location;
+}
+
+void ACrowdManager::SnapToGround(FVector& Location) const
+{
+	//Only world geometry counts as ground, so agents never stand on each other.
+	const FVector TraceStart = Location + FVector(0.0f, 0.0f, 500.0f);
+	const FVector TraceEnd = Location - FVector(0.0f, 0.0f, 1000.0f);
+
+	FHitResult Hit;
+	if (GetWorld()->LineTraceSingleByObjectType(Hit, TraceStart, TraceEnd, FCollisionObjectQueryParams(ECC_WorldStatic), FCollisionQueryParams(SCENE_QUERY_STAT(CrowdGroundTrace))))
+	{
+		Location.Z = Hit.ImpactPoint.Z + AgentHalfHeight;
+	}
+}
+
+void ACrowdManager::UpdateVisuals(const TArray<FVector>& InPositions)
+{
+	//Instances are interchangeable, so keep the count in step with the arrays. New instances are always drawn below.
+	while (InstancedMesh->GetInstanceCount() > InPositions.Num())
+	{
+		InstancedMesh->RemoveInstance(InstancedMesh->GetInstanceCount() - 1);
+	}
+	while (InstancedMesh->GetInstanceCount() < InPositions.Num())
+	{
+		InstancedMesh->AddInstanceWorldSpace(FTransform::Identity);
+	}
+	const int32 NumDrawn = FMath::Min(DrawnPositions.Num(), InPositions.Num());
+	DrawnPositions.SetNumUninitialized(InPositions.Num(), false);
+
+	//Only instances whose agent has moved far enough are rewritten, and the render state is only rebuilt if any were.
+	const float UpdateDistanceSquared = FMath::Square(VisualUpdateDistance);
+	int32 NumUpdated = 0;
+	for (int32 Index = 0; Index < InPositions.Num(); ++Index)
+	{
+		if (Index >= NumDrawn || FVector::DistSquared(InPositions[Index], DrawnPositions[Index]) > UpdateDistanceSquared)
+		{
+			DrawnPositions[Index] = InPositions[Index];
+			InstancedMesh->UpdateInstanceTransform(Index, FTransform(InPositions[Index] + AgentMeshOffset), true, false, true);
+			++NumUpdated;
+		}
+	}
+
+	if (NumUpdated > 0)
+	{
+		InstancedMesh->MarkRenderStateDirty();
+	}
+	SET_DWORD_STAT(STAT_ThirdPersonMP_CrowdInstancesUpdated, NumUpdated);
+}
+
+float ACrowdManager::GetServerTime() const
+{
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	return GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+}
@@ -0,0 +1,216 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "Engine/NetSerialization.h"
+#include "Math/RandomStream.h"
+#include "CrowdManager.generated.h"
+
+class AMyPawn;
+
+/** One crowd agent as seen by clients: the straight segment it is currently walking along. */
+USTRUCT()
+struct FCrowdAgentItem : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	/** Where the segment starts, rounded to the centimetre. */
+	UPROPERTY()
+	FVector_NetQuantize Start;
+
+	/** Server world time at which the agent was at Start. */
+	UPROPERTY()
+	float StartTime;
+
+	/** Heading, compressed with FRotator::CompressAxisToShort. */
+	UPROPERTY()
+	uint16 Yaw;
+
+	/** Speed in cm/s. */
+	UPROPERTY()
+	uint16 Speed;
+
+	FCrowdAgentItem()
+		: Start(ForceInitToZero)
+		, StartTime(0.0f)
+		, Yaw(0)
+		, Speed(0)
+	{
+	}
+
+	/** Returns the unit vector the agent walks along. */
+	FORCEINLINE FVector GetDirection() const
+	{
+		return FRotator(0.0f, FRotator::DecompressAxisFromShort(Yaw), 0.0f).Vector();
+	}
+
+	/** Returns where the agent is at Time. */
+	FORCEINLINE FVector GetLocation(float Time) const
+	{
+		return Start + GetDirection() * (Speed * FMath::Max(Time - StartTime, 0.0f));
+	}
+};
+
+/** Delta-replicated list of crowd agents, indexed by agent. */
+USTRUCT()
+struct FCrowdAgentArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FCrowdAgentItem> Items;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FCrowdAgentItem, FCrowdAgentArray>(Items, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FCrowdAgentArray> : public TStructOpsTypeTraitsBase2<FCrowdAgentArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
+/**
+ * Crowd of lightweight wandering NPCs, used as targets for projectile practice and load tests. Agents walk in straight,
+ * quantized segments kept in contiguous arrays on the server, and only a change of segment is replicated, in one
+ * fast-array for the whole crowd; clients extrapolate each segment and draw every agent through one instanced static
+ * mesh. On the server each agent also has an AMyPawn, which gives it a capsule for projectiles to hit but has no mesh,
+ * no tick and no actor channel. Spawned by AThirdPersonMPGameMode when there are agents to spawn.
+ *
+ * The crowd is capped at MaxAgents: a fast-array update carries at most that many changed items, and the first update
+ * a client receives carries every agent.
+ */
+UCLASS(config=Game, notplaceable)
+class THIRDPERSONMP_API ACrowdManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	ACrowdManager();
+
+	/** Most agents a crowd can have, the most changed items FFastArraySerializer sends in one update. */
+	static const int32 MaxAgents = 2048;
+
+	/** Property replication */
+	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	virtual void PostInitializeComponents() override;
+	virtual void Tick(float DeltaSeconds) override;
+
+	/** Number of agents spawned at BeginPlay: the value of -CrowdAgents=<n> if given, NumAgents otherwise, up to MaxAgents. */
+	int32 GetNumAgentsToSpawn() const;
+
+	/** Deals Damage to the agent at AgentIndex, respawning it somewhere else once its health runs out. Server only. */
+	void DamageAgent(int32 AgentIndex, float Damage);
+
+	/** Number of agents on this machine. */
+	FORCEINLINE int32 GetNumAgents() const { return AgentArray.Items.Num(); }
+
+	/** Agents spawned when the command line does not say otherwise. */
+	UPROPERTY(Config, EditAnywhere, Category = "Crowd")
+	int32 NumAgents;
+
+	/** Agents spawn and wander within this distance of the first player start. */
+	UPROPERTY(Config, EditAnywhere, Category = "Crowd")
+	float WanderRadius;
+
+	/** Slowest and fastest walking speed, in cm/s. */
+	UPROPERTY(Config, EditAnywhere, Category = "Crowd")
+	float MinSpeed;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Crowd")
+	float MaxSpeed;
+
+	/** Shortest and longest time, in seconds, an agent walks before picking a new heading. */
+	UPROPERTY(Config, EditAnywhere, Category = "Crowd")
+	float MinTurnInterval;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Crowd")
+	float MaxTurnInterval;
+
+	/** Damage an agent takes before it respawns. */
+	UPROPERTY(Config, EditAnywhere, Category = "Crowd")
+	float AgentHealth;
+
+	/** Distance, in cm, an agent moves before its instance is redrawn. */
+	UPROPERTY(Config, EditAnywhere, Category = "Crowd")
+	float VisualUpdateDistance;
+
+protected:
+	virtual void BeginPlay() override;
+
+	/** Spawns Count agents at random points around WanderCenter. */
+	void SpawnAgents(int32 Count);
+
+	/** Moves every agent along its segment, starts new segments for agents due to turn, and moves their pawns. */
+	void StepServer(float DeltaSeconds);
+
+	/** Starts a new segment for the agent at AgentIndex from Location, and marks it for replication. */
+	void StartSegment(int32 AgentIndex, const FVector& Location);
+
+	/** Returns a random point within WanderRadius of WanderCenter, on the ground. */
+	FVector FindSpawnLocation();
+
+	/** Moves Location vertically so the agent's capsule stands on the ground below it, if there is any. */
+	void SnapToGround(FVector& Location) const;
+
+	/** Writes the agents that moved in InPositions into the instanced mesh, growing or shrinking it to match. */
+	void UpdateVisuals(const TArray<FVector>& InPositions);
+
+	/** Returns the server world time as seen on this machine. */
+	float GetServerTime() const;
+
+	/** Puts AgentMesh on InstancedMesh once it has loaded. */
+	void OnAgentMeshLoaded();
+
+	/** Replicated segment of every agent. */
+	UPROPERTY(Replicated)
+	FCrowdAgentArray AgentArray;
+
+	/** Draws every agent on non-dedicated machines. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components", meta = (AllowPrivateAccess = "true"))
+	class UInstancedStaticMeshComponent* InstancedMesh;
+
+	/** Mesh drawn for each agent, loaded on machines that render. */
+	UPROPERTY(EditDefaultsOnly, Category = "Effects")
+	TSoftObjectPtr<class UStaticMesh> AgentMesh;
+
+	/** Offset from an agent's capsule centre to where its mesh is drawn. */
+	UPROPERTY(EditDefaultsOnly, Category = "Effects")
+	FVector AgentMeshOffset;
+
+	/** Pawn spawned on the server for each agent. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<AMyPawn> AgentPawnClass;
+
+	/** Server: pawn of each agent. */
+	UPROPERTY(Transient)
+	TArray<AMyPawn*> AgentPawns;
+
+private:
+	/** Server state, one entry per agent. Segments match what is replicated in AgentArray. */
+	TArray<FVector> SegmentStarts;
+	TArray<FVector> SegmentDirections;
+	TArray<float> SegmentSpeeds;
+	TArray<float> SegmentStartTimes;
+	TArray<float> TimesToTurn;
+	TArray<float> Healths;
+	TArray<FVector> Positions;
+
+	/** Client: position of each agent this frame. */
+	TArray<FVector> ClientPositions;
+
+	/** Position each instance was last drawn at. */
+	TArray<FVector> DrawnPositions;
+
+	FVector WanderCenter;
+	float AgentHalfHeight;
+	FRandomStream Random;
+};
@@ -0,0 +1,138 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "DamageManager.h"
+#include "ThirdPersonMP.h"
+#include "ThirdPersonMPCharacter.h"
+#include "Algo/Sort.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_CYCLE_STAT(TEXT("ResolveDamage"), STAT_ThirdPersonMP_ResolveDamage, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Damage Targets Resolved"), STAT_ThirdPersonMP_DamageTargetsResolved, STATGROUP_ThirdPersonMP);
+
+ADamageManager::ADamageManager()
+{
+	//Resolve after everything that can deal damage this frame has ticked.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+
+	bReplicates = false;
+
+	InitialQueueCapacity = 256;
+	MaxDamageOverTimeEffects = 512;
+}
+
+void ADamageManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	QueuedDamage.Reserve(InitialQueueCapacity);
+	ResolvingDamage.Reserve(InitialQueueCapacity);
+	ResolvedTargets.Reserve(InitialQueueCapacity);
+	DamageOverTimeEffects.Reserve(MaxDamageOverTimeEffects);
+}
+
+void ADamageManager::QueueDamage(AThirdPersonMPCharacter* Target, float Amount)
+{
+	if (Target && Amount != 0.0f)
+	{
+		QueuedDamage.Add({ Target, Amount });
+	}
+}
+
+void ADamageManager::AddDamageOverTime(AThirdPersonMPCharacter* Target, float DamagePerSecond, float Duration)
+{
+	if (Target == nullptr || DamagePerSecond == 0.0f || Duration <= 0.0f)
+	{
+		return;
+	}
+
+	if (DamageOverTimeEffects.Num() >= MaxDamageOverTimeEffects)
+	{
+		UE_LOG(LogThirdPersonMP, Verbose, TEXT("Damage over time on %s dropped: %d effects already running."), *Target->GetName(), DamageOverTimeEffects.Num());
+		return;
+	}
+
+	DamageOverTimeEffects.Add({ Target, DamagePerSecond, Duration });
+}
+
+void ADamageManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	TickDamageOverTime(DeltaSeconds);
+	ResolveQueuedDamage(GThirdPersonMPParallelCharacterWork != 0);
+}
+
+void ADamageManager::TickDamageOverTime(float DeltaSeconds)
+{
+	for (int32 Index = DamageOverTimeEffects.Num() - 1; Index >= 0; --Index)
+	{
+		FDamageOverTimeEffect& Effect = DamageOverTimeEffects[Index];
+		AThirdPersonMPCharacter* Target = Effect.Target.Get();
+		if (Target)
+		{
+			QueueDamage(Target, Effect.DamagePerSecond * FMath::Min(DeltaSeconds, Effect.TimeRemaining));
+			Effect.TimeRemaining -= DeltaSeconds;
+		}
+
+		if (Target == nullptr || Effect.TimeRemaining <= 0.0f)
+		{
+			DamageOverTimeEffects.RemoveAtSwap(Index, 1, false);
+		}
+	}
+}
+
+void ADamageManager::ResolveQueuedDamage(bool bParallel)
+{
+	if (QueuedDamage.Num() == 0)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ThirdPersonMP_ResolveDamage);
+	CSV_SCOPED_TIMING_STAT(ThirdPersonMP, ResolveDamage);
+
+	//Damage dealt while resolving lands in the other queue and is resolved next frame.
+	Swap(QueuedDamage, ResolvingDamage);
+
+	//Group by target so each one is resolved with a single sum.
+	Algo::SortBy(ResolvingDamage, &FQueuedDamage::Target);
+
+	ResolvedTargets.Reset();
+	for (int32 Index = 0; Index < ResolvingDamage.Num(); ++Index)
+	{
+		if (Index == 0 || ResolvingDamage[Index].Target != ResolvingDamage[Index - 1].Target)
+		{
+			ResolvedTargets.Add({ ResolvingDamage[Index].Target, Index, 0.0f });
+		}
+	}
+
+	//Resolving only reads the queue and the target's health, and nothing writes either until every target is done, so each target can be resolved on a different thread.
+	ParallelFor(ResolvedTargets.Num(), [this](int32 Index)
+	{
+		FResolvedDamage& Resolved = ResolvedTargets[Index];
+		const int32 End = Index + 1 < ResolvedTargets.Num() ? ResolvedTargets[Index + 1].First : ResolvingDamage.Num();
+
+		float Total = 0.0f;
+		for (int32 DamageIndex = Resolved.First; DamageIndex < End; ++DamageIndex)
+		{
+			Total += ResolvingDamage[DamageIndex].Amount;
+		}
+		Resolved.NewHealth = FMath::Clamp(Resolved.Target->GetCurrentHealth() - Total, 0.0f, Resolved.Target->GetMaxHealth());
+	}, !bParallel);
+
+	//Setting health marks it for replication and runs gameplay code (kills, health updates), so it stays on the game thread.
+	int32 NumTargets = 0;
+	for (const FResolvedDamage& Resolved : ResolvedTargets)
+	{
+		if (!Resolved.Target->IsPendingKill())
+		{
+			Resolved.Target->SetCurrentHealth(Resolved.NewHealth);
+			++NumTargets;
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_ThirdPersonMP_DamageTargetsResolved, NumTargets);
+	ResolvingDamage.Reset();
+}
@@ -0,0 +1,121 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "DamageManager.generated.h"
+
+class AThirdPersonMPCharacter;
+
+/** Linear damage falloff with distance. Full damage up to StartDistance, MinScale of it from EndDistance on. Disabled while EndDistance is not greater than StartDistance. */
+USTRUCT(BlueprintType)
+struct FDamageFalloff
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Damage")
+	float StartDistance;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Damage")
+	float EndDistance;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Damage", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+	float MinScale;
+
+	FDamageFalloff()
+		: StartDistance(0.0f)
+		, EndDistance(0.0f)
+		, MinScale(1.0f)
+	{
+	}
+
+	/** Returns the damage scale at Distance. */
+	FORCEINLINE float Evaluate(float Distance) const
+	{
+		if (EndDistance <= StartDistance)
+		{
+			return 1.0f;
+		}
+
+		const float Alpha = FMath::Clamp((Distance - StartDistance) / (EndDistance - StartDistance), 0.0f, 1.0f);
+		return FMath::Lerp(1.0f, MinScale, Alpha);
+	}
+};
+
+/**
+ * Server-side damage pipeline. Damage to characters is queued as it happens during the frame and resolved once per
+ * target at the end of the frame, so a character hit several times changes (and replicates) its health once.
+ * Also runs damage over time into the same queue. Queues are reused every frame, so queuing does not allocate.
+ * Owned and spawned by AThirdPersonMPGameMode.
+ */
+UCLASS(config=Game, notplaceable)
+class THIRDPERSONMP_API ADamageManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	ADamageManager();
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	/** Queues Amount of damage to Target, applied at the end of the frame. */
+	void QueueDamage(AThirdPersonMPCharacter* Target, float Amount);
+
+	/** Deals DamagePerSecond to Target every frame for Duration seconds. */
+	void AddDamageOverTime(AThirdPersonMPCharacter* Target, float DamagePerSecond, float Duration);
+
+	/**
+	 * Sums the queued damage per target and works out each target's resulting health. With bParallel, every target is
+	 * resolved on a worker thread; setting the health always happens on the game thread. Called from Tick, and by the
+	 * parallel character work benchmark.
+	 */
+	void ResolveQueuedDamage(bool bParallel);
+
+	/** Space reserved up front for damage queued in one frame. The queue grows past it if needed. */
+	UPROPERTY(Config, EditAnywhere, Category = "Damage")
+	int32 InitialQueueCapacity;
+
+	/** Most damage over time effects that can run at once. Further effects are dropped. */
+	UPROPERTY(Config, EditAnywhere, Category = "Damage")
+	int32 MaxDamageOverTimeEffects;
+
+protected:
+	virtual void BeginPlay() override;
+
+private:
+	struct FQueuedDamage
+	{
+		AThirdPersonMPCharacter* Target;
+		float Amount;
+	};
+
+	struct FDamageOverTimeEffect
+	{
+		TWeakObjectPtr<AThirdPersonMPCharacter> Target;
+		float DamagePerSecond;
+		float TimeRemaining;
+	};
+
+	/** Sum of the damage in ResolvingDamage for one target, whose entries start at First, and the health it leaves. */
+	struct FResolvedDamage
+	{
+		AThirdPersonMPCharacter* Target;
+		int32 First;
+		float NewHealth;
+	};
+
+	/** Queues this frame's share of every damage over time effect, removing finished ones. */
+	void TickDamageOverTime(float DeltaSeconds);
+
+	/** Damage queued this frame. Targets are only dereferenced in the same frame, before garbage collection can run. */
+	TArray<FQueuedDamage> QueuedDamage;
+
+	/** Damage being resolved. Swapped with QueuedDamage every frame so both keep their allocations. */
+	TArray<FQueuedDamage> ResolvingDamage;
+
+	/** One entry per target in ResolvingDamage. Reused every frame. */
+	TArray<FResolvedDamage> ResolvedTargets;
+
+	TArray<FDamageOverTimeEffect> DamageOverTimeEffects;
+};
@@ -2,4 +2,209 @@
 
 
 #include "EmbedGameStateBase.h"
+#include "ThirdPersonMP.h"
+#include "ImpactEffectManager.h"
+#include "WorldGridStreamingManager.h"
+#include "MyWorldSettings.h"
+#include "Engine/World.h"
+#include "Net/UnrealNetwork.h"
+#include "Net/Core/PushModel/PushModel.h"
+#include "TimerManager.h"
 
+DECLARE_DWORD_COUNTER_STAT(TEXT("Scoreboard Rows Sent"), STAT_ThirdPersonMP_ScoreboardRowsSent, STATGROUP_ThirdPersonMP);
+
+void FScoreboardRow::PostReplicatedAdd(const FScoreboardArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->OnScoreboardRowReplicated();
+	}
+}
+
+void FScoreboardRow::PostReplicatedChange(const FScoreboardArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->OnScoreboardRowReplicated();
+	}
+}
+
+void FScoreboardRow::PreReplicatedRemove(const FScoreboardArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->OnScoreboardRowReplicated();
+	}
+}
+
+AEmbedGameStateBase::AEmbedGameStateBase()
+{
+	ImpactEffectManagerClass = AImpactEffectManager::StaticClass();
+	GridStreamingManagerClass = AWorldGridStreamingManager::StaticClass();
+
+	ScoreboardUpdateRate = 2.0f;
+	PingRefreshInterval = 5.0f;
+	TimeToPingRefresh = 0.0f;
+}
+
+void AEmbedGameStateBase::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	//The scoreboard only changes when rows are added, removed or updated, and each of those marks it dirty
+	FDoRepLifetimeParams PushParams;
+	PushParams.bIsPushBased = true;
+	DOREPLIFETIME_WITH_PARAMS_FAST(AEmbedGameStateBase, Scoreboard, PushParams);
+}
+
+void AEmbedGameStateBase::PostInitializeComponents()
+{
+	Scoreboard.Owner = this;
+
+	Super::PostInitializeComponents();
+
+	FActorSpawnParameters SpawnInfo;
+	SpawnInfo.Owner = this;
+	SpawnInfo.Instigator = GetInstigator();
+	SpawnInfo.ObjectFlags |= RF_Transient;
+
+	// the game state exists on every machine, so it owns the client-side managers; a dedicated server renders nothing and gets none
+	if (GetNetMode() != NM_DedicatedServer && ImpactEffectManagerClass)
+	{
+		ImpactEffectManager = GetWorld()->SpawnActor<AImpactEffectManager>(ImpactEffectManagerClass, SpawnInfo);
+	}
+
+	// clients stream what their players see and servers what their players collide with, so every machine gets one
+	if (GridStreamingManagerClass && AMyWorldSettings::GetGridStreamingSettings(GetWorld()))
+	{
+		GridStreamingManager = GetWorld()->SpawnActor<AWorldGridStreamingManager>(GridStreamingManagerClass, SpawnInfo);
+	}
+}
+
+void AEmbedGameStateBase::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (HasAuthority() && ScoreboardUpdateRate > 0.0f)
+	{
+		GetWorldTimerManager().SetTimer(ScoreboardTimer, this, &AEmbedGameStateBase::UpdateScoreboard, 1.0f / ScoreboardUpdateRate, true);
+	}
+}
+
+void AEmbedGameStateBase::AddPlayerState(APlayerState* PlayerState)
+{
+	Super::AddPlayerState(PlayerState);
+
+	//Clients get their rows from the server
+	AEmbedPlayerState* EmbedPlayerState = Cast<AEmbedPlayerState>(PlayerState);
+	if (!HasAuthority() || EmbedPlayerState == nullptr || PlayerState->IsPendingKill())
+	{
+		return;
+	}
+
+	//A player state is added from its PostInitializeComponents, before its id and name are set. UpdateScoreboard sends
+	//them once they are.
+	if (!Scoreboard.Rows.ContainsByPredicate([EmbedPlayerState](const FScoreboardRow& Row) { return Row.PlayerState == EmbedPlayerState; }))
+	{
+		FScoreboardRow& Row = Scoreboard.Rows.AddDefaulted_GetRef();
+		Row.PlayerState = EmbedPlayerState;
+		Row.PlayerId = PlayerState->GetPlayerId();
+		Row.PlayerName = PlayerState->GetPlayerName();
+		Row.Stats = EmbedPlayerState->GetMatchStats();
+		Row.Ping = PlayerState->GetPing();
+		Scoreboard.MarkItemDirty(Row);
+		MARK_PROPERTY_DIRTY_FROM_NAME(AEmbedGameStateBase, Scoreboard, this);
+	}
+}
+
+void AEmbedGameStateBase::RemovePlayerState(APlayerState* PlayerState)
+{
+	if (HasAuthority())
+	{
+		const int32 Index = Scoreboard.Rows.IndexOfByPredicate([PlayerState](const FScoreboardRow& Row) { return Row.PlayerState == PlayerState; });
+		if (Index != INDEX_NONE)
+		{
+			Scoreboard.Rows.RemoveAt(Index);
+			Scoreboard.MarkArrayDirty();
+			MARK_PROPERTY_DIRTY_FROM_NAME(AEmbedGameStateBase, Scoreboard, this);
+		}
+	}
+
+	Super::RemovePlayerState(PlayerState);
+}
+
+void AEmbedGameStateBase::MarkScoreboardRowDirty(AEmbedPlayerState* PlayerState)
+{
+	if (HasAuthority())
+	{
+		DirtyPlayerStates.AddUnique(PlayerState);
+	}
+}
+
+void AEmbedGameStateBase::UpdateScoreboard()
+{
+	//A ping refresh touches every row, so it runs far less often than stats changes are sent.
+	TimeToPingRefresh -= 1.0f / ScoreboardUpdateRate;
+	const bool bRefreshPings = TimeToPingRefresh <= 0.0f;
+	if (bRefreshPings)
+	{
+		TimeToPingRefresh = PingRefreshInterval;
+	}
+
+	int32 NumRowsSent = 0;
+	for (FScoreboardRow& Row : Scoreboard.Rows)
+	{
+		AEmbedPlayerState* PlayerState = Row.PlayerState.Get();
+		if (PlayerState == nullptr)
+		{
+			continue;
+		}
+
+		bool bChanged = false;
+		if (DirtyPlayerStates.Contains(PlayerState))
+		{
+			Row.Stats = PlayerState->GetMatchStats();
+			bChanged = true;
+		}
+
+		if (Row.PlayerId != PlayerState->GetPlayerId())
+		{
+			Row.PlayerId = PlayerState->GetPlayerId();
+			bChanged = true;
+		}
+
+		if (Row.PlayerName != PlayerState->GetPlayerName())
+		{
+			Row.PlayerName = PlayerState->GetPlayerName();
+			bChanged = true;
+		}
+
+		if (bRefreshPings && Row.Ping != PlayerState->GetPing())
+		{
+			Row.Ping = PlayerState->GetPing();
+			bChanged = true;
+		}
+
+		if (bChanged)
+		{
+			Scoreboard.MarkItemDirty(Row);
+			++NumRowsSent;
+		}
+	}
+
+	DirtyPlayerStates.Reset();
+
+	SET_DWORD_STAT(STAT_ThirdPersonMP_ScoreboardRowsSent, NumRowsSent);
+	CSV_CUSTOM_STAT(ThirdPersonMP, ScoreboardRowsSent, NumRowsSent, ECsvCustomStatOp::Accumulate);
+
+	if (NumRowsSent > 0)
+	{
+		MARK_PROPERTY_DIRTY_FROM_NAME(AEmbedGameStateBase, Scoreboard, this);
+		OnScoreboardChanged.Broadcast();
+	}
+}
+
+void AEmbedGameStateBase::OnScoreboardRowReplicated()
+{
+	OnScoreboardChanged.Broadcast();
+}
@@ -4,14 +4,176 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/GameStateBase.h"
+#include "Engine/NetSerialization.h"
+#include "EmbedPlayerState.h"
 #include "EmbedGameStateBase.generated.h"
 
+class AEmbedGameStateBase;
+class AImpactEffectManager;
+class AWorldGridStreamingManager;
+class AProjectileSimulationManager;
+
+/** One player's line on the scoreboard. */
+USTRUCT(BlueprintType)
+struct FScoreboardRow : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	/** APlayerState::GetPlayerId of the player. */
+	UPROPERTY(BlueprintReadOnly, Category = "Scoreboard")
+	int32 PlayerId;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Scoreboard")
+	FString PlayerName;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Scoreboard")
+	FPlayerMatchStats Stats;
+
+	/** Ping in milliseconds divided by 4, as in APlayerState::GetPing. */
+	UPROPERTY(BlueprintReadOnly, Category = "Scoreboard")
+	uint8 Ping;
+
+	/** Server: the player the row is for. Rows are matched by this rather than PlayerId, which is not set yet when the row is added. */
+	TWeakObjectPtr<AEmbedPlayerState> PlayerState;
+
+	FScoreboardRow()
+		: PlayerId(INDEX_NONE)
+		, Ping(0)
+	{
+	}
+
+	void PostReplicatedAdd(const struct FScoreboardArray& InArraySerializer);
+	void PostReplicatedChange(const struct FScoreboardArray& InArraySerializer);
+	void PreReplicatedRemove(const struct FScoreboardArray& InArraySerializer);
+};
+
+/** Delta-replicated scoreboard, one row per player. */
+USTRUCT()
+struct FScoreboardArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FScoreboardRow> Rows;
+
+	/** Game state that owns this array, used to route client callbacks. */
+	UPROPERTY(NotReplicated)
+	AEmbedGameStateBase* Owner;
+
+	FScoreboardArray()
+		: Owner(nullptr)
+	{
+	}
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FScoreboardRow, FScoreboardArray>(Rows, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FScoreboardArray> : public TStructOpsTypeTraitsBase2<FScoreboardArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
 /**
- * 
+ * Game state. Owns the client-side managers, and replicates the match scoreboard: one fast-array row per player with
+ * their AEmbedPlayerState stats and ping. The server collects the rows that changed and sends them together
+ * ScoreboardUpdateRate times a second, so scoreboard traffic follows how much is happening rather than how many
+ * players there are, and the player states themselves can stay dormant.
  */
-UCLASS()
+UCLASS(config=Game)
 class THIRDPERSONMP_API AEmbedGameStateBase : public AGameStateBase
 {
 	GENERATED_BODY()
-	
+
+public:
+	AEmbedGameStateBase();
+
+	/** Property replication */
+	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	virtual void PostInitializeComponents() override;
+	virtual void AddPlayerState(APlayerState* PlayerState) override;
+	virtual void RemovePlayerState(APlayerState* PlayerState) override;
+
+	/** Returns this machine's impact effect manager, or nullptr on a dedicated server. */
+	FORCEINLINE AImpactEffectManager* GetImpactEffectManager() const { return ImpactEffectManager; }
+
+	/** Returns this machine's grid streaming, or nullptr when the map does not use it. */
+	FORCEINLINE AWorldGridStreamingManager* GetGridStreamingManager() const { return GridStreamingManager; }
+
+	/** Returns the batched projectile simulation once it has begun play on this machine, or nullptr when the match does not use it. */
+	FORCEINLINE AProjectileSimulationManager* GetProjectileSimulationManager() const { return ProjectileSimulationManager; }
+
+	/** Called by AProjectileSimulationManager when it begins play, so nothing has to search the world for it. */
+	FORCEINLINE void SetProjectileSimulationManager(AProjectileSimulationManager* InManager) { ProjectileSimulationManager = InManager; }
+
+	/** Returns every player's scoreboard row, in join order. */
+	FORCEINLINE const TArray<FScoreboardRow>& GetScoreboard() const { return Scoreboard.Rows; }
+
+	/** Sends PlayerState's row with the next scoreboard update. Server only. */
+	void MarkScoreboardRowDirty(AEmbedPlayerState* PlayerState);
+
+	/**
+	 * Copies the stats of every player marked dirty, and any new id, name or ping, into their rows, and marks those rows
+	 * for replication. Runs ScoreboardUpdateRate times a second on the server.
+	 */
+	void UpdateScoreboard();
+
+	/** Broadcast on clients whenever scoreboard rows arrive, and on the server whenever it sends them. */
+	FSimpleMulticastDelegate OnScoreboardChanged;
+
+	/** Scoreboard updates sent per second. Changes within one interval go out together. */
+	UPROPERTY(Config, EditAnywhere, Category = "Scoreboard")
+	float ScoreboardUpdateRate;
+
+	/** Seconds between refreshes of every row's ping. */
+	UPROPERTY(Config, EditAnywhere, Category = "Scoreboard")
+	float PingRefreshInterval;
+
+protected:
+	virtual void BeginPlay() override;
+
+	/** Called on clients for every row added, changed or removed. */
+	void OnScoreboardRowReplicated();
+
+	friend struct FScoreboardRow;
+
+	/** Class of the impact effect manager spawned on machines that render. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<AImpactEffectManager> ImpactEffectManagerClass;
+
+	/** Plays pooled, culled impact effects. Never created on a dedicated server. */
+	UPROPERTY(Transient)
+	AImpactEffectManager* ImpactEffectManager;
+
+	/** Class of the grid streaming manager spawned when the map's AMyWorldSettings enables grid streaming. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<AWorldGridStreamingManager> GridStreamingManagerClass;
+
+	/** Streams the map's cells around the players, on clients and servers alike. */
+	UPROPERTY(Transient)
+	AWorldGridStreamingManager* GridStreamingManager;
+
+	/** Spawned by AThirdPersonMPGameMode and replicated, so it registers itself here rather than being created by the game state. */
+	UPROPERTY(Transient)
+	AProjectileSimulationManager* ProjectileSimulationManager;
+
+	/** Push-model replicated: mark it dirty along with any row or the array. */
+	UPROPERTY(Replicated)
+	FScoreboardArray Scoreboard;
+
+private:
+	/** Server: players whose rows changed since the last update. */
+	TArray<TWeakObjectPtr<AEmbedPlayerState>> DirtyPlayerStates;
+
+	/** Server: seconds of updates left until pings are refreshed. */
+	float TimeToPingRefresh;
+
+	FTimerHandle ScoreboardTimer;
 };
@@ -2,4 +2,107 @@
 
 
 #include "EmbedPlayerState.h"
+#include "EmbedGameStateBase.h"
+#include "Engine/World.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/Pawn.h"
 
+bool FPlayerMatchStats::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	uint32 PackedKills = (uint32)FMath::Max(Kills, 0);
+	uint32 PackedDeaths = (uint32)FMath::Max(Deaths, 0);
+	uint32 PackedDamage = (uint32)FMath::Max(FMath::RoundToInt(DamageDealt), 0);
+	uint32 PackedShotsFired = (uint32)FMath::Max(ShotsFired, 0);
+	uint32 PackedShotsHit = (uint32)FMath::Max(ShotsHit, 0);
+
+	Ar.SerializeIntPacked(PackedKills);
+	Ar.SerializeIntPacked(PackedDeaths);
+	Ar.SerializeIntPacked(PackedDamage);
+	Ar.SerializeIntPacked(PackedShotsFired);
+	Ar.SerializeIntPacked(PackedShotsHit);
+
+	if (Ar.IsLoading())
+	{
+		Kills = (int32)PackedKills;
+		Deaths = (int32)PackedDeaths;
+		DamageDealt = (float)PackedDamage;
+		ShotsFired = (int32)PackedShotsFired;
+		ShotsHit = (int32)PackedShotsHit;
+	}
+
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
+
+AEmbedPlayerState::AEmbedPlayerState()
+{
+	//Stats go out through the game state's scoreboard, so between changes to the name or other engine properties there is nothing to send.
+	NetDormancy = DORM_DormantAll;
+}
+
+void AEmbedPlayerState::CopyProperties(APlayerState* PlayerState)
+{
+	Super::CopyProperties(PlayerState);
+
+	if (AEmbedPlayerState* EmbedPlayerState = Cast<AEmbedPlayerState>(PlayerState))
+	{
+		EmbedPlayerState->MatchStats = MatchStats;
+		EmbedPlayerState->OnMatchStatsChanged();
+	}
+}
+
+void AEmbedPlayerState::AddShotFired()
+{
+	++MatchStats.ShotsFired;
+	OnMatchStatsChanged();
+}
+
+void AEmbedPlayerState::AddHit(float Damage)
+{
+	++MatchStats.ShotsHit;
+	MatchStats.DamageDealt += Damage;
+	OnMatchStatsChanged();
+}
+
+void AEmbedPlayerState::AddKill()
+{
+	++MatchStats.Kills;
+	OnMatchStatsChanged();
+}
+
+void AEmbedPlayerState::AddDeath()
+{
+	++MatchStats.Deaths;
+	OnMatchStatsChanged();
+}
+
+void AEmbedPlayerState::RecordHit(AController* InstigatorController, AActor* HitActor, float Damage)
+{
+	APawn* HitPawn = Cast<APawn>(HitActor);
+	AEmbedPlayerState* Shooter = InstigatorController ? InstigatorController->GetPlayerState<AEmbedPlayerState>() : nullptr;
+	if (HitPawn && Shooter && HitPawn != InstigatorController->GetPawn())
+	{
+		Shooter->AddHit(Damage);
+	}
+}
+
+void AEmbedPlayerState::RecordKill(AController* Killer, AController* Victim)
+{
+	if (AEmbedPlayerState* VictimState = Victim ? Victim->GetPlayerState<AEmbedPlayerState>() : nullptr)
+	{
+		VictimState->AddDeath();
+	}
+
+	if (AEmbedPlayerState* KillerState = (Killer && Killer != Victim) ? Killer->GetPlayerState<AEmbedPlayerState>() : nullptr)
+	{
+		KillerState->AddKill();
+	}
+}
+
+void AEmbedPlayerState::OnMatchStatsChanged()
+{
+	if (AEmbedGameStateBase* GameState = GetWorld()->GetGameState<AEmbedGameStateBase>())
+	{
+		GameState->MarkScoreboardRowDirty(this);
+	}
+}
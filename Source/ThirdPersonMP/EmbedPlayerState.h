@@ -6,12 +6,95 @@
 #include "GameFramework/PlayerState.h"
 #include "EmbedPlayerState.generated.h"
 
+/** A player's stats for the current match. */
+USTRUCT(BlueprintType)
+struct FPlayerMatchStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+	int32 Kills;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+	int32 Deaths;
+
+	/** Damage dealt by this player's projectiles, before it is resolved by the target. */
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+	float DamageDealt;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+	int32 ShotsFired;
+
+	/** Shots that hit a pawn. */
+	UPROPERTY(BlueprintReadOnly, Category = "Stats")
+	int32 ShotsHit;
+
+	FPlayerMatchStats()
+		: Kills(0)
+		, Deaths(0)
+		, DamageDealt(0.0f)
+		, ShotsFired(0)
+		, ShotsHit(0)
+	{
+	}
+
+	/** Returns the fraction of shots fired that hit, from 0 to 1. */
+	FORCEINLINE float GetAccuracy() const
+	{
+		return ShotsFired > 0 ? FMath::Min((float)ShotsHit / ShotsFired, 1.0f) : 0.0f;
+	}
+
+	/** Packs each stat into as few bytes as its value needs. Damage is sent rounded to a whole point. */
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FPlayerMatchStats> : public TStructOpsTypeTraitsBase2<FPlayerMatchStats>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
 /**
- * 
+ * Player state carrying the player's match stats. The stats are kept on the server and reach clients as a row of
+ * AEmbedGameStateBase's scoreboard, so the player state itself stays net dormant and only wakes up when one of the
+ * engine's own properties, such as the player name, changes. Those are push-model replicated (net.IsPushModelEnabled),
+ * so they must be changed through APlayerState's setters, which mark them dirty, rather than written directly.
  */
 UCLASS()
 class THIRDPERSONMP_API AEmbedPlayerState : public APlayerState
 {
 	GENERATED_BODY()
-	
+
+public:
+	AEmbedPlayerState();
+
+	/** Keeps the stats of a player who reconnects during the match. */
+	virtual void CopyProperties(APlayerState* PlayerState) override;
+
+	/** Returns this player's stats. Up to date on the server only; clients read the game state's scoreboard. */
+	FORCEINLINE const FPlayerMatchStats& GetMatchStats() const { return MatchStats; }
+
+	/** Counts a shot fired by this player. Server only. */
+	void AddShotFired();
+
+	/** Counts a hit on a pawn for Damage. Server only. */
+	void AddHit(float Damage);
+
+	void AddKill();
+	void AddDeath();
+
+	/** Counts a hit for Damage to the player behind InstigatorController, if HitActor is a pawn other than their own. */
+	static void RecordHit(AController* InstigatorController, AActor* HitActor, float Damage);
+
+	/** Counts a death for Victim's player and, unless it was their own doing, a kill for Killer's. */
+	static void RecordKill(AController* Killer, AController* Victim);
+
+private:
+	/** Queues this player's scoreboard row to be sent with the game state's next update. */
+	void OnMatchStatsChanged();
+
+	FPlayerMatchStats MatchStats;
 };
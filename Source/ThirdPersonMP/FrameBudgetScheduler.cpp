@@ -0,0 +1,199 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "FrameBudgetScheduler.h"
+#include "ThirdPersonMP.h"
+#include "ThirdPersonMPGameMode.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("RunDeferredWork"), STAT_ThirdPersonMP_RunDeferredWork, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Deferred Work Queued (High)"), STAT_ThirdPersonMP_DeferredQueuedHigh, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Deferred Work Queued (Normal)"), STAT_ThirdPersonMP_DeferredQueuedNormal, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Deferred Work Queued (Low)"), STAT_ThirdPersonMP_DeferredQueuedLow, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Deferred Work Run"), STAT_ThirdPersonMP_DeferredRun, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Deferred Work Run Over Budget"), STAT_ThirdPersonMP_DeferredStarved, STATGROUP_ThirdPersonMP);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Deferred Work Wait Mean (ms)"), STAT_ThirdPersonMP_DeferredWaitMeanMs, STATGROUP_ThirdPersonMP);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Deferred Work Wait Max (ms)"), STAT_ThirdPersonMP_DeferredWaitMaxMs, STATGROUP_ThirdPersonMP);
+
+static int32 GThirdPersonMPDeferWork = 1;
+static FAutoConsoleVariableRef CVarThirdPersonMPDeferWork(
+	TEXT("ThirdPersonMP.DeferWork"),
+	GThirdPersonMPDeferWork,
+	TEXT("If nonzero, non-urgent server work waits for AFrameBudgetScheduler to run it within the frame budget. If zero, it runs immediately."),
+	ECVF_Default);
+
+AFrameBudgetScheduler::AFrameBudgetScheduler()
+{
+	//After every other actor, so what the frame has already spent is known and work queued this frame can still run in it.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_LastDemotable;
+	bReplicates = false;
+
+	FrameBudgetFraction = 0.75f;
+	DefaultTickIntervalMs = 33.3f;
+	MinWorkMs = 0.25f;
+	HighMaxDelay = 0.1f;
+	NormalMaxDelay = 0.5f;
+	LowMaxDelay = 2.0f;
+
+	FMemory::Memzero(QueueDepths);
+	FrameStartTime = 0.0;
+	NumRun = 0;
+	NumStarved = 0;
+	TotalWaitMs = 0.0;
+	MaxWaitMs = 0.0f;
+}
+
+void AFrameBudgetScheduler::Defer(const UObject* WorldContextObject, EDeferredWorkPriority Priority, TFunction<void()>&& Work)
+{
+	if (AFrameBudgetScheduler* Scheduler = GetDeferringScheduler(WorldContextObject))
+	{
+		Scheduler->Enqueue(Priority, MoveTemp(Work));
+	}
+	else
+	{
+		Work();
+	}
+}
+
+bool AFrameBudgetScheduler::IsDeferring(const UObject* WorldContextObject)
+{
+	return GetDeferringScheduler(WorldContextObject) != nullptr;
+}
+
+AFrameBudgetScheduler* AFrameBudgetScheduler::GetDeferringScheduler(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	AThirdPersonMPGameMode* GameMode = World ? World->GetAuthGameMode<AThirdPersonMPGameMode>() : nullptr;
+	AFrameBudgetScheduler* Scheduler = GameMode ? GameMode->GetFrameBudgetScheduler() : nullptr;
+	return (Scheduler && Scheduler->HasActorBegunPlay() && GThirdPersonMPDeferWork) ? Scheduler : nullptr;
+}
+
+void AFrameBudgetScheduler::Enqueue(EDeferredWorkPriority Priority, TFunction<void()>&& Work)
+{
+	check((int32)Priority < (int32)EDeferredWorkPriority::Num);
+
+	FDeferredWork Item;
+	Item.Work = MoveTemp(Work);
+	Item.EnqueueTime = FPlatformTime::Seconds();
+	Queues[(int32)Priority].Enqueue(MoveTemp(Item));
+	++QueueDepths[(int32)Priority];
+}
+
+void AFrameBudgetScheduler::BeginPlay()
+{
+	Super::BeginPlay();
+
+	WorldTickStartHandle = FWorldDelegates::OnWorldTickStart.AddUObject(this, &AFrameBudgetScheduler::OnWorldTickStart);
+}
+
+void AFrameBudgetScheduler::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	FWorldDelegates::OnWorldTickStart.Remove(WorldTickStartHandle);
+
+	Super::EndPlay(EndPlayReason);
+
+	//Nothing is dropped. Whatever is still queued runs now, and anything it defers in turn runs immediately.
+	const double Now = FPlatformTime::Seconds();
+	for (int32 Priority = 0; Priority < (int32)EDeferredWorkPriority::Num; ++Priority)
+	{
+		while (!Queues[Priority].IsEmpty())
+		{
+			RunNext(Priority, Now);
+		}
+	}
+}
+
+void AFrameBudgetScheduler::OnWorldTickStart(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds)
+{
+	if (InWorld == GetWorld())
+	{
+		FrameStartTime = FPlatformTime::Seconds();
+	}
+}
+
+void AFrameBudgetScheduler::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	THIRDPERSONMP_SCOPE(RunDeferredWork);
+
+	NumRun = 0;
+	NumStarved = 0;
+	TotalWaitMs = 0.0;
+	MaxWaitMs = 0.0f;
+
+	const float MaxDelays[(int32)EDeferredWorkPriority::Num] = { HighMaxDelay, NormalMaxDelay, LowMaxDelay };
+	const double TickStartTime = FPlatformTime::Seconds();
+	double Now = TickStartTime;
+
+	//Work that has waited longer than its priority allows runs first, whatever the budget.
+	for (int32 Priority = 0; Priority < (int32)EDeferredWorkPriority::Num; ++Priority)
+	{
+		const FDeferredWork* Head = Queues[Priority].Peek();
+		while (Head && Now - Head->EnqueueTime > MaxDelays[Priority])
+		{
+			RunNext(Priority, Now);
+			++NumStarved;
+			Now = FPlatformTime::Seconds();
+			Head = Queues[Priority].Peek();
+		}
+	}
+
+	//Then whatever fits in the rest of the frame's budget, highest priority first. Turning deferral off drains everything.
+	const double FrameStart = FrameStartTime > 0.0 ? FrameStartTime : TickStartTime;
+	const double Deadline = GThirdPersonMPDeferWork
+		? FMath::Max(FrameStart + GetFrameBudgetMs() / 1000.0, TickStartTime + MinWorkMs / 1000.0)
+		: MAX_dbl;
+	for (int32 Priority = 0; Priority < (int32)EDeferredWorkPriority::Num && Now < Deadline; ++Priority)
+	{
+		while (!Queues[Priority].IsEmpty() && Now < Deadline)
+		{
+			RunNext(Priority, Now);
+			Now = FPlatformTime::Seconds();
+		}
+	}
+
+	const float MeanWaitMs = NumRun > 0 ? (float)(TotalWaitMs / NumRun) : 0.0f;
+
+	SET_DWORD_STAT(STAT_ThirdPersonMP_DeferredQueuedHigh, GetQueueDepth(EDeferredWorkPriority::High));
+	SET_DWORD_STAT(STAT_ThirdPersonMP_DeferredQueuedNormal, GetQueueDepth(EDeferredWorkPriority::Normal));
+	SET_DWORD_STAT(STAT_ThirdPersonMP_DeferredQueuedLow, GetQueueDepth(EDeferredWorkPriority::Low));
+	SET_DWORD_STAT(STAT_ThirdPersonMP_DeferredRun, NumRun);
+	SET_DWORD_STAT(STAT_ThirdPersonMP_DeferredStarved, NumStarved);
+	SET_FLOAT_STAT(STAT_ThirdPersonMP_DeferredWaitMeanMs, MeanWaitMs);
+	SET_FLOAT_STAT(STAT_ThirdPersonMP_DeferredWaitMaxMs, MaxWaitMs);
+	CSV_CUSTOM_STAT(ThirdPersonMP, DeferredQueuedHigh, GetQueueDepth(EDeferredWorkPriority::High), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ThirdPersonMP, DeferredQueuedNormal, GetQueueDepth(EDeferredWorkPriority::Normal), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ThirdPersonMP, DeferredQueuedLow, GetQueueDepth(EDeferredWorkPriority::Low), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ThirdPersonMP, DeferredRun, NumRun, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ThirdPersonMP, DeferredRunOverBudget, NumStarved, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ThirdPersonMP, DeferredWaitMeanMs, MeanWaitMs, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ThirdPersonMP, DeferredWaitMaxMs, MaxWaitMs, ECsvCustomStatOp::Set);
+}
+
+void AFrameBudgetScheduler::RunNext(int32 Priority, double Now)
+{
+	FDeferredWork Item;
+	if (!Queues[Priority].Dequeue(Item))
+	{
+		return;
+	}
+	--QueueDepths[Priority];
+
+	const float WaitMs = (float)((Now - Item.EnqueueTime) * 1000.0);
+	TotalWaitMs += WaitMs;
+	MaxWaitMs = FMath::Max(MaxWaitMs, WaitMs);
+	++NumRun;
+
+	Item.Work();
+}
+
+float AFrameBudgetScheduler::GetFrameBudgetMs() const
+{
+	const UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	const float TickIntervalMs = (NetDriver && NetDriver->NetServerMaxTickRate > 0) ? 1000.0f / NetDriver->NetServerMaxTickRate : DefaultTickIntervalMs;
+	return TickIntervalMs * FrameBudgetFraction;
+}
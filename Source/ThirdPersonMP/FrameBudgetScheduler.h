@@ -0,0 +1,117 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "Containers/Queue.h"
+#include "FrameBudgetScheduler.generated.h"
+
+/** How long deferred server work may wait. Queues are drained in this order. */
+UENUM()
+enum class EDeferredWorkPriority : uint8
+{
+	/** Work players see within a few frames, such as impact effects on a listen server. */
+	High,
+
+	/** Follow-up nobody waits on, such as starting an impact's damage over time. */
+	Normal,
+
+	/** Work that only has to happen eventually, such as growing pools. */
+	Low,
+
+	Num UMETA(Hidden)
+};
+
+/**
+ * Runs non-urgent server work within the frame's time budget. Work is queued by priority with Defer and drained at the
+ * end of each frame's actor ticks, for as long as the frame is under FrameBudgetFraction of the server's tick interval.
+ * What does not fit carries over to later frames, so a burst (a whole team firing at once) spreads its follow-up work
+ * over the frames after it instead of pushing its own frame over the tick. Each frame drains at least MinWorkMs, and
+ * work that has waited longer than its priority's max delay runs whatever the budget, so nothing starves.
+ *
+ * Reports queue depths, work run, and the time work waited under stat ThirdPersonMP and in the CSV profiler.
+ * ThirdPersonMP.DeferWork 0 runs everything immediately instead, for comparison. Spawned by AThirdPersonMPGameMode.
+ */
+UCLASS(config=Game, notplaceable)
+class THIRDPERSONMP_API AFrameBudgetScheduler : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AFrameBudgetScheduler();
+
+	/**
+	 * Queues Work on the scheduler of WorldContextObject's world. Runs it immediately where there is none (clients) or
+	 * deferral is off. Work runs on the game thread and must check that whatever it captured still exists.
+	 */
+	static void Defer(const UObject* WorldContextObject, EDeferredWorkPriority Priority, TFunction<void()>&& Work);
+
+	/** Returns true if Defer would queue work in WorldContextObject's world rather than run it immediately. */
+	static bool IsDeferring(const UObject* WorldContextObject);
+
+	/** Queues Work to run when the budget allows. */
+	void Enqueue(EDeferredWorkPriority Priority, TFunction<void()>&& Work);
+
+	/** Returns the number of work items waiting at Priority. */
+	FORCEINLINE int32 GetQueueDepth(EDeferredWorkPriority Priority) const { return QueueDepths[(int32)Priority]; }
+
+	/** Fraction of the server's tick interval the frame may use before deferred work waits for the next frame. */
+	UPROPERTY(Config, EditAnywhere, Category = "Scheduling")
+	float FrameBudgetFraction;
+
+	/** Tick interval assumed when there is no net driver to take the server's tick rate from, in milliseconds. */
+	UPROPERTY(Config, EditAnywhere, Category = "Scheduling")
+	float DefaultTickIntervalMs;
+
+	/** Milliseconds of deferred work run every frame, even a frame already over budget. */
+	UPROPERTY(Config, EditAnywhere, Category = "Scheduling")
+	float MinWorkMs;
+
+	/** Seconds work of each priority may wait before it runs whatever the budget. */
+	UPROPERTY(Config, EditAnywhere, Category = "Scheduling")
+	float HighMaxDelay;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Scheduling")
+	float NormalMaxDelay;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Scheduling")
+	float LowMaxDelay;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+
+private:
+	struct FDeferredWork
+	{
+		TFunction<void()> Work;
+		double EnqueueTime;
+	};
+
+	/** Returns the scheduler of WorldContextObject's world if it has begun play and deferral is on, otherwise nullptr. */
+	static AFrameBudgetScheduler* GetDeferringScheduler(const UObject* WorldContextObject);
+
+	void OnWorldTickStart(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds);
+
+	/** Runs the oldest work at Priority and records how long it waited. */
+	void RunNext(int32 Priority, double Now);
+
+	/** Returns the milliseconds this frame may take before deferred work stops. */
+	float GetFrameBudgetMs() const;
+
+	TQueue<FDeferredWork> Queues[(int32)EDeferredWorkPriority::Num];
+	int32 QueueDepths[(int32)EDeferredWorkPriority::Num];
+
+	/** When the current world tick started. */
+	double FrameStartTime;
+
+	/** This frame's work run, how much of it ran past the budget because it had waited too long, and how long it waited. */
+	int32 NumRun;
+	int32 NumStarved;
+	double TotalWaitMs;
+	float MaxWaitMs;
+
+	FDelegateHandle WorldTickStartHandle;
+};
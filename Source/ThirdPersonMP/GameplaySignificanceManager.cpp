@@ -0,0 +1,329 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "GameplaySignificanceManager.h"
+#include "ThirdPersonMP.h"
+#include "ThirdPersonMPReplicationGraph.h"
+#include "Async/ParallelFor.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("UpdateSignificance"), STAT_ThirdPersonMP_UpdateSignificance, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Significance Updates"), STAT_ThirdPersonMP_SignificanceUpdates, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Significance Actors"), STAT_ThirdPersonMP_SignificanceActors, STATGROUP_ThirdPersonMP);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Ticks Saved/Frame"), STAT_ThirdPersonMP_TicksSavedPerFrame, STATGROUP_ThirdPersonMP);
+
+AGameplaySignificanceManager::AGameplaySignificanceManager()
+{
+	//Score after everything has moved for the frame.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+
+	bReplicates = false;
+
+	MaxSignificanceDistance = 10000.0f;
+	ActivityWindow = 2.0f;
+	UpdateBudgetMs = 0.25f;
+	NextEntry = 0;
+}
+
+void AGameplaySignificanceManager::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	Tiers.Sort([](const FSignificanceTier& A, const FSignificanceTier& B) { return A.MinSignificance > B.MinSignificance; });
+	TierActorTicks.SetNumZeroed(Tiers.Num());
+	TierAnimationTicks.SetNumZeroed(Tiers.Num());
+}
+
+void AGameplaySignificanceManager::RegisterActor(AActor* Actor)
+{
+	if (Actor == nullptr || EntryIndices.Contains(Actor))
+	{
+		return;
+	}
+
+	TInlineComponentArray<USkeletalMeshComponent*> Meshes(Actor);
+
+	EntryIndices.Add(Actor, Entries.Num());
+
+	FSignificanceEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.Actor = Actor;
+	Entry.DefaultTickInterval = Actor->GetActorTickInterval();
+	Entry.DefaultNetUpdateFrequency = Actor->NetUpdateFrequency;
+	Entry.LastActiveTime = GetWorld()->GetTimeSeconds();
+	Entry.Tier = INDEX_NONE;
+	Entry.NumActorTicks = Actor->IsActorTickEnabled() ? 1 : 0;
+	Entry.NumAnimatedMeshes = Meshes.Num();
+	Entry.bTickDisabled = false;
+}
+
+void AGameplaySignificanceManager::UnregisterActor(AActor* Actor)
+{
+	const int32* Index = EntryIndices.Find(Actor);
+	if (Index != nullptr)
+	{
+		const int32 EntryIndex = *Index;
+		ApplyTier(Entries[EntryIndex], Actor, INDEX_NONE);
+		RemoveEntry(EntryIndex);
+	}
+}
+
+void AGameplaySignificanceManager::NotifyActivity(AActor* Actor)
+{
+	const int32* Index = EntryIndices.Find(Actor);
+	if (Index == nullptr)
+	{
+		return;
+	}
+
+	FSignificanceEntry* Entry = &Entries[*Index];
+
+	//Bring the actor back to full rate now rather than when the round-robin next reaches it.
+	Entry->LastActiveTime = GetWorld()->GetTimeSeconds();
+	if (Entry->Tier != 0 && Tiers.Num() > 0)
+	{
+		ApplyTier(*Entry, Actor, 0);
+	}
+}
+
+void AGameplaySignificanceManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	SCOPE_CYCLE_COUNTER(STAT_ThirdPersonMP_UpdateSignificance);
+	CSV_SCOPED_TIMING_STAT(ThirdPersonMP, UpdateSignificance);
+
+	ViewLocations.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APlayerController* PlayerController = It->Get())
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+			ViewLocations.Add(ViewLocation);
+		}
+	}
+
+	int32 NumVisited = 0;
+	if (GThirdPersonMPParallelCharacterWork != 0)
+	{
+		//On worker threads every actor is rescored each frame, so none waits for the round-robin to reach it.
+		UpdateAllActors(ViewLocations, true);
+		NumVisited = Entries.Num();
+	}
+	else
+	{
+		const float Now = GetWorld()->GetTimeSeconds();
+		const double Deadline = FPlatformTime::Seconds() + UpdateBudgetMs / 1000.0;
+		const int32 NumToVisit = Entries.Num();
+		while (NumVisited < NumToVisit && Entries.Num() > 0)
+		{
+			if (NextEntry >= Entries.Num())
+			{
+				NextEntry = 0;
+			}
+
+			FSignificanceEntry& Entry = Entries[NextEntry];
+			++NumVisited;
+
+			AActor* Actor = Entry.Actor.Get();
+			if (Actor == nullptr)
+			{
+				CountTickFunctions(Entry, -1);
+				RemoveEntry(NextEntry);
+				continue;
+			}
+
+			UpdateEntry(Entry, Actor, Now);
+			++NextEntry;
+
+			//Reading the clock costs about as much as scoring a few actors, so only check it every few.
+			if ((NumVisited % 16) == 0 && FPlatformTime::Seconds() > Deadline)
+			{
+				break;
+			}
+		}
+	}
+
+	const float TicksSaved = EstimateTicksSaved(DeltaSeconds);
+	SET_DWORD_STAT(STAT_ThirdPersonMP_SignificanceUpdates, NumVisited);
+	SET_DWORD_STAT(STAT_ThirdPersonMP_SignificanceActors, Entries.Num());
+	SET_FLOAT_STAT(STAT_ThirdPersonMP_TicksSavedPerFrame, TicksSaved);
+	CSV_CUSTOM_STAT(ThirdPersonMP, TicksSavedPerFrame, TicksSaved, ECsvCustomStatOp::Set);
+}
+
+void AGameplaySignificanceManager::UpdateAllActors(TArrayView<const FVector> InViewLocations, bool bParallel)
+{
+	if (ViewLocations.GetData() != InViewLocations.GetData())
+	{
+		ViewLocations.Reset();
+		ViewLocations.Append(InViewLocations.GetData(), InViewLocations.Num());
+	}
+
+	RemoveStaleEntries();
+
+	//Locations are read on the game thread. Scoring is a distance to every viewer per actor, and only touches the entries, so that part runs on the workers.
+	const float Now = GetWorld()->GetTimeSeconds();
+	EntryLocations.SetNumUninitialized(Entries.Num(), false);
+	EntryTiers.SetNumUninitialized(Entries.Num(), false);
+	for (int32 Index = 0; Index < Entries.Num(); ++Index)
+	{
+		EntryLocations[Index] = Entries[Index].Actor.Get()->GetActorLocation();
+	}
+
+	ParallelFor(Entries.Num(), [this, Now](int32 Index)
+	{
+		EntryTiers[Index] = FindTier(ScoreEntry(Entries[Index], EntryLocations[Index], Now));
+	}, !bParallel);
+
+	//Applying a tier changes tick functions and the replication graph, so it stays on the game thread.
+	for (int32 Index = 0; Index < Entries.Num(); ++Index)
+	{
+		if (EntryTiers[Index] != Entries[Index].Tier)
+		{
+			ApplyTier(Entries[Index], Entries[Index].Actor.Get(), EntryTiers[Index]);
+		}
+	}
+}
+
+void AGameplaySignificanceManager::RemoveStaleEntries()
+{
+	for (int32 Index = Entries.Num() - 1; Index >= 0; --Index)
+	{
+		if (!Entries[Index].Actor.IsValid())
+		{
+			CountTickFunctions(Entries[Index], -1);
+			RemoveEntry(Index);
+		}
+	}
+}
+
+void AGameplaySignificanceManager::RemoveEntry(int32 Index)
+{
+	EntryIndices.Remove(Entries[Index].Actor);
+	Entries.RemoveAtSwap(Index, 1, false);
+
+	//The last entry moved into the gap.
+	if (Index < Entries.Num())
+	{
+		EntryIndices.Add(Entries[Index].Actor, Index);
+	}
+}
+
+void AGameplaySignificanceManager::UpdateEntry(FSignificanceEntry& Entry, AActor* Actor, float Now)
+{
+	const int32 NewTier = FindTier(ScoreEntry(Entry, Actor->GetActorLocation(), Now));
+	if (NewTier != Entry.Tier)
+	{
+		ApplyTier(Entry, Actor, NewTier);
+	}
+}
+
+float AGameplaySignificanceManager::ScoreEntry(const FSignificanceEntry& Entry, const FVector& Location, float Now) const
+{
+	if (Now - Entry.LastActiveTime <= ActivityWindow)
+	{
+		return 1.0f;
+	}
+
+	float MinDistanceSquared = MAX_flt;
+	for (const FVector& ViewLocation : ViewLocations)
+	{
+		MinDistanceSquared = FMath::Min(MinDistanceSquared, FVector::DistSquared(Location, ViewLocation));
+	}
+
+	//With nobody watching, nothing is significant.
+	return (ViewLocations.Num() > 0 && MaxSignificanceDistance > 0.0f) ? 1.0f - FMath::Min(FMath::Sqrt(MinDistanceSquared) / MaxSignificanceDistance, 1.0f) : 0.0f;
+}
+
+int32 AGameplaySignificanceManager::FindTier(float Significance) const
+{
+	for (int32 Index = 0; Index < Tiers.Num(); ++Index)
+	{
+		if (Significance >= Tiers[Index].MinSignificance)
+		{
+			return Index;
+		}
+	}
+	return Tiers.Num() - 1;
+}
+
+void AGameplaySignificanceManager::ApplyTier(FSignificanceEntry& Entry, AActor* Actor, int32 NewTier)
+{
+	const FSignificanceTier* Tier = Tiers.IsValidIndex(NewTier) ? &Tiers[NewTier] : nullptr;
+
+	if (Actor->PrimaryActorTick.bCanEverTick)
+	{
+		Actor->SetActorTickInterval((Tier && Tier->TickInterval > 0.0f) ? Tier->TickInterval : Entry.DefaultTickInterval);
+
+		//Only turn back on a tick this manager turned off. Actors that switch their own tick on and off keep control of it.
+		const bool bDisableTick = Tier && !Tier->bTickEnabled;
+		if (bDisableTick && !Entry.bTickDisabled && Actor->IsActorTickEnabled())
+		{
+			Actor->SetActorTickEnabled(false);
+			Entry.bTickDisabled = true;
+		}
+		else if (!bDisableTick && Entry.bTickDisabled)
+		{
+			Actor->SetActorTickEnabled(true);
+			Entry.bTickDisabled = false;
+		}
+	}
+
+	TInlineComponentArray<USkeletalMeshComponent*> Meshes(Actor);
+	for (USkeletalMeshComponent* Mesh : Meshes)
+	{
+		Mesh->SetComponentTickInterval(Tier ? Tier->AnimationTickInterval : 0.0f);
+	}
+
+	SetNetUpdateFrequency(Actor, (Tier && Tier->NetUpdateFrequency > 0.0f) ? Tier->NetUpdateFrequency : Entry.DefaultNetUpdateFrequency);
+
+	CountTickFunctions(Entry, -1);
+	Entry.Tier = NewTier;
+	CountTickFunctions(Entry, 1);
+}
+
+void AGameplaySignificanceManager::SetNetUpdateFrequency(AActor* Actor, float NetUpdateFrequency) const
+{
+	//The replication graph turns NetUpdateFrequency into a replication period once, when the actor is added, so it has to be told about changes. It keeps each connection's bandwidth slowdown on top of the new rate.
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	if (UThirdPersonMPReplicationGraph* ReplicationGraph = NetDriver ? NetDriver->GetReplicationDriver<UThirdPersonMPReplicationGraph>() : nullptr)
+	{
+		ReplicationGraph->SetActorNetUpdateFrequency(Actor, NetUpdateFrequency);
+	}
+	else
+	{
+		Actor->NetUpdateFrequency = NetUpdateFrequency;
+	}
+}
+
+void AGameplaySignificanceManager::CountTickFunctions(const FSignificanceEntry& Entry, int32 Sign)
+{
+	if (TierActorTicks.IsValidIndex(Entry.Tier))
+	{
+		TierActorTicks[Entry.Tier] += Sign * Entry.NumActorTicks;
+		TierAnimationTicks[Entry.Tier] += Sign * Entry.NumAnimatedMeshes;
+	}
+}
+
+float AGameplaySignificanceManager::EstimateTicksSaved(float DeltaSeconds) const
+{
+	//A tick function with an interval longer than the frame runs on roughly DeltaSeconds / Interval of the frames.
+	auto SkippedFraction = [DeltaSeconds](float Interval)
+	{
+		return Interval > DeltaSeconds ? 1.0f - DeltaSeconds / Interval : 0.0f;
+	};
+
+	float TicksSaved = 0.0f;
+	for (int32 Index = 0; Index < Tiers.Num(); ++Index)
+	{
+		const FSignificanceTier& Tier = Tiers[Index];
+		TicksSaved += TierActorTicks[Index] * (Tier.bTickEnabled ? SkippedFraction(Tier.TickInterval) : 1.0f);
+		TicksSaved += TierAnimationTicks[Index] * SkippedFraction(Tier.AnimationTickInterval);
+	}
+	return TicksSaved;
+}
@@ -0,0 +1,160 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "GameplaySignificanceManager.generated.h"
+
+/** How an actor is updated while its significance is at least MinSignificance. */
+USTRUCT()
+struct FSignificanceTier
+{
+	GENERATED_BODY()
+
+	/** Lowest significance, from 0 to 1, that falls in this tier. */
+	UPROPERTY(EditAnywhere, Category = "Significance")
+	float MinSignificance;
+
+	/** If false, the actor's own tick is turned off. */
+	UPROPERTY(EditAnywhere, Category = "Significance")
+	bool bTickEnabled;
+
+	/** Seconds between actor ticks. Zero keeps the actor's own interval. */
+	UPROPERTY(EditAnywhere, Category = "Significance")
+	float TickInterval;
+
+	/** Seconds between skeletal mesh (animation) ticks. Zero ticks every frame. */
+	UPROPERTY(EditAnywhere, Category = "Significance")
+	float AnimationTickInterval;
+
+	/** Net updates per second. Zero keeps the actor's own frequency. */
+	UPROPERTY(EditAnywhere, Category = "Significance")
+	float NetUpdateFrequency;
+
+	FSignificanceTier()
+		: MinSignificance(0.0f)
+		, bTickEnabled(true)
+		, TickInterval(0.0f)
+		, AnimationTickInterval(0.0f)
+		, NetUpdateFrequency(0.0f)
+	{
+	}
+};
+
+/**
+ * Server-side throttling of gameplay actors. Scores each registered actor from 0 to 1 by its distance to the nearest
+ * player's view point, with actors that were active recently (firing, taking damage) held at 1, and applies the tick,
+ * animation and net update settings of the tier the score falls in. Actors are rescored round-robin within
+ * UpdateBudgetMs per frame, so the cost stays fixed however many actors there are. With
+ * ThirdPersonMP.ParallelCharacterWork, every actor is scored each frame on worker threads instead. Owned and spawned
+ * by AThirdPersonMPGameMode.
+ */
+UCLASS(config=Game, notplaceable)
+class THIRDPERSONMP_API AGameplaySignificanceManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AGameplaySignificanceManager();
+
+	virtual void PostInitializeComponents() override;
+	virtual void Tick(float DeltaSeconds) override;
+
+	/** Starts scoring Actor. Its current tick interval and net update frequency are what tiers with zero values restore. */
+	void RegisterActor(AActor* Actor);
+
+	/** Stops scoring Actor and restores its own settings. */
+	void UnregisterActor(AActor* Actor);
+
+	/** Marks Actor as active, keeping it at full significance for ActivityWindow seconds. */
+	void NotifyActivity(AActor* Actor);
+
+	/**
+	 * Scores every registered actor against InViewLocations and applies the tiers that changed. With bParallel, the
+	 * scores are computed on worker threads; applying tiers always happens on the game thread. Called from Tick, and by
+	 * the parallel character work benchmark.
+	 */
+	void UpdateAllActors(TArrayView<const FVector> InViewLocations, bool bParallel);
+
+	/** Tiers, from most to least significant. Sorted by MinSignificance when the manager is spawned. */
+	UPROPERTY(Config, EditAnywhere, Category = "Significance")
+	TArray<FSignificanceTier> Tiers;
+
+	/** Distance from the nearest viewer, in cm, at which significance reaches zero. */
+	UPROPERTY(Config, EditAnywhere, Category = "Significance")
+	float MaxSignificanceDistance;
+
+	/** Seconds an actor stays fully significant after NotifyActivity. */
+	UPROPERTY(Config, EditAnywhere, Category = "Significance")
+	float ActivityWindow;
+
+	/** Time spent rescoring actors per frame, in milliseconds. Actors not reached keep their tier until the next frame. */
+	UPROPERTY(Config, EditAnywhere, Category = "Significance")
+	float UpdateBudgetMs;
+
+private:
+	struct FSignificanceEntry
+	{
+		TWeakObjectPtr<AActor> Actor;
+		float DefaultTickInterval;
+		float DefaultNetUpdateFrequency;
+		float LastActiveTime;
+
+		/** Index into Tiers, or INDEX_NONE before the first update. */
+		int32 Tier;
+
+		/** Tick functions on the actor that tiers throttle: its own tick if it was ticking when registered, and its skeletal meshes. */
+		int32 NumActorTicks;
+		int32 NumAnimatedMeshes;
+
+		/** True while the actor's tick is off because of its tier. */
+		bool bTickDisabled;
+	};
+
+	/** Rescores Entry and applies its new tier if it changed. */
+	void UpdateEntry(FSignificanceEntry& Entry, AActor* Actor, float Now);
+
+	/** Returns the significance of Entry's actor at Location. Only reads Entry and ViewLocations, so it is safe on worker threads. */
+	float ScoreEntry(const FSignificanceEntry& Entry, const FVector& Location, float Now) const;
+
+	/** Removes entries whose actor is gone. */
+	void RemoveStaleEntries();
+
+	/** Removes the entry at Index by swapping in the last one, keeping EntryIndices in step. */
+	void RemoveEntry(int32 Index);
+
+	/** Applies the tick, animation and net update settings of NewTier to Actor. INDEX_NONE restores the actor's own settings. */
+	void ApplyTier(FSignificanceEntry& Entry, AActor* Actor, int32 NewTier);
+
+	/** Sets Actor's net update frequency, including the replication graph's copy of it. */
+	void SetNetUpdateFrequency(AActor* Actor, float NetUpdateFrequency) const;
+
+	/** Returns the tier Significance falls in. */
+	int32 FindTier(float Significance) const;
+
+	/** Adds Sign times Entry's tick functions to the per-tier counts used for the ticks saved estimate. */
+	void CountTickFunctions(const FSignificanceEntry& Entry, int32 Sign);
+
+	/** Estimates how many tick functions did not run this frame because of their tier. */
+	float EstimateTicksSaved(float DeltaSeconds) const;
+
+	TArray<FSignificanceEntry> Entries;
+
+	/** Index into Entries of each registered actor, so registering and activity do not search the array. */
+	TMap<TWeakObjectPtr<AActor>, int32> EntryIndices;
+
+	/** View point of every player, gathered once per frame. */
+	TArray<FVector> ViewLocations;
+
+	/** Location and new tier of every entry while UpdateAllActors runs. Reused every frame. */
+	TArray<FVector> EntryLocations;
+	TArray<int32> EntryTiers;
+
+	/** Actor and animation tick functions currently in each tier. */
+	TArray<int32> TierActorTicks;
+	TArray<int32> TierAnimationTicks;
+
+	/** Entry the next rescoring pass starts at. */
+	int32 NextEntry;
+};
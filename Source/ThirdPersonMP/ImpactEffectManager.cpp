@@ -0,0 +1,223 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "ImpactEffectManager.h"
+#include "ThirdPersonMP.h"
+#include "EmbedGameStateBase.h"
+#include "CosmeticAssetLoader.h"
+#include "FrameBudgetScheduler.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Engine/Engine.h"
+#include "Engine/GameViewportClient.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Kismet/GameplayStatics.h"
+#include "Particles/ParticleSystem.h"
+#include "Particles/ParticleSystemComponent.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Impact Effects Played"), STAT_ThirdPersonMP_ImpactEffectsPlayed, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Impact Effects Culled (Distance)"), STAT_ThirdPersonMP_ImpactEffectsCulledDistance, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Impact Effects Culled (Frustum)"), STAT_ThirdPersonMP_ImpactEffectsCulledFrustum, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Impact Effects Dropped"), STAT_ThirdPersonMP_ImpactEffectsDropped, STATGROUP_ThirdPersonMP);
+
+AImpactEffectManager::AImpactEffectManager()
+{
+	PrimaryActorTick.bCanEverTick = false;
+	bReplicates = false;
+
+	PrewarmEffect = TSoftObjectPtr<UParticleSystem>(FSoftObjectPath(TEXT("/Game/StarterContent/Particles/P_Explosion.P_Explosion")));
+
+	PrewarmCount = 16;
+	MaxPoolSize = 64;
+	MaxNewEffectsPerFrame = 8;
+	MaxViewDistance = 10000.0f;
+	CullRadius = 300.0f;
+
+	ViewFrame = 0;
+	NewEffectsThisFrame = 0;
+	bHasView = false;
+	ViewLocation = FVector::ZeroVector;
+	ViewDirection = FVector::ForwardVector;
+	ViewConeHalfAngle = PI;
+}
+
+void AImpactEffectManager::PlayImpactEffect(const UObject* WorldContextObject, UParticleSystem* Effect, const FVector& Location)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	if (World == nullptr || Effect == nullptr || World->GetNetMode() == NM_DedicatedServer)
+	{
+		return;
+	}
+
+	AEmbedGameStateBase* GameState = World->GetGameState<AEmbedGameStateBase>();
+	if (AImpactEffectManager* Manager = GameState ? GameState->GetImpactEffectManager() : nullptr)
+	{
+		//A listen server renders too, so the effects of a burst of impacts wait for spare frame time there. Clients play them immediately.
+		TWeakObjectPtr<AImpactEffectManager> WeakManager = Manager;
+		TWeakObjectPtr<UParticleSystem> WeakEffect = Effect;
+		AFrameBudgetScheduler::Defer(Manager, EDeferredWorkPriority::High, [WeakManager, WeakEffect, Location]()
+		{
+			AImpactEffectManager* DeferredManager = WeakManager.Get();
+			UParticleSystem* DeferredEffect = WeakEffect.Get();
+			if (DeferredManager && DeferredEffect)
+			{
+				DeferredManager->PlayEffect(DeferredEffect, Location);
+			}
+		});
+		return;
+	}
+
+	//The game state has not replicated yet.
+	UGameplayStatics::SpawnEmitterAtLocation(World, Effect, Location, FRotator::ZeroRotator, true, EPSCPoolMethod::AutoRelease);
+}
+
+void AImpactEffectManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	FreeComponents.Reserve(MaxPoolSize);
+	PooledComponents.Reserve(MaxPoolSize);
+
+	UCosmeticAssetLoader::Request(PrewarmEffect.ToSoftObjectPath(), FStreamableDelegate::CreateUObject(this, &AImpactEffectManager::OnPrewarmEffectLoaded));
+}
+
+void AImpactEffectManager::OnPrewarmEffectLoaded()
+{
+	UParticleSystem* Effect = PrewarmEffect.Get();
+	if (Effect == nullptr)
+	{
+		return;
+	}
+
+	const int32 NumToCreate = FMath::Min(PrewarmCount, MaxPoolSize) - PooledComponents.Num();
+	for (int32 Index = 0; Index < NumToCreate; ++Index)
+	{
+		if (UParticleSystemComponent* Component = CreatePooledComponent(Effect))
+		{
+			FreeComponents.Add(Component);
+		}
+	}
+}
+
+bool AImpactEffectManager::PlayEffect(UParticleSystem* Effect, const FVector& Location)
+{
+	if (Effect == nullptr)
+	{
+		return false;
+	}
+
+	if (ViewFrame != GFrameCounter)
+	{
+		ViewFrame = GFrameCounter;
+		NewEffectsThisFrame = 0;
+		bHasView = UpdateView();
+	}
+
+	if (NewEffectsThisFrame >= MaxNewEffectsPerFrame)
+	{
+		INC_DWORD_STAT(STAT_ThirdPersonMP_ImpactEffectsDropped);
+		return false;
+	}
+
+	if (bHasView)
+	{
+		if (MaxViewDistance > 0.0f && FVector::DistSquared(ViewLocation, Location) > FMath::Square(MaxViewDistance))
+		{
+			INC_DWORD_STAT(STAT_ThirdPersonMP_ImpactEffectsCulledDistance);
+			return false;
+		}
+
+		if (CullRadius >= 0.0f && !IsInView(Location))
+		{
+			INC_DWORD_STAT(STAT_ThirdPersonMP_ImpactEffectsCulledFrustum);
+			return false;
+		}
+	}
+
+	UParticleSystemComponent* Component = FreeComponents.Num() > 0 ? FreeComponents.Pop(false) : CreatePooledComponent(Effect);
+	if (Component == nullptr)
+	{
+		INC_DWORD_STAT(STAT_ThirdPersonMP_ImpactEffectsDropped);
+		return false;
+	}
+
+	if (Component->Template != Effect)
+	{
+		Component->SetTemplate(Effect);
+	}
+
+	Component->SetWorldLocationAndRotation(Location, FRotator::ZeroRotator);
+	Component->ActivateSystem(true);
+
+	++NewEffectsThisFrame;
+	INC_DWORD_STAT(STAT_ThirdPersonMP_ImpactEffectsPlayed);
+	return true;
+}
+
+UParticleSystemComponent* AImpactEffectManager::CreatePooledComponent(UParticleSystem* Effect)
+{
+	if (PooledComponents.Num() >= MaxPoolSize)
+	{
+		return nullptr;
+	}
+
+	UParticleSystemComponent* Component = NewObject<UParticleSystemComponent>(this);
+	Component->bAutoActivate = false;
+	Component->bAutoDestroy = false;
+	Component->SetTemplate(Effect);
+	Component->OnSystemFinished.AddDynamic(this, &AImpactEffectManager::OnEffectFinished);
+	Component->RegisterComponent();
+
+	PooledComponents.Add(Component);
+	return Component;
+}
+
+void AImpactEffectManager::OnEffectFinished(UParticleSystemComponent* Component)
+{
+	FreeComponents.AddUnique(Component);
+}
+
+bool AImpactEffectManager::UpdateView()
+{
+	APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	if (PlayerController == nullptr || !PlayerController->IsLocalController())
+	{
+		return false;
+	}
+
+	FRotator ViewRotation;
+	PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+	ViewDirection = ViewRotation.Vector();
+
+	//Widen the horizontal field of view to the frustum's corners, so the cone contains the whole frustum.
+	const float FOVAngle = PlayerController->PlayerCameraManager ? PlayerController->PlayerCameraManager->GetFOVAngle() : 90.0f;
+	float AspectRatio = 16.0f / 9.0f;
+	if (GEngine && GEngine->GameViewport)
+	{
+		FVector2D ViewportSize;
+		GEngine->GameViewport->GetViewportSize(ViewportSize);
+		if (ViewportSize.Y > 0.0f)
+		{
+			AspectRatio = ViewportSize.X / ViewportSize.Y;
+		}
+	}
+
+	const float TanHalfHorizontal = FMath::Tan(FMath::DegreesToRadians(FMath::Clamp(FOVAngle, 1.0f, 170.0f) * 0.5f));
+	const float TanHalfVertical = TanHalfHorizontal / AspectRatio;
+	ViewConeHalfAngle = FMath::Atan(FMath::Sqrt(FMath::Square(TanHalfHorizontal) + FMath::Square(TanHalfVertical)));
+	return true;
+}
+
+bool AImpactEffectManager::IsInView(const FVector& Location) const
+{
+	const FVector ToEffect = Location - ViewLocation;
+	const float Distance = ToEffect.Size();
+	if (Distance <= CullRadius)
+	{
+		return true;
+	}
+
+	const float Angle = FMath::Acos(FMath::Clamp(FVector::DotProduct(ViewDirection, ToEffect / Distance), -1.0f, 1.0f));
+	const float AngularRadius = FMath::Asin(CullRadius / Distance);
+	return Angle - AngularRadius <= ViewConeHalfAngle;
+}
@@ -0,0 +1,96 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "ImpactEffectManager.generated.h"
+
+class UParticleSystem;
+class UParticleSystemComponent;
+
+/**
+ * Client-side impact effects. Hands out particle components from a pool pre-warmed at BeginPlay, skips effects that are
+ * too far away or outside the view, and starts at most MaxNewEffectsPerFrame effects per frame, so a burst of impacts
+ * in one frame does not hitch. Owned and spawned by AEmbedGameStateBase on every machine except dedicated servers.
+ */
+UCLASS(config=Game, notplaceable)
+class THIRDPERSONMP_API AImpactEffectManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AImpactEffectManager();
+
+	/**
+	 * Plays Effect at Location through the world's impact effect manager. Does nothing on a dedicated server, and falls
+	 * back to spawning the emitter directly if the manager does not exist yet.
+	 */
+	static void PlayImpactEffect(const UObject* WorldContextObject, UParticleSystem* Effect, const FVector& Location);
+
+	/** Plays Effect at Location unless it is culled or this frame's cap has been reached. Returns true if it was played. */
+	bool PlayEffect(UParticleSystem* Effect, const FVector& Location);
+
+	/** Effect the pool's components are set up with once it has loaded. */
+	UPROPERTY(EditAnywhere, Category = "Effects")
+	TSoftObjectPtr<UParticleSystem> PrewarmEffect;
+
+	/** Number of particle components created at BeginPlay. */
+	UPROPERTY(Config, EditAnywhere, Category = "Effects")
+	int32 PrewarmCount;
+
+	/** Upper bound on the number of particle components owned by the pool. Effects past it are dropped. */
+	UPROPERTY(Config, EditAnywhere, Category = "Effects")
+	int32 MaxPoolSize;
+
+	/** Most effects started in a single frame. */
+	UPROPERTY(Config, EditAnywhere, Category = "Effects")
+	int32 MaxNewEffectsPerFrame;
+
+	/** Effects further than this from the view, in cm, are skipped. Zero disables distance culling. */
+	UPROPERTY(Config, EditAnywhere, Category = "Effects")
+	float MaxViewDistance;
+
+	/** Effects whose bounds, approximated by a sphere of this radius, are entirely outside the view frustum are skipped. Negative disables frustum culling. */
+	UPROPERTY(Config, EditAnywhere, Category = "Effects")
+	float CullRadius;
+
+protected:
+	virtual void BeginPlay() override;
+
+	/** Creates the pre-warmed components once PrewarmEffect has loaded. */
+	void OnPrewarmEffectLoaded();
+
+	/** Creates a new pooled particle component. Returns nullptr when the pool is full. */
+	UParticleSystemComponent* CreatePooledComponent(UParticleSystem* Effect);
+
+	/** Returns a finished component to the free list. */
+	UFUNCTION()
+	void OnEffectFinished(UParticleSystemComponent* Component);
+
+	/** Components ready to be handed out. */
+	UPROPERTY(Transient)
+	TArray<UParticleSystemComponent*> FreeComponents;
+
+	/** Every component owned by the pool, playing or free. */
+	UPROPERTY(Transient)
+	TArray<UParticleSystemComponent*> PooledComponents;
+
+private:
+	/** Refreshes the cached view for the current frame. Returns false if there is no local view to cull against. */
+	bool UpdateView();
+
+	/** Returns true if a sphere of CullRadius at Location may be visible from the cached view. */
+	bool IsInView(const FVector& Location) const;
+
+	/** Frame the cached view and the per-frame count belong to. */
+	uint64 ViewFrame;
+	int32 NewEffectsThisFrame;
+
+	bool bHasView;
+	FVector ViewLocation;
+	FVector ViewDirection;
+
+	/** Half-angle, in radians, of a cone around ViewDirection that encloses the view frustum. */
+	float ViewConeHalfAngle;
+};
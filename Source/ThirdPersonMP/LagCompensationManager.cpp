@@ -0,0 +1,251 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "LagCompensationManager.h"
+#include "ThirdPersonMP.h"
+#include "Async/ParallelFor.h"
+#include "Components/CapsuleComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+void FLagCompensationHistory::Init(int32 Capacity)
+{
+	Samples.SetNumUninitialized(FMath::Max(Capacity, 2));
+	Head = 0;
+	Count = 0;
+}
+
+void FLagCompensationHistory::Record(float Time, const FVector& Location, float HalfHeight)
+{
+	FLagCompensationSample& NewSample = Samples[Head];
+	NewSample.Time = Time;
+	NewSample.HalfHeight = HalfHeight;
+	NewSample.Location = Location;
+
+	Head = (Head + 1) % Samples.Num();
+	Count = FMath::Min(Count + 1, Samples.Num());
+}
+
+bool FLagCompensationHistory::Sample(float Time, FVector& OutLocation, float& OutHalfHeight) const
+{
+	if (Count == 0)
+	{
+		return false;
+	}
+
+	//Binary search for the first sample at or after Time.
+	int32 Low = 0;
+	int32 High = Count;
+	while (Low < High)
+	{
+		const int32 Mid = (Low + High) / 2;
+		if (At(Mid).Time < Time)
+		{
+			Low = Mid + 1;
+		}
+		else
+		{
+			High = Mid;
+		}
+	}
+
+	if (Low == 0 || Low == Count)
+	{
+		const FLagCompensationSample& Clamped = At(Low == 0 ? 0 : Count - 1);
+		OutLocation = Clamped.Location;
+		OutHalfHeight = Clamped.HalfHeight;
+		return true;
+	}
+
+	const FLagCompensationSample& Before = At(Low - 1);
+	const FLagCompensationSample& After = At(Low);
+	const float Span = After.Time - Before.Time;
+	const float Alpha = Span > KINDA_SMALL_NUMBER ? (Time - Before.Time) / Span : 1.0f;
+
+	OutLocation = FMath::Lerp(Before.Location, After.Location, Alpha);
+	OutHalfHeight = FMath::Lerp(Before.HalfHeight, After.HalfHeight, Alpha);
+	return true;
+}
+
+ALagCompensationManager::ALagCompensationManager()
+{
+	//Record after movement has run for the frame, so samples match what is replicated.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	bReplicates = false;
+
+	MaxRewindTime = 0.5f;
+	HistoryCapacity = 64;
+}
+
+void ALagCompensationManager::RegisterCharacter(ACharacter* Character)
+{
+	if (Character == nullptr || IsTracked(Character))
+	{
+		return;
+	}
+
+	FLagCompensationTarget& Target = Targets.AddDefaulted_GetRef();
+	Target.Actor = Character;
+	Target.Radius = Character->GetCapsuleComponent()->GetScaledCapsuleRadius();
+	Target.History.Init(HistoryCapacity);
+}
+
+void ALagCompensationManager::UnregisterCharacter(ACharacter* Character)
+{
+	const int32 Index = Targets.IndexOfByPredicate([Character](const FLagCompensationTarget& Target) { return Target.Actor == Character; });
+	if (Index != INDEX_NONE)
+	{
+		Targets.RemoveAtSwap(Index, 1, false);
+	}
+}
+
+bool ALagCompensationManager::IsTracked(const AActor* Actor) const
+{
+	return Actor && Targets.ContainsByPredicate([Actor](const FLagCompensationTarget& Target) { return Target.Actor == Actor; });
+}
+
+void ALagCompensationManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	CaptureHistory(GThirdPersonMPParallelCharacterWork != 0);
+}
+
+void ALagCompensationManager::CaptureHistory(bool bParallel)
+{
+	//Resolve the characters on the game thread, so workers only read capsule transforms and write their own history.
+	CaptureCapsules.Reset();
+	for (int32 Index = Targets.Num() - 1; Index >= 0; --Index)
+	{
+		if (Cast<ACharacter>(Targets[Index].Actor.Get()) == nullptr)
+		{
+			Targets.RemoveAtSwap(Index, 1, false);
+		}
+	}
+
+	for (const FLagCompensationTarget& Target : Targets)
+	{
+		CaptureCapsules.Add(CastChecked<ACharacter>(Target.Actor.Get())->GetCapsuleComponent());
+	}
+
+	CaptureHistory(Targets, CaptureCapsules, GetWorld()->GetTimeSeconds(), bParallel);
+}
+
+void ALagCompensationManager::CaptureHistory(TArrayView<FLagCompensationTarget> InTargets, TArrayView<const UCapsuleComponent*> Capsules, float Time, bool bParallel)
+{
+	check(InTargets.Num() == Capsules.Num());
+	ParallelFor(InTargets.Num(), [InTargets, Capsules, Time](int32 Index)
+	{
+		const UCapsuleComponent* Capsule = Capsules[Index];
+		InTargets[Index].History.Record(Time, Capsule->GetComponentLocation(), Capsule->GetScaledCapsuleHalfHeight());
+	}, !bParallel);
+}
+
+float ALagCompensationManager::ClampRewindTime(float Time) const
+{
+	const float Now = GetWorld()->GetTimeSeconds();
+	return FMath::Clamp(Time, Now - MaxRewindTime, Now);
+}
+
+bool ALagCompensationManager::RewindSweep(const FVector& Start, const FVector& End, float SweepRadius, float RewindTime, const AActor* IgnoreActor, FLagCompensatedHit& OutHit) const
+{
+	return RewindSweep(Targets, Start, End, SweepRadius, RewindTime, IgnoreActor, OutHit);
+}
+
+bool ALagCompensationManager::RewindSweep(TArrayView<const FLagCompensationTarget> InTargets, const FVector& Start, const FVector& End, float SweepRadius, float RewindTime, const AActor* IgnoreActor, FLagCompensatedHit& OutHit)
+{
+	const float SegmentLength = FVector::Dist(Start, End);
+	bool bHit = false;
+
+	for (const FLagCompensationTarget& Target : InTargets)
+	{
+		FVector Location;
+		float HalfHeight;
+		if ((IgnoreActor && Target.Actor == IgnoreActor) || !Target.History.Sample(RewindTime, Location, HalfHeight))
+		{
+			continue;
+		}
+
+		//A capsule is a segment with a radius, so the sweep hits it when the two segments come within the summed radii.
+		const FVector CapsuleAxis(0.0f, 0.0f, FMath::Max(HalfHeight - Target.Radius, 0.0f));
+		FVector PointOnSweep;
+		FVector PointOnCapsule;
+		FMath::SegmentDistToSegmentSafe(Start, End, Location - CapsuleAxis, Location + CapsuleAxis, PointOnSweep, PointOnCapsule);
+
+		if (FVector::DistSquared(PointOnSweep, PointOnCapsule) > FMath::Square(Target.Radius + SweepRadius))
+		{
+			continue;
+		}
+
+		const float HitTime = SegmentLength > KINDA_SMALL_NUMBER ? FVector::Dist(Start, PointOnSweep) / SegmentLength : 0.0f;
+		if (!bHit || HitTime < OutHit.Time)
+		{
+			OutHit.Actor = Target.Actor.Get();
+			OutHit.Location = PointOnSweep;
+			OutHit.Time = HitTime;
+			bHit = true;
+		}
+	}
+
+	return bHit;
+}
+
+//Times RewindSweep over synthetic targets for a range of history depths, to check that per-impact cost stays flat as history grows.
+static void RunLagCompensationBenchmark(const TArray<FString>& Args)
+{
+	const int32 NumTargets = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 64;
+	const int32 NumQueries = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 10000;
+	const float TickInterval = 1.0f / 60.0f;
+	const int32 Depths[] = { 8, 16, 32, 64, 128, 256, 512 };
+
+	UE_LOG(LogThirdPersonMP, Display, TEXT("Lag compensation benchmark: %d targets, %d queries per depth."), NumTargets, NumQueries);
+	UE_LOG(LogThirdPersonMP, Display, TEXT("Depth, TotalMs, NsPerQuery, Hits"));
+
+	for (const int32 Depth : Depths)
+	{
+		FRandomStream Random(Depth);
+
+		TArray<FLagCompensationTarget> Targets;
+		Targets.SetNum(NumTargets);
+		for (FLagCompensationTarget& Target : Targets)
+		{
+			Target.Radius = 42.0f;
+			Target.History.Init(Depth);
+
+			FVector Location(Random.FRandRange(-5000.0f, 5000.0f), Random.FRandRange(-5000.0f, 5000.0f), 96.0f);
+			const FVector Velocity(Random.FRandRange(-600.0f, 600.0f), Random.FRandRange(-600.0f, 600.0f), 0.0f);
+			for (int32 SampleIndex = 0; SampleIndex < Depth; ++SampleIndex)
+			{
+				Target.History.Record(SampleIndex * TickInterval, Location, 96.0f);
+				Location += Velocity * TickInterval;
+			}
+		}
+
+		const float Newest = (Depth - 1) * TickInterval;
+		int32 NumHits = 0;
+
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Query = 0; Query < NumQueries; ++Query)
+		{
+			const FVector Start(Random.FRandRange(-5000.0f, 5000.0f), Random.FRandRange(-5000.0f, 5000.0f), 96.0f);
+			const FVector End = Start + Random.GetUnitVector() * 25.0f;
+			FLagCompensatedHit Hit;
+			if (ALagCompensationManager::RewindSweep(Targets, Start, End, 37.5f, Random.FRandRange(0.0f, Newest), nullptr, Hit))
+			{
+				++NumHits;
+			}
+		}
+		const double Elapsed = FPlatformTime::Seconds() - StartTime;
+
+		UE_LOG(LogThirdPersonMP, Display, TEXT("%d, %.3f, %.1f, %d"), Depth, Elapsed * 1000.0, Elapsed * 1.0e9 / FMath::Max(NumQueries, 1), NumHits);
+	}
+}
+
+static FAutoConsoleCommand LagCompensationBenchmarkCommand(
+	TEXT("ThirdPersonMP.LagCompensation.Benchmark"),
+	TEXT("Times rewind queries against history depth. Usage: ThirdPersonMP.LagCompensation.Benchmark [NumTargets=64] [NumQueries=10000]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunLagCompensationBenchmark));
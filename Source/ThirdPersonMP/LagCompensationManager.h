@@ -0,0 +1,145 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "LagCompensationManager.generated.h"
+
+class ACharacter;
+class UCapsuleComponent;
+
+/** One recorded capsule position. */
+struct FLagCompensationSample
+{
+	float Time;
+	float HalfHeight;
+	FVector Location;
+};
+
+/** Fixed-capacity ring buffer of capsule positions, oldest to newest. Allocates only in Init. */
+class THIRDPERSONMP_API FLagCompensationHistory
+{
+public:
+	FLagCompensationHistory()
+		: Head(0)
+		, Count(0)
+	{
+	}
+
+	/** Allocates room for Capacity samples and clears the history. */
+	void Init(int32 Capacity);
+
+	/** Appends a sample, overwriting the oldest one once the buffer is full. Times must not decrease. */
+	void Record(float Time, const FVector& Location, float HalfHeight);
+
+	/**
+	 * Returns the capsule at Time, interpolating between the two samples around it.
+	 * Times outside the history are clamped to the oldest or newest sample. Returns false if the history is empty.
+	 */
+	bool Sample(float Time, FVector& OutLocation, float& OutHalfHeight) const;
+
+	FORCEINLINE int32 Num() const { return Count; }
+
+private:
+	/** Returns the I-th sample counting from the oldest. */
+	FORCEINLINE const FLagCompensationSample& At(int32 I) const
+	{
+		const int32 Capacity = Samples.Num();
+		return Samples[(Head - Count + I + Capacity) % Capacity];
+	}
+
+	TArray<FLagCompensationSample> Samples;
+
+	/** Index the next sample is written to. */
+	int32 Head;
+	int32 Count;
+};
+
+/** A character whose past positions are tracked for lag compensation. */
+struct FLagCompensationTarget
+{
+	TWeakObjectPtr<AActor> Actor;
+	float Radius;
+	FLagCompensationHistory History;
+};
+
+/** Result of a rewound query. */
+struct FLagCompensatedHit
+{
+	/** Target that was hit. */
+	AActor* Actor;
+
+	/** Point on the swept segment closest to the rewound capsule. */
+	FVector Location;
+
+	/** Fraction of the way from Start to End at which the hit happened. */
+	float Time;
+
+	FLagCompensatedHit()
+		: Actor(nullptr)
+		, Location(ForceInitToZero)
+		, Time(1.0f)
+	{
+	}
+};
+
+/**
+ * Server-side lag compensation. Records every registered character's capsule each frame into a fixed-size history
+ * and answers queries about where those capsules were at an earlier time, so that shots can be judged against what
+ * the shooter saw rather than against the server's current state. Owned and spawned by AThirdPersonMPGameMode.
+ */
+UCLASS(config=Game, notplaceable)
+class THIRDPERSONMP_API ALagCompensationManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	ALagCompensationManager();
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	/** Starts recording Character's capsule. */
+	void RegisterCharacter(ACharacter* Character);
+
+	/** Stops recording Character's capsule. */
+	void UnregisterCharacter(ACharacter* Character);
+
+	/**
+	 * Records every tracked capsule at the current time. With bParallel, the capsules are read and recorded on worker
+	 * threads; the call returns once all of them are done. Called from Tick.
+	 */
+	void CaptureHistory(bool bParallel);
+
+	/** Implementation of CaptureHistory over an arbitrary set of targets, recording each one's capsule at Time. Exposed for the benchmark. */
+	static void CaptureHistory(TArrayView<FLagCompensationTarget> Targets, TArrayView<const UCapsuleComponent*> Capsules, float Time, bool bParallel);
+
+	/** Clamps a shooter's time to the window the history covers. */
+	float ClampRewindTime(float Time) const;
+
+	/**
+	 * Sweeps a sphere of SweepRadius from Start to End against every tracked capsule as it was at RewindTime,
+	 * ignoring IgnoreActor. Returns the earliest hit along the segment.
+	 */
+	bool RewindSweep(const FVector& Start, const FVector& End, float SweepRadius, float RewindTime, const AActor* IgnoreActor, FLagCompensatedHit& OutHit) const;
+
+	/** Returns true if Actor is tracked. */
+	bool IsTracked(const AActor* Actor) const;
+
+	/** Implementation of RewindSweep over an arbitrary set of targets. Exposed for the benchmark. */
+	static bool RewindSweep(TArrayView<const FLagCompensationTarget> Targets, const FVector& Start, const FVector& End, float SweepRadius, float RewindTime, const AActor* IgnoreActor, FLagCompensatedHit& OutHit);
+
+	/** Seconds of history kept per character. Shots older than this are judged against the oldest sample. */
+	UPROPERTY(Config, EditAnywhere, Category = "LagCompensation")
+	float MaxRewindTime;
+
+	/** Samples kept per character. Should cover MaxRewindTime at the server tick rate. */
+	UPROPERTY(Config, EditAnywhere, Category = "LagCompensation")
+	int32 HistoryCapacity;
+
+private:
+	TArray<FLagCompensationTarget> Targets;
+
+	/** Capsule of each entry in Targets for the capture in progress. Reused every frame. */
+	TArray<const UCapsuleComponent*> CaptureCapsules;
+};
@@ -0,0 +1,87 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "LoadTestBotComponent.h"
+#include "ThirdPersonMPCharacter.h"
+#include "GameFramework/Controller.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+
+ULoadTestBotComponent::ULoadTestBotComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickGroup = TG_PrePhysics;
+
+	Pattern = ELoadTestBotPattern::Random;
+	MinTurnInterval = 1.0f;
+	MaxTurnInterval = 4.0f;
+	CircleTurnRate = 45.0f;
+	bFireContinuously = true;
+
+	Heading = 0.0f;
+	TimeToNextTurn = 0.0f;
+}
+
+bool ULoadTestBotComponent::IsLoadTestBot()
+{
+	return FParse::Param(FCommandLine::Get(), TEXT("LoadTestBot"));
+}
+
+void ULoadTestBotComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	FString PatternName;
+	if (FParse::Value(FCommandLine::Get(), TEXT("LoadTestBot="), PatternName))
+	{
+		Pattern = PatternName.Equals(TEXT("Circle"), ESearchCase::IgnoreCase) ? ELoadTestBotPattern::Circle : ELoadTestBotPattern::Random;
+	}
+
+	int32 Seed = (int32)FPlatformProcess::GetCurrentProcessId();
+	FParse::Value(FCommandLine::Get(), TEXT("BotSeed="), Seed);
+	Random.Initialize(Seed);
+
+	Heading = Random.FRandRange(0.0f, 360.0f);
+}
+
+void ULoadTestBotComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	//The client's character only becomes locally controlled once its controller has replicated.
+	AThirdPersonMPCharacter* Character = Cast<AThirdPersonMPCharacter>(GetOwner());
+	if (Character == nullptr || !Character->IsLocallyControlled() || Character->Controller == nullptr)
+	{
+		return;
+	}
+
+	switch (Pattern)
+	{
+	case ELoadTestBotPattern::Circle:
+		Heading += CircleTurnRate * DeltaTime;
+		break;
+
+	case ELoadTestBotPattern::Random:
+	default:
+		TimeToNextTurn -= DeltaTime;
+		if (TimeToNextTurn <= 0.0f)
+		{
+			Heading = Random.FRandRange(0.0f, 360.0f);
+			TimeToNextTurn = Random.FRandRange(MinTurnInterval, MaxTurnInterval);
+		}
+		break;
+	}
+
+	Heading = FRotator::ClampAxis(Heading);
+
+	//Aim where we run, so shots spread across the map instead of all going one way.
+	const FRotator Aim(0.0f, Heading, 0.0f);
+	Character->Controller->SetControlRotation(Aim);
+	Character->AddMovementInput(Aim.Vector(), 1.0f);
+
+	if (bFireContinuously)
+	{
+		Character->StartFire();
+	}
+}
@@ -0,0 +1,65 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Math/RandomStream.h"
+#include "LoadTestBotComponent.generated.h"
+
+/** How a load-test bot steers. */
+UENUM()
+enum class ELoadTestBotPattern : uint8
+{
+	/** Runs in a random direction, picking a new one every few seconds. */
+	Random,
+
+	/** Runs in a circle at a fixed turn rate. */
+	Circle,
+};
+
+/**
+ * Drives the owning client's AThirdPersonMPCharacter for load tests: runs it around and fires continuously, through the
+ * same input path a player uses. Added by the character on clients started with -LoadTestBot[=Random|Circle], seeded
+ * with -BotSeed=<n>.
+ */
+UCLASS(config=Game)
+class THIRDPERSONMP_API ULoadTestBotComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	ULoadTestBotComponent();
+
+	/** Returns true if this process was started as a load-test bot. */
+	static bool IsLoadTestBot();
+
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/** Steering pattern, overridden by the value of -LoadTestBot=. */
+	UPROPERTY(EditAnywhere, Category = "LoadTest")
+	ELoadTestBotPattern Pattern;
+
+	/** Shortest and longest time, in seconds, a Random bot keeps its heading. */
+	UPROPERTY(Config, EditAnywhere, Category = "LoadTest")
+	float MinTurnInterval;
+
+	UPROPERTY(Config, EditAnywhere, Category = "LoadTest")
+	float MaxTurnInterval;
+
+	/** Turn rate of a Circle bot, in degrees per second. */
+	UPROPERTY(Config, EditAnywhere, Category = "LoadTest")
+	float CircleTurnRate;
+
+	/** If true, the bot holds the trigger down for as long as it runs. */
+	UPROPERTY(Config, EditAnywhere, Category = "LoadTest")
+	bool bFireContinuously;
+
+protected:
+	virtual void BeginPlay() override;
+
+private:
+	FRandomStream Random;
+	float Heading;
+	float TimeToNextTurn;
+};
@@ -0,0 +1,256 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "LoadTestMetricsRecorder.h"
+#include "ThirdPersonMP.h"
+#include "ThirdPersonMPGameMode.h"
+#include "ProjectilePool.h"
+#include "ProjectileSimulationManager.h"
+#include "ThirdPersonMPReplicationGraph.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "Misc/CommandLine.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+
+namespace LoadTestMetrics
+{
+	float Percentile(const TArray<float>& Sorted, float Percentile)
+	{
+		if (Sorted.Num() == 0)
+		{
+			return 0.0f;
+		}
+
+		const int32 Index = FMath::Clamp(FMath::CeilToInt(Percentile * Sorted.Num()) - 1, 0, Sorted.Num() - 1);
+		return Sorted[Index];
+	}
+}
+
+ALoadTestMetricsRecorder::ALoadTestMetricsRecorder()
+{
+	PrimaryActorTick.bCanEverTick = false;
+	bReplicates = false;
+
+	SampleInterval = 1.0f;
+
+	FrameStartTime = 0.0;
+	PostActorTickTime = 0.0;
+	NetTickTime = 0.0;
+	StartTime = 0.0;
+	LastSampleTime = 0.0;
+	Duration = 0.0;
+}
+
+bool ALoadTestMetricsRecorder::GetOutputPath(FString& OutPath)
+{
+	return FParse::Value(FCommandLine::Get(), TEXT("LoadTestMetrics="), OutPath) && !OutPath.IsEmpty();
+}
+
+void ALoadTestMetricsRecorder::BeginPlay()
+{
+	Super::BeginPlay();
+
+	FString Path;
+	if (!GetOutputPath(Path))
+	{
+		return;
+	}
+
+	const FString ConnectionPath = FPaths::Combine(FPaths::GetPath(Path), FPaths::GetBaseFilename(Path) + TEXT("_connections.csv"));
+	SummaryWriter.Reset(IFileManager::Get().CreateFileWriter(*Path));
+	ConnectionWriter.Reset(IFileManager::Get().CreateFileWriter(*ConnectionPath));
+	if (!SummaryWriter || !ConnectionWriter)
+	{
+		UE_LOG(LogThirdPersonMP, Error, TEXT("Load test metrics: could not open %s for writing."), *Path);
+		SummaryWriter.Reset();
+		ConnectionWriter.Reset();
+		return;
+	}
+
+	WriteLine(*SummaryWriter, TEXT("Time,Connections,FrameMsP50,FrameMsP90,FrameMsP99,FrameMsMax,NetTickMsP50,NetTickMsP99,NetTickMsMax,InBytesPerSec,OutBytesPerSec,OutBytesPerSecMaxConnection,ActiveProjectiles,PooledProjectiles,BatchedProjectiles"));
+	WriteLine(*ConnectionWriter, TEXT("Time,Connection,InBytesPerSec,OutBytesPerSec,InPacketsPerSec,OutPacketsPerSec,PingMs,EstimatedBytesPerSec,OwnedBytesPerSec,CharacterBytesPerSec,ProjectileBytesPerSec,OtherBytesPerSec,ThrottledActors"));
+
+	double DurationSeconds = 0.0;
+	if (FParse::Value(FCommandLine::Get(), TEXT("LoadTestDuration="), DurationSeconds))
+	{
+		Duration = DurationSeconds;
+	}
+
+	FrameTimes.Reserve(256);
+	NetTickTimes.Reserve(256);
+
+	//The net driver registered its own tick handlers when the world started listening, before any actor began play,
+	//so ours run right after it has dispatched and flushed.
+	UWorld* World = GetWorld();
+	TickStartHandle = FWorldDelegates::OnWorldTickStart.AddUObject(this, &ALoadTestMetricsRecorder::OnWorldTickStart);
+	TickDispatchHandle = World->TickDispatchEvent.AddUObject(this, &ALoadTestMetricsRecorder::OnTickDispatch);
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &ALoadTestMetricsRecorder::OnWorldPostActorTick);
+	TickFlushHandle = World->TickFlushEvent.AddUObject(this, &ALoadTestMetricsRecorder::OnTickFlush);
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &ALoadTestMetricsRecorder::OnEndFrame);
+
+	StartTime = FPlatformTime::Seconds();
+	LastSampleTime = StartTime;
+
+	UE_LOG(LogThirdPersonMP, Log, TEXT("Load test metrics: writing to %s."), *Path);
+}
+
+void ALoadTestMetricsRecorder::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (SummaryWriter)
+	{
+		FWorldDelegates::OnWorldTickStart.Remove(TickStartHandle);
+		GetWorld()->TickDispatchEvent.Remove(TickDispatchHandle);
+		FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+		GetWorld()->TickFlushEvent.Remove(TickFlushHandle);
+		FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+
+		WriteSample(FPlatformTime::Seconds());
+		SummaryWriter->Close();
+		ConnectionWriter->Close();
+		SummaryWriter.Reset();
+		ConnectionWriter.Reset();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ALoadTestMetricsRecorder::OnWorldTickStart(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds)
+{
+	if (InWorld == GetWorld())
+	{
+		FrameStartTime = FPlatformTime::Seconds();
+		PostActorTickTime = 0.0;
+		NetTickTime = 0.0;
+	}
+}
+
+void ALoadTestMetricsRecorder::OnTickDispatch(float DeltaSeconds)
+{
+	if (FrameStartTime > 0.0)
+	{
+		NetTickTime += FPlatformTime::Seconds() - FrameStartTime;
+	}
+}
+
+void ALoadTestMetricsRecorder::OnWorldPostActorTick(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds)
+{
+	if (InWorld == GetWorld())
+	{
+		PostActorTickTime = FPlatformTime::Seconds();
+	}
+}
+
+void ALoadTestMetricsRecorder::OnTickFlush(float DeltaSeconds)
+{
+	if (PostActorTickTime > 0.0)
+	{
+		NetTickTime += FPlatformTime::Seconds() - PostActorTickTime;
+	}
+}
+
+void ALoadTestMetricsRecorder::OnEndFrame()
+{
+	const double Now = FPlatformTime::Seconds();
+	if (FrameStartTime > 0.0)
+	{
+		FrameTimes.Add((Now - FrameStartTime) * 1000.0);
+		NetTickTimes.Add(NetTickTime * 1000.0);
+		FrameStartTime = 0.0;
+	}
+
+	if (Now - LastSampleTime >= SampleInterval)
+	{
+		WriteSample(Now);
+	}
+
+	if (Duration > 0.0 && Now - StartTime >= Duration)
+	{
+		UE_LOG(LogThirdPersonMP, Log, TEXT("Load test metrics: %.0f seconds recorded, exiting."), Duration);
+		Duration = 0.0;
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+void ALoadTestMetricsRecorder::WriteSample(double Now)
+{
+	LastSampleTime = Now;
+	const float Time = Now - StartTime;
+
+	FrameTimes.Sort();
+	NetTickTimes.Sort();
+
+	int32 NumConnections = 0;
+	int32 InBytesPerSecond = 0;
+	int32 OutBytesPerSecond = 0;
+	int32 MaxOutBytesPerSecond = 0;
+
+	if (UNetDriver* NetDriver = GetWorld()->GetNetDriver())
+	{
+		const UThirdPersonMPReplicationGraph* ReplicationGraph = Cast<UThirdPersonMPReplicationGraph>(NetDriver->GetReplicationDriver());
+		for (UNetConnection* Connection : NetDriver->ClientConnections)
+		{
+			if (Connection == nullptr)
+			{
+				continue;
+			}
+
+			++NumConnections;
+			InBytesPerSecond += Connection->InBytesPerSecond;
+			OutBytesPerSecond += Connection->OutBytesPerSecond;
+			MaxOutBytesPerSecond = FMath::Max(MaxOutBytesPerSecond, Connection->OutBytesPerSecond);
+
+			//Zeros when the connection is not paced by the replication graph's prioritizer
+			const FThirdPersonMPConnectionBandwidth* Found = ReplicationGraph ? ReplicationGraph->GetConnectionBandwidth(Connection) : nullptr;
+			const FThirdPersonMPConnectionBandwidth Bandwidth = Found ? *Found : FThirdPersonMPConnectionBandwidth();
+
+			WriteLine(*ConnectionWriter, FString::Printf(TEXT("%.2f,%s,%d,%d,%d,%d,%.1f,%.0f,%.0f,%.0f,%.0f,%.0f,%d"),
+				Time, *Connection->LowLevelGetRemoteAddress(true), Connection->InBytesPerSecond, Connection->OutBytesPerSecond,
+				Connection->InPacketsPerSecond, Connection->OutPacketsPerSecond, Connection->AvgLag * 1000.0f,
+				Bandwidth.EstimatedBytesPerSecond,
+				Bandwidth.CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Owned],
+				Bandwidth.CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Character],
+				Bandwidth.CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Projectile],
+				Bandwidth.CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Other],
+				Bandwidth.NumThrottledActors));
+		}
+	}
+
+	int32 ActiveProjectiles = 0;
+	int32 PooledProjectiles = 0;
+	int32 BatchedProjectiles = 0;
+	if (AThirdPersonMPGameMode* GameMode = GetWorld()->GetAuthGameMode<AThirdPersonMPGameMode>())
+	{
+		if (AProjectilePool* ProjectilePool = GameMode->GetProjectilePool())
+		{
+			ActiveProjectiles = ProjectilePool->GetNumActive();
+			PooledProjectiles = ProjectilePool->GetNumPooled();
+		}
+		if (AProjectileSimulationManager* ProjectileSimulationManager = GameMode->GetProjectileSimulationManager())
+		{
+			BatchedProjectiles = ProjectileSimulationManager->GetNumLive();
+		}
+	}
+
+	WriteLine(*SummaryWriter, FString::Printf(TEXT("%.2f,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%d,%d,%d,%d,%d,%d"),
+		Time, NumConnections,
+		LoadTestMetrics::Percentile(FrameTimes, 0.5f), LoadTestMetrics::Percentile(FrameTimes, 0.9f), LoadTestMetrics::Percentile(FrameTimes, 0.99f), LoadTestMetrics::Percentile(FrameTimes, 1.0f),
+		LoadTestMetrics::Percentile(NetTickTimes, 0.5f), LoadTestMetrics::Percentile(NetTickTimes, 0.99f), LoadTestMetrics::Percentile(NetTickTimes, 1.0f),
+		InBytesPerSecond, OutBytesPerSecond, MaxOutBytesPerSecond,
+		ActiveProjectiles, PooledProjectiles, BatchedProjectiles));
+
+	SummaryWriter->Flush();
+	ConnectionWriter->Flush();
+
+	FrameTimes.Reset();
+	NetTickTimes.Reset();
+}
+
+void ALoadTestMetricsRecorder::WriteLine(FArchive& Writer, const FString& Line)
+{
+	FTCHARToUTF8 Utf8(*(Line + LINE_TERMINATOR));
+	Writer.Serialize((void*)Utf8.Get(), Utf8.Length());
+}
@@ -0,0 +1,78 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "LoadTestMetricsRecorder.generated.h"
+
+namespace LoadTestMetrics
+{
+	/** Returns the Percentile (0-1) of Sorted, which must be in ascending order. */
+	THIRDPERSONMP_API float Percentile(const TArray<float>& Sorted, float Percentile);
+}
+
+/**
+ * Server-side load-test metrics. Once per SampleInterval, appends a row to <path> with frame time percentiles, net tick
+ * time percentiles, bandwidth totals and projectile counts, and a row per client connection to <path>_connections.csv.
+ * Spawned by AThirdPersonMPGameMode on servers started with -LoadTestMetrics=<path>. Stops the server after
+ * -LoadTestDuration=<seconds> if given.
+ *
+ * Frame time runs from the start of the world tick to the end of the engine frame, so it excludes the idle wait for
+ * the server's tick rate. Net tick time is the net driver's receive (from the start of the world tick to the end of
+ * TickDispatch) plus its send (from the end of actor ticking to the end of TickFlush).
+ */
+UCLASS(config=Game, notplaceable)
+class THIRDPERSONMP_API ALoadTestMetricsRecorder : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	ALoadTestMetricsRecorder();
+
+	/** Returns true and the CSV path if this server was started with -LoadTestMetrics=<path>. */
+	static bool GetOutputPath(FString& OutPath);
+
+	/** Seconds covered by each row. */
+	UPROPERTY(Config, EditAnywhere, Category = "LoadTest")
+	float SampleInterval;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	void OnWorldTickStart(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds);
+	void OnTickDispatch(float DeltaSeconds);
+	void OnWorldPostActorTick(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds);
+	void OnTickFlush(float DeltaSeconds);
+	void OnEndFrame();
+
+	/** Writes the rows for the samples gathered since the last call and clears them. */
+	void WriteSample(double Now);
+
+	/** Writes one line of text to Writer. */
+	static void WriteLine(FArchive& Writer, const FString& Line);
+
+	TUniquePtr<FArchive> SummaryWriter;
+	TUniquePtr<FArchive> ConnectionWriter;
+
+	/** Per-frame times, in milliseconds, since the last row. */
+	TArray<float> FrameTimes;
+	TArray<float> NetTickTimes;
+
+	/** Platform times, in seconds, marking the phases of the current frame. Zero when a phase has not started. */
+	double FrameStartTime;
+	double PostActorTickTime;
+	double NetTickTime;
+
+	double StartTime;
+	double LastSampleTime;
+	double Duration;
+
+	FDelegateHandle TickStartHandle;
+	FDelegateHandle TickDispatchHandle;
+	FDelegateHandle PostActorTickHandle;
+	FDelegateHandle TickFlushHandle;
+	FDelegateHandle EndFrameHandle;
+};
@@ -0,0 +1,122 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "MatchReplay.h"
+#include "ThirdPersonMP.h"
+#include "Engine/DemoNetDriver.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CommandLine.h"
+
+UMatchReplay::UMatchReplay()
+{
+	bRecordReplays = false;
+	CheckpointInterval = 10.0f;
+	RecordHz = 10.0f;
+	ReplayStreamer = TEXT("LocalFileNetworkReplayStreaming");
+}
+
+bool UMatchReplay::GetReplayName(FString& OutName)
+{
+	if (!FParse::Value(FCommandLine::Get(), TEXT("RecordReplay="), OutName) && !FParse::Param(FCommandLine::Get(), TEXT("RecordReplay")) && !GetDefault<UMatchReplay>()->bRecordReplays)
+	{
+		return false;
+	}
+
+	if (OutName.IsEmpty())
+	{
+		OutName = FString::Printf(TEXT("ThirdPersonMP-%s"), *FDateTime::Now().ToString());
+	}
+	return true;
+}
+
+void UMatchReplay::StartRecording(UWorld* World)
+{
+	UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+	FString ReplayName;
+	if (GameInstance == nullptr || World->GetNetMode() == NM_Client || !GetReplayName(ReplayName))
+	{
+		return;
+	}
+
+	//The demo driver reads these every frame it records. Set by game setting, so a value given on the command line or console still wins.
+	const UMatchReplay* Settings = GetDefault<UMatchReplay>();
+	if (IConsoleVariable* CheckpointDelay = IConsoleManager::Get().FindConsoleVariable(TEXT("demo.CheckpointUploadDelayInSeconds")))
+	{
+		CheckpointDelay->Set(Settings->CheckpointInterval, ECVF_SetByGameSetting);
+	}
+	if (IConsoleVariable* RecordRate = IConsoleManager::Get().FindConsoleVariable(TEXT("demo.RecordHz")))
+	{
+		RecordRate->Set(Settings->RecordHz, ECVF_SetByGameSetting);
+	}
+
+	TArray<FString> Options;
+	if (!Settings->ReplayStreamer.IsEmpty())
+	{
+		Options.Add(FString::Printf(TEXT("ReplayStreamerOverride=%s"), *Settings->ReplayStreamer));
+	}
+
+	UE_LOG(LogThirdPersonMP, Log, TEXT("Recording replay %s with %s, checkpoint every %.1f s."), *ReplayName, *Settings->ReplayStreamer, Settings->CheckpointInterval);
+	GameInstance->StartRecordingReplay(ReplayName, ReplayName, Options);
+}
+
+void UMatchReplay::StopRecording(UWorld* World)
+{
+	UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+	if (GameInstance && World->DemoNetDriver && World->DemoNetDriver->IsRecording())
+	{
+		GameInstance->StopRecordingReplay();
+	}
+}
+
+void UMatchReplay::OnReplayStarted(UWorld* World)
+{
+	UDemoNetDriver* DemoNetDriver = World ? World->DemoNetDriver : nullptr;
+	if (DemoNetDriver == nullptr || !DemoNetDriver->IsPlaying())
+	{
+		return;
+	}
+
+	UE_LOG(LogThirdPersonMP, Log, TEXT("Playing replay, %.1f s long."), DemoNetDriver->GetDemoTotalTime());
+
+	//Lets a script play a replay through a headless build and collect its profile once the match is over.
+	if (FParse::Param(FCommandLine::Get(), TEXT("ReplayExitOnEnd")))
+	{
+		DemoNetDriver->OnDemoFinishPlaybackDelegate.AddLambda([]()
+		{
+			UE_LOG(LogThirdPersonMP, Log, TEXT("Replay finished, exiting."));
+#if CSV_PROFILER
+			//End the capture here so the profile covers the playback and nothing of the shutdown.
+			if (FCsvProfiler::Get()->IsCapturing())
+			{
+				FCsvProfiler::Get()->EndCapture();
+			}
+#endif
+			FPlatformMisc::RequestExit(false);
+		});
+	}
+}
+
+//Seeks the replay playing in World and logs how long it took, which is bounded by the checkpoint interval it was recorded with.
+static void SeekReplay(const TArray<FString>& Args, UWorld* World)
+{
+	UDemoNetDriver* DemoNetDriver = World ? World->DemoNetDriver : nullptr;
+	if (DemoNetDriver == nullptr || !DemoNetDriver->IsPlaying() || Args.Num() < 1)
+	{
+		UE_LOG(LogThirdPersonMP, Warning, TEXT("ThirdPersonMP.Replay.Seek needs a replay playing and a time in seconds."));
+		return;
+	}
+
+	const float TargetTime = FCString::Atof(*Args[0]);
+	const double StartTime = FPlatformTime::Seconds();
+	DemoNetDriver->GotoTimeInSeconds(TargetTime, FOnGotoTimeDelegate::CreateLambda([TargetTime, StartTime](bool bWasSuccessful)
+	{
+		UE_LOG(LogThirdPersonMP, Display, TEXT("Replay seek to %.1f s %s after %.0f ms."), TargetTime, bWasSuccessful ? TEXT("finished") : TEXT("failed"), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	}));
+}
+
+static FAutoConsoleCommandWithWorldAndArgs SeekReplayCommand(
+	TEXT("ThirdPersonMP.Replay.Seek"),
+	TEXT("Seeks the playing replay and logs how long the seek took. Usage: ThirdPersonMP.Replay.Seek <Seconds>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&SeekReplay));
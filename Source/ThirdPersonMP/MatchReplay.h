@@ -0,0 +1,59 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "MatchReplay.generated.h"
+
+class UWorld;
+
+/**
+ * Records matches as network replays, to investigate desyncs and performance incidents after the fact. The server
+ * records through a DemoNetDriver into the local file streamer, which writes on a background thread, so the game
+ * thread never waits on the disk. Everything that reaches clients through replication is in the replay: character
+ * movement, pooled and batched projectile launches and impacts, CurrentHealth and the crowd. Checkpoints every
+ * CheckpointInterval seconds bound how much a seek has to fast-forward.
+ *
+ * Recording is on when bRecordReplays is set or the server is started with -RecordReplay[=<Name>]. Replays are written
+ * to Saved/Demos/<Name>.replay, and play back with the demoplay <Name> console command, including on a headless client
+ * (-nullrhi); -ReplayExitOnEnd quits once playback reaches the end, so a recorded match can be re-run through an
+ * instrumented build from a script.
+ */
+UCLASS(config=Game)
+class THIRDPERSONMP_API UMatchReplay : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UMatchReplay();
+
+	/** Starts recording World's match if recording is enabled. Server only. */
+	static void StartRecording(UWorld* World);
+
+	/** Stops recording World's match, finishing the file. Does nothing when it is not recording. */
+	static void StopRecording(UWorld* World);
+
+	/** Called whenever a replay starts playing on this machine. */
+	static void OnReplayStarted(UWorld* World);
+
+	/** Records every match, even without -RecordReplay. */
+	UPROPERTY(Config)
+	bool bRecordReplays;
+
+	/** Seconds between checkpoints. A seek replays at most this much from the checkpoint before it. */
+	UPROPERTY(Config)
+	float CheckpointInterval;
+
+	/** Times per second actors are recorded. Lower than a client's update rate; playback interpolates in between. */
+	UPROPERTY(Config)
+	float RecordHz;
+
+	/** Replay streamer the recording is written with. */
+	UPROPERTY(Config)
+	FString ReplayStreamer;
+
+private:
+	/** Returns the name to record under: the -RecordReplay= value, or one made from the date when that is empty. */
+	static bool GetReplayName(FString& OutName);
+};
@@ -0,0 +1,393 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "MatchTelemetryRecorder.h"
+#include "ThirdPersonMP.h"
+#include "ThirdPersonMPCharacter.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerState.h"
+#include "EngineUtils.h"
+#include "HAL/Event.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformTLS.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "Misc/ScopeLock.h"
+#include "Templates/Atomic.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Telemetry Events Dropped"), STAT_ThirdPersonMP_TelemetryEventsDropped, STATGROUP_ThirdPersonMP);
+
+namespace MatchTelemetry
+{
+	//File layout, all little-endian. The file starts with a FFileHeader, followed by chunks. Each chunk is a FChunkHeader
+	//followed by its columns in the order below, each NumRows values long and padded with zeros to a multiple of 8 bytes:
+	//Time float32, Type uint8, ActorId uint32, OtherId uint32, X float32, Y float32, Z float32, Value float32.
+	static const uint32 FileMagic = 0x544D5054; // "TPMT"
+	static const uint32 ChunkMagic = 0x434D5054; // "TPMC"
+	static const uint32 Version = 1;
+	static const uint32 NumColumns = 8;
+
+	struct FFileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 ChunkHeaderSize;
+		uint32 NumColumns;
+	};
+
+	struct FChunkHeader
+	{
+		uint32 Magic;
+		uint32 NumRows;
+		uint32 Reserved[2];
+	};
+
+	static_assert(sizeof(FFileHeader) % 8 == 0 && sizeof(FChunkHeader) % 8 == 0, "Headers must keep the columns 8-byte aligned.");
+}
+
+/** Per-thread rings emptied into chunked columns by a background thread. */
+class FMatchTelemetryWriter : public FRunnable
+{
+public:
+	FMatchTelemetryWriter(FArchive* InFile, int32 InRingCapacity, int32 InChunkRows, float InFlushIntervalMs)
+		: File(InFile)
+		, RingCapacity(FMath::RoundUpToPowerOfTwo(FMath::Max(InRingCapacity, 64)))
+		, ChunkRows(FMath::Max(InChunkRows, 1))
+		, FlushIntervalMs(FMath::Max(FMath::RoundToInt(InFlushIntervalMs), 1))
+		, bStopping(false)
+	{
+		TlsSlot = FPlatformTLS::AllocTlsSlot();
+
+		Times.Reserve(ChunkRows);
+		Types.Reserve(ChunkRows);
+		ActorIds.Reserve(ChunkRows);
+		OtherIds.Reserve(ChunkRows);
+		Xs.Reserve(ChunkRows);
+		Ys.Reserve(ChunkRows);
+		Zs.Reserve(ChunkRows);
+		Values.Reserve(ChunkRows);
+
+		MatchTelemetry::FFileHeader Header = { MatchTelemetry::FileMagic, MatchTelemetry::Version, sizeof(MatchTelemetry::FChunkHeader), MatchTelemetry::NumColumns };
+		File->Serialize(&Header, sizeof(Header));
+
+		WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+		Thread = FRunnableThread::Create(this, TEXT("MatchTelemetryWriter"), 0, TPri_BelowNormal);
+	}
+
+	virtual ~FMatchTelemetryWriter()
+	{
+		//Recording threads have stopped by now, so the final drain sees every event
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+
+		File->Close();
+		delete File;
+
+		for (FRing* Ring : Rings)
+		{
+			delete Ring;
+		}
+		FPlatformTLS::FreeTlsSlot(TlsSlot);
+	}
+
+	/** Copies Event into the calling thread's ring. Drops it if the ring is full. */
+	void Record(const FMatchTelemetryEvent& Event)
+	{
+		FRing* Ring = (FRing*)FPlatformTLS::GetTlsValue(TlsSlot);
+		if (Ring == nullptr)
+		{
+			Ring = new FRing(RingCapacity);
+			FPlatformTLS::SetTlsValue(TlsSlot, Ring);
+
+			FScopeLock Lock(&RingsLock);
+			Rings.Add(Ring);
+		}
+
+		const uint64 Head = Ring->Head.Load(EMemoryOrder::Relaxed);
+		if (Head - Ring->Tail.Load() >= (uint64)RingCapacity)
+		{
+			NumDropped.Increment();
+			return;
+		}
+
+		Ring->Events[Head & (RingCapacity - 1)] = Event;
+		Ring->Head.Store(Head + 1);
+	}
+
+	/** Returns the events dropped since the last call. */
+	int32 TakeNumDropped()
+	{
+		return NumDropped.Set(0);
+	}
+
+	virtual uint32 Run() override
+	{
+		while (!bStopping)
+		{
+			WakeEvent->Wait(FlushIntervalMs);
+			Drain();
+		}
+
+		Drain();
+		WriteChunk();
+		return 0;
+	}
+
+	virtual void Stop() override
+	{
+		bStopping = true;
+		WakeEvent->Trigger();
+	}
+
+private:
+	/** Single producer, single consumer: the recording thread advances Head, the writer thread advances Tail. */
+	struct FRing
+	{
+		explicit FRing(int32 Capacity)
+			: Head(0)
+			, Tail(0)
+		{
+			Events.SetNumUninitialized(Capacity);
+		}
+
+		TArray<FMatchTelemetryEvent> Events;
+		TAtomic<uint64> Head;
+		TAtomic<uint64> Tail;
+	};
+
+	/** Moves every ring's events into the column buffers, writing chunks as they fill. Writer thread only. */
+	void Drain()
+	{
+		TArray<FRing*, TInlineAllocator<16>> RingsToDrain;
+		{
+			FScopeLock Lock(&RingsLock);
+			RingsToDrain = Rings;
+		}
+
+		for (FRing* Ring : RingsToDrain)
+		{
+			const uint64 Tail = Ring->Tail.Load(EMemoryOrder::Relaxed);
+			const uint64 Head = Ring->Head.Load();
+			for (uint64 Index = Tail; Index < Head; ++Index)
+			{
+				const FMatchTelemetryEvent& Event = Ring->Events[Index & (RingCapacity - 1)];
+				Times.Add(Event.Time);
+				Types.Add((uint8)Event.Type);
+				ActorIds.Add(Event.ActorId);
+				OtherIds.Add(Event.OtherId);
+				Xs.Add(Event.Location.X);
+				Ys.Add(Event.Location.Y);
+				Zs.Add(Event.Location.Z);
+				Values.Add(Event.Value);
+
+				if (Times.Num() >= ChunkRows)
+				{
+					WriteChunk();
+				}
+			}
+			Ring->Tail.Store(Head);
+		}
+	}
+
+	/** Writes the buffered rows as one chunk and empties the buffers. */
+	void WriteChunk()
+	{
+		const int32 NumRows = Times.Num();
+		if (NumRows == 0)
+		{
+			return;
+		}
+
+		MatchTelemetry::FChunkHeader Header = { MatchTelemetry::ChunkMagic, (uint32)NumRows, { 0, 0 } };
+		File->Serialize(&Header, sizeof(Header));
+
+		WriteColumn(Times);
+		WriteColumn(Types);
+		WriteColumn(ActorIds);
+		WriteColumn(OtherIds);
+		WriteColumn(Xs);
+		WriteColumn(Ys);
+		WriteColumn(Zs);
+		WriteColumn(Values);
+		File->Flush();
+
+		Times.Reset();
+		Types.Reset();
+		ActorIds.Reset();
+		OtherIds.Reset();
+		Xs.Reset();
+		Ys.Reset();
+		Zs.Reset();
+		Values.Reset();
+	}
+
+	template<typename T>
+	void WriteColumn(TArray<T>& Column)
+	{
+		static const uint8 Padding[8] = {};
+		const int64 NumBytes = Column.Num() * sizeof(T);
+		File->Serialize(Column.GetData(), NumBytes);
+		File->Serialize((void*)Padding, Align(NumBytes, 8) - NumBytes);
+	}
+
+	FArchive* File;
+	const int32 RingCapacity;
+	const int32 ChunkRows;
+	const uint32 FlushIntervalMs;
+
+	uint32 TlsSlot;
+	FCriticalSection RingsLock;
+	TArray<FRing*> Rings;
+	FThreadSafeCounter NumDropped;
+
+	/** Rows of the chunk being filled, one array per column. */
+	TArray<float> Times;
+	TArray<uint8> Types;
+	TArray<uint32> ActorIds;
+	TArray<uint32> OtherIds;
+	TArray<float> Xs;
+	TArray<float> Ys;
+	TArray<float> Zs;
+	TArray<float> Values;
+
+	FEvent* WakeEvent;
+	FRunnableThread* Thread;
+	TAtomic<bool> bStopping;
+};
+
+AMatchTelemetryRecorder::AMatchTelemetryRecorder()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+	bReplicates = false;
+
+	PositionSampleInterval = 0.25f;
+	RingCapacity = 16384;
+	ChunkRows = 65536;
+	FlushIntervalMs = 50.0f;
+
+	LastActorId = 0;
+	NumEventsDropped = 0;
+}
+
+AMatchTelemetryRecorder::~AMatchTelemetryRecorder()
+{
+}
+
+bool AMatchTelemetryRecorder::GetOutputPath(FString& OutPath)
+{
+	return FParse::Value(FCommandLine::Get(), TEXT("MatchTelemetry="), OutPath) && !OutPath.IsEmpty();
+}
+
+void AMatchTelemetryRecorder::BeginPlay()
+{
+	Super::BeginPlay();
+
+	FString Path;
+	if (!GetOutputPath(Path))
+	{
+		return;
+	}
+
+	FArchive* File = IFileManager::Get().CreateFileWriter(*Path);
+	if (File == nullptr)
+	{
+		UE_LOG(LogThirdPersonMP, Error, TEXT("Match telemetry: could not open %s for writing."), *Path);
+		return;
+	}
+
+	Writer = MakeUnique<FMatchTelemetryWriter>(File, RingCapacity, ChunkRows, FlushIntervalMs);
+
+	SetActorTickInterval(PositionSampleInterval);
+	SetActorTickEnabled(true);
+
+	UE_LOG(LogThirdPersonMP, Log, TEXT("Match telemetry: writing to %s."), *Path);
+}
+
+void AMatchTelemetryRecorder::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (Writer)
+	{
+		NumEventsDropped += Writer->TakeNumDropped();
+		Writer.Reset();
+
+		if (NumEventsDropped > 0)
+		{
+			UE_LOG(LogThirdPersonMP, Warning, TEXT("Match telemetry: dropped %d events to full rings. Raise RingCapacity or lower FlushIntervalMs."), NumEventsDropped);
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AMatchTelemetryRecorder::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	for (TActorIterator<AThirdPersonMPCharacter> It(GetWorld()); It; ++It)
+	{
+		Record(EMatchTelemetryEvent::Position, *It, nullptr, It->GetActorLocation(), It->GetCurrentHealth());
+	}
+
+	const int32 NumDropped = Writer ? Writer->TakeNumDropped() : 0;
+	NumEventsDropped += NumDropped;
+	INC_DWORD_STAT_BY(STAT_ThirdPersonMP_TelemetryEventsDropped, NumDropped);
+}
+
+void AMatchTelemetryRecorder::RecordFire(const AActor* Shooter, const FVector& Origin, int32 Sequence)
+{
+	Record(EMatchTelemetryEvent::Fire, Shooter, nullptr, Origin, (float)Sequence);
+}
+
+void AMatchTelemetryRecorder::RecordImpact(const AActor* Shooter, const AActor* HitActor, const FVector& ImpactPoint, float Damage)
+{
+	Record(EMatchTelemetryEvent::Impact, Shooter, HitActor, ImpactPoint, Damage);
+}
+
+void AMatchTelemetryRecorder::RecordDamage(const AActor* DamagedActor, const AActor* DamageInstigator, float Damage)
+{
+	Record(EMatchTelemetryEvent::Damage, DamagedActor, DamageInstigator, DamagedActor ? DamagedActor->GetActorLocation() : FVector::ZeroVector, Damage);
+}
+
+void AMatchTelemetryRecorder::Record(EMatchTelemetryEvent Type, const AActor* Actor, const AActor* Other, const FVector& Location, float Value)
+{
+	if (Writer)
+	{
+		FMatchTelemetryEvent Event;
+		Event.Time = GetWorld()->GetTimeSeconds();
+		Event.ActorId = GetTelemetryId(Actor);
+		Event.OtherId = GetTelemetryId(Other);
+		Event.Location = Location;
+		Event.Value = Value;
+		Event.Type = Type;
+		Writer->Record(Event);
+	}
+}
+
+uint32 AMatchTelemetryRecorder::GetTelemetryId(const AActor* Actor)
+{
+	if (Actor == nullptr)
+	{
+		return 0;
+	}
+
+	const APawn* Pawn = Cast<APawn>(Actor);
+	if (const APlayerState* PlayerState = Pawn ? Pawn->GetPlayerState() : nullptr)
+	{
+		return (uint32)PlayerState->GetPlayerId();
+	}
+
+	FScopeLock Lock(&ActorIdsLock);
+	uint32& Id = ActorIds.FindOrAdd(FObjectKey(Actor));
+	if (Id == 0)
+	{
+		Id = ActorIdFlag | ++LastActorId;
+	}
+	return Id;
+}
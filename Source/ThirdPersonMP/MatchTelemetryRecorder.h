@@ -0,0 +1,119 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "HAL/CriticalSection.h"
+#include "UObject/ObjectKey.h"
+#include "MatchTelemetryRecorder.generated.h"
+
+class FMatchTelemetryWriter;
+
+/** Kind of a telemetry event, as stored in the file's Type column. */
+UENUM()
+enum class EMatchTelemetryEvent : uint8
+{
+	Fire,
+	Impact,
+	Damage,
+	Position,
+};
+
+/** One telemetry event. Written to the file one column per field. */
+struct FMatchTelemetryEvent
+{
+	/** World time in seconds. */
+	float Time;
+
+	/** AMatchTelemetryRecorder::GetTelemetryId of the actor the event is about, and of the other actor involved, or 0. */
+	uint32 ActorId;
+	uint32 OtherId;
+
+	FVector Location;
+
+	/** Damage for impacts and damage events, health for positions, the fire command's sequence for fire events. */
+	float Value;
+
+	EMatchTelemetryEvent Type;
+};
+
+/**
+ * Server-side match telemetry. Records every shot, projectile impact and damage event, and each character's position
+ * and health every PositionSampleInterval, to the file given with -MatchTelemetry=<path>. Spawned by
+ * AThirdPersonMPGameMode on servers started with that option.
+ *
+ * Recording only copies the event into a ring buffer owned by the calling thread, so it is safe from the parallel
+ * character work and allocates nothing after a thread's first event. A background thread empties the rings and
+ * writes the events in chunks of up to ChunkRows rows, each chunk holding one contiguous array per column, so a
+ * reader can map the file and use the arrays in place. Content/Python/match_telemetry.py reads the format. Events
+ * from different threads are not in time order within a chunk; sort by Time where that matters. Events that arrive
+ * while a thread's ring is full are dropped and counted.
+ */
+UCLASS(config=Game, notplaceable)
+class THIRDPERSONMP_API AMatchTelemetryRecorder : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AMatchTelemetryRecorder();
+	virtual ~AMatchTelemetryRecorder();
+
+	/** Returns true and the file path if this server was started with -MatchTelemetry=<path>. */
+	static bool GetOutputPath(FString& OutPath);
+
+	/** Records a shot fired by Shooter from Origin. Sequence is the fire command's sequence number. */
+	void RecordFire(const AActor* Shooter, const FVector& Origin, int32 Sequence);
+
+	/** Records a projectile fired by Shooter hitting HitActor, or level geometry if it is null, for Damage. */
+	void RecordImpact(const AActor* Shooter, const AActor* HitActor, const FVector& ImpactPoint, float Damage);
+
+	/** Records Damage taken by DamagedActor from DamageInstigator, if known. */
+	void RecordDamage(const AActor* DamagedActor, const AActor* DamageInstigator, float Damage);
+
+	/**
+	 * Returns the id Actor is recorded under, or 0 for none. A pawn with a player state is recorded under its
+	 * APlayerState::GetPlayerId, so a player keeps one id across respawns. Any other actor gets the next number of a
+	 * counter the first time it is recorded, with ActorIdFlag set, and keeps it for the rest of the match. Unlike
+	 * UObject unique ids, neither is handed to another actor after garbage collection. Safe from any thread.
+	 */
+	uint32 GetTelemetryId(const AActor* Actor);
+
+	/** Set on ids that are not player ids. */
+	static const uint32 ActorIdFlag = 0x80000000u;
+
+	/** Seconds between samples of every character's position and health. */
+	UPROPERTY(Config, EditAnywhere, Category = "Telemetry")
+	float PositionSampleInterval;
+
+	/** Events each recording thread can hold before the writer thread empties it. Rounded up to a power of two. */
+	UPROPERTY(Config, EditAnywhere, Category = "Telemetry")
+	int32 RingCapacity;
+
+	/** Rows per chunk in the file. */
+	UPROPERTY(Config, EditAnywhere, Category = "Telemetry")
+	int32 ChunkRows;
+
+	/** Milliseconds the writer thread waits between emptying the rings. */
+	UPROPERTY(Config, EditAnywhere, Category = "Telemetry")
+	float FlushIntervalMs;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+
+private:
+	void Record(EMatchTelemetryEvent Type, const AActor* Actor, const AActor* Other, const FVector& Location, float Value);
+
+	/** Owns the rings, the background thread and the file. Null unless recording. */
+	TUniquePtr<FMatchTelemetryWriter> Writer;
+
+	/** Ids handed out to actors without a player state, and the last one handed out. Guarded by ActorIdsLock. */
+	TMap<FObjectKey, uint32> ActorIds;
+	uint32 LastActorId;
+	FCriticalSection ActorIdsLock;
+
+	/** Events dropped to full rings so far, reported when recording ends. */
+	int32 NumEventsDropped;
+};
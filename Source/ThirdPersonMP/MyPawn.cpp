@@ -2,33 +2,45 @@
 
 
 #include "MyPawn.h"
+#include "CrowdManager.h"
+#include "Components/CapsuleComponent.h"
+#include "Engine/CollisionProfile.h"
 
 // Sets default values
 AMyPawn::AMyPawn()
 {
- 	// Set this pawn to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
-
+	// The crowd manager moves every agent in one batch, so the pawn itself never ticks.
+	PrimaryActorTick.bCanEverTick = false;
+
+	// Clients see the crowd through the manager's replicated array, so the pawn needs no actor channel.
+	bReplicates = false;
+	AutoPossessAI = EAutoPossessAI::Disabled;
+
+	CapsuleComponent = CreateDefaultSubobject<UCapsuleComponent>(TEXT("CollisionCylinder"));
+	CapsuleComponent->InitCapsuleSize(42.0f, 96.0f);
+	CapsuleComponent->SetCollisionProfileName(UCollisionProfile::Pawn_ProfileName);
+	CapsuleComponent->SetGenerateOverlapEvents(false);
+	CapsuleComponent->SetCanEverAffectNavigation(false);
+	CapsuleComponent->SetMobility(EComponentMobility::Movable);
+	RootComponent = CapsuleComponent;
+
+	AgentIndex = INDEX_NONE;
 }
 
-// Called when the game starts or when spawned
-void AMyPawn::BeginPlay()
+void AMyPawn::InitAgent(ACrowdManager* Manager, int32 InAgentIndex)
 {
-	Super::BeginPlay();
-	
+	CrowdManager = Manager;
+	AgentIndex = InAgentIndex;
 }
 
-// Called every frame
-void AMyPawn::Tick(float DeltaTime)
+float AMyPawn::TakeDamage(float DamageAmount, struct FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser)
 {
-	Super::Tick(DeltaTime);
+	const float ActualDamage = Super::TakeDamage(DamageAmount, DamageEvent, EventInstigator, DamageCauser);
 
-}
-
-// Called to bind functionality to input
-void AMyPawn::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
-{
-	Super::SetupPlayerInputComponent(PlayerInputComponent);
+	if (ACrowdManager* Manager = CrowdManager.Get())
+	{
+		Manager->DamageAgent(AgentIndex, ActualDamage);
+	}
 
+	return ActualDamage;
 }
-
@@ -6,6 +6,14 @@
 #include "GameFramework/Pawn.h"
 #include "MyPawn.generated.h"
 
+class ACrowdManager;
+class UCapsuleComponent;
+
+/**
+ * Server-side body of one ACrowdManager agent. It only has a capsule, so that projectiles and traces hit the agent, and
+ * forwards the damage it takes to the manager. It has no mesh, does not tick and does not replicate: the manager moves
+ * it and replicates the whole crowd in one array, and clients draw agents without spawning pawns at all.
+ */
 UCLASS()
 class THIRDPERSONMP_API AMyPawn : public APawn
 {
@@ -15,15 +23,20 @@ public:
 	// Sets default values for this pawn's properties
 	AMyPawn();
 
-protected:
-	// Called when the game starts or when spawned
-	virtual void BeginPlay() override;
+	/** Ties this pawn to the agent at AgentIndex in Manager. */
+	void InitAgent(ACrowdManager* Manager, int32 InAgentIndex);
 
-public:	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
+	/** Passes the damage on to the agent's health in the crowd manager. */
+	virtual float TakeDamage(float DamageAmount, struct FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser) override;
 
-	// Called to bind functionality to input
-	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
+	/** Returns CapsuleComponent subobject **/
+	FORCEINLINE UCapsuleComponent* GetCapsuleComponent() const { return CapsuleComponent; }
 
+private:
+	/** Collision the agent is hit with. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components", meta = (AllowPrivateAccess = "true"))
+	UCapsuleComponent* CapsuleComponent;
+
+	TWeakObjectPtr<ACrowdManager> CrowdManager;
+	int32 AgentIndex;
 };
@@ -2,4 +2,84 @@
 
 
 #include "MyWorldSettings.h"
+#include "ThirdPersonMP.h"
+#include "Engine/LevelStreaming.h"
+#include "Engine/World.h"
+#include "Misc/PackageName.h"
 
+AMyWorldSettings::AMyWorldSettings()
+{
+	bEnableGridStreaming = false;
+	GridOrigin = FVector2D::ZeroVector;
+	CellSize = 25600.0f;
+	ClientLoadRadius = 51200.0f;
+	ClientUnloadRadius = 64000.0f;
+	ServerLoadRadius = 12800.0f;
+	ServerUnloadRadius = 25600.0f;
+	LookAheadSeconds = 2.0f;
+}
+
+const AMyWorldSettings* AMyWorldSettings::GetGridStreamingSettings(const UWorld* World)
+{
+	const AMyWorldSettings* Settings = World ? Cast<AMyWorldSettings>(World->GetWorldSettings()) : nullptr;
+	return (Settings && Settings->bEnableGridStreaming && Settings->GridCells.Num() > 0) ? Settings : nullptr;
+}
+
+FIntPoint AMyWorldSettings::GetCellCoordinates(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt((Location.X - GridOrigin.X) / CellSize), FMath::FloorToInt((Location.Y - GridOrigin.Y) / CellSize));
+}
+
+float AMyWorldSettings::GetDistanceToCell(const FVector& Location, const FIntPoint& Coordinates) const
+{
+	const FVector2D Min = GridOrigin + FVector2D(Coordinates.X, Coordinates.Y) * CellSize;
+	const FVector2D Max = Min + FVector2D(CellSize, CellSize);
+	const FVector2D Point(Location);
+	const FVector2D Closest(FMath::Clamp(Point.X, Min.X, Max.X), FMath::Clamp(Point.Y, Min.Y, Max.Y));
+	return FVector2D::Distance(Point, Closest);
+}
+
+#if WITH_EDITOR
+void AMyWorldSettings::BuildGridCellsFromSubLevels()
+{
+	UWorld* World = GetWorld();
+	if (World == nullptr)
+	{
+		return;
+	}
+
+	//Name_X_Y is a cell's level and Name_X_Y_Collision its collision level, whatever order they are listed in
+	TMap<FIntPoint, FWorldGridCell> Cells;
+	for (ULevelStreaming* StreamingLevel : World->GetStreamingLevels())
+	{
+		if (StreamingLevel == nullptr)
+		{
+			continue;
+		}
+
+		TArray<FString> Parts;
+		FPackageName::GetShortName(StreamingLevel->GetWorldAssetPackageName()).ParseIntoArray(Parts, TEXT("_"));
+		const bool bCollision = Parts.Num() > 0 && Parts.Last().Equals(TEXT("Collision"), ESearchCase::IgnoreCase);
+		if (bCollision)
+		{
+			Parts.Pop();
+		}
+		if (Parts.Num() < 3 || !Parts[Parts.Num() - 2].IsNumeric() || !Parts[Parts.Num() - 1].IsNumeric())
+		{
+			continue;
+		}
+
+		const FIntPoint Coordinates(FCString::Atoi(*Parts[Parts.Num() - 2]), FCString::Atoi(*Parts[Parts.Num() - 1]));
+		FWorldGridCell& Cell = Cells.FindOrAdd(Coordinates);
+		Cell.Coordinates = Coordinates;
+		(bCollision ? Cell.CollisionLevel : Cell.Level) = TSoftObjectPtr<UWorld>(StreamingLevel->GetWorldAsset().ToSoftObjectPath());
+	}
+
+	Modify();
+	GridCells.Reset();
+	Cells.ValueSort([](const FWorldGridCell& A, const FWorldGridCell& B) { return A.Coordinates.Y != B.Coordinates.Y ? A.Coordinates.Y < B.Coordinates.Y : A.Coordinates.X < B.Coordinates.X; });
+	Cells.GenerateValueArray(GridCells);
+
+	UE_LOG(LogThirdPersonMP, Log, TEXT("Grid streaming: %d cells found in the sub-levels of %s."), GridCells.Num(), *World->GetMapName());
+}
+#endif
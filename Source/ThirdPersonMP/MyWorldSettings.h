@@ -6,12 +6,103 @@
 #include "GameFramework/WorldSettings.h"
 #include "MyWorldSettings.generated.h"
 
+/** One cell of a grid-streamed map: the sub-levels holding the actors inside its square. */
+USTRUCT(BlueprintType)
+struct FWorldGridCell
+{
+	GENERATED_BODY()
+
+	/** Column and row of the cell, counted from GridOrigin. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Streaming")
+	FIntPoint Coordinates;
+
+	/** Sub-level with everything in the cell that only matters to a machine that renders. Loaded by clients. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Streaming")
+	TSoftObjectPtr<UWorld> Level;
+
+	/**
+	 * Optional sub-level with the cell's blocking geometry and gameplay actors. Loaded by clients and servers; when it
+	 * is not set, Level holds everything and servers load that instead.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Streaming")
+	TSoftObjectPtr<UWorld> CollisionLevel;
+
+	/** If false, nothing in the cell can block or affect gameplay (a backdrop past the play area), so servers never load it. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Streaming")
+	bool bCollisionRelevant;
+
+	FWorldGridCell()
+		: Coordinates(0, 0)
+		, bCollisionRelevant(true)
+	{
+	}
+};
+
 /**
- * 
+ * World settings for ThirdPersonMP maps. A map too large to keep loaded can be split into a grid of square cells, each
+ * a pair of sub-levels added to the map with the Blueprint streaming method. AWorldGridStreamingManager then streams
+ * cells in and out around the players: clients load every cell within ClientLoadRadius of their view, servers load
+ * the collision of every cell within ServerLoadRadius of any player.
  */
 UCLASS()
 class THIRDPERSONMP_API AMyWorldSettings : public AWorldSettings
 {
 	GENERATED_BODY()
-	
+
+public:
+	AMyWorldSettings();
+
+	/** Returns the settings of World if it uses AMyWorldSettings with grid streaming enabled, or nullptr. */
+	static const AMyWorldSettings* GetGridStreamingSettings(const UWorld* World);
+
+	/** Returns the coordinates of the cell containing Location. */
+	FIntPoint GetCellCoordinates(const FVector& Location) const;
+
+	/** Returns the horizontal distance from Location to the nearest point of the cell at Coordinates. Zero inside it. */
+	float GetDistanceToCell(const FVector& Location, const FIntPoint& Coordinates) const;
+
+#if WITH_EDITOR
+	/**
+	 * Replaces GridCells with one cell per sub-level of this map named <anything>_<X>_<Y>, using the sub-level named
+	 * <anything>_<X>_<Y>_Collision, if there is one, as its collision level.
+	 */
+	UFUNCTION(CallInEditor, Category = "Streaming")
+	void BuildGridCellsFromSubLevels();
+#endif
+
+	/** If true, the cells in GridCells are streamed around the players instead of being loaded with the map. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Streaming")
+	bool bEnableGridStreaming;
+
+	/** World position of the corner of cell (0, 0). */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Streaming", meta = (EditCondition = "bEnableGridStreaming"))
+	FVector2D GridOrigin;
+
+	/** Width of a cell, in cm. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Streaming", meta = (EditCondition = "bEnableGridStreaming", ClampMin = "100.0"))
+	float CellSize;
+
+	/** Clients load cells within this distance of their view, in cm. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Streaming", meta = (EditCondition = "bEnableGridStreaming"))
+	float ClientLoadRadius;
+
+	/** Clients keep loaded cells until they are further than this. Larger than ClientLoadRadius, so cells near the edge are not streamed in and out. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Streaming", meta = (EditCondition = "bEnableGridStreaming"))
+	float ClientUnloadRadius;
+
+	/** Servers load the collision of cells within this distance of any player, in cm. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Streaming", meta = (EditCondition = "bEnableGridStreaming"))
+	float ServerLoadRadius;
+
+	/** Servers keep loaded cells until they are further than this from every player. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Streaming", meta = (EditCondition = "bEnableGridStreaming"))
+	float ServerUnloadRadius;
+
+	/** Cells are also loaded around where each player will be this many seconds ahead at their current velocity. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Streaming", meta = (EditCondition = "bEnableGridStreaming"))
+	float LookAheadSeconds;
+
+	/** The cells of the map. Sub-levels not listed here are loaded the usual way. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Streaming", meta = (EditCondition = "bEnableGridStreaming"))
+	TArray<FWorldGridCell> GridCells;
 };
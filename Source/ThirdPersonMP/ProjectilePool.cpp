@@ -0,0 +1,167 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "ProjectilePool.h"
+#include "ThirdPersonMP.h"
+#include "ThirdPersonMPProjectile.h"
+#include "FrameBudgetScheduler.h"
+#include "Engine/World.h"
+
+AProjectilePool::AProjectilePool()
+{
+	PrimaryActorTick.bCanEverTick = false;
+	bReplicates = false;
+
+	PrewarmClass = AThirdPersonMPProjectile::StaticClass();
+	PrewarmCount = 32;
+	MaxPoolSize = 256;
+	GrowOnMiss = 8;
+
+	NumPooled = 0;
+	NumFree = 0;
+	HitCount = 0;
+	MissCount = 0;
+	OverflowCount = 0;
+}
+
+void AProjectilePool::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (PrewarmClass)
+	{
+		const int32 NumToSpawn = FMath::Min(PrewarmCount, MaxPoolSize);
+		FProjectilePoolBucket& Bucket = Buckets.FindOrAdd(PrewarmClass);
+		Bucket.Free.Reserve(NumToSpawn);
+
+		for (int32 Index = 0; Index < NumToSpawn; ++Index)
+		{
+			if (AThirdPersonMPProjectile* Projectile = SpawnPooledProjectile(PrewarmClass))
+			{
+				Bucket.Free.Push(Projectile);
+				++NumFree;
+			}
+		}
+	}
+}
+
+void AProjectilePool::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UE_LOG(LogThirdPersonMP, Log, TEXT("Projectile pool: %d pooled, %d hits, %d misses, %d overflows."), NumPooled, HitCount, MissCount, OverflowCount);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+AThirdPersonMPProjectile* AProjectilePool::Acquire(TSubclassOf<AThirdPersonMPProjectile> ProjectileClass, const FVector& Location, const FRotator& Rotation, AActor* NewOwner, APawn* NewInstigator, uint16 ShotId)
+{
+	UClass* Class = ProjectileClass ? *ProjectileClass : AThirdPersonMPProjectile::StaticClass();
+	FProjectilePoolBucket& Bucket = Buckets.FindOrAdd(Class);
+
+	AThirdPersonMPProjectile* Projectile = nullptr;
+	while (!Projectile && Bucket.Free.Num() > 0)
+	{
+		Projectile = Bucket.Free.Pop(false);
+		--NumFree;
+
+		//Something other than the pool destroyed this projectile while it was parked.
+		if (Projectile == nullptr || Projectile->IsPendingKill())
+		{
+			Projectile = nullptr;
+			--NumPooled;
+		}
+	}
+
+	if (Projectile)
+	{
+		++HitCount;
+	}
+	else if (NumPooled < MaxPoolSize)
+	{
+		++MissCount;
+		Projectile = SpawnPooledProjectile(Class);
+
+		//A miss usually means a burst of fire, so park a few more for the next shots, outside the frame that is already busy. With deferral off they would land in that frame, so the pool grows one shot at a time as before.
+		TWeakObjectPtr<AProjectilePool> WeakThis = this;
+		TWeakObjectPtr<UClass> WeakClass = Class;
+		const int32 NumToGrow = AFrameBudgetScheduler::IsDeferring(this) ? GrowOnMiss : 0;
+		for (int32 Index = 0; Index < NumToGrow; ++Index)
+		{
+			AFrameBudgetScheduler::Defer(this, EDeferredWorkPriority::Low, [WeakThis, WeakClass]()
+			{
+				AProjectilePool* Pool = WeakThis.Get();
+				UClass* GrowClass = WeakClass.Get();
+				if (Pool && GrowClass && !Pool->IsActorBeingDestroyed())
+				{
+					if (AThirdPersonMPProjectile* Spare = Pool->SpawnPooledProjectile(GrowClass))
+					{
+						Pool->Buckets.FindOrAdd(GrowClass).Free.Push(Spare);
+						++Pool->NumFree;
+					}
+				}
+			});
+		}
+	}
+
+	if (Projectile)
+	{
+		Projectile->ActivateFromPool(Location, Rotation, NewOwner, NewInstigator, ShotId);
+		return Projectile;
+	}
+
+	//The pool is full. Keep the shot, but spawn it the old way so it destroys itself on impact.
+	++OverflowCount;
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.Instigator = NewInstigator;
+	SpawnParameters.Owner = NewOwner;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	Projectile = GetWorld()->SpawnActor<AThirdPersonMPProjectile>(Class, Location, Rotation, SpawnParameters);
+	if (Projectile)
+	{
+		//Times out through OnLifetimeExpired like a pooled shot, where ReturnToPool destroys it.
+		Projectile->SetShotId(ShotId);
+	}
+	return Projectile;
+}
+
+void AProjectilePool::Release(AThirdPersonMPProjectile* Projectile)
+{
+	if (Projectile == nullptr)
+	{
+		return;
+	}
+
+	if (!Projectile->IsPooled())
+	{
+		Projectile->Destroy();
+		return;
+	}
+
+	if (Projectile->IsActive())
+	{
+		Projectile->DeactivateToPool();
+		Buckets.FindOrAdd(Projectile->GetClass()).Free.Push(Projectile);
+		++NumFree;
+	}
+}
+
+AThirdPersonMPProjectile* AProjectilePool::SpawnPooledProjectile(UClass* ProjectileClass)
+{
+	if (NumPooled >= MaxPoolSize)
+	{
+		return nullptr;
+	}
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.Owner = this;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	AThirdPersonMPProjectile* Projectile = GetWorld()->SpawnActor<AThirdPersonMPProjectile>(ProjectileClass, GetActorLocation(), FRotator::ZeroRotator, SpawnParameters);
+	if (Projectile)
+	{
+		Projectile->InitPooled(this);
+		++NumPooled;
+	}
+	return Projectile;
+}
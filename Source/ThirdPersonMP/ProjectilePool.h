@@ -0,0 +1,95 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "ProjectilePool.generated.h"
+
+class AThirdPersonMPProjectile;
+
+/** Free list of pooled projectiles of a single class. */
+USTRUCT()
+struct FProjectilePoolBucket
+{
+	GENERATED_BODY()
+
+	/** Projectiles that are parked and ready to be handed out. */
+	UPROPERTY()
+	TArray<AThirdPersonMPProjectile*> Free;
+};
+
+/**
+ * Server-side pool of projectile actors. Projectiles are pre-warmed at BeginPlay, handed out by Acquire when a character
+ * fires and returned by Release on impact or timeout, so that firing does not spawn and destroy an actor (and open and
+ * close an actor channel on every client) per shot. Owned and spawned by AThirdPersonMPGameMode.
+ */
+UCLASS(config=Game, notplaceable)
+class THIRDPERSONMP_API AProjectilePool : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AProjectilePool();
+
+	/**
+	 * Hands out a projectile of the given class, launched from the given location and rotation for fire command ShotId.
+	 * Reuses a parked projectile when one is available, spawns a new pooled one while under MaxPoolSize (and, while
+	 * work is being deferred, queues GrowOnMiss more as low priority deferred work), and otherwise falls back to an unpooled projectile that destroys
+	 * itself as before.
+	 */
+	AThirdPersonMPProjectile* Acquire(TSubclassOf<AThirdPersonMPProjectile> ProjectileClass, const FVector& Location, const FRotator& Rotation, AActor* NewOwner, APawn* NewInstigator, uint16 ShotId);
+
+	/** Returns a pooled projectile to its free list. Unpooled projectiles are destroyed instead. */
+	void Release(AThirdPersonMPProjectile* Projectile);
+
+	/** Number of Acquire calls served from the free list. */
+	FORCEINLINE int32 GetHitCount() const { return HitCount; }
+
+	/** Number of Acquire calls that had to grow the pool. */
+	FORCEINLINE int32 GetMissCount() const { return MissCount; }
+
+	/** Number of Acquire calls that found the pool at MaxPoolSize and fell back to an unpooled projectile. */
+	FORCEINLINE int32 GetOverflowCount() const { return OverflowCount; }
+
+	/** Number of pooled projectiles currently in flight. */
+	FORCEINLINE int32 GetNumActive() const { return NumPooled - NumFree; }
+
+	/** Total number of projectiles owned by the pool, in flight or parked. */
+	FORCEINLINE int32 GetNumPooled() const { return NumPooled; }
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Spawns a new pooled projectile and parks it. Returns nullptr when the pool is full. */
+	AThirdPersonMPProjectile* SpawnPooledProjectile(UClass* ProjectileClass);
+
+	/** Projectile class created at BeginPlay. */
+	UPROPERTY(EditAnywhere, Category = "Pool")
+	TSubclassOf<AThirdPersonMPProjectile> PrewarmClass;
+
+	/** Number of projectiles created at BeginPlay. */
+	UPROPERTY(Config, EditAnywhere, Category = "Pool")
+	int32 PrewarmCount;
+
+	/** Upper bound on the number of projectiles owned by the pool, across all classes. */
+	UPROPERTY(Config, EditAnywhere, Category = "Pool")
+	int32 MaxPoolSize;
+
+	/** Extra projectiles parked after a miss, spawned one at a time when the frame budget allows, for the rest of the burst. None while ThirdPersonMP.DeferWork is 0. */
+	UPROPERTY(Config, EditAnywhere, Category = "Pool")
+	int32 GrowOnMiss;
+
+	/** Parked projectiles, keyed by projectile class. */
+	UPROPERTY(Transient)
+	TMap<UClass*, FProjectilePoolBucket> Buckets;
+
+private:
+	int32 NumPooled;
+	int32 NumFree;
+
+	int32 HitCount;
+	int32 MissCount;
+	int32 OverflowCount;
+};
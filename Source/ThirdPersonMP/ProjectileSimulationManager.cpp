@@ -0,0 +1,414 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "ProjectileSimulationManager.h"
+#include "ThirdPersonMP.h"
+#include "ThirdPersonMPProjectile.h"
+#include "ImpactEffectManager.h"
+#include "CosmeticAssetLoader.h"
+#include "ThirdPersonMPGameMode.h"
+#include "LagCompensationManager.h"
+#include "EmbedGameStateBase.h"
+#include "Algo/BinarySearch.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "Net/UnrealNetwork.h"
+#include "Particles/ParticleSystem.h"
+
+void FProjectileEvent::PostReplicatedAdd(const FProjectileEventArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->OnEventAdded(*this);
+	}
+}
+
+void FProjectileEvent::PostReplicatedChange(const FProjectileEventArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->OnEventChanged(*this);
+	}
+}
+
+void FProjectileEvent::PreReplicatedRemove(const FProjectileEventArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->OnEventRemoved(*this);
+	}
+}
+
+AProjectileSimulationManager::AProjectileSimulationManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	bReplicates = true;
+	bAlwaysRelevant = true;
+	NetUpdateFrequency = 60.0f;
+	NetPriority = 2.0f;
+
+	InstancedMesh = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("InstancedMesh"));
+	InstancedMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	InstancedMesh->SetMobility(EComponentMobility::Movable);
+	InstancedMesh->SetCastShadow(false);
+	RootComponent = InstancedMesh;
+
+	//Same visuals as AThirdPersonMPProjectile, so switching between the two paths looks identical.
+	ProjectileMesh = TSoftObjectPtr<UStaticMesh>(FSoftObjectPath(TEXT("/Game/StarterContent/Shapes/Shape_Sphere.Shape_Sphere")));
+	ExplosionEffect = TSoftObjectPtr<UParticleSystem>(FSoftObjectPath(TEXT("/Game/StarterContent/Particles/P_Explosion.P_Explosion")));
+
+	MaxProjectiles = 8192;
+	ImpactRetainTime = 1.0f;
+	MaxRetainedEvents = 1024;
+	MaxImpactEffectAge = 0.5f;
+	TraceChannel = ECC_WorldDynamic;
+	NextProjectileId = 0;
+}
+
+void AProjectileSimulationManager::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(AProjectileSimulationManager, EventArray);
+}
+
+void AProjectileSimulationManager::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	EventArray.Owner = this;
+
+	if (GetNetMode() == NM_DedicatedServer)
+	{
+		InstancedMesh->SetVisibility(false);
+	}
+
+	UCosmeticAssetLoader::Request(ProjectileMesh.ToSoftObjectPath(), FStreamableDelegate::CreateUObject(this, &AProjectileSimulationManager::OnProjectileMeshLoaded));
+	UCosmeticAssetLoader::Request(ExplosionEffect.ToSoftObjectPath());
+}
+
+void AProjectileSimulationManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	//Clients only begin play once the game state has arrived, so it is always there to register with.
+	if (AEmbedGameStateBase* GameState = GetWorld()->GetGameState<AEmbedGameStateBase>())
+	{
+		GameState->SetProjectileSimulationManager(this);
+	}
+}
+
+void AProjectileSimulationManager::OnProjectileMeshLoaded()
+{
+	InstancedMesh->SetStaticMesh(ProjectileMesh.Get());
+}
+
+int32 AProjectileSimulationManager::SpawnProjectile(const AThirdPersonMPProjectile* Archetype, const FVector& Location, const FRotator& Rotation, AActor* ProjectileOwner, APawn* ProjectileInstigator, float ShooterTime)
+{
+	if (!HasAuthority() || Archetype == nullptr || Ids.Num() >= MaxProjectiles)
+	{
+		return INDEX_NONE;
+	}
+
+	const int32 ProjectileId = NextProjectileId++;
+	const FVector Velocity = Rotation.Vector() * Archetype->ProjectileMovementComponent->InitialSpeed;
+
+	Ids.Add(ProjectileId);
+	Positions.Add(Location);
+	Velocities.Add(Velocity);
+	Lifetimes.Add(Archetype->MaxLifetime > 0.0f ? Archetype->MaxLifetime : BIG_NUMBER);
+	LaunchLocations.Add(Location);
+	LaunchTimes.Add(GetWorld()->GetTimeSeconds());
+	ShooterTimes.Add(ShooterTime);
+	Archetypes.Add(Archetype);
+	Owners.Add(ProjectileOwner);
+	InstigatorControllers.Add(ProjectileInstigator ? ProjectileInstigator->Controller : nullptr);
+	PendingTraces.AddDefaulted();
+
+	FProjectileEvent& Event = EventArray.Events.AddDefaulted_GetRef();
+	Event.ProjectileId = ProjectileId;
+	Event.Location = Location;
+	Event.Velocity = Velocity;
+	Event.SpawnTime = GetServerTime();
+	EventArray.MarkItemDirty(Event);
+
+	return ProjectileId;
+}
+
+void AProjectileSimulationManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (HasAuthority())
+	{
+		StepServer(DeltaSeconds);
+		PruneEvents(GetServerTime());
+
+		if (GetNetMode() != NM_DedicatedServer)
+		{
+			UpdateVisuals(Positions);
+		}
+	}
+	else
+	{
+		StepClient();
+		UpdateVisuals(ClientPositions);
+	}
+}
+
+void AProjectileSimulationManager::StepServer(float DeltaSeconds)
+{
+	UWorld* World = GetWorld();
+
+	//Consume the traces issued last frame. Iterating backwards keeps swap-removal from skipping entries.
+	FTraceDatum TraceDatum;
+	for (int32 Index = Ids.Num() - 1; Index >= 0; --Index)
+	{
+		if (PendingTraces[Index].IsValid() && World->QueryTraceData(PendingTraces[Index], TraceDatum))
+		{
+			PendingTraces[Index] = FTraceHandle();
+
+			const FHitResult* BlockingHit = TraceDatum.OutHits.FindByPredicate([](const FHitResult& Hit) { return Hit.bBlockingHit; });
+			if (BlockingHit)
+			{
+				HandleImpact(Index, *BlockingHit);
+				RemoveServerProjectile(Index);
+			}
+		}
+	}
+
+	//Integrate and issue this frame's traces in one pass over the arrays.
+	const float ServerTime = GetServerTime();
+	AThirdPersonMPGameMode* GameMode = World->GetAuthGameMode<AThirdPersonMPGameMode>();
+	ALagCompensationManager* LagCompensation = GameMode ? GameMode->GetLagCompensationManager() : nullptr;
+	for (int32 Index = Ids.Num() - 1; Index >= 0; --Index)
+	{
+		Lifetimes[Index] -= DeltaSeconds;
+		if (Lifetimes[Index] <= 0.0f)
+		{
+			//A shot that ran out of time may still have passed through a character as the shooter saw it.
+			FLagCompensatedHit RewoundHit;
+			if (LagCompensation && SweepRewoundPath(LagCompensation, Index, Positions[Index], RewoundHit))
+			{
+				ResolveImpact(Index, RewoundHit.Actor, FHitResult(RewoundHit.Actor, nullptr, RewoundHit.Location, -Velocities[Index].GetSafeNormal()));
+				RemoveServerProjectile(Index);
+				continue;
+			}
+
+			const int32 EventIndex = Algo::BinarySearchBy(EventArray.Events, Ids[Index], &FProjectileEvent::ProjectileId);
+			if (EventIndex != INDEX_NONE)
+			{
+				EventArray.Events[EventIndex].ExpireTime = ServerTime + ImpactRetainTime;
+			}
+			RemoveServerProjectile(Index);
+			continue;
+		}
+
+		const FVector Start = Positions[Index];
+		const FVector End = Start + Velocities[Index] * DeltaSeconds;
+		Positions[Index] = End;
+
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ProjectileSimulationTrace), false, Owners[Index].Get());
+		PendingTraces[Index] = World->AsyncLineTraceByChannel(EAsyncTraceType::Single, Start, End, TraceChannel, QueryParams);
+	}
+}
+
+//Traced hits go through the same lag compensation and damage resolution as AThirdPersonMPProjectile::OnProjectileImpact.
+void AProjectileSimulationManager::HandleImpact(int32 Index, const FHitResult& Hit)
+{
+	AActor* DamagedActor = Hit.GetActor();
+	FHitResult DamageHit = Hit;
+
+	AThirdPersonMPGameMode* GameMode = GetWorld()->GetAuthGameMode<AThirdPersonMPGameMode>();
+	if (ALagCompensationManager* LagCompensation = GameMode ? GameMode->GetLagCompensationManager() : nullptr)
+	{
+		FLagCompensatedHit RewoundHit;
+		if (SweepRewoundPath(LagCompensation, Index, Hit.Location, RewoundHit))
+		{
+			DamagedActor = RewoundHit.Actor;
+			DamageHit.ImpactPoint = RewoundHit.Location;
+		}
+		else if (LagCompensation->IsTracked(DamagedActor))
+		{
+			//The flight missed this character as the shooter saw it, so it is only in the way now.
+			DamagedActor = nullptr;
+		}
+	}
+
+	ResolveImpact(Index, DamagedActor, DamageHit);
+}
+
+void AProjectileSimulationManager::ResolveImpact(int32 Index, AActor* DamagedActor, const FHitResult& DamageHit)
+{
+	Archetypes[Index]->ApplyImpactDamage(this, Owners[Index].Get(), InstigatorControllers[Index].Get(), DamagedActor, DamageHit, Velocities[Index].GetSafeNormal(), LaunchLocations[Index]);
+
+	const float ServerTime = GetServerTime();
+	const int32 EventIndex = Algo::BinarySearchBy(EventArray.Events, Ids[Index], &FProjectileEvent::ProjectileId);
+	if (EventIndex != INDEX_NONE)
+	{
+		FProjectileEvent& Event = EventArray.Events[EventIndex];
+		Event.Location = DamageHit.ImpactPoint;
+		Event.bImpact = true;
+		Event.ImpactTime = ServerTime;
+		Event.ExpireTime = ServerTime + ImpactRetainTime;
+		EventArray.MarkItemDirty(Event);
+	}
+
+	AImpactEffectManager::PlayImpactEffect(this, ExplosionEffect.Get(), DamageHit.ImpactPoint);
+}
+
+bool AProjectileSimulationManager::SweepRewoundPath(ALagCompensationManager* LagCompensation, int32 Index, const FVector& End, FLagCompensatedHit& OutHit) const
+{
+	const AThirdPersonMPProjectile* Archetype = Archetypes[Index];
+	const FVector FromLaunch = End - LaunchLocations[Index];
+	const float Length = FMath::Min(FromLaunch.Size(), Archetype->MaxRewindSweepDistance);
+	const FVector Start = End - FromLaunch.GetSafeNormal() * Length;
+
+	const float RewindTime = LagCompensation->ClampRewindTime(ShooterTimes[Index] + (GetWorld()->GetTimeSeconds() - LaunchTimes[Index]));
+	return LagCompensation->RewindSweep(Start, End, Archetype->SphereComponent->GetScaledSphereRadius(), RewindTime, Owners[Index].Get(), OutHit);
+}
+
+void AProjectileSimulationManager::RemoveServerProjectile(int32 Index)
+{
+	Ids.RemoveAtSwap(Index, 1, false);
+	Positions.RemoveAtSwap(Index, 1, false);
+	Velocities.RemoveAtSwap(Index, 1, false);
+	Lifetimes.RemoveAtSwap(Index, 1, false);
+	LaunchLocations.RemoveAtSwap(Index, 1, false);
+	LaunchTimes.RemoveAtSwap(Index, 1, false);
+	ShooterTimes.RemoveAtSwap(Index, 1, false);
+	Archetypes.RemoveAtSwap(Index, 1, false);
+	Owners.RemoveAtSwap(Index, 1, false);
+	InstigatorControllers.RemoveAtSwap(Index, 1, false);
+	PendingTraces.RemoveAtSwap(Index, 1, false);
+}
+
+void AProjectileSimulationManager::PruneEvents(float ServerTime)
+{
+	//Finished events can sit anywhere behind a projectile that is still flying, so every one is checked rather than only a prefix. Removal keeps the id order the binary searches rely on.
+	int32 NumFinished = 0;
+	for (const FProjectileEvent& Event : EventArray.Events)
+	{
+		if (Event.ExpireTime > 0.0f)
+		{
+			++NumFinished;
+		}
+	}
+
+	//Past MaxRetainedEvents the oldest finished events go early, so a burst of impacts cannot grow the array without bound.
+	int32 NumToDropEarly = FMath::Max(NumFinished - MaxRetainedEvents, 0);
+	const int32 NumRemoved = EventArray.Events.RemoveAll([ServerTime, &NumToDropEarly](const FProjectileEvent& Event)
+	{
+		if (Event.ExpireTime <= 0.0f)
+		{
+			return false;
+		}
+		if (Event.ExpireTime <= ServerTime)
+		{
+			return true;
+		}
+		if (NumToDropEarly > 0)
+		{
+			--NumToDropEarly;
+			return true;
+		}
+		return false;
+	});
+
+	if (NumRemoved > 0)
+	{
+		EventArray.MarkArrayDirty();
+	}
+}
+
+void AProjectileSimulationManager::OnEventAdded(const FProjectileEvent& Event)
+{
+	if (Event.bImpact)
+	{
+		//Spawned and hit between two updates; only the explosion is worth showing, unless it happened long before this client joined.
+		RemoveClientProjectile(Event.ProjectileId, Event.Location, GetServerTime() - Event.ImpactTime <= MaxImpactEffectAge);
+		return;
+	}
+
+	ClientIds.Add(Event.ProjectileId);
+	ClientOrigins.Add(Event.Location);
+	ClientVelocities.Add(Event.Velocity);
+	ClientSpawnTimes.Add(Event.SpawnTime);
+	ClientPositions.Add(Event.Location);
+}
+
+void AProjectileSimulationManager::OnEventChanged(const FProjectileEvent& Event)
+{
+	if (Event.bImpact)
+	{
+		RemoveClientProjectile(Event.ProjectileId, Event.Location, true);
+	}
+}
+
+void AProjectileSimulationManager::OnEventRemoved(const FProjectileEvent& Event)
+{
+	RemoveClientProjectile(Event.ProjectileId, Event.Location, false);
+}
+
+void AProjectileSimulationManager::RemoveClientProjectile(int32 ProjectileId, const FVector& Location, bool bExplode)
+{
+	const int32 Index = ClientIds.Find(ProjectileId);
+	if (Index != INDEX_NONE)
+	{
+		ClientIds.RemoveAtSwap(Index, 1, false);
+		ClientOrigins.RemoveAtSwap(Index, 1, false);
+		ClientVelocities.RemoveAtSwap(Index, 1, false);
+		ClientSpawnTimes.RemoveAtSwap(Index, 1, false);
+		ClientPositions.RemoveAtSwap(Index, 1, false);
+	}
+
+	if (bExplode)
+	{
+		AImpactEffectManager::PlayImpactEffect(this, ExplosionEffect.Get(), Location);
+	}
+}
+
+void AProjectileSimulationManager::StepClient()
+{
+	const float ServerTime = GetServerTime();
+	for (int32 Index = 0; Index < ClientIds.Num(); ++Index)
+	{
+		const float FlightTime = FMath::Max(ServerTime - ClientSpawnTimes[Index], 0.0f);
+		ClientPositions[Index] = ClientOrigins[Index] + ClientVelocities[Index] * FlightTime;
+	}
+}
+
+void AProjectileSimulationManager::UpdateVisuals(const TArray<FVector>& InPositions)
+{
+	const FVector Scale(0.75f);
+
+	//Instances are interchangeable, so keep the count in step with the arrays and rewrite every transform.
+	while (InstancedMesh->GetInstanceCount() > InPositions.Num())
+	{
+		InstancedMesh->RemoveInstance(InstancedMesh->GetInstanceCount() - 1);
+	}
+	while (InstancedMesh->GetInstanceCount() < InPositions.Num())
+	{
+		InstancedMesh->AddInstanceWorldSpace(FTransform(FQuat::Identity, FVector::ZeroVector, Scale));
+	}
+
+	for (int32 Index = 0; Index < InPositions.Num(); ++Index)
+	{
+		InstancedMesh->UpdateInstanceTransform(Index, FTransform(FQuat::Identity, InPositions[Index], Scale), true, false, true);
+	}
+
+	if (InPositions.Num() > 0)
+	{
+		InstancedMesh->MarkRenderStateDirty();
+	}
+}
+
+float AProjectileSimulationManager::GetServerTime() const
+{
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	return GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+}
@@ -0,0 +1,227 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "Engine/NetSerialization.h"
+#include "WorldCollision.h"
+#include "ProjectileSimulationManager.generated.h"
+
+class AProjectileSimulationManager;
+class AThirdPersonMPProjectile;
+class ALagCompensationManager;
+struct FLagCompensatedHit;
+
+/** One simulated projectile as seen by clients: a spawn, later flagged as an impact before it is dropped from the array. */
+USTRUCT()
+struct FProjectileEvent : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	/** Id of the projectile, increasing in spawn order. */
+	UPROPERTY()
+	int32 ProjectileId;
+
+	/** Launch origin, or the impact point once bImpact is set. */
+	UPROPERTY()
+	FVector_NetQuantize Location;
+
+	/** Launch velocity. */
+	UPROPERTY()
+	FVector_NetQuantize Velocity;
+
+	/** Server world time of the launch. */
+	UPROPERTY()
+	float SpawnTime;
+
+	/** True once the projectile has hit something. */
+	UPROPERTY()
+	bool bImpact;
+
+	/** Server world time of the impact, so a client that joins later does not replay old explosions. */
+	UPROPERTY()
+	float ImpactTime;
+
+	/** Server world time at which the event may be dropped from the array. Not replicated. */
+	UPROPERTY(NotReplicated)
+	float ExpireTime;
+
+	FProjectileEvent()
+		: ProjectileId(INDEX_NONE)
+		, Location(ForceInitToZero)
+		, Velocity(ForceInitToZero)
+		, SpawnTime(0.0f)
+		, bImpact(false)
+		, ImpactTime(0.0f)
+		, ExpireTime(0.0f)
+	{
+	}
+
+	void PostReplicatedAdd(const struct FProjectileEventArray& InArraySerializer);
+	void PostReplicatedChange(const struct FProjectileEventArray& InArraySerializer);
+	void PreReplicatedRemove(const struct FProjectileEventArray& InArraySerializer);
+};
+
+/** Delta-replicated list of projectile events, kept sorted by ProjectileId. */
+USTRUCT()
+struct FProjectileEventArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FProjectileEvent> Events;
+
+	/** Manager that owns this array, used to route client callbacks. */
+	UPROPERTY(NotReplicated)
+	AProjectileSimulationManager* Owner;
+
+	FProjectileEventArray()
+		: Owner(nullptr)
+	{
+	}
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FProjectileEvent, FProjectileEventArray>(Events, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FProjectileEventArray> : public TStructOpsTypeTraitsBase2<FProjectileEventArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
+/**
+ * Optional replacement for per-actor projectiles. Live projectiles are stored in contiguous arrays and stepped in one
+ * batched pass per frame on the server, using async line traces whose results are consumed on the next frame.
+ * Clients receive a compact fast-array of spawn and impact events and draw every projectile through one instanced
+ * static mesh. Spawned by AThirdPersonMPGameMode when bUseBatchedProjectiles is set.
+ */
+UCLASS(config=Game, notplaceable)
+class THIRDPERSONMP_API AProjectileSimulationManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AProjectileSimulationManager();
+
+	/** Property replication */
+	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	virtual void PostInitializeComponents() override;
+	virtual void BeginPlay() override;
+	virtual void Tick(float DeltaSeconds) override;
+
+	/**
+	 * Launches a simulated projectile using the speed, damage and lifetime of Archetype. Its impacts are judged against
+	 * where characters were at ShooterTime plus the flight time, as for projectile actors. Server only.
+	 * @return the id of the new projectile, or INDEX_NONE if MaxProjectiles are already live.
+	 */
+	int32 SpawnProjectile(const AThirdPersonMPProjectile* Archetype, const FVector& Location, const FRotator& Rotation, AActor* ProjectileOwner, APawn* ProjectileInstigator, float ShooterTime);
+
+	/** Number of projectiles currently simulated on this machine. */
+	FORCEINLINE int32 GetNumLive() const { return HasAuthority() ? Ids.Num() : ClientIds.Num(); }
+
+	/** Client callbacks from the replicated event array. */
+	void OnEventAdded(const FProjectileEvent& Event);
+	void OnEventChanged(const FProjectileEvent& Event);
+	void OnEventRemoved(const FProjectileEvent& Event);
+
+protected:
+	/** Consumes last frame's traces, integrates every live projectile and issues this frame's traces. */
+	void StepServer(float DeltaSeconds);
+
+	/** Judges a traced hit against the characters as the shooter saw them, then resolves it. */
+	void HandleImpact(int32 Index, const FHitResult& Hit);
+
+	/** Applies damage to DamagedActor, if any, through the archetype's damage resolution and flags the projectile's event as an impact. */
+	void ResolveImpact(int32 Index, AActor* DamagedActor, const FHitResult& DamageHit);
+
+	/** Sweeps the last stretch of the flight up to End, at most the archetype's MaxRewindSweepDistance long, against the characters as the shooter saw them. */
+	bool SweepRewoundPath(ALagCompensationManager* LagCompensation, int32 Index, const FVector& End, FLagCompensatedHit& OutHit) const;
+
+	/** Removes the projectile at Index from the server arrays by swapping in the last one. */
+	void RemoveServerProjectile(int32 Index);
+
+	/** Drops finished events that every client has had time to receive, and the oldest finished ones beyond MaxRetainedEvents. */
+	void PruneEvents(float ServerTime);
+
+	/** Extrapolates client projectiles from their replicated launch state. */
+	void StepClient();
+
+	/** Removes the client projectile with the given id, optionally playing the explosion at Location. */
+	void RemoveClientProjectile(int32 ProjectileId, const FVector& Location, bool bExplode);
+
+	/** Writes Positions into the instanced mesh, growing or shrinking it to match. */
+	void UpdateVisuals(const TArray<FVector>& InPositions);
+
+	/** Returns the server world time as seen on this machine. */
+	float GetServerTime() const;
+
+	/** Replicated spawn and impact events. */
+	UPROPERTY(Replicated)
+	FProjectileEventArray EventArray;
+
+	/** Draws every simulated projectile on non-dedicated machines. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components", meta = (AllowPrivateAccess = "true"))
+	class UInstancedStaticMeshComponent* InstancedMesh;
+
+	/** Mesh drawn for each projectile, loaded on machines that render. */
+	UPROPERTY(EditDefaultsOnly, Category = "Effects")
+	TSoftObjectPtr<class UStaticMesh> ProjectileMesh;
+
+	/** Particle played where a projectile hits, loaded on machines that render. */
+	UPROPERTY(EditAnywhere, Category = "Effects")
+	TSoftObjectPtr<class UParticleSystem> ExplosionEffect;
+
+	/** Puts ProjectileMesh on InstancedMesh once it has loaded. */
+	void OnProjectileMeshLoaded();
+
+	/** Upper bound on simultaneously live projectiles. */
+	UPROPERTY(Config, EditAnywhere, Category = "Simulation")
+	int32 MaxProjectiles;
+
+	/** Seconds an impacted event stays in the array so clients can see it before it is dropped. */
+	UPROPERTY(Config, EditAnywhere, Category = "Simulation")
+	float ImpactRetainTime;
+
+	/** Upper bound on finished events kept for ImpactRetainTime. Live events are already bounded by MaxProjectiles. */
+	UPROPERTY(Config, EditAnywhere, Category = "Simulation")
+	int32 MaxRetainedEvents;
+
+	/** Impacts older than this when a client first receives them are not shown, so a joining client does not replay every retained explosion. */
+	UPROPERTY(Config, EditAnywhere, Category = "Simulation")
+	float MaxImpactEffectAge;
+
+	/** Collision channel used for projectile traces. */
+	UPROPERTY(EditAnywhere, Category = "Simulation")
+	TEnumAsByte<ECollisionChannel> TraceChannel;
+
+private:
+	/** Server state, one entry per live projectile. */
+	TArray<int32> Ids;
+	TArray<FVector> Positions;
+	TArray<FVector> Velocities;
+	TArray<float> Lifetimes;
+	TArray<FVector> LaunchLocations;
+	TArray<float> LaunchTimes;
+	TArray<float> ShooterTimes;
+	TArray<const AThirdPersonMPProjectile*> Archetypes;
+	TArray<TWeakObjectPtr<AActor>> Owners;
+	TArray<TWeakObjectPtr<AController>> InstigatorControllers;
+	TArray<FTraceHandle> PendingTraces;
+
+	/** Client state, one entry per projectile currently drawn. */
+	TArray<int32> ClientIds;
+	TArray<FVector> ClientOrigins;
+	TArray<FVector> ClientVelocities;
+	TArray<float> ClientSpawnTimes;
+	TArray<FVector> ClientPositions;
+
+	int32 NextProjectileId;
+};
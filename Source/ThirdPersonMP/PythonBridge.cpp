@@ -1,31 +1,226 @@
 // //Copyright 2020 Edwin Yung. All Rights Reserved
 #include "PythonBridge.h"
+#include "ThirdPersonMP.h"
+#include "Containers/Ticker.h"
+#if WITH_EDITOR
+#include "Templates/Atomic.h"
+#include "UObject/UObjectArray.h"
+#endif
+
+DECLARE_CYCLE_STAT(TEXT("PythonBatch"), STAT_ThirdPersonMP_PythonBatch, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Python Batches"), STAT_ThirdPersonMP_PythonBatches, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Python Commands"), STAT_ThirdPersonMP_PythonCommands, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Python Commands Queued"), STAT_ThirdPersonMP_PythonCommandsQueued, STATGROUP_ThirdPersonMP);
+
+namespace PythonBridge
+{
+    static TWeakObjectPtr<UPythonBridge> CachedBridge;
+
+#if WITH_EDITOR
+    //Python only runs in the editor, so nothing else pays for watching every object created
+
+    /** Set whenever a class is created, on whichever thread creates it, and checked by Get on the game thread. */
+    static TAtomic<bool> bClassCreated(false);
+
+    /** Any new class may be a subclass of the bridge that Get should return instead of the cached one. */
+    class FClassCreateListener : public FUObjectArray::FUObjectCreateListener
+    {
+    public:
+        virtual void NotifyUObjectCreated(const UObjectBase* Object, int32 Index) override
+        {
+            if (Object->GetClass()->IsChildOf(UClass::StaticClass()))
+            {
+                bClassCreated = true;
+            }
+        }
+
+        virtual void OnUObjectArrayShutdown() override
+        {
+            GUObjectArray.RemoveUObjectCreateListener(this);
+        }
+    };
+
+    static FClassCreateListener ClassCreateListener;
+#endif
+
+    struct FQueuedCommands
+    {
+        TArray<FPythonCommand> Commands;
+        TArray<FString> Results;
+        int32 NextCommand;
+        FOnPythonCommandsComplete OnComplete;
+    };
+
+    static TArray<FQueuedCommands> Queue;
+    static int32 NumQueuedCommands = 0;
+    static FDelegateHandle QueueTickHandle;
+}
+
+UPythonBridge::UPythonBridge()
+{
+    QueueBatchSize = 32;
+    QueueTimeSliceMs = 5.0f;
+}
 
 UPythonBridge* UPythonBridge::Get()
 {
+#if WITH_EDITOR
+    if (PythonBridge::bClassCreated.Exchange(false))
+    {
+        InvalidateCache();
+    }
+#endif
+
+    //A class Python redefines is replaced by a new one, and the old one is flagged
+    UPythonBridge* Bridge = PythonBridge::CachedBridge.Get();
+    if (Bridge && !Bridge->GetClass()->HasAnyClassFlags(CLASS_NewerVersionExists))
+    {
+        return Bridge;
+    }
+
     TArray<UClass*> PythonBridgeClasses;
     GetDerivedClasses(UPythonBridge::StaticClass(), PythonBridgeClasses);
     int32 NumClasses = PythonBridgeClasses.Num();
     if (NumClasses > 0)
     {
-        return Cast<UPythonBridge>(PythonBridgeClasses[NumClasses - 1]->GetDefaultObject());
+        Bridge = Cast<UPythonBridge>(PythonBridgeClasses[NumClasses - 1]->GetDefaultObject());
+        PythonBridge::CachedBridge = Bridge;
+        return Bridge;
     }
     return nullptr;
 };
 
-void FTestPythonPlugin::MenuCallback2() {
-    UPythonBridge* bridge = UPythonBridge::Get();
-    bridge->FunctionImplementedInPython();
+void UPythonBridge::InvalidateCache()
+{
+    PythonBridge::CachedBridge.Reset();
+}
+
+void UPythonBridge::OnReloadComplete(EReloadCompleteReason Reason)
+{
+    InvalidateCache();
 }
 
-/*
-#include "MyClass.h" 
+void UPythonBridge::OnModulesChanged(FName ModuleName, EModuleChangeReason Reason)
+{
+    //A loaded module may register classes derived from this one
+    InvalidateCache();
+}
 
-MyClass::MyClass()
+void UPythonBridge::Startup()
 {
+#if WITH_EDITOR
+    GUObjectArray.AddUObjectCreateListener(&PythonBridge::ClassCreateListener);
+#endif
 }
 
-MyClass::~MyClass()
+void UPythonBridge::Shutdown()
 {
+#if WITH_EDITOR
+    GUObjectArray.RemoveUObjectCreateListener(&PythonBridge::ClassCreateListener);
+#endif
+
+    if (PythonBridge::QueueTickHandle.IsValid())
+    {
+        FTicker::GetCoreTicker().RemoveTicker(PythonBridge::QueueTickHandle);
+        PythonBridge::QueueTickHandle.Reset();
+    }
+
+    PythonBridge::Queue.Empty();
+    PythonBridge::NumQueuedCommands = 0;
+    InvalidateCache();
+}
+
+TArray<FString> UPythonBridge::ExecuteBatch(const TArray<FPythonCommand>& Commands)
+{
+    TArray<FString> Results;
+    UPythonBridge* Bridge = Get();
+    if (Bridge && Commands.Num() > 0)
+    {
+        SCOPE_CYCLE_COUNTER(STAT_ThirdPersonMP_PythonBatch);
+        const double StartTime = FPlatformTime::Seconds();
+
+        Results = Bridge->RunCommands(Commands);
+
+        const double ElapsedMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+        INC_DWORD_STAT(STAT_ThirdPersonMP_PythonBatches);
+        INC_DWORD_STAT_BY(STAT_ThirdPersonMP_PythonCommands, Commands.Num());
+        UE_LOG(LogThirdPersonMP, Verbose, TEXT("Python batch of %d commands took %.2f ms (%.3f ms per command)"), Commands.Num(), ElapsedMs, ElapsedMs / Commands.Num());
+    }
+
+    Results.SetNum(Commands.Num());
+    return Results;
+}
+
+void UPythonBridge::QueueCommands(const TArray<FPythonCommand>& Commands, const FOnPythonCommandsComplete& OnComplete)
+{
+    PythonBridge::FQueuedCommands& Queued = PythonBridge::Queue.AddDefaulted_GetRef();
+    Queued.Commands = Commands;
+    Queued.Results.Reserve(Commands.Num());
+    Queued.NextCommand = 0;
+    Queued.OnComplete = OnComplete;
+
+    PythonBridge::NumQueuedCommands += Commands.Num();
+    SET_DWORD_STAT(STAT_ThirdPersonMP_PythonCommandsQueued, PythonBridge::NumQueuedCommands);
+
+    if (!PythonBridge::QueueTickHandle.IsValid())
+    {
+        PythonBridge::QueueTickHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&UPythonBridge::TickQueue));
+    }
+}
+
+int32 UPythonBridge::GetNumQueuedCommands()
+{
+    return PythonBridge::NumQueuedCommands;
+}
+
+bool UPythonBridge::TickQueue(float DeltaTime)
+{
+    const UPythonBridge* Settings = GetDefault<UPythonBridge>();
+    const int32 BatchSize = FMath::Max(Settings->QueueBatchSize, 1);
+    const double EndTime = FPlatformTime::Seconds() + Settings->QueueTimeSliceMs / 1000.0;
+
+    do
+    {
+        //Python can queue more commands while it runs, which may move the queue, so the batch is taken out of it first
+        //and nothing refers into the queue across the call
+        TArray<FPythonCommand> Batch;
+        {
+            PythonBridge::FQueuedCommands& Queued = PythonBridge::Queue[0];
+            const int32 NumCommands = FMath::Min(BatchSize, Queued.Commands.Num() - Queued.NextCommand);
+            Batch.Reserve(NumCommands);
+            for (int32 Index = 0; Index < NumCommands; ++Index)
+            {
+                Batch.Add(MoveTemp(Queued.Commands[Queued.NextCommand + Index]));
+            }
+            Queued.NextCommand += NumCommands;
+            PythonBridge::NumQueuedCommands -= NumCommands;
+        }
+
+        TArray<FString> BatchResults = ExecuteBatch(Batch);
+        if (PythonBridge::Queue.Num() == 0)
+        {
+            break;
+        }
+
+        PythonBridge::FQueuedCommands& Queued = PythonBridge::Queue[0];
+        Queued.Results.Append(MoveTemp(BatchResults));
+
+        if (Queued.NextCommand >= Queued.Commands.Num())
+        {
+            //Taken off the queue first, since the callback may queue more work
+            PythonBridge::FQueuedCommands Completed = MoveTemp(Queued);
+            PythonBridge::Queue.RemoveAt(0);
+            Completed.OnComplete.ExecuteIfBound(Completed.Results);
+        }
+    }
+    while (PythonBridge::Queue.Num() > 0 && FPlatformTime::Seconds() < EndTime);
+
+    SET_DWORD_STAT(STAT_ThirdPersonMP_PythonCommandsQueued, PythonBridge::NumQueuedCommands);
+
+    if (PythonBridge::Queue.Num() == 0)
+    {
+        PythonBridge::QueueTickHandle.Reset();
+        return false;
+    }
+    return true;
 }
-*/
@@ -8,24 +8,83 @@
 #include "Engine.h"
 #include "PythonBridge.generated.h"
 
-UCLASS(Blueprintable)
+/** One command for the Python side: a command name and a payload it interprets, usually JSON. */
+USTRUCT(BlueprintType)
+struct FPythonCommand
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadWrite, Category = Python)
+        FString Command;
+
+    UPROPERTY(BlueprintReadWrite, Category = Python)
+        FString Payload;
+};
+
+DECLARE_DYNAMIC_DELEGATE_OneParam(FOnPythonCommandsComplete, const TArray<FString>&, Results);
+
+/**
+ * Bridge to editor Python. Python defines a subclass and overrides its events; C++ reaches that subclass through Get().
+ * The lookup is cached, and dropped on hot reload, on module loads, and in the editor whenever a new class is created,
+ * which covers Python defining or redefining a subclass; InvalidateCache drops it by hand. Commands go over in batches so a loop
+ * over many assets crosses into Python once, either at once through ExecuteBatch or spread over frames through
+ * QueueCommands.
+ */
+UCLASS(Blueprintable, config=Game)
 class UPythonBridge : public UObject
 {
     GENERATED_BODY()
 
 public:
+    UPythonBridge();
+
     UFUNCTION(BlueprintCallable, Category = Python)
         static UPythonBridge* Get();
 
+    /** Forgets the cached bridge, so the next Get looks up the most derived class again. */
+    UFUNCTION(BlueprintCallable, Category = Python)
+        static void InvalidateCache();
+
     UFUNCTION(BlueprintImplementableEvent, Category = Python)
         void FunctionImplementedInPython() const;
-};
 
-/**
- * 
-class THIRDPERSONMP_API MyClass
-{
-public:
-	MyClass();
-	~MyClass();
+    /** Implemented in Python. Runs every command in order and returns one result per command. */
+    UFUNCTION(BlueprintImplementableEvent, Category = Python)
+        TArray<FString> RunCommands(const TArray<FPythonCommand>& Commands) const;
+
+    /** Runs Commands in one call into Python and returns one result per command, empty where Python gave none. */
+    UFUNCTION(BlueprintCallable, Category = Python)
+        static TArray<FString> ExecuteBatch(const TArray<FPythonCommand>& Commands);
+
+    /**
+     * Queues Commands to run QueueBatchSize at a time, for no more than QueueTimeSliceMs each frame, and calls OnComplete
+     * with every result once the last one has run. Queued work runs in the order it was queued.
+     */
+    UFUNCTION(BlueprintCallable, Category = Python)
+        static void QueueCommands(const TArray<FPythonCommand>& Commands, const FOnPythonCommandsComplete& OnComplete);
+
+    /** Returns the number of queued commands that have not run yet. */
+    UFUNCTION(BlueprintPure, Category = Python)
+        static int32 GetNumQueuedCommands();
+
+    static void OnReloadComplete(EReloadCompleteReason Reason);
+    static void OnModulesChanged(FName ModuleName, EModuleChangeReason Reason);
+
+    /** Starts watching for new classes in the editor, where Python can define them. Called by the module on startup. */
+    static void Startup();
+
+    /** Stops running the queue, dropping whatever is left in it, and stops watching for new classes. Called by the module on shutdown. */
+    static void Shutdown();
+
+    /** Commands sent to Python per call when running the queue. */
+    UPROPERTY(Config, EditAnywhere, Category = Python)
+        int32 QueueBatchSize;
+
+    /** Milliseconds a frame may spend running queued commands. At least one batch runs every frame. */
+    UPROPERTY(Config, EditAnywhere, Category = Python)
+        float QueueTimeSliceMs;
+
+private:
+    /** Runs queued batches until the frame's time slice is spent. Returns false once the queue is empty. */
+    static bool TickQueue(float DeltaTime);
 };
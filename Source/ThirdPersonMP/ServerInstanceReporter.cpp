@@ -0,0 +1,135 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "ServerInstanceReporter.h"
+#include "ThirdPersonMP.h"
+#include "Common/UdpSocketBuilder.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/GameSession.h"
+#include "IPAddress.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "TimerManager.h"
+
+AServerInstanceReporter::AServerInstanceReporter()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+	bReplicates = false;
+
+	ReportInterval = 1.0f;
+
+	Socket = nullptr;
+	FrameMsSum = 0.0;
+	FrameMsMax = 0.0f;
+	NumFrames = 0;
+}
+
+bool AServerInstanceReporter::GetRouterAddress(FString& OutAddress)
+{
+	return FParse::Value(FCommandLine::Get(), TEXT("SessionRouter="), OutAddress) && !OutAddress.IsEmpty();
+}
+
+void AServerInstanceReporter::BeginPlay()
+{
+	Super::BeginPlay();
+
+	FString Address;
+	if (!GetRouterAddress(Address))
+	{
+		return;
+	}
+
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	FString Host;
+	FString PortString;
+	bool bIsValid = false;
+	if (Address.Split(TEXT(":"), &Host, &PortString))
+	{
+		RouterAddr = SocketSubsystem->CreateInternetAddr();
+		RouterAddr->SetIp(*Host, bIsValid);
+		RouterAddr->SetPort(FCString::Atoi(*PortString));
+	}
+
+	if (!bIsValid)
+	{
+		UE_LOG(LogThirdPersonMP, Error, TEXT("Session router: %s is not an ip:port address."), *Address);
+		RouterAddr.Reset();
+		return;
+	}
+
+	Socket = FUdpSocketBuilder(TEXT("SessionRouterReports")).AsNonBlocking().Build();
+	if (Socket == nullptr)
+	{
+		UE_LOG(LogThirdPersonMP, Error, TEXT("Session router: could not create a UDP socket."));
+		return;
+	}
+
+	if (!FParse::Value(FCommandLine::Get(), TEXT("InstanceId="), InstanceId))
+	{
+		InstanceId = FString::FromInt(GetWorld()->URL.Port);
+	}
+
+	//Room for a report's worth of frames at well above the server's tick rate, so Tick never allocates.
+	FrameMsSamples.Reserve(FMath::CeilToInt(ReportInterval * 240.0f));
+
+	SetActorTickEnabled(true);
+	GetWorldTimerManager().SetTimer(ReportTimer, FTimerDelegate::CreateUObject(this, &AServerInstanceReporter::SendReport, false), ReportInterval, true);
+
+	UE_LOG(LogThirdPersonMP, Log, TEXT("Session router: reporting as instance %s to %s."), *InstanceId, *Address);
+}
+
+void AServerInstanceReporter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (Socket)
+	{
+		SendReport(true);
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+		Socket = nullptr;
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AServerInstanceReporter::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	//Game thread work for the last frame, without the wait for the server's tick rate
+	const float FrameMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+	FrameMsSamples.Add(FrameMs);
+	FrameMsSum += FrameMs;
+	FrameMsMax = FMath::Max(FrameMsMax, FrameMs);
+	++NumFrames;
+}
+
+void AServerInstanceReporter::SendReport(bool bStopping)
+{
+	AGameModeBase* GameMode = GetWorld()->GetAuthGameMode();
+	const int32 NumPlayers = GameMode ? GameMode->GetNumPlayers() : 0;
+	const int32 MaxPlayers = (GameMode && GameMode->GameSession) ? GameMode->GameSession->MaxPlayers : 0;
+	const float FrameMsMean = NumFrames > 0 ? (float)(FrameMsSum / NumFrames) : 0.0f;
+
+	//The percentile of the interval's own frames; a percentile of per-interval means would hide every spike.
+	float FrameMsP99 = 0.0f;
+	if (FrameMsSamples.Num() > 0)
+	{
+		FrameMsSamples.Sort();
+		FrameMsP99 = FrameMsSamples[FMath::Min(FrameMsSamples.Num() * 99 / 100, FrameMsSamples.Num() - 1)];
+	}
+
+	const FString Report = FString::Printf(TEXT("{\"instance\":\"%s\",\"port\":%d,\"players\":%d,\"maxPlayers\":%d,\"frameMs\":%.3f,\"frameMsP99\":%.3f,\"frameMsMax\":%.3f,\"stopping\":%s}"),
+		*InstanceId.ReplaceCharWithEscapedChar(), GetWorld()->URL.Port, NumPlayers, MaxPlayers, FrameMsMean, FrameMsP99, FrameMsMax, bStopping ? TEXT("true") : TEXT("false"));
+
+	const FTCHARToUTF8 Utf8Report(*Report);
+	int32 BytesSent = 0;
+	Socket->SendTo((const uint8*)Utf8Report.Get(), Utf8Report.Length(), BytesSent, *RouterAddr);
+
+	FrameMsSamples.Reset();
+	FrameMsSum = 0.0;
+	FrameMsMax = 0.0f;
+	NumFrames = 0;
+}
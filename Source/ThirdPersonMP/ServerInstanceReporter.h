@@ -0,0 +1,54 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "ServerInstanceReporter.generated.h"
+
+class FSocket;
+class FInternetAddr;
+
+/**
+ * Reports this server's load to a local session router. Every ReportInterval, sends one UDP datagram to the address
+ * given with -SessionRouter=<ip:port>, holding a JSON object with the instance id (-InstanceId=, or the port), the
+ * port clients should connect to, the player count and limit, and the mean, 99th percentile and worst game thread
+ * milliseconds over the interval. Sends a last report with "stopping" set when the match ends. Spawned by AThirdPersonMPGameMode on servers
+ * started with -SessionRouter. Scripts/ServerHost.py runs the instances and Scripts/SessionRouter.py the router.
+ */
+UCLASS(config=Game, notplaceable)
+class THIRDPERSONMP_API AServerInstanceReporter : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AServerInstanceReporter();
+
+	/** Returns true and the router's address if this server was started with -SessionRouter=<ip:port>. */
+	static bool GetRouterAddress(FString& OutAddress);
+
+	/** Seconds between reports. */
+	UPROPERTY(Config, EditAnywhere, Category = "Hosting")
+	float ReportInterval;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+
+private:
+	/** Sends one report with the frame times gathered since the last, and clears them. */
+	void SendReport(bool bStopping);
+
+	FSocket* Socket;
+	TSharedPtr<FInternetAddr> RouterAddr;
+	FString InstanceId;
+
+	/** Game thread milliseconds of every frame since the last report. */
+	TArray<float> FrameMsSamples;
+	double FrameMsSum;
+	float FrameMsMax;
+	int32 NumFrames;
+
+	FTimerHandle ReportTimer;
+};
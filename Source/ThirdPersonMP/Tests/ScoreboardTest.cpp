@@ -0,0 +1,59 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#include "EmbedGameStateBase.h"
+#include "EmbedPlayerState.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FScoreboardTwoPlayersTest, "ThirdPersonMP.Scoreboard.TwoPlayers", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FScoreboardTwoPlayersTest::RunTest(const FString& Parameters)
+{
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	AEmbedGameStateBase* GameState = World->SpawnActor<AEmbedGameStateBase>();
+	World->SetGameState(GameState);
+
+	//As at login, each player state adds itself to the game state while spawning, and only then gets its id and name
+	AEmbedPlayerState* PlayerStates[2];
+	for (int32 Index = 0; Index < 2; ++Index)
+	{
+		PlayerStates[Index] = World->SpawnActor<AEmbedPlayerState>();
+		PlayerStates[Index]->SetPlayerId(256 + Index);
+		PlayerStates[Index]->SetPlayerName(FString::Printf(TEXT("Player%d"), Index));
+	}
+
+	GameState->UpdateScoreboard();
+
+	const TArray<FScoreboardRow>& Rows = GameState->GetScoreboard();
+	if (TestEqual(TEXT("Rows after two players join"), Rows.Num(), 2))
+	{
+		for (int32 Index = 0; Index < 2; ++Index)
+		{
+			TestEqual(TEXT("Row player id"), Rows[Index].PlayerId, 256 + Index);
+			TestEqual(TEXT("Row player name"), Rows[Index].PlayerName, FString::Printf(TEXT("Player%d"), Index));
+		}
+
+		PlayerStates[1]->AddKill();
+		GameState->UpdateScoreboard();
+		TestEqual(TEXT("Kills of the player who scored"), Rows[1].Stats.Kills, 1);
+		TestEqual(TEXT("Kills of the other player"), Rows[0].Stats.Kills, 0);
+	}
+
+	World->DestroyActor(PlayerStates[0]);
+	if (TestEqual(TEXT("Rows after the first player leaves"), Rows.Num(), 1))
+	{
+		TestEqual(TEXT("Remaining row player id"), Rows[0].PlayerId, 257);
+	}
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	return true;
+}
+
+#endif
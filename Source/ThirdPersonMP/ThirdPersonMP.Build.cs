@@ -8,6 +8,9 @@ public class ThirdPersonMP : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay", "ReplicationGraph", "NetCore", "Sockets", "Networking" });
+
+		// Loaded by name when a replay is recorded or played, so it has to be listed for packaging.
+		DynamicallyLoadedModuleNames.Add("LocalFileNetworkReplayStreaming");
 	}
 }
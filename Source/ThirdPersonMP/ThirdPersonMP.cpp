@@ -1,7 +1,101 @@
 // Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
 
 #include "ThirdPersonMP.h"
+#include "CosmeticAssetLoader.h"
+#include "MatchReplay.h"
+#include "PythonBridge.h"
+#include "Engine/DemoNetDriver.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CoreDelegates.h"
 #include "Modules/ModuleManager.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, ThirdPersonMP, "ThirdPersonMP" );
- 
\ No newline at end of file
+DEFINE_LOG_CATEGORY(LogThirdPersonMP);
+
+DEFINE_STAT(STAT_ThirdPersonMP_HandleFire);
+DEFINE_STAT(STAT_ThirdPersonMP_ServerFireCommands);
+DEFINE_STAT(STAT_ThirdPersonMP_OnProjectileImpact);
+DEFINE_STAT(STAT_ThirdPersonMP_ProjectileDestroyed);
+DEFINE_STAT(STAT_ThirdPersonMP_TakeDamage);
+DEFINE_STAT(STAT_ThirdPersonMP_SetCurrentHealth);
+DEFINE_STAT(STAT_ThirdPersonMP_OnHealthUpdate);
+
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Projectiles Spawned/sec"), STAT_ThirdPersonMP_ProjectilesSpawnedPerSec, STATGROUP_ThirdPersonMP);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Projectile Impacts/sec"), STAT_ThirdPersonMP_ProjectileImpactsPerSec, STATGROUP_ThirdPersonMP);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Damage Events/sec"), STAT_ThirdPersonMP_DamageEventsPerSec, STATGROUP_ThirdPersonMP);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("RPCs Received/sec"), STAT_ThirdPersonMP_RpcsReceivedPerSec, STATGROUP_ThirdPersonMP);
+
+CSV_DEFINE_CATEGORY(ThirdPersonMP, true);
+
+int32 GThirdPersonMPParallelCharacterWork = 0;
+static FAutoConsoleVariableRef CVarThirdPersonMPParallelCharacterWork(
+	TEXT("ThirdPersonMP.ParallelCharacterWork"),
+	GThirdPersonMPParallelCharacterWork,
+	TEXT("If nonzero, lag compensation capture, health resolution and significance scoring run in parallel on worker threads. Compare with ThirdPersonMP.ParallelCharacterWork.Benchmark."),
+	ECVF_Default);
+
+int32 FThirdPersonMPModule::EventCounts[(int32)EThirdPersonMPEvent::Num] = {};
+
+void FThirdPersonMPModule::StartupModule()
+{
+	FDefaultGameModuleImpl::StartupModule();
+
+	FMemory::Memzero(EventRates);
+	TimeSinceRateUpdate = 0.0f;
+
+	TickHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FThirdPersonMPModule::Tick));
+	PostEngineInitHandle = FCoreDelegates::OnPostEngineInit.AddRaw(this, &FThirdPersonMPModule::OnPostEngineInit);
+	ReplayStartedHandle = FNetworkReplayDelegates::OnReplayStarted.AddStatic(&UMatchReplay::OnReplayStarted);
+	ReloadCompleteHandle = FCoreUObjectDelegates::ReloadCompleteDelegate.AddStatic(&UPythonBridge::OnReloadComplete);
+	ModulesChangedHandle = FModuleManager::Get().OnModulesChanged().AddStatic(&UPythonBridge::OnModulesChanged);
+	UPythonBridge::Startup();
+}
+
+void FThirdPersonMPModule::ShutdownModule()
+{
+	FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+	FCoreDelegates::OnPostEngineInit.Remove(PostEngineInitHandle);
+	FNetworkReplayDelegates::OnReplayStarted.Remove(ReplayStartedHandle);
+	FCoreUObjectDelegates::ReloadCompleteDelegate.Remove(ReloadCompleteHandle);
+	FModuleManager::Get().OnModulesChanged().Remove(ModulesChangedHandle);
+	UPythonBridge::Shutdown();
+	CosmeticPreloadHandle.Reset();
+
+	FDefaultGameModuleImpl::ShutdownModule();
+}
+
+void FThirdPersonMPModule::OnPostEngineInit()
+{
+	UCosmeticAssetLoader::LogStartupMilestone(TEXT("Engine initialized"));
+
+	//Cosmetic content is no longer hard-referenced by class defaults, so start loading it now, while the first map loads.
+	CosmeticPreloadHandle = UCosmeticAssetLoader::StartPreload();
+}
+
+bool FThirdPersonMPModule::Tick(float DeltaTime)
+{
+	TimeSinceRateUpdate += DeltaTime;
+	if (TimeSinceRateUpdate >= 1.0f)
+	{
+		for (int32 Index = 0; Index < (int32)EThirdPersonMPEvent::Num; ++Index)
+		{
+			EventRates[Index] = EventCounts[Index] / TimeSinceRateUpdate;
+			EventCounts[Index] = 0;
+		}
+		TimeSinceRateUpdate = 0.0f;
+
+		SET_FLOAT_STAT(STAT_ThirdPersonMP_ProjectilesSpawnedPerSec, EventRates[(int32)EThirdPersonMPEvent::ProjectileSpawned]);
+		SET_FLOAT_STAT(STAT_ThirdPersonMP_ProjectileImpactsPerSec, EventRates[(int32)EThirdPersonMPEvent::ProjectileImpact]);
+		SET_FLOAT_STAT(STAT_ThirdPersonMP_DamageEventsPerSec, EventRates[(int32)EThirdPersonMPEvent::DamageEvent]);
+		SET_FLOAT_STAT(STAT_ThirdPersonMP_RpcsReceivedPerSec, EventRates[(int32)EThirdPersonMPEvent::RpcReceived]);
+	}
+
+	//CSV rows are per frame, so repeat the last rates every frame to keep the columns continuous.
+	CSV_CUSTOM_STAT(ThirdPersonMP, ProjectilesSpawnedPerSec, EventRates[(int32)EThirdPersonMPEvent::ProjectileSpawned], ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ThirdPersonMP, ProjectileImpactsPerSec, EventRates[(int32)EThirdPersonMPEvent::ProjectileImpact], ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ThirdPersonMP, DamageEventsPerSec, EventRates[(int32)EThirdPersonMPEvent::DamageEvent], ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ThirdPersonMP, RpcsReceivedPerSec, EventRates[(int32)EThirdPersonMPEvent::RpcReceived], ECsvCustomStatOp::Set);
+
+	return true;
+}
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FThirdPersonMPModule, ThirdPersonMP, "ThirdPersonMP" );
@@ -3,3 +3,92 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "Modules/ModuleManager.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Stats/Stats.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogThirdPersonMP, Log, All);
+
+DECLARE_STATS_GROUP(TEXT("ThirdPersonMP"), STATGROUP_ThirdPersonMP, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("HandleFire"), STAT_ThirdPersonMP_HandleFire, STATGROUP_ThirdPersonMP, THIRDPERSONMP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ServerFireCommands"), STAT_ThirdPersonMP_ServerFireCommands, STATGROUP_ThirdPersonMP, THIRDPERSONMP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("OnProjectileImpact"), STAT_ThirdPersonMP_OnProjectileImpact, STATGROUP_ThirdPersonMP, THIRDPERSONMP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ProjectileDestroyed"), STAT_ThirdPersonMP_ProjectileDestroyed, STATGROUP_ThirdPersonMP, THIRDPERSONMP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("TakeDamage"), STAT_ThirdPersonMP_TakeDamage, STATGROUP_ThirdPersonMP, THIRDPERSONMP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("SetCurrentHealth"), STAT_ThirdPersonMP_SetCurrentHealth, STATGROUP_ThirdPersonMP, THIRDPERSONMP_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("OnHealthUpdate"), STAT_ThirdPersonMP_OnHealthUpdate, STATGROUP_ThirdPersonMP, THIRDPERSONMP_API);
+
+CSV_DECLARE_CATEGORY_EXTERN(ThirdPersonMP);
+
+/**
+ * ThirdPersonMP.ParallelCharacterWork. When nonzero, the server's per-character work that only reads gameplay state
+ * (lag compensation capture, resolving each character's health from its queued damage, and significance scoring) is
+ * spread over task graph worker threads. Anything that writes gameplay state is applied on the game thread afterwards.
+ * Every batch is joined before its manager's tick returns, so it is complete before the frame's replication.
+ */
+extern THIRDPERSONMP_API int32 GThirdPersonMPParallelCharacterWork;
+
+/**
+ * Times the enclosing scope as STAT_ThirdPersonMP_<Name> under stat ThirdPersonMP, as <Name> in the ThirdPersonMP
+ * CSV profiler category (-csvprofile), and as a ThirdPersonMP_<Name> CPU event in Unreal Insights (-trace=cpu).
+ */
+#define THIRDPERSONMP_SCOPE(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_ThirdPersonMP_##Name); \
+	CSV_SCOPED_TIMING_STAT(ThirdPersonMP, Name); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(ThirdPersonMP_##Name)
+
+struct FStreamableHandle;
+
+/** Gameplay events counted by the module and reported as per-second rates. */
+enum class EThirdPersonMPEvent : uint8
+{
+	ProjectileSpawned,
+	ProjectileImpact,
+	DamageEvent,
+	RpcReceived,
+
+	Num
+};
+
+/**
+ * Game module. Turns the gameplay event counts into per-second rates once a second, and reports them under
+ * stat ThirdPersonMP and as custom stats in the ThirdPersonMP CSV profiler category. Also starts the background
+ * preload of cosmetic assets once the engine has initialized, hands replays to UMatchReplay as they start playing, and
+ * tells UPythonBridge when hot reloads or module loads may have added classes.
+ */
+class FThirdPersonMPModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void StartupModule() override;
+	virtual void ShutdownModule() override;
+
+	/** Counts Count occurrences of Event this second. Game thread only. */
+	static FORCEINLINE void CountEvent(EThirdPersonMPEvent Event, int32 Count = 1)
+	{
+		EventCounts[(int32)Event] += Count;
+	}
+
+private:
+	bool Tick(float DeltaTime);
+	void OnPostEngineInit();
+
+	static int32 EventCounts[(int32)EThirdPersonMPEvent::Num];
+
+	/** Rates computed at the end of the last full second, and the time accumulated towards the next one. */
+	float EventRates[(int32)EThirdPersonMPEvent::Num];
+	float TimeSinceRateUpdate;
+
+	FDelegateHandle TickHandle;
+	FDelegateHandle PostEngineInitHandle;
+	FDelegateHandle ReplayStartedHandle;
+
+	/** Drop UPythonBridge's cached lookup when classes may have changed. */
+	FDelegateHandle ReloadCompleteHandle;
+	FDelegateHandle ModulesChangedHandle;
+
+	/** Keeps the preloaded cosmetic assets in memory. */
+	TSharedPtr<FStreamableHandle> CosmeticPreloadHandle;
+};
@@ -1,26 +1,40 @@
 // Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
 
 #include "ThirdPersonMPCharacter.h"
+#include "ThirdPersonMP.h"
 #include "HeadMountedDisplayFunctionLibrary.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/InputComponent.h"
-#include "GameFramework/CharacterMovementComponent.h"
+#include "ThirdPersonMPMovementComponent.h"
 #include "GameFramework/Controller.h"
+#include "GameFramework/GameStateBase.h"
 #include "GameFramework/SpringArmComponent.h"
 
 //These provide required functionality for variable replication as well as access to the AddOnscreenDebugMessage function in GEngine, which we will use to output messages to the screen.
 #include "Net/UnrealNetwork.h"
+#include "Net/Core/PushModel/PushModel.h"
 #include "Engine/Engine.h"
 
 //This will enable our Character class to recognize the projectile's type and spawn it.
 #include "ThirdPersonMPProjectile.h"
+#include "ThirdPersonMPGameMode.h"
+#include "ProjectilePool.h"
+#include "ProjectileSimulationManager.h"
+#include "LagCompensationManager.h"
+#include "GameplaySignificanceManager.h"
+#include "LoadTestBotComponent.h"
+#include "DamageManager.h"
+#include "EmbedPlayerState.h"
+#include "MatchTelemetryRecorder.h"
+#include "EmbedGameStateBase.h"
 
 
 //////////////////////////////////////////////////////////////////////////
 // AThirdPersonMPCharacter
 
-AThirdPersonMPCharacter::AThirdPersonMPCharacter()
+AThirdPersonMPCharacter::AThirdPersonMPCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UThirdPersonMPMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
 	// Set size for collision capsule
 	GetCapsuleComponent()->InitCapsuleSize(42.f, 96.0f);
@@ -57,6 +71,7 @@ AThirdPersonMPCharacter::AThirdPersonMPCharacter()
 	//Initialize the player's Health. Any time a new copy of this Character is created, its current health will be set to its maximum health value.
 	MaxHealth = 100.0f;
 	CurrentHealth = MaxHealth;
+	LastDamageTakenTime = -FLT_MAX;
 
 	//These will initialize the variables necessary to handle firing the projectile.
 	//Initialize projectile class
@@ -64,6 +79,66 @@ AThirdPersonMPCharacter::AThirdPersonMPCharacter()
 	//Initialize fire rate
 	FireRate = 0.25f;
 	bIsFiringWeapon = false;
+
+	//Initialize the unreliable fire command channel
+	FireBurstSize = 2.0f;
+	FireCommandRedundancy = 3;
+	MaxFireOriginError = 200.0f;
+	NextFireSequence = 0;
+	LastFireSequence = 0;
+	FireSequenceMask = 0;
+	bHasFireSequence = false;
+	FireTokens = FireBurstSize;
+	LastFireTokenTime = 0.0f;
+
+	//Initialize client-side projectile prediction
+	bPredictProjectiles = true;
+	PredictedShotTimeout = 1.0f;
+}
+
+void AThirdPersonMPCharacter::BeginPlay()
+{
+	Super::BeginPlay();
+
+	//The server keeps a short history of every character's capsule so shots can be judged at the shooter's time.
+	AThirdPersonMPGameMode* GameMode = GetWorld()->GetAuthGameMode<AThirdPersonMPGameMode>();
+	if (ALagCompensationManager* LagCompensation = GameMode ? GameMode->GetLagCompensationManager() : nullptr)
+	{
+		LagCompensation->RegisterCharacter(this);
+	}
+
+	//Characters far from every player tick, animate and replicate less often.
+	if (AGameplaySignificanceManager* SignificanceManager = GameMode ? GameMode->GetSignificanceManager() : nullptr)
+	{
+		SignificanceManager->RegisterActor(this);
+	}
+}
+
+void AThirdPersonMPCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	AThirdPersonMPGameMode* GameMode = GetWorld()->GetAuthGameMode<AThirdPersonMPGameMode>();
+	if (ALagCompensationManager* LagCompensation = GameMode ? GameMode->GetLagCompensationManager() : nullptr)
+	{
+		LagCompensation->UnregisterCharacter(this);
+	}
+
+	if (AGameplaySignificanceManager* SignificanceManager = GameMode ? GameMode->GetSignificanceManager() : nullptr)
+	{
+		SignificanceManager->UnregisterActor(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AThirdPersonMPCharacter::PawnClientRestart()
+{
+	Super::PawnClientRestart();
+
+	if (ULoadTestBotComponent::IsLoadTestBot() && FindComponentByClass<ULoadTestBotComponent>() == nullptr)
+	{
+		ULoadTestBotComponent* Bot = NewObject<ULoadTestBotComponent>(this, TEXT("LoadTestBot"));
+		Bot->RegisterComponent();
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -160,22 +235,26 @@ void AThirdPersonMPCharacter::MoveRight(float Value)
 // Replicated Properties
 
 
-//The GetLifetimeReplicatedProps function is responsible for replicating any properties we designate with the Replicated specifier, and enables us to configure how a property will replicate. Here we are using the most basic implementation for CurrentHealth. If at any time you add more properties that need to be replicated, you must add them to this function as well.
+//The GetLifetimeReplicatedProps function is responsible for replicating any properties we designate with the Replicated specifier, and enables us to configure how a property will replicate. If at any time you add more properties that need to be replicated, you must add them to this function as well.
+//CurrentHealth is push based: the net driver skips comparing it against its shadow copy on every net update, and only sends it after SetCurrentHealth marks it dirty. Any new push-based property must be marked dirty wherever it is written, or clients will never see the change.
 
 //You must call the Super version of GetLifetimeReplicatedProps, or inherited properties from your Actor's parent class will not replicate, even if the parent class designates them as being replicated.
 void AThirdPersonMPCharacter::GetLifetimeReplicatedProps(TArray <FLifetimeProperty>& OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
-	DOREPLIFETIME(AThirdPersonMPCharacter, CurrentHealth);
+
+	FDoRepLifetimeParams PushParams;
+	PushParams.bIsPushBased = true;
+	DOREPLIFETIME_WITH_PARAMS_FAST(AThirdPersonMPCharacter, CurrentHealth, PushParams);
 }
 
 
-//StartFire is the function that players call on their local machine in order to initiate the firing process, and it restricts how often the user is allowed to call HandleFire based on the following criteria :
+//StartFire is the function that players call on their local machine in order to initiate the firing process, and it restricts how often the user is allowed to fire based on the following criteria :
 //The user cannot fire a projectile if they are already in the middle of firing.This is designated with bFiringWeapon, which is set to true when StartFire is called.
 //bFiringWeapon is only set to false when StopFire is called.
 //StopFire is called when a timer with a length of FireRate finishes.
-//This means that when the user fires a projectile, they must wait a number of seconds equal to FireRate before they can fire again.This will function consistently regarldess of what kind of input StartFire is bound to.For example, if the user binds the "Fire" command to a scroll wheel or similarly inappropriate input, or if they mash the button repeatedly, this function will still execute at an acceptable interval of time and not overflow the user's queue for reliable functions with calls to HandleFire.
-//Because HandleFire is a Server RPC, its implementation in the CPP file must have the suffix _Implementation added to the function name.Our implementation here uses the Character's Control Rotation to get the direction that the camera is facing, then spawn the projectile facing in that direction, enabling the player to aim. The projectile's Projectile Movement Component then handles moving it in that direction.
+//This means that when the user fires a projectile, they must wait a number of seconds equal to FireRate before they can fire again.This will function consistently regarldess of what kind of input StartFire is bound to. The server does not rely on this, though: it enforces the same rate with its own token bucket in ConsumeFireToken.
+//Each shot becomes an FFireCommand carrying a sequence number, the estimated server time, and the origin and aim taken from the Character's Control Rotation. On the server (a listen server host or standalone game) it is handled immediately. On a client it is queued and sent by FlushFireCommands at the end of the Character's Tick, together with any other shots from the same frame and resends of recent ones. The client also spawns a predicted projectile straight away, which the server's projectile replaces when it arrives carrying the same sequence as its ShotId.
 
 void AThirdPersonMPCharacter::StartFire()
 {
@@ -184,7 +263,23 @@ void AThirdPersonMPCharacter::StartFire()
 		bIsFiringWeapon = true;
 		UWorld* World = GetWorld();
 		World->GetTimerManager().SetTimer(FiringTimer, this, &AThirdPersonMPCharacter::StopFire, FireRate, false);
-		HandleFire();
+
+		FFireCommand Command;
+		Command.Sequence = NextFireSequence++;
+		Command.Timestamp = GetServerWorldTime();
+		Command.Origin = GetMuzzleLocation();
+		Command.Aim = GetControlRotation().Vector();
+
+		if (HasAuthority())
+		{
+			HandleFire(Command);
+		}
+		else
+		{
+			SpawnPredictedProjectile(Command);
+			PendingFireCommands.Add(Command);
+			PendingFireCommandSends.Add((uint8)FMath::Clamp(FireCommandRedundancy, 1, 255));
+		}
 	}
 }
 
@@ -193,21 +288,261 @@ void AThirdPersonMPCharacter::StopFire()
 	bIsFiringWeapon = false;
 }
 
-void AThirdPersonMPCharacter::HandleFire_Implementation()
+void AThirdPersonMPCharacter::Tick(float DeltaSeconds)
 {
-	FVector spawnLocation = GetActorLocation() + (GetControlRotation().Vector() * 100.0f) + (GetActorUpVector() * 50.0f);
-	FRotator spawnRotation = GetControlRotation();
+	Super::Tick(DeltaSeconds);
 
-	FActorSpawnParameters spawnParameters;
-	spawnParameters.Instigator = Instigator;
-	spawnParameters.Owner = this;
+	if (PendingFireCommands.Num() > 0 && IsLocallyControlled() && !HasAuthority())
+	{
+		FlushFireCommands();
+	}
+}
+
+void AThirdPersonMPCharacter::FlushFireCommands()
+{
+	FireCommandBatch.Reset();
+
+	//Oldest first, so the server sees sequences in order when nothing was lost.
+	for (int32 Index = 0; Index < PendingFireCommands.Num(); ++Index)
+	{
+		FireCommandBatch.Add(PendingFireCommands[Index]);
+		--PendingFireCommandSends[Index];
+	}
 
-	AThirdPersonMPProjectile* spawnedProjectile = GetWorld()->SpawnActor<AThirdPersonMPProjectile>(spawnLocation, spawnRotation, spawnParameters);
+	for (int32 Index = PendingFireCommands.Num() - 1; Index >= 0; --Index)
+	{
+		if (PendingFireCommandSends[Index] == 0)
+		{
+			PendingFireCommands.RemoveAt(Index, 1, false);
+			PendingFireCommandSends.RemoveAt(Index, 1, false);
+		}
+	}
+
+	ServerFireCommands(FireCommandBatch);
+}
+
+void AThirdPersonMPCharacter::ServerFireCommands_Implementation(const TArray<FFireCommand>& Commands)
+{
+	THIRDPERSONMP_SCOPE(ServerFireCommands);
+	FThirdPersonMPModule::CountEvent(EThirdPersonMPEvent::RpcReceived);
+
+	//A well-behaved client never has more than a few shots in flight per batch, so ignore anything past that.
+	const int32 MaxCommandsPerBatch = 16;
+	const int32 NumCommands = FMath::Min(Commands.Num(), MaxCommandsPerBatch);
+
+	for (int32 Index = 0; Index < NumCommands; ++Index)
+	{
+		const FFireCommand& Command = Commands[Index];
+		if (!AcceptFireSequence(Command.Sequence))
+		{
+			continue;
+		}
+
+		if (ConsumeFireToken())
+		{
+			HandleFire(Command);
+		}
+		else
+		{
+			ClientRejectFire(Command.Sequence);
+		}
+	}
+}
+
+void AThirdPersonMPCharacter::ClientRejectFire_Implementation(uint16 Sequence)
+{
+	TWeakObjectPtr<AThirdPersonMPProjectile> Predicted;
+	if (PredictedProjectiles.RemoveAndCopyValue(Sequence, Predicted) && Predicted.IsValid())
+	{
+		Predicted->CancelPrediction();
+	}
+}
+
+void AThirdPersonMPCharacter::SpawnPredictedProjectile(const FFireCommand& Command)
+{
+	//The batched simulation draws its own projectiles from replicated events, so there is nothing for a prediction to hand off to.
+	const AEmbedGameStateBase* GameState = GetWorld()->GetGameState<AEmbedGameStateBase>();
+	if (!bPredictProjectiles || (GameState && GameState->GetProjectileSimulationManager()))
+	{
+		return;
+	}
+
+	//Forget predictions that timed out or were removed.
+	for (auto It = PredictedProjectiles.CreateIterator(); It; ++It)
+	{
+		if (!It.Value().IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	UClass* Class = ProjectileClass ? *ProjectileClass : AThirdPersonMPProjectile::StaticClass();
+	const FTransform SpawnTransform(Command.Aim.Rotation(), Command.Origin);
+
+	AThirdPersonMPProjectile* Predicted = GetWorld()->SpawnActorDeferred<AThirdPersonMPProjectile>(Class, SpawnTransform, this, this, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if (Predicted)
+	{
+		Predicted->InitPredicted(Command.Sequence, Command.Origin, PredictedShotTimeout);
+		Predicted->FinishSpawning(SpawnTransform);
+		PredictedProjectiles.Add(Command.Sequence, Predicted);
+	}
+}
+
+void AThirdPersonMPCharacter::ReconcilePredictedProjectile(AThirdPersonMPProjectile* AuthoritativeProjectile)
+{
+	TWeakObjectPtr<AThirdPersonMPProjectile> Predicted;
+	if (PredictedProjectiles.RemoveAndCopyValue(AuthoritativeProjectile->GetShotId(), Predicted) && Predicted.IsValid())
+	{
+		AuthoritativeProjectile->TakeOverFromPrediction(Predicted.Get());
+	}
+}
+
+bool AThirdPersonMPCharacter::AcceptFireSequence(uint16 Sequence)
+{
+	if (!bHasFireSequence)
+	{
+		bHasFireSequence = true;
+		LastFireSequence = Sequence;
+		FireSequenceMask = 1;
+		return true;
+	}
+
+	//Signed distance handles wrap-around of the 16 bit counter.
+	const int16 Delta = (int16)(uint16)(Sequence - LastFireSequence);
+	if (Delta > 0)
+	{
+		FireSequenceMask = (Delta < 32) ? ((FireSequenceMask << Delta) | 1) : 1;
+		LastFireSequence = Sequence;
+		return true;
+	}
+
+	const int32 Age = -Delta;
+	if (Age >= 32)
+	{
+		return false;
+	}
+
+	const uint32 Bit = 1u << Age;
+	if (FireSequenceMask & Bit)
+	{
+		return false;
+	}
+
+	FireSequenceMask |= Bit;
+	return true;
+}
+
+bool AThirdPersonMPCharacter::ConsumeFireToken()
+{
+	const float Now = GetWorld()->GetTimeSeconds();
+	if (FireRate > 0.0f)
+	{
+		FireTokens = FMath::Min(FireBurstSize, FireTokens + (Now - LastFireTokenTime) / FireRate);
+	}
+	else
+	{
+		FireTokens = FireBurstSize;
+	}
+	LastFireTokenTime = Now;
+
+	if (FireTokens < 1.0f)
+	{
+		return false;
+	}
+
+	FireTokens -= 1.0f;
+	return true;
+}
+
+FVector AThirdPersonMPCharacter::GetMuzzleLocation() const
+{
+	return GetActorLocation() + (GetControlRotation().Vector() * 100.0f) + (GetActorUpVector() * 50.0f);
+}
+
+float AThirdPersonMPCharacter::GetServerWorldTime() const
+{
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	return GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+}
+
+//HandleFire spawns the projectile for a fire command that passed the server's checks. The client's origin is trusted only as far as MaxFireOriginError from where the server thinks the muzzle is, and the projectile faces along the client's aim, enabling the player to aim. The projectile's Projectile Movement Component then handles moving it in that direction.
+void AThirdPersonMPCharacter::HandleFire(const FFireCommand& Command)
+{
+	THIRDPERSONMP_SCOPE(HandleFire);
+
+	FVector spawnLocation = Command.Origin;
+	const FVector serverLocation = GetMuzzleLocation();
+	if (FVector::DistSquared(spawnLocation, serverLocation) > FMath::Square(MaxFireOriginError))
+	{
+		spawnLocation = serverLocation;
+	}
+	FRotator spawnRotation = Command.Aim.Rotation();
+
+	if (AEmbedPlayerState* EmbedPlayerState = GetPlayerState<AEmbedPlayerState>())
+	{
+		EmbedPlayerState->AddShotFired();
+	}
+
+	AThirdPersonMPGameMode* GameMode = GetWorld()->GetAuthGameMode<AThirdPersonMPGameMode>();
+	if (AGameplaySignificanceManager* SignificanceManager = GameMode ? GameMode->GetSignificanceManager() : nullptr)
+	{
+		SignificanceManager->NotifyActivity(this);
+	}
+
+	if (AMatchTelemetryRecorder* Telemetry = GameMode ? GameMode->GetTelemetryRecorder() : nullptr)
+	{
+		Telemetry->RecordFire(this, spawnLocation, Command.Sequence);
+	}
+
+	//Lets the projectile judge its impact against where characters were when this shot was fired, on either projectile path.
+	ALagCompensationManager* LagCompensation = GameMode ? GameMode->GetLagCompensationManager() : nullptr;
+	const float ShooterTime = LagCompensation ? LagCompensation->ClampRewindTime(Command.Timestamp) : GetWorld()->GetTimeSeconds();
+
+	if (AProjectileSimulationManager* SimulationManager = GameMode ? GameMode->GetProjectileSimulationManager() : nullptr)
+	{
+		UClass* Class = ProjectileClass ? *ProjectileClass : AThirdPersonMPProjectile::StaticClass();
+		if (SimulationManager->SpawnProjectile(Class->GetDefaultObject<AThirdPersonMPProjectile>(), spawnLocation, spawnRotation, this, GetInstigator(), ShooterTime) != INDEX_NONE)
+		{
+			FThirdPersonMPModule::CountEvent(EThirdPersonMPEvent::ProjectileSpawned);
+		}
+		return;
+	}
+
+	//Projectiles are handed out by the game mode's pool rather than spawned per shot. The spawn is kept as a fallback for game modes without a pool.
+	AThirdPersonMPProjectile* spawnedProjectile = nullptr;
+	if (AProjectilePool* ProjectilePool = GameMode ? GameMode->GetProjectilePool() : nullptr)
+	{
+		spawnedProjectile = ProjectilePool->Acquire(ProjectileClass, spawnLocation, spawnRotation, this, GetInstigator(), Command.Sequence);
+	}
+	else
+	{
+		FActorSpawnParameters spawnParameters;
+		spawnParameters.Instigator = GetInstigator();
+		spawnParameters.Owner = this;
+
+		spawnedProjectile = GetWorld()->SpawnActor<AThirdPersonMPProjectile>(spawnLocation, spawnRotation, spawnParameters);
+		if (spawnedProjectile)
+		{
+			spawnedProjectile->SetShotId(Command.Sequence);
+		}
+	}
+
+	if (spawnedProjectile)
+	{
+		FThirdPersonMPModule::CountEvent(EThirdPersonMPEvent::ProjectileSpawned);
+	}
+
+	if (spawnedProjectile && LagCompensation)
+	{
+		spawnedProjectile->SetShooterTime(ShooterTime);
+	}
 }
 
 //We will be using this function to perform updates in response to changes to the player's CurrentHealth. Currently its functionality is limited to onscreen debug messages, but additional functionality could be added, like an OnDeath function that is called on all machines in order to trigger a death animation. Note that OnHealthUpdate is not replicated, and we will need to manually call it on all devices.
 void AThirdPersonMPCharacter::OnHealthUpdate()
 {
+	THIRDPERSONMP_SCOPE(OnHealthUpdate);
+
 	//Client-specific functionality
 	if (IsLocallyControlled())
 	{
@@ -221,12 +556,14 @@ void AThirdPersonMPCharacter::OnHealthUpdate()
 		}
 	}
 
-	//Server-specific functionality
-	if (Role == ROLE_Authority)
+	//Server-specific functionality. This is debug output only, so it is compiled out of shipping and server builds and skipped on dedicated servers, where nobody would see it and every hit would pay for the string formatting.
+#if !UE_BUILD_SHIPPING && !UE_SERVER
+	if (GetLocalRole() == ROLE_Authority && GetNetMode() != NM_DedicatedServer)
 	{
 		FString healthMessage = FString::Printf(TEXT("%s now has %f health remaining."), *GetFName().ToString(), CurrentHealth);
 		GEngine->AddOnScreenDebugMessage(-1, 5.f, FColor::Blue, healthMessage);
 	}
+#endif
 
 	//Functions that occur on all machines. 
 	/*
@@ -245,9 +582,17 @@ void AThirdPersonMPCharacter::OnRep_CurrentHealth()
 //While "setter" functions like this are not necessary for every variable, they are preferable for sensitive gameplay variables that change frequently during play, especially if they can be modified by many different sources.This is a best - practice for single - player and multiplayer games alike, as it makes live changes to these variables more consistent, easier to debug, and easier to extend with new functionality.
 void AThirdPersonMPCharacter::SetCurrentHealth(float healthValue)
 {
-	if (Role == ROLE_Authority)
+	THIRDPERSONMP_SCOPE(SetCurrentHealth);
+
+	if (GetLocalRole() == ROLE_Authority)
 	{
+		const bool bWasAlive = CurrentHealth > 0.f;
 		CurrentHealth = FMath::Clamp(healthValue, 0.f, MaxHealth);
+		MARK_PROPERTY_DIRTY_FROM_NAME(AThirdPersonMPCharacter, CurrentHealth, this);
+		if (bWasAlive && CurrentHealth <= 0.f)
+		{
+			AEmbedPlayerState::RecordKill(LastDamageInstigator.Get(), Controller);
+		}
 		OnHealthUpdate();
 	}
 }
@@ -256,9 +601,34 @@ void AThirdPersonMPCharacter::SetCurrentHealth(float healthValue)
 //The built - in functions for applying damage to Actors call the basic TakeDamage function for that Actor.In this case we implement a simple health deduction using SetCurrentHealth.
 float AThirdPersonMPCharacter::TakeDamage(float DamageTaken, struct FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser)
 {
+	THIRDPERSONMP_SCOPE(TakeDamage);
+	FThirdPersonMPModule::CountEvent(EThirdPersonMPEvent::DamageEvent);
+
+	LastDamageTakenTime = GetWorld()->GetTimeSeconds();
+	if (EventInstigator)
+	{
+		LastDamageInstigator = EventInstigator;
+	}
+
+	AThirdPersonMPGameMode* GameMode = GetWorld()->GetAuthGameMode<AThirdPersonMPGameMode>();
+	if (AGameplaySignificanceManager* SignificanceManager = GameMode ? GameMode->GetSignificanceManager() : nullptr)
+	{
+		SignificanceManager->NotifyActivity(this);
+	}
+
+	if (AMatchTelemetryRecorder* Telemetry = GameMode ? GameMode->GetTelemetryRecorder() : nullptr)
+	{
+		Telemetry->RecordDamage(this, EventInstigator ? EventInstigator->GetPawn() : nullptr, DamageTaken);
+	}
+
+	//Every hit in a frame is summed by the damage manager, so health changes and replicates once per frame however many hits land.
+	if (ADamageManager* DamageManager = GameMode ? GameMode->GetDamageManager() : nullptr)
+	{
+		DamageManager->QueueDamage(this, DamageTaken);
+		return DamageTaken;
+	}
+
 	float damageApplied = CurrentHealth - DamageTaken;
 	SetCurrentHealth(damageApplied);
 	return damageApplied;
 }
-
-
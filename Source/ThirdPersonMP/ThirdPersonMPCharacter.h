@@ -4,13 +4,51 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "Engine/NetSerialization.h"
 #include "ThirdPersonMPCharacter.generated.h"
 
+/** A single shot requested by a client. Several of these are packed into one unreliable ServerFireCommands call per frame. */
+USTRUCT()
+struct FFireCommand
+{
+	GENERATED_BODY()
+
+	/** Per-character shot counter, used by the server to drop duplicates and stale resends. Wraps around. */
+	UPROPERTY()
+	uint16 Sequence;
+
+	/** Server world time at which the client fired, as estimated by the client. */
+	UPROPERTY()
+	float Timestamp;
+
+	/** Where the client spawned the shot from. */
+	UPROPERTY()
+	FVector_NetQuantize10 Origin;
+
+	/** Direction the client aimed in. */
+	UPROPERTY()
+	FVector_NetQuantizeNormal Aim;
+
+	FFireCommand()
+		: Sequence(0)
+		, Timestamp(0.0f)
+		, Origin(ForceInitToZero)
+		, Aim(ForceInitToZero)
+	{
+	}
+};
+
 UCLASS(config=Game)
 class AThirdPersonMPCharacter : public ACharacter
 {
 	GENERATED_BODY()
 
+	/** Load-test bots fire through StartFire like a player would. */
+	friend class ULoadTestBotComponent;
+
+	/** The benchmark drives server-side bots through the same input functions. */
+	friend class ABenchmarkRunner;
+
 	/** Camera boom positioning the camera behind the character */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
 	class USpringArmComponent* CameraBoom;
@@ -20,11 +58,20 @@ class AThirdPersonMPCharacter : public ACharacter
 	class UCameraComponent* FollowCamera;
 public:
 	/** Constructor */
-	AThirdPersonMPCharacter();
+	AThirdPersonMPCharacter(const FObjectInitializer& ObjectInitializer);
 
 	/** Property replication */
 	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
+	/** Flushes queued fire commands once per frame on owning clients. */
+	virtual void Tick(float DeltaSeconds) override;
+
+	/** Hands the character to a load-test bot on clients started with -LoadTestBot. */
+	virtual void PawnClientRestart() override;
+
+	/** Matches an authoritative projectile that just arrived on the owning client with the prediction spawned for the same shot, if there is one. */
+	void ReconcilePredictedProjectile(class AThirdPersonMPProjectile* AuthoritativeProjectile);
+
 	/** Base turn rate, in deg/sec. Other scaling may affect final turn rate. */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category=Camera)
 	float BaseTurnRate;
@@ -40,7 +87,7 @@ protected:
 	UPROPERTY(EditDefaultsOnly, Category = "Health")
 		float MaxHealth;
 
-	/** The player's current health. When reduced to 0, they are considered dead.*/
+	/** The player's current health. When reduced to 0, they are considered dead. Push-model replicated, so only change it through SetCurrentHealth.*/
 	UPROPERTY(ReplicatedUsing = OnRep_CurrentHealth)
 		float CurrentHealth;
 
@@ -51,6 +98,12 @@ protected:
 	/** Response to health being updated. Called on the server immediately after modification, and on clients in response to a RepNotify*/
 	void OnHealthUpdate();
 
+	/** Controller behind the last damage taken, credited with the kill if health reaches 0. Server only.*/
+	TWeakObjectPtr<AController> LastDamageInstigator;
+
+	/** World time of the last damage taken, or a large negative number if none. Server only.*/
+	float LastDamageTakenTime;
+
 	//The GetMaxHealth and GetCurrentHealth functions provide getters that can access the player's health values from outside of AThirdPersonMPCharacter, both in C++ and in Blueprint. As const functions they provide a safe means of getting these values without allowing them to be modified. We are also declaring functions for setting the player's health and taking damage.
 
 public: 
@@ -62,16 +115,24 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Health")
 	FORCEINLINE float GetCurrentHealth() const { return CurrentHealth; }
 
+	/** Returns the world time this character last took damage. Server only.*/
+	FORCEINLINE float GetLastDamageTakenTime() const { return LastDamageTakenTime; }
+
+	/** Returns the controller behind the last damage this character took, if it still exists. Server only.*/
+	FORCEINLINE AController* GetLastDamageInstigator() const { return LastDamageInstigator.Get(); }
+
 	/** Setter for Current Health. Clamps the value between 0 and MaxHealth and calls OnHealthUpdate. Should only be called on the server.*/
 	UFUNCTION(BlueprintCallable, Category = "Health")
 	void SetCurrentHealth(float healthValue);
 
-	/** Event for taking damage. Overridden from APawn.*/
+	/** Event for taking damage. Overridden from APawn. Queues the damage with the game mode's damage manager when there is one.*/
 	UFUNCTION(BlueprintCallable, Category = "Health")
 	float TakeDamage(float DamageTaken, struct FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser) override;
 
 
 protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	/** Resets HMD orientation in VR. */
 	void OnResetVR();
@@ -106,16 +167,36 @@ protected:
 	// End of APawn interface
 
 
-	//These are the variables and functions we will be using to fire our projectiles. HandleFire is the only RPC we will implement in this tutorial, and it will be responsible for spawning projectiles on the server. Because it has the Server specifier, any attempt to call it on a client will result in the call being directed over the network to the authoritative Character on the server instead. Because HandleFire has the Reliable specifier as well, it is placed into a queue for reliable RPCs whenever it gets called, and it is removed from the queue when the server successfully receives it.This guarnatees that the server will definitely receive this function call.However, the queue for reliable RPCs can overflow if too many RPCs are placed into it at once without removing them, and if it does then it will force the user to disconnect.Therefore, we need to be cautious in how often we allow players to call this function.
+	//These are the variables and functions we will be using to fire our projectiles. StartFire runs on the owning machine and turns each shot into an FFireCommand. Shots fired during a frame are packed into a single call to ServerFireCommands, which has the Server specifier, so any attempt to call it on a client will result in the call being directed over the network to the authoritative Character on the server instead. ServerFireCommands is Unreliable: it never sits in the reliable queue, so it can neither overflow it and disconnect the player nor delay other traffic while a lost packet is resent. Instead, every command is resent in a few consecutive batches, and the server drops duplicates by sequence number and rate-limits shots with a token bucket rather than trusting the client's FiringTimer.
 
 	/** The type of projectile the character is going to fire.*/
 	UPROPERTY(EditDefaultsOnly, Category = "Gameplay|Projectile")
 	TSubclassOf<class AThirdPersonMPProjectile> ProjectileClass;
 
-	/** Delay between shots in seconds. Used to control fire rate for our test projectile, but also to prevent an overflow of server functions from binding SpawnProjectile directly to input.*/
+	/** Delay between shots in seconds. Used to control fire rate for our test projectile on the client, and as the refill interval of the server's token bucket.*/
 	UPROPERTY(EditDefaultsOnly, Category = "Gameplay")
 	float FireRate;
 
+	/** Number of shots the server lets a client fire back to back before FireRate applies. Absorbs jitter in how commands arrive.*/
+	UPROPERTY(EditDefaultsOnly, Category = "Gameplay")
+	float FireBurstSize;
+
+	/** Number of consecutive batches each fire command is sent in, to survive packet loss on the unreliable channel.*/
+	UPROPERTY(EditDefaultsOnly, Category = "Gameplay")
+	int32 FireCommandRedundancy;
+
+	/** Largest distance, in cm, between a client's reported shot origin and the server's muzzle position before the server's is used instead.*/
+	UPROPERTY(EditDefaultsOnly, Category = "Gameplay")
+	float MaxFireOriginError;
+
+	/** If true, the owning client spawns a cosmetic projectile as soon as it fires instead of waiting a round trip for the server's.*/
+	UPROPERTY(EditDefaultsOnly, Category = "Gameplay|Projectile")
+	bool bPredictProjectiles;
+
+	/** Seconds a predicted projectile waits for the server's projectile before the shot is treated as rejected and removed.*/
+	UPROPERTY(EditDefaultsOnly, Category = "Gameplay|Projectile")
+	float PredictedShotTimeout;
+
 	/** If true, we are in the process of firing projectiles. */
 	bool bIsFiringWeapon;
 
@@ -127,13 +208,60 @@ protected:
 	UFUNCTION(BlueprintCallable, Category = "Gameplay")
 	void StopFire();
 
-	/** Server function for spawning projectiles.*/
-	UFUNCTION(Server, Reliable)
-	void HandleFire();
+	/** Server function for spawning projectiles. Receives every new shot fired by the owning client since the last batch, plus resends of recent ones.*/
+	UFUNCTION(Server, Unreliable)
+	void ServerFireCommands(const TArray<FFireCommand>& Commands);
+
+	/** Tells the owning client that the server dropped one of its shots, so the prediction for it can be removed.*/
+	UFUNCTION(Client, Unreliable)
+	void ClientRejectFire(uint16 Sequence);
+
+	/** Spawns the projectile for an accepted fire command. Server only.*/
+	void HandleFire(const FFireCommand& Command);
+
+	/** Spawns the owning client's cosmetic projectile for a shot it is about to send.*/
+	void SpawnPredictedProjectile(const FFireCommand& Command);
+
+	/** Returns where a shot fired now would spawn.*/
+	FVector GetMuzzleLocation() const;
+
+	/** Returns the server world time as seen on this machine.*/
+	float GetServerWorldTime() const;
+
+	/** Sends every queued fire command that still has resends left in one ServerFireCommands call.*/
+	void FlushFireCommands();
+
+	/** Returns true the first time the server sees Sequence, tracking the last 32 sequences to cope with reordering.*/
+	bool AcceptFireSequence(uint16 Sequence);
+
+	/** Takes a token from the server's fire-rate bucket, returning false if it is empty.*/
+	bool ConsumeFireToken();
 
 	/** A timer handle used for providing the fire rate delay in-between spawns.*/
 	FTimerHandle FiringTimer;
 
+	/** Client: fire commands waiting to be (re)sent, with how many more batches each should go out in.*/
+	TArray<FFireCommand> PendingFireCommands;
+	TArray<uint8> PendingFireCommandSends;
+
+	/** Client: batch reused by FlushFireCommands to avoid allocating every frame.*/
+	TArray<FFireCommand> FireCommandBatch;
+
+	/** Client: sequence number of the next shot.*/
+	uint16 NextFireSequence;
+
+	/** Client: predicted projectiles waiting for their authoritative copy, keyed by shot sequence.*/
+	TMap<uint16, TWeakObjectPtr<class AThirdPersonMPProjectile>> PredictedProjectiles;
+
+	/** Server: newest sequence accepted, and a bit per older sequence that has also been seen.*/
+	uint16 LastFireSequence;
+	uint32 FireSequenceMask;
+	bool bHasFireSequence;
+
+	/** Server: token bucket used to enforce FireRate.*/
+	float FireTokens;
+	float LastFireTokenTime;
+
 public:
 	/** Returns CameraBoom subobject **/
 	FORCEINLINE class USpringArmComponent* GetCameraBoom() const { return CameraBoom; }
@@ -1,15 +1,247 @@
 // Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
 
 #include "ThirdPersonMPGameMode.h"
+#include "ThirdPersonMP.h"
 #include "ThirdPersonMPCharacter.h"
-#include "UObject/ConstructorHelpers.h"
+#include "EmbedGameStateBase.h"
+#include "EmbedPlayerState.h"
+#include "ProjectilePool.h"
+#include "ProjectileSimulationManager.h"
+#include "LagCompensationManager.h"
+#include "LoadTestMetricsRecorder.h"
+#include "MatchTelemetryRecorder.h"
+#include "ServerInstanceReporter.h"
+#include "WorldStreamingFlythrough.h"
+#include "BenchmarkRunner.h"
+#include "FrameBudgetScheduler.h"
+#include "DamageManager.h"
+#include "CrowdManager.h"
+#include "GameplaySignificanceManager.h"
+#include "CosmeticAssetLoader.h"
+#include "MatchReplay.h"
+#include "Components/CapsuleComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
 
 AThirdPersonMPGameMode::AThirdPersonMPGameMode()
 {
 	// set default pawn class to our Blueprinted character
-	static ConstructorHelpers::FClassFinder<APawn> PlayerPawnBPClass(TEXT("/Game/ThirdPersonCPP/Blueprints/ThirdPersonCharacter"));
-	if (PlayerPawnBPClass.Class != NULL)
+	DefaultPawnClassAsset = TSoftClassPtr<APawn>(FSoftObjectPath(TEXT("/Game/ThirdPersonCPP/Blueprints/ThirdPersonCharacter.ThirdPersonCharacter_C")));
+
+	GameStateClass = AEmbedGameStateBase::StaticClass();
+	PlayerStateClass = AEmbedPlayerState::StaticClass();
+
+	ProjectilePoolClass = AProjectilePool::StaticClass();
+	ProjectileSimulationManagerClass = AProjectileSimulationManager::StaticClass();
+	bUseBatchedProjectiles = false;
+	FrameBudgetSchedulerClass = AFrameBudgetScheduler::StaticClass();
+	LagCompensationManagerClass = ALagCompensationManager::StaticClass();
+	DamageManagerClass = ADamageManager::StaticClass();
+	CrowdManagerClass = ACrowdManager::StaticClass();
+	SignificanceManagerClass = AGameplaySignificanceManager::StaticClass();
+	LoadTestMetricsRecorderClass = ALoadTestMetricsRecorder::StaticClass();
+	TelemetryRecorderClass = AMatchTelemetryRecorder::StaticClass();
+	InstanceReporterClass = AServerInstanceReporter::StaticClass();
+	StreamingFlythroughClass = AWorldStreamingFlythrough::StaticClass();
+	BenchmarkRunnerClass = ABenchmarkRunner::StaticClass();
+}
+
+void AThirdPersonMPGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	// the character blueprint carries gameplay settings, so dedicated servers need it too; load it before the first player can spawn
+	if (!DefaultPawnClassAsset.IsNull())
+	{
+		if (UClass* PawnClass = DefaultPawnClassAsset.LoadSynchronous())
+		{
+			DefaultPawnClass = PawnClass;
+		}
+	}
+
+	Super::InitGame(MapName, Options, ErrorMessage);
+}
+
+void AThirdPersonMPGameMode::PreInitializeComponents()
+{
+	Super::PreInitializeComponents();
+
+	FActorSpawnParameters SpawnInfo;
+	SpawnInfo.Instigator = GetInstigator();
+	SpawnInfo.ObjectFlags |= RF_Transient;
+
+	// first, so the benchmark has seeded the random streams and fixed the time step before anything else uses them
+	FString BenchmarkScriptPath;
+	if (BenchmarkRunnerClass && ABenchmarkRunner::GetScriptPath(BenchmarkScriptPath))
+	{
+		BenchmarkRunner = GetWorld()->SpawnActor<ABenchmarkRunner>(BenchmarkRunnerClass, SpawnInfo);
+	}
+
+	// before the managers that defer work to it, so it is there for the first frame they tick
+	if (FrameBudgetSchedulerClass)
+	{
+		FrameBudgetScheduler = GetWorld()->SpawnActor<AFrameBudgetScheduler>(FrameBudgetSchedulerClass, SpawnInfo);
+	}
+
+	// the game mode only exists on the server, so the pool and everything it hands out is server-authoritative
+	if (ProjectilePoolClass)
+	{
+		ProjectilePool = GetWorld()->SpawnActor<AProjectilePool>(ProjectilePoolClass, SpawnInfo);
+	}
+
+	// the batched simulation replicates its own events, so clients pick it up like any other always-relevant actor
+	if (bUseBatchedProjectiles && ProjectileSimulationManagerClass)
+	{
+		ProjectileSimulationManager = GetWorld()->SpawnActor<AProjectileSimulationManager>(ProjectileSimulationManagerClass, SpawnInfo);
+	}
+
+	if (LagCompensationManagerClass)
+	{
+		LagCompensationManager = GetWorld()->SpawnActor<ALagCompensationManager>(LagCompensationManagerClass, SpawnInfo);
+	}
+
+	if (DamageManagerClass)
+	{
+		DamageManager = GetWorld()->SpawnActor<ADamageManager>(DamageManagerClass, SpawnInfo);
+	}
+
+	if (SignificanceManagerClass)
+	{
+		SignificanceManager = GetWorld()->SpawnActor<AGameplaySignificanceManager>(SignificanceManagerClass, SpawnInfo);
+	}
+
+	// like the batched projectiles, the crowd replicates itself, so clients receive it without the game mode
+	if (CrowdManagerClass && CrowdManagerClass->GetDefaultObject<ACrowdManager>()->GetNumAgentsToSpawn() > 0)
+	{
+		CrowdManager = GetWorld()->SpawnActor<ACrowdManager>(CrowdManagerClass, SpawnInfo);
+	}
+
+	FString LoadTestMetricsPath;
+	if (LoadTestMetricsRecorderClass && ALoadTestMetricsRecorder::GetOutputPath(LoadTestMetricsPath))
+	{
+		LoadTestMetricsRecorder = GetWorld()->SpawnActor<ALoadTestMetricsRecorder>(LoadTestMetricsRecorderClass, SpawnInfo);
+	}
+
+	FString TelemetryPath;
+	if (TelemetryRecorderClass && AMatchTelemetryRecorder::GetOutputPath(TelemetryPath))
+	{
+		TelemetryRecorder = GetWorld()->SpawnActor<AMatchTelemetryRecorder>(TelemetryRecorderClass, SpawnInfo);
+	}
+
+	FString RouterAddress;
+	if (InstanceReporterClass && AServerInstanceReporter::GetRouterAddress(RouterAddress))
+	{
+		InstanceReporter = GetWorld()->SpawnActor<AServerInstanceReporter>(InstanceReporterClass, SpawnInfo);
+	}
+
+	// the game mode also exists in a standalone game, so this runs the client side of the test as well as the server side
+	FString FlythroughPath;
+	if (StreamingFlythroughClass && AWorldStreamingFlythrough::GetOutputPath(FlythroughPath))
+	{
+		StreamingFlythrough = GetWorld()->SpawnActor<AWorldStreamingFlythrough>(StreamingFlythroughClass, SpawnInfo);
+	}
+}
+
+void AThirdPersonMPGameMode::StartPlay()
+{
+	Super::StartPlay();
+
+	UCosmeticAssetLoader::LogStartupMilestone(TEXT("Game started"));
+
+	UMatchReplay::StartRecording(GetWorld());
+}
+
+void AThirdPersonMPGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UMatchReplay::StopRecording(GetWorld());
+
+	Super::EndPlay(EndPlayReason);
+}
+
+//Times the per-character work that ThirdPersonMP.ParallelCharacterWork spreads over worker threads, serial against parallel.
+//Everything runs in a scratch world of its own, so the characters it spawns never reach a live match's lag compensation,
+//significance, damage or replication. Queuing the damage is not timed, as it happens during gameplay either way.
+static void RunParallelCharacterWorkBenchmark(const TArray<FString>& Args)
+{
+	const int32 NumFrames = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 1000;
+	const int32 HitsPerCharacter = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 4;
+	const int32 CharacterCounts[] = { 32, 64, 128 };
+
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	ADamageManager* DamageManager = World->SpawnActor<ADamageManager>();
+	AGameplaySignificanceManager* SignificanceManager = World->SpawnActor<AGameplaySignificanceManager>();
+	const int32 HistoryCapacity = GetDefault<ALagCompensationManager>()->HistoryCapacity;
+
+	UE_LOG(LogThirdPersonMP, Display, TEXT("Parallel character work benchmark: %d frames, %d hits per character per frame."), NumFrames, HitsPerCharacter);
+	UE_LOG(LogThirdPersonMP, Display, TEXT("Characters, SerialMsPerFrame, ParallelMsPerFrame, Speedup"));
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	TArray<AThirdPersonMPCharacter*> Characters;
+	for (const int32 NumCharacters : CharacterCounts)
 	{
-		DefaultPawnClass = PlayerPawnBPClass.Class;
+		for (int32 Index = Characters.Num(); Index < NumCharacters; ++Index)
+		{
+			const FVector Location((Index % 16) * 200.0f, (Index / 16) * 200.0f, 0.0f);
+			if (AThirdPersonMPCharacter* Character = World->SpawnActor<AThirdPersonMPCharacter>(AThirdPersonMPCharacter::StaticClass(), Location, FRotator::ZeroRotator, SpawnParameters))
+			{
+				Characters.Add(Character);
+				SignificanceManager->RegisterActor(Character);
+			}
+		}
+
+		TArray<FLagCompensationTarget> Targets;
+		TArray<const UCapsuleComponent*> Capsules;
+		TArray<FVector> ViewLocations;
+		Targets.SetNum(Characters.Num());
+		for (int32 Index = 0; Index < Characters.Num(); ++Index)
+		{
+			Targets[Index].Actor = Characters[Index];
+			Targets[Index].Radius = Characters[Index]->GetCapsuleComponent()->GetScaledCapsuleRadius();
+			Targets[Index].History.Init(HistoryCapacity);
+			Capsules.Add(Characters[Index]->GetCapsuleComponent());
+
+			//Every character is also a player looking on, as in a full match.
+			ViewLocations.Add(Characters[Index]->GetActorLocation());
+		}
+
+		double MsPerFrame[2];
+		float SampleTime = 0.0f;
+		for (int32 Mode = 0; Mode < 2; ++Mode)
+		{
+			const bool bParallel = Mode == 1;
+			double Elapsed = 0.0;
+			for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+			{
+				SampleTime += 1.0f / 60.0f;
+				for (AThirdPersonMPCharacter* Character : Characters)
+				{
+					for (int32 Hit = 0; Hit < HitsPerCharacter; ++Hit)
+					{
+						DamageManager->QueueDamage(Character, KINDA_SMALL_NUMBER);
+					}
+				}
+
+				const double StartTime = FPlatformTime::Seconds();
+				ALagCompensationManager::CaptureHistory(Targets, Capsules, SampleTime, bParallel);
+				DamageManager->ResolveQueuedDamage(bParallel);
+				SignificanceManager->UpdateAllActors(ViewLocations, bParallel);
+				Elapsed += FPlatformTime::Seconds() - StartTime;
+			}
+			MsPerFrame[Mode] = Elapsed * 1000.0 / NumFrames;
+		}
+
+		UE_LOG(LogThirdPersonMP, Display, TEXT("%d, %.4f, %.4f, %.2f"), Characters.Num(), MsPerFrame[0], MsPerFrame[1], MsPerFrame[1] > 0.0 ? MsPerFrame[0] / MsPerFrame[1] : 0.0);
 	}
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
 }
+
+static FAutoConsoleCommandWithArgs ParallelCharacterWorkBenchmarkCommand(
+	TEXT("ThirdPersonMP.ParallelCharacterWork.Benchmark"),
+	TEXT("Times serial against parallel per-character server work (lag compensation capture, health resolution, significance scoring) at 32, 64 and 128 characters, in a scratch world apart from any match. Only times the work itself; Scripts/ParallelCharacterWorkBenchmark.sh measures whole frames. Usage: ThirdPersonMP.ParallelCharacterWork.Benchmark [NumFrames=1000] [HitsPerCharacter=4]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunParallelCharacterWorkBenchmark));
@@ -6,13 +6,160 @@
 #include "GameFramework/GameModeBase.h"
 #include "ThirdPersonMPGameMode.generated.h"
 
-UCLASS(minimalapi)
+class AProjectilePool;
+class AProjectileSimulationManager;
+class ALagCompensationManager;
+class ALoadTestMetricsRecorder;
+class ABenchmarkRunner;
+class AFrameBudgetScheduler;
+class AMatchTelemetryRecorder;
+class AServerInstanceReporter;
+class AWorldStreamingFlythrough;
+class ADamageManager;
+class ACrowdManager;
+class AGameplaySignificanceManager;
+
+UCLASS(minimalapi, config=Game)
 class AThirdPersonMPGameMode : public AGameModeBase
 {
 	GENERATED_BODY()
 
 public:
 	AThirdPersonMPGameMode();
+
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void PreInitializeComponents() override;
+	virtual void StartPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Returns the server's projectile pool. */
+	FORCEINLINE AProjectilePool* GetProjectilePool() const { return ProjectilePool; }
+
+	/** Returns the batched projectile simulation, or nullptr when projectiles are individual actors. */
+	FORCEINLINE AProjectileSimulationManager* GetProjectileSimulationManager() const { return ProjectileSimulationManager; }
+
+	/** Returns the server's lag compensation history. */
+	FORCEINLINE ALagCompensationManager* GetLagCompensationManager() const { return LagCompensationManager; }
+
+	/** Returns the server's damage pipeline. */
+	FORCEINLINE ADamageManager* GetDamageManager() const { return DamageManager; }
+
+	/** Returns the NPC crowd, or nullptr when there are no crowd agents. */
+	FORCEINLINE ACrowdManager* GetCrowdManager() const { return CrowdManager; }
+
+	/** Returns the server's tick and net update throttling. */
+	FORCEINLINE AGameplaySignificanceManager* GetSignificanceManager() const { return SignificanceManager; }
+
+	/** Returns the server's deferred work scheduler. */
+	FORCEINLINE AFrameBudgetScheduler* GetFrameBudgetScheduler() const { return FrameBudgetScheduler; }
+
+	/** Returns the match telemetry recorder, or nullptr when telemetry is off. */
+	FORCEINLINE AMatchTelemetryRecorder* GetTelemetryRecorder() const { return TelemetryRecorder; }
+
+protected:
+	/** Pawn class loaded into DefaultPawnClass at InitGame. Soft so that constructing the CDO does not pull in the blueprint. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSoftClassPtr<APawn> DefaultPawnClassAsset;
+
+	/** Class of the projectile pool spawned for this game mode. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<AProjectilePool> ProjectilePoolClass;
+
+	/** Pool handing out projectiles to characters on this server. */
+	UPROPERTY(Transient)
+	AProjectilePool* ProjectilePool;
+
+	/** If true, characters fire into the batched projectile simulation instead of using projectile actors. */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Gameplay|Projectile")
+	bool bUseBatchedProjectiles;
+
+	/** Class of the batched projectile simulation spawned when bUseBatchedProjectiles is set. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<AProjectileSimulationManager> ProjectileSimulationManagerClass;
+
+	/** Batched projectile simulation, if enabled. */
+	UPROPERTY(Transient)
+	AProjectileSimulationManager* ProjectileSimulationManager;
+
+	/** Class of the deferred work scheduler spawned for this game mode. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<AFrameBudgetScheduler> FrameBudgetSchedulerClass;
+
+	/** Runs non-urgent server work within the frame budget. */
+	UPROPERTY(Transient)
+	AFrameBudgetScheduler* FrameBudgetScheduler;
+
+	/** Class of the lag compensation manager spawned for this game mode. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<ALagCompensationManager> LagCompensationManagerClass;
+
+	/** Records character positions so hits can be judged at the shooter's time. */
+	UPROPERTY(Transient)
+	ALagCompensationManager* LagCompensationManager;
+
+	/** Class of the damage pipeline spawned for this game mode. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<ADamageManager> DamageManagerClass;
+
+	/** Sums the damage each character takes in a frame and applies it once. */
+	UPROPERTY(Transient)
+	ADamageManager* DamageManager;
+
+	/** Class of the crowd manager spawned when it has agents to spawn. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<ACrowdManager> CrowdManagerClass;
+
+	/** Lightweight NPC targets, if enabled. */
+	UPROPERTY(Transient)
+	ACrowdManager* CrowdManager;
+
+	/** Class of the significance manager spawned for this game mode. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<AGameplaySignificanceManager> SignificanceManagerClass;
+
+	/** Throttles ticks and net updates of actors far from every player. */
+	UPROPERTY(Transient)
+	AGameplaySignificanceManager* SignificanceManager;
+
+	/** Class of the metrics recorder spawned on servers started with -LoadTestMetrics=<path>. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<ALoadTestMetricsRecorder> LoadTestMetricsRecorderClass;
+
+	/** Load-test metrics recorder, if enabled. */
+	UPROPERTY(Transient)
+	ALoadTestMetricsRecorder* LoadTestMetricsRecorder;
+
+	/** Class of the telemetry recorder spawned on servers started with -MatchTelemetry=<path>. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<AMatchTelemetryRecorder> TelemetryRecorderClass;
+
+	/** Match telemetry recorder, if enabled. */
+	UPROPERTY(Transient)
+	AMatchTelemetryRecorder* TelemetryRecorder;
+
+	/** Class of the load reporter spawned on servers started with -SessionRouter=<ip:port>. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<AServerInstanceReporter> InstanceReporterClass;
+
+	/** Reports this instance's load to the local session router, if enabled. */
+	UPROPERTY(Transient)
+	AServerInstanceReporter* InstanceReporter;
+
+	/** Class of the streaming test spawned on machines started with -StreamingFlythrough=<path>. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<AWorldStreamingFlythrough> StreamingFlythroughClass;
+
+	/** Grid streaming test, if enabled. */
+	UPROPERTY(Transient)
+	AWorldStreamingFlythrough* StreamingFlythrough;
+
+	/** Class of the benchmark runner spawned on servers started with -BenchmarkScript=<path>. */
+	UPROPERTY(EditDefaultsOnly, Category = "Classes")
+	TSubclassOf<ABenchmarkRunner> BenchmarkRunnerClass;
+
+	/** Deterministic benchmark, if enabled. */
+	UPROPERTY(Transient)
+	ABenchmarkRunner* BenchmarkRunner;
 };
 
 
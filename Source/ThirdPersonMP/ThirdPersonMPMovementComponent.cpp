@@ -0,0 +1,175 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "ThirdPersonMPMovementComponent.h"
+#include "ThirdPersonMP.h"
+#include "Engine/NetConnection.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "Engine/NetSerialization.h"
+#include "UObject/CoreNet.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Client Moves"), STAT_ThirdPersonMP_ClientMoves, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("ServerMove Calls"), STAT_ThirdPersonMP_ServerMoveCalls, STATGROUP_ThirdPersonMP);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Move Bytes Per Move"), STAT_ThirdPersonMP_BytesPerMove, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Upstream Bytes/sec"), STAT_ThirdPersonMP_UpstreamBytesPerSecond, STATGROUP_ThirdPersonMP);
+
+namespace ThirdPersonMPMovement
+{
+	/** Bits FVector_NetQuantize<Scale> writes for Vector. The packed encoding grows with the magnitude of each component. */
+	template<typename QuantizedVectorType>
+	int32 QuantizedVectorBits(const FVector& Vector)
+	{
+		FNetBitWriter Writer(nullptr, 128);
+		bool bSuccess = true;
+		QuantizedVectorType Quantized(Vector);
+		Quantized.NetSerialize(Writer, nullptr, bSuccess);
+		return (int32)Writer.GetNumBits();
+	}
+
+	/** Approximate payload bits of the move-specific ServerMove parameters: timestamp, acceleration, flags and packed view. */
+	int32 MoveBits(const FSavedMove_Character& Move)
+	{
+		return 32 + QuantizedVectorBits<FVector_NetQuantize10>(Move.Acceleration) + 8 + 32;
+	}
+}
+
+void FSavedMove_ThirdPersonMP::SetMoveFor(ACharacter* Character, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData)
+{
+	const UThirdPersonMPMovementComponent* Movement = Cast<UThirdPersonMPMovementComponent>(Character->GetCharacterMovement());
+	Super::SetMoveFor(Character, InDeltaTime, Movement ? Movement->QuantizeAcceleration(NewAccel) : NewAccel, ClientData);
+
+	//ServerMove packs pitch and yaw into 16 bits each and roll into 8, so replay with what the server will actually use.
+	SavedControlRotation.Pitch = FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(SavedControlRotation.Pitch));
+	SavedControlRotation.Yaw = FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(SavedControlRotation.Yaw));
+	SavedControlRotation.Roll = FRotator::DecompressAxisFromByte(FRotator::CompressAxisToByte(SavedControlRotation.Roll));
+}
+
+FNetworkPredictionData_Client_ThirdPersonMP::FNetworkPredictionData_Client_ThirdPersonMP(const UCharacterMovementComponent& ClientMovement)
+	: Super(ClientMovement)
+{
+}
+
+FSavedMovePtr FNetworkPredictionData_Client_ThirdPersonMP::AllocateNewMove()
+{
+	return FSavedMovePtr(new FSavedMove_ThirdPersonMP());
+}
+
+UThirdPersonMPMovementComponent::UThirdPersonMPMovementComponent()
+{
+	AccelerationDirectionSteps = 128;
+	AccelerationMagnitudeSteps = 16;
+	MaxClientPositionError = 0.0f;
+
+	WindowMoves = 0;
+	WindowBits = 0;
+	WindowStartTime = 0.0f;
+	BytesPerMove = 0.0f;
+}
+
+FNetworkPredictionData_Client* UThirdPersonMPMovementComponent::GetPredictionData_Client() const
+{
+	if (ClientPredictionData == nullptr)
+	{
+		UThirdPersonMPMovementComponent* MutableThis = const_cast<UThirdPersonMPMovementComponent*>(this);
+		MutableThis->ClientPredictionData = new FNetworkPredictionData_Client_ThirdPersonMP(*this);
+	}
+
+	return ClientPredictionData;
+}
+
+void UThirdPersonMPMovementComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (CharacterOwner == nullptr || CharacterOwner->GetLocalRole() != ROLE_AutonomousProxy)
+	{
+		return;
+	}
+
+	const float Now = GetWorld()->GetRealTimeSeconds();
+	if (Now - WindowStartTime >= 1.0f)
+	{
+		BytesPerMove = WindowMoves > 0 ? (WindowBits / 8.0f) / WindowMoves : 0.0f;
+		WindowMoves = 0;
+		WindowBits = 0;
+		WindowStartTime = Now;
+	}
+
+	SET_FLOAT_STAT(STAT_ThirdPersonMP_BytesPerMove, BytesPerMove);
+	if (UNetConnection* Connection = CharacterOwner->GetNetConnection())
+	{
+		SET_DWORD_STAT(STAT_ThirdPersonMP_UpstreamBytesPerSecond, Connection->OutBytesPerSecond);
+	}
+}
+
+FVector UThirdPersonMPMovementComponent::QuantizeAcceleration(const FVector& InAcceleration) const
+{
+	const float MaxAccel = GetMaxAcceleration();
+	if (MaxAccel <= 0.0f || AccelerationDirectionSteps <= 0 || AccelerationMagnitudeSteps <= 0 || InAcceleration.IsNearlyZero())
+	{
+		return InAcceleration;
+	}
+
+	const float Fraction = FMath::RoundToFloat(FMath::Min(InAcceleration.Size() / MaxAccel, 1.0f) * AccelerationMagnitudeSteps) / AccelerationMagnitudeSteps;
+	if (Fraction <= 0.0f)
+	{
+		return FVector::ZeroVector;
+	}
+
+	const float StepDegrees = 360.0f / AccelerationDirectionSteps;
+	FRotator Direction = InAcceleration.Rotation();
+	Direction.Yaw = FMath::GridSnap(Direction.Yaw, StepDegrees);
+	Direction.Pitch = FMath::GridSnap(Direction.Pitch, StepDegrees);
+
+	return Direction.Vector() * (Fraction * MaxAccel);
+}
+
+void UThirdPersonMPMovementComponent::ReplicateMoveToServer(float DeltaTime, const FVector& NewAcceleration)
+{
+	++WindowMoves;
+	INC_DWORD_STAT(STAT_ThirdPersonMP_ClientMoves);
+
+	Super::ReplicateMoveToServer(DeltaTime, NewAcceleration);
+}
+
+void UThirdPersonMPMovementComponent::CallServerMove(const FSavedMove_Character* NewMove, const FSavedMove_Character* OldMove)
+{
+	//Tally the parameters of the RPC the base class is about to send. RPC and packet headers are not included.
+	//Shared parameters: client location, roll, movement base and bone name (counted as null and None), and movement mode.
+	int32 Bits = ThirdPersonMPMovement::MoveBits(*NewMove);
+	Bits += ThirdPersonMPMovement::QuantizedVectorBits<FVector_NetQuantize100>(NewMove->SavedLocation) + 8 + 8 + 8 + 8;
+
+	const FNetworkPredictionData_Client_Character* ClientData = GetPredictionData_Client_Character();
+	if (const FSavedMove_Character* PendingMove = ClientData->PendingMove.Get())
+	{
+		Bits += ThirdPersonMPMovement::MoveBits(*PendingMove);
+	}
+
+	if (OldMove)
+	{
+		Bits += 32 + ThirdPersonMPMovement::QuantizedVectorBits<FVector_NetQuantize10>(OldMove->Acceleration) + 8;
+	}
+
+	WindowBits += Bits;
+	INC_DWORD_STAT(STAT_ThirdPersonMP_ServerMoveCalls);
+
+	Super::CallServerMove(NewMove, OldMove);
+}
+
+bool UThirdPersonMPMovementComponent::ServerExceedsAllowablePositionError(float ClientTimeStamp, float DeltaTime, const FVector& Accel, const FVector& ClientWorldLocation, const FVector& RelativeClientLocation, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode)
+{
+	if (MaxClientPositionError <= 0.0f)
+	{
+		return Super::ServerExceedsAllowablePositionError(ClientTimeStamp, DeltaTime, Accel, ClientWorldLocation, RelativeClientLocation, ClientMovementBase, ClientBaseBoneName, ClientMovementMode);
+	}
+
+	//Same checks as the base class, with our own distance in place of the game network manager's.
+	if (PackNetworkMovementMode() != ClientMovementMode)
+	{
+		return true;
+	}
+
+	const FVector LocDiff = UpdatedComponent->GetComponentLocation() - ClientWorldLocation;
+	return LocDiff.SizeSquared() > FMath::Square(MaxClientPositionError);
+}
@@ -0,0 +1,78 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "ThirdPersonMPMovementComponent.generated.h"
+
+/**
+ * Saved move that stores its acceleration and control rotation on a coarse grid. Inputs that differ by less than a grid
+ * step produce identical moves, which the base class can then combine into a single ServerMove, and the client replays
+ * with exactly the rotation the server receives.
+ */
+class FSavedMove_ThirdPersonMP : public FSavedMove_Character
+{
+public:
+	typedef FSavedMove_Character Super;
+
+	virtual void SetMoveFor(ACharacter* Character, float InDeltaTime, FVector const& NewAccel, class FNetworkPredictionData_Client_Character& ClientData) override;
+};
+
+/** Client prediction data that allocates FSavedMove_ThirdPersonMP. */
+class FNetworkPredictionData_Client_ThirdPersonMP : public FNetworkPredictionData_Client_Character
+{
+public:
+	typedef FNetworkPredictionData_Client_Character Super;
+
+	FNetworkPredictionData_Client_ThirdPersonMP(const UCharacterMovementComponent& ClientMovement);
+
+	virtual FSavedMovePtr AllocateNewMove() override;
+};
+
+/**
+ * Character movement for AThirdPersonMPCharacter. Quantizes the moves the owning client sends so more of them combine,
+ * lets the server's correction threshold be tuned in config, and reports what each move costs upstream under stat ThirdPersonMP.
+ */
+UCLASS(config=Game)
+class THIRDPERSONMP_API UThirdPersonMPMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	UThirdPersonMPMovementComponent();
+
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+	virtual FNetworkPredictionData_Client* GetPredictionData_Client() const override;
+
+	/** Snaps an acceleration to AccelerationDirectionSteps headings and AccelerationMagnitudeSteps fractions of the max acceleration. */
+	FVector QuantizeAcceleration(const FVector& InAcceleration) const;
+
+	/** Average ServerMove payload per client move over the last second, in bytes. Owning client only. */
+	FORCEINLINE float GetBytesPerMove() const { return BytesPerMove; }
+
+	/** Number of headings an acceleration can point in. 128 keeps keyboard diagonals exact. */
+	UPROPERTY(Config, EditAnywhere, Category = "Character Movement (Networking)")
+	int32 AccelerationDirectionSteps;
+
+	/** Number of magnitudes an acceleration can have between zero and the max acceleration. */
+	UPROPERTY(Config, EditAnywhere, Category = "Character Movement (Networking)")
+	int32 AccelerationMagnitudeSteps;
+
+	/** Distance, in cm, between the client's and the server's location above which the server corrects the client. Zero uses the game network manager's MAXPOSITIONERRORSQUARED. */
+	UPROPERTY(Config, EditAnywhere, Category = "Character Movement (Networking)")
+	float MaxClientPositionError;
+
+protected:
+	virtual void ReplicateMoveToServer(float DeltaTime, const FVector& NewAcceleration) override;
+	virtual void CallServerMove(const FSavedMove_Character* NewMove, const FSavedMove_Character* OldMove) override;
+	virtual bool ServerExceedsAllowablePositionError(float ClientTimeStamp, float DeltaTime, const FVector& Accel, const FVector& ClientWorldLocation, const FVector& RelativeClientLocation, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode) override;
+
+private:
+	/** Client moves made and ServerMove payload bits sent since WindowStartTime. */
+	int32 WindowMoves;
+	int32 WindowBits;
+	float WindowStartTime;
+
+	float BytesPerMove;
+};
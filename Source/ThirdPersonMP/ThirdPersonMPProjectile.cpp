@@ -2,22 +2,41 @@
 
 
 #include "ThirdPersonMPProjectile.h"
+#include "ThirdPersonMP.h"
+#include "ProjectilePool.h"
+#include "ThirdPersonMPCharacter.h"
+#include "ThirdPersonMPGameMode.h"
+#include "LagCompensationManager.h"
+#include "GameplaySignificanceManager.h"
+#include "ImpactEffectManager.h"
+#include "CosmeticAssetLoader.h"
+#include "EmbedPlayerState.h"
+#include "MatchTelemetryRecorder.h"
+#include "FrameBudgetScheduler.h"
 
 //The first four are the components we are using while GamePlayStatics.h will give us access to basic gameplay functions, and ConstructorHelpers.h will give us access to some useful Constructor functions for setting up our components.
 #include "Components/SphereComponent.h"
 #include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "GameFramework/DamageType.h"
 #include "Particles/ParticleSystem.h"
 
 #include "Kismet/GameplayStatics.h"
 #include "UObject/ConstructorHelpers.h"
+#include "Net/UnrealNetwork.h"
+#include "Net/Core/PushModel/PushModel.h"
+#include "TimerManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("SweepRewoundPath"), STAT_ThirdPersonMP_SweepRewoundPath, STATGROUP_ThirdPersonMP);
 
 // Sets default values
 AThirdPersonMPProjectile::AThirdPersonMPProjectile()
 {
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	// Tick is only used to blend out a prediction correction on the owning client, so it starts disabled.
 	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
 
 	//The bReplicates variable tells the game that this Actor should replicate. By default, the Actor would only exist locally on the machine that spawns it. With bReplicates set to True, as long as an authoritative copy of the Actor exists on the server, it will try to replicate the Actor to all connected clients.
 	bReplicates = true;
@@ -25,13 +44,28 @@ AThirdPersonMPProjectile::AThirdPersonMPProjectile()
 	//These will initialize both the amount of Damage that the Projectile will deal to an Actor as well as the Damage Type that will be used in the damage event. Here we are initializing with the base UDamageType, as we have not yet defined any new Damage Types.
 	DamageType = UDamageType::StaticClass();
 	Damage = 10.0f;
+	MaxLifetime = 5.0f;
+	MaxRewindSweepDistance = 600.0f;
 
-	//This will set the asset reference for our ExplosionEffect to be the P_Explosion asset inside of StarterContent.
-	static ConstructorHelpers::FObjectFinder<UParticleSystem> DefaultExplosionEffect(TEXT("/Game/StarterContent/Particles/P_Explosion.P_Explosion"));
-	if (DefaultExplosionEffect.Succeeded())
-	{
-		ExplosionEffect = DefaultExplosionEffect.Object;
-	}
+	bAppliedActive = false;
+	AppliedGeneration = 0;
+
+	ShotId = 0;
+	ShooterTime = 0.0f;
+	LaunchTime = 0.0f;
+	LaunchLocation = FVector::ZeroVector;
+	DamageOverTimePerSecond = 0.0f;
+	DamageOverTimeDuration = 0.0f;
+	PredictionCorrectionTime = 0.1f;
+	bIsPredicted = false;
+	bPredictedImpacted = false;
+	bSuppressEffects = false;
+	MeshBaseLocation = FVector::ZeroVector;
+	CorrectionOffset = FVector::ZeroVector;
+	CorrectionTimeRemaining = 0.0f;
+
+	//This will set the asset reference for our ExplosionEffect to be the P_Explosion asset inside of StarterContent. It is a soft reference, so it is only loaded where it is needed.
+	ExplosionEffect = TSoftObjectPtr<UParticleSystem>(FSoftObjectPath(TEXT("/Game/StarterContent/Particles/P_Explosion.P_Explosion")));
 
 	//Definition for the SphereComponent that will serve as the Root component for the projectile and its collision.
 	//This will define the SphereComponent when the object is constructed, giving our Projectile collision.
@@ -43,24 +77,18 @@ AThirdPersonMPProjectile::AThirdPersonMPProjectile()
 	//Registering the Projectile Impact function on a Hit event.
 	//This will register the OnProjectileImpact function with the OnComponentHit event on the Sphere Component, which acts as the projectile's primary collision component. To make especially sure that only the server runs this gameplay logic, we check for Role == ROLE_Authority before registering OnProjectileImpact.
 	//underneath the line that reads RootComponent = SphereComponent
-	if (Role == ROLE_Authority)
+	if (GetLocalRole() == ROLE_Authority)
 	{
 		SphereComponent->OnComponentHit.AddDynamic(this, &AThirdPersonMPProjectile::OnProjectileImpact);
 	}
 
-	//This will define the StaticMeshComponent that we are using as a visual representation. It will automatically try to find the Shape_Sphere mesh inside of StarterContent and fill it in for us. The sphere will also be scaled so as to align with our SphereComponent in size.
+	//This will define the StaticMeshComponent that we are using as a visual representation. The Shape_Sphere mesh inside of StarterContent is filled in once it has loaded, on machines that render. The sphere will also be scaled so as to align with our SphereComponent in size.
 	//Definition for the Mesh that will serve as our visual representation.
-	static ConstructorHelpers::FObjectFinder<UStaticMesh> DefaultMesh(TEXT("/Game/StarterContent/Shapes/Shape_Sphere.Shape_Sphere"));
+	MeshAsset = TSoftObjectPtr<UStaticMesh>(FSoftObjectPath(TEXT("/Game/StarterContent/Shapes/Shape_Sphere.Shape_Sphere")));
 	StaticMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("Mesh"));
 	StaticMesh->SetupAttachment(RootComponent);
-
-	//Set the Static Mesh and its position/scale if we successfully found a mesh asset to use.
-	if (DefaultMesh.Succeeded())
-	{
-		StaticMesh->SetStaticMesh(DefaultMesh.Object);
-		StaticMesh->RelativeLocation = FVector(0.0f, 0.0f, -37.5f);
-		StaticMesh->RelativeScale3D = FVector(0.75f, 0.75f, 0.75f);
-	}
+	StaticMesh->RelativeLocation = FVector(0.0f, 0.0f, -37.5f);
+	StaticMesh->RelativeScale3D = FVector(0.75f, 0.75f, 0.75f);
 
 	//Definition for the Projectile Movement Component.
 	//This will define the Projectile Movement Component for our Projectile. This Component is replicated, and any movement that it performs on the server will be reproduced on clients.
@@ -73,30 +101,441 @@ AThirdPersonMPProjectile::AThirdPersonMPProjectile()
 
 }
 
+void AThirdPersonMPProjectile::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	MeshBaseLocation = StaticMesh->RelativeLocation;
+
+	UCosmeticAssetLoader::Request(MeshAsset.ToSoftObjectPath(), FStreamableDelegate::CreateUObject(this, &AThirdPersonMPProjectile::OnMeshLoaded));
+	UCosmeticAssetLoader::Request(ExplosionEffect.ToSoftObjectPath());
+}
+
+void AThirdPersonMPProjectile::OnMeshLoaded()
+{
+	if (StaticMesh->GetStaticMesh() == nullptr)
+	{
+		StaticMesh->SetStaticMesh(MeshAsset.Get());
+	}
+}
+
 // Called when the game starts or when spawned
 void AThirdPersonMPProjectile::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	LaunchTime = GetWorld()->GetTimeSeconds();
+	ShooterTime = LaunchTime;
+	LaunchLocation = GetActorLocation();
+
+	//An unpooled projectile replicates its launch state and times out like a pooled one, so its copies start from the same origin, a prediction can be fast-forwarded from it, and a shot that hit nothing still gets its rewound check before it goes. A pooled one is parked right after this and sets both on each launch.
+	if (HasAuthority() && !bIsPredicted)
+	{
+		PoolState.Origin = LaunchLocation;
+		PoolState.Direction = GetActorForwardVector();
+		MARK_PROPERTY_DIRTY_FROM_NAME(AThirdPersonMPProjectile, PoolState, this);
+
+		if (MaxLifetime > 0.0f)
+		{
+			GetWorldTimerManager().SetTimer(LifetimeTimer, this, &AThirdPersonMPProjectile::OnLifetimeExpired, MaxLifetime, false);
+		}
+	}
+
+	//Pooled projectiles live for the whole match, so they are registered once. Nothing on the server depends on their tick; the rewound checks run from impacts and timeouts.
+	AThirdPersonMPGameMode* GameMode = GetWorld()->GetAuthGameMode<AThirdPersonMPGameMode>();
+	if (AGameplaySignificanceManager* SignificanceManager = GameMode ? GameMode->GetSignificanceManager() : nullptr)
+	{
+		SignificanceManager->RegisterActor(this);
+	}
+}
+
+void AThirdPersonMPProjectile::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	AThirdPersonMPGameMode* GameMode = GetWorld()->GetAuthGameMode<AThirdPersonMPGameMode>();
+	if (AGameplaySignificanceManager* SignificanceManager = GameMode ? GameMode->GetSignificanceManager() : nullptr)
+	{
+		SignificanceManager->UnregisterActor(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 
-//This is the function that we are going to call when the Projectile impacts with an object. If the object it impacts with is a valid Actor, it will call the ApplyPointDamage function to damage it at the point where the collision takes place. Meanwhile, any collision regardless of the impacted surface will destroy this Actor, causing the explosion effect to appear.
+//This is the function that we are going to call when the Projectile impacts with an object. If the object it impacts with is a valid Actor, it will call the ApplyPointDamage function to damage it at the point where the collision takes place. Meanwhile, any collision regardless of the impacted surface will return this Actor to its pool (or destroy it, if unpooled), causing the explosion effect to appear.
 void AThirdPersonMPProjectile::OnProjectileImpact(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
 {
-	if (OtherActor)
+	THIRDPERSONMP_SCOPE(OnProjectileImpact);
+
+	if (bIsPredicted)
 	{
-		UGameplayStatics::ApplyPointDamage(OtherActor, Damage, NormalImpulse, Hit, Instigator->Controller, this, DamageType);
+		OnPredictedImpact();
+		return;
 	}
 
-	Destroy();
+	if (!HasAuthority() || !PoolState.bActive)
+	{
+		return;
+	}
+
+	//Characters are judged where they were when the shooter saw this part of the flight, not where the server has them now. Anything else is taken from the physics hit as before.
+	AActor* DamagedActor = OtherActor;
+	FHitResult DamageHit = Hit;
+	if (ALagCompensationManager* LagCompensation = GetLagCompensation())
+	{
+		//One bounded sweep of the flight leading up to this hit, so every impact costs the same however long the flight was.
+		FLagCompensatedHit RewoundHit;
+		if (SweepRewoundPath(Hit.Location, RewoundHit))
+		{
+			DamagedActor = RewoundHit.Actor;
+			DamageHit.ImpactPoint = RewoundHit.Location;
+		}
+		else if (LagCompensation->IsTracked(OtherActor))
+		{
+			//The flight missed this character as the shooter saw it, so it is only in the way now.
+			DamagedActor = nullptr;
+		}
+	}
+
+	ResolveImpact(DamagedActor, DamageHit, NormalImpulse);
+}
+
+ALagCompensationManager* AThirdPersonMPProjectile::GetLagCompensation() const
+{
+	if (bIsPredicted || !HasAuthority())
+	{
+		return nullptr;
+	}
+
+	AThirdPersonMPGameMode* GameMode = GetWorld()->GetAuthGameMode<AThirdPersonMPGameMode>();
+	return GameMode ? GameMode->GetLagCompensationManager() : nullptr;
 }
 
-//The Destroyed function is called any time an Actor is destroyed. Particle emitters themselves do not normally replicate, but since Actor destruction does replicate, we know that if we destroy this projectile on the server then this function will be called on each connected client when they destroy their own copies of it. As a result, all players will see the explosion effect when the projectile is destroyed.
+bool AThirdPersonMPProjectile::SweepRewoundPath(const FVector& End, FLagCompensatedHit& OutHit) const
+{
+	ALagCompensationManager* LagCompensation = GetLagCompensation();
+	if (LagCompensation == nullptr)
+	{
+		return false;
+	}
+
+	THIRDPERSONMP_SCOPE(SweepRewoundPath);
+
+	//Projectiles fly straight, so the flight is the line from the launch to End.
+	const FVector FromLaunch = End - LaunchLocation;
+	const float Length = FMath::Min(FromLaunch.Size(), MaxRewindSweepDistance);
+	const FVector Start = End - FromLaunch.GetSafeNormal() * Length;
+
+	const float RewindTime = LagCompensation->ClampRewindTime(ShooterTime + (GetWorld()->GetTimeSeconds() - LaunchTime));
+	return LagCompensation->RewindSweep(Start, End, SphereComponent->GetScaledSphereRadius(), RewindTime, GetOwner(), OutHit);
+}
+
+void AThirdPersonMPProjectile::ResolveRewoundHit(const FLagCompensatedHit& RewoundHit)
+{
+	//The projectile has already flown past the point, so bring it back for the explosion.
+	const FVector Direction = ProjectileMovementComponent->Velocity.GetSafeNormal();
+	SetActorLocation(RewoundHit.Location, false, nullptr, ETeleportType::TeleportPhysics);
+	ResolveImpact(RewoundHit.Actor, FHitResult(RewoundHit.Actor, nullptr, RewoundHit.Location, -Direction), Direction);
+}
+
+void AThirdPersonMPProjectile::ResolveImpact(AActor* DamagedActor, const FHitResult& DamageHit, const FVector& HitFromDirection)
+{
+	ApplyImpactDamage(this, GetOwner(), GetInstigatorController(), DamagedActor, DamageHit, HitFromDirection, LaunchLocation);
+	ReturnToPool();
+}
+
+void AThirdPersonMPProjectile::ApplyImpactDamage(AActor* DamageCauser, AActor* Shooter, AController* InstigatorController, AActor* DamagedActor, const FHitResult& DamageHit, const FVector& HitFromDirection, const FVector& FromLocation) const
+{
+	FThirdPersonMPModule::CountEvent(EThirdPersonMPEvent::ProjectileImpact);
+
+	AThirdPersonMPGameMode* GameMode = DamageCauser->GetWorld()->GetAuthGameMode<AThirdPersonMPGameMode>();
+	float AppliedDamage = 0.0f;
+	if (DamagedActor)
+	{
+		const float FalloffScale = RangeFalloff.Evaluate(FVector::Dist(FromLocation, DamageHit.ImpactPoint));
+		AppliedDamage = Damage * FalloffScale;
+		UGameplayStatics::ApplyPointDamage(DamagedActor, AppliedDamage, HitFromDirection, DamageHit, InstigatorController, DamageCauser, DamageType);
+		AEmbedPlayerState::RecordHit(InstigatorController, DamagedActor, AppliedDamage);
+
+		//The hit itself lands this frame. The damage over time it starts can wait for spare frame time, in one piece of work per impact.
+		AThirdPersonMPCharacter* DamagedCharacter = Cast<AThirdPersonMPCharacter>(DamagedActor);
+		if (DamagedCharacter && DamageOverTimePerSecond > 0.0f)
+		{
+			TWeakObjectPtr<ADamageManager> WeakDamageManager = GameMode ? GameMode->GetDamageManager() : nullptr;
+			TWeakObjectPtr<AThirdPersonMPCharacter> WeakDamagedCharacter = DamagedCharacter;
+			const float DamagePerSecond = DamageOverTimePerSecond * FalloffScale;
+			const float Duration = DamageOverTimeDuration;
+			AFrameBudgetScheduler::Defer(DamageCauser, EDeferredWorkPriority::Normal, [WeakDamageManager, WeakDamagedCharacter, DamagePerSecond, Duration]()
+			{
+				if (ADamageManager* DamageManager = WeakDamageManager.Get())
+				{
+					DamageManager->AddDamageOverTime(WeakDamagedCharacter.Get(), DamagePerSecond, Duration);
+				}
+			});
+		}
+	}
+
+	if (AMatchTelemetryRecorder* Telemetry = GameMode ? GameMode->GetTelemetryRecorder() : nullptr)
+	{
+		Telemetry->RecordImpact(Shooter, DamagedActor, DamageHit.ImpactPoint, AppliedDamage);
+	}
+}
+
+//The Destroyed function is called any time an Actor is destroyed. Particle emitters themselves do not normally replicate, but since Actor destruction does replicate, we know that if we destroy this projectile on the server then this function will be called on each connected client when they destroy their own copies of it. As a result, all players will see the explosion effect when the projectile is destroyed. Pooled projectiles are not destroyed per shot; they play the same effect from ApplyPoolState when they are parked instead.
 void AThirdPersonMPProjectile::Destroyed()
 {
+	THIRDPERSONMP_SCOPE(ProjectileDestroyed);
+
+	if (PoolState.bActive)
+	{
+		PlayExplosionEffect();
+	}
+}
+
+void AThirdPersonMPProjectile::PlayExplosionEffect()
+{
+	if (bSuppressEffects)
+	{
+		return;
+	}
+
+	//Effects are pooled and culled by the impact effect manager, and skipped entirely on a dedicated server.
 	FVector spawnLocation = GetActorLocation();
-	UGameplayStatics::SpawnEmitterAtLocation(this, ExplosionEffect, spawnLocation, FRotator::ZeroRotator, true, EPSCPoolMethod::AutoRelease);
+	AImpactEffectManager::PlayImpactEffect(this, ExplosionEffect.Get(), spawnLocation);
+}
+
+void AThirdPersonMPProjectile::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	//Both only change when a pooled projectile is launched or parked, so they are push based and marked dirty there
+	FDoRepLifetimeParams PushParams;
+	PushParams.bIsPushBased = true;
+	DOREPLIFETIME_WITH_PARAMS_FAST(AThirdPersonMPProjectile, PoolState, PushParams);
+
+	PushParams.Condition = COND_OwnerOnly;
+	DOREPLIFETIME_WITH_PARAMS_FAST(AThirdPersonMPProjectile, ShotId, PushParams);
+}
+
+//Pooled projectiles stay net dormant for their whole life. Clients simulate flight locally from the launch state, so each change of PoolState only needs a single flush of dormancy rather than an open actor channel.
+void AThirdPersonMPProjectile::InitPooled(AProjectilePool* Pool)
+{
+	OwningPool = Pool;
+	SetNetDormancy(DORM_DormantAll);
+	DeactivateToPool();
+}
+
+void AThirdPersonMPProjectile::ActivateFromPool(const FVector& Location, const FRotator& Rotation, AActor* NewOwner, APawn* NewInstigator, uint16 InShotId)
+{
+	SetOwner(NewOwner);
+	SetInstigator(NewInstigator);
+	ShotId = InShotId;
+	MARK_PROPERTY_DIRTY_FROM_NAME(AThirdPersonMPProjectile, ShotId, this);
+
+	LaunchTime = GetWorld()->GetTimeSeconds();
+	ShooterTime = LaunchTime;
+	LaunchLocation = Location;
+
+	PoolState.Origin = Location;
+	PoolState.Direction = Rotation.Vector();
+	PoolState.Generation++;
+	PoolState.bActive = true;
+	MARK_PROPERTY_DIRTY_FROM_NAME(AThirdPersonMPProjectile, PoolState, this);
+	ApplyPoolState();
+	FlushNetDormancy();
+
+	if (MaxLifetime > 0.0f)
+	{
+		GetWorldTimerManager().SetTimer(LifetimeTimer, this, &AThirdPersonMPProjectile::OnLifetimeExpired, MaxLifetime, false);
+	}
+
+	//Registered once in BeginPlay, so a parked projectile may have dropped to a low tier; a relaunch brings it back to full rate.
+	AThirdPersonMPGameMode* GameMode = GetWorld()->GetAuthGameMode<AThirdPersonMPGameMode>();
+	if (AGameplaySignificanceManager* SignificanceManager = GameMode ? GameMode->GetSignificanceManager() : nullptr)
+	{
+		SignificanceManager->NotifyActivity(this);
+	}
+}
+
+void AThirdPersonMPProjectile::DeactivateToPool()
+{
+	GetWorldTimerManager().ClearTimer(LifetimeTimer);
+	SetActorTickEnabled(false);
+
+	PoolState.bActive = false;
+	MARK_PROPERTY_DIRTY_FROM_NAME(AThirdPersonMPProjectile, PoolState, this);
+	ApplyPoolState();
+	FlushNetDormancy();
+}
+
+void AThirdPersonMPProjectile::ReturnToPool()
+{
+	if (AProjectilePool* Pool = OwningPool.Get())
+	{
+		Pool->Release(this);
+	}
+	else
+	{
+		Destroy();
+	}
+}
+
+void AThirdPersonMPProjectile::SetShotId(uint16 InShotId)
+{
+	ShotId = InShotId;
+	MARK_PROPERTY_DIRTY_FROM_NAME(AThirdPersonMPProjectile, ShotId, this);
+}
+
+void AThirdPersonMPProjectile::SetShooterTime(float InShooterTime)
+{
+	ShooterTime = InShooterTime;
+}
+
+void AThirdPersonMPProjectile::OnLifetimeExpired()
+{
+	//A shot that ran out of time may still have passed through a character as the shooter saw it.
+	FLagCompensatedHit RewoundHit;
+	if (SweepRewoundPath(GetActorLocation(), RewoundHit))
+	{
+		ResolveRewoundHit(RewoundHit);
+		return;
+	}
+
+	ReturnToPool();
+}
+
+void AThirdPersonMPProjectile::OnRep_PoolState()
+{
+	ApplyPoolState();
+}
+
+void AThirdPersonMPProjectile::ApplyPoolState()
+{
+	//A shot that was in flight locally has ended, either because the projectile was parked or because it was parked and relaunched before this copy saw the park.
+	if (bAppliedActive && (!PoolState.bActive || PoolState.Generation != AppliedGeneration))
+	{
+		PlayExplosionEffect();
+	}
+
+	if (PoolState.bActive)
+	{
+		bSuppressEffects = false;
+
+		const FVector Direction = PoolState.Direction;
+		SetActorLocationAndRotation(PoolState.Origin, Direction.Rotation(), false, nullptr, ETeleportType::TeleportPhysics);
+		SetActorHiddenInGame(false);
+		SetActorEnableCollision(true);
+
+		ProjectileMovementComponent->SetUpdatedComponent(SphereComponent);
+		ProjectileMovementComponent->Velocity = Direction * ProjectileMovementComponent->InitialSpeed;
+		ProjectileMovementComponent->UpdateComponentVelocity();
+		ProjectileMovementComponent->SetComponentTickEnabled(true);
+	}
+	else
+	{
+		ProjectileMovementComponent->StopMovementImmediately();
+		ProjectileMovementComponent->SetComponentTickEnabled(false);
+		SetActorHiddenInGame(true);
+		SetActorEnableCollision(false);
+	}
+
+	const bool bNewShot = PoolState.bActive && (!bAppliedActive || PoolState.Generation != AppliedGeneration);
+	bAppliedActive = PoolState.bActive;
+	AppliedGeneration = PoolState.Generation;
+
+	if (bNewShot && !HasAuthority())
+	{
+		ReconcileWithPrediction();
+	}
+}
+
+//Copies whose initial replication carried no launch state reconcile once it has arrived.
+void AThirdPersonMPProjectile::PostNetInit()
+{
+	Super::PostNetInit();
+
+	if (PoolState.bActive && !bAppliedActive)
+	{
+		ReconcileWithPrediction();
+	}
+}
+
+void AThirdPersonMPProjectile::ReconcileWithPrediction()
+{
+	AThirdPersonMPCharacter* Shooter = Cast<AThirdPersonMPCharacter>(GetOwner());
+	if (Shooter && Shooter->IsLocallyControlled())
+	{
+		Shooter->ReconcilePredictedProjectile(this);
+	}
+}
+
+//Predicted projectiles are spawned by the owning client the moment it fires. They never deal damage; they only exist so the shot appears without waiting a round trip for the server's projectile.
+void AThirdPersonMPProjectile::InitPredicted(uint16 InShotId, const FVector& Origin, float Timeout)
+{
+	bIsPredicted = true;
+	ShotId = InShotId;
+	PoolState.Origin = Origin;
+
+	//Not InitialLifeSpan: a lifespan destroys the actor with effects on, and an unconfirmed shot would explode in mid-air.
+	if (Timeout > 0.0f)
+	{
+		GetWorldTimerManager().SetTimer(LifetimeTimer, this, &AThirdPersonMPProjectile::CancelPrediction, Timeout, false);
+	}
+}
+
+void AThirdPersonMPProjectile::OnPredictedImpact()
+{
+	if (bPredictedImpacted)
+	{
+		return;
+	}
+
+	//Show the explosion now and keep the hidden copy around, so the server's copy can be told not to show it again.
+	PlayExplosionEffect();
+	bPredictedImpacted = true;
+	bSuppressEffects = true;
+
+	ProjectileMovementComponent->StopMovementImmediately();
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+}
+
+void AThirdPersonMPProjectile::CancelPrediction()
+{
+	bSuppressEffects = true;
+	Destroy();
+}
+
+void AThirdPersonMPProjectile::TakeOverFromPrediction(AThirdPersonMPProjectile* Predicted)
+{
+	if (Predicted->bPredictedImpacted)
+	{
+		//The prediction already hit and exploded. The server's copy follows the same path, so it stays invisible.
+		bSuppressEffects = true;
+		ProjectileMovementComponent->StopMovementImmediately();
+		SetActorHiddenInGame(true);
+		SetActorEnableCollision(false);
+	}
+	else
+	{
+		//Fast-forward from the server's origin by the distance the prediction has already covered, then blend out whatever difference is left. Not from the current location, which a copy reconciled after its initial replication has already moved along.
+		const FVector Direction = GetActorForwardVector();
+		const float Travelled = FVector::Dist(Predicted->PoolState.Origin, Predicted->GetActorLocation());
+		const FVector FastForwardLocation = PoolState.Origin + Direction * Travelled;
+		SetActorLocation(FastForwardLocation, false, nullptr, ETeleportType::TeleportPhysics);
+
+		CorrectionOffset = Predicted->GetActorLocation() - FastForwardLocation;
+		CorrectionTimeRemaining = PredictionCorrectionTime;
+		ApplyCorrectionOffset(CorrectionOffset);
+		SetActorTickEnabled(CorrectionTimeRemaining > 0.0f);
+	}
+
+	Predicted->bSuppressEffects = true;
+	Predicted->Destroy();
+}
+
+void AThirdPersonMPProjectile::ApplyCorrectionOffset(const FVector& WorldOffset)
+{
+	StaticMesh->SetRelativeLocation(MeshBaseLocation + GetActorTransform().InverseTransformVectorNoScale(WorldOffset));
 }
 
 // Called every frame
@@ -104,5 +543,15 @@ void AThirdPersonMPProjectile::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	if (CorrectionTimeRemaining > 0.0f)
+	{
+		CorrectionTimeRemaining = FMath::Max(CorrectionTimeRemaining - DeltaTime, 0.0f);
+		ApplyCorrectionOffset(CorrectionOffset * (CorrectionTimeRemaining / PredictionCorrectionTime));
+
+		if (CorrectionTimeRemaining <= 0.0f)
+		{
+			SetActorTickEnabled(false);
+		}
+	}
 }
 
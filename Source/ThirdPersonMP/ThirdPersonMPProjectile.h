@@ -4,8 +4,45 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Engine/NetSerialization.h"
+#include "DamageManager.h"
 #include "ThirdPersonMPProjectile.generated.h"
 
+class AProjectilePool;
+class ALagCompensationManager;
+struct FLagCompensatedHit;
+
+/** Launch state of a projectile. Replicated as a single struct so clients see activation and parking atomically. */
+USTRUCT()
+struct FProjectilePoolState
+{
+	GENERATED_BODY()
+
+	/** Where the projectile was launched from. */
+	UPROPERTY()
+	FVector_NetQuantize Origin;
+
+	/** Direction the projectile was launched in. */
+	UPROPERTY()
+	FVector_NetQuantizeNormal Direction;
+
+	/** Incremented every time the projectile is handed out, so that a park and re-launch within one net update is still seen as two shots. */
+	UPROPERTY()
+	uint8 Generation;
+
+	/** True while the projectile is in flight, false while it is parked in the pool. */
+	UPROPERTY()
+	bool bActive;
+
+	FProjectilePoolState()
+		: Origin(ForceInitToZero)
+		, Direction(ForceInitToZero)
+		, Generation(0)
+		, bActive(true)
+	{
+	}
+};
+
 UCLASS()
 class THIRDPERSONMP_API AThirdPersonMPProjectile : public AActor
 {
@@ -32,8 +69,13 @@ public:
 
 	// Particle used when the projectile impacts against another object and explodes.
 	//A Particle System reference that we are going to use to spawn an explosion effect in a later step.
+	//Soft references so a dedicated server never loads them. Loaded through UCosmeticAssetLoader on machines that render.
 	UPROPERTY(EditAnywhere, Category = "Effects")
-	class UParticleSystem* ExplosionEffect;
+	TSoftObjectPtr<class UParticleSystem> ExplosionEffect;
+
+	/** Mesh shown by StaticMesh, loaded on machines that render. */
+	UPROPERTY(EditDefaultsOnly, Category = "Effects")
+	TSoftObjectPtr<class UStaticMesh> MeshAsset;
 
 	//The damage type and damage that will be done by this projectile
 	//A Damage Type for use in damage events.
@@ -45,15 +87,168 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Damage")
 	float Damage;
 
+	/** Scales Damage, and any damage over time, by the distance the projectile travelled before it hit. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Damage")
+	FDamageFalloff RangeFalloff;
+
+	/** Damage per second a hit character keeps taking after the impact, for DamageOverTimeDuration seconds. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Damage")
+	float DamageOverTimePerSecond;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Damage")
+	float DamageOverTimeDuration;
+
+	/** Seconds a projectile may fly without hitting anything before it is returned to the pool (or destroyed, if unpooled). */
+	UPROPERTY(EditDefaultsOnly, Category = "Projectile")
+	float MaxLifetime;
+
+	/** Longest stretch of flight, ending where the projectile hit or timed out, checked against characters as the shooter saw them. */
+	UPROPERTY(EditDefaultsOnly, Category = "Projectile")
+	float MaxRewindSweepDistance;
+
+	/** Property replication */
+	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/** Marks this projectile as owned by Pool and parks it. Called once by the pool right after spawning. */
+	void InitPooled(AProjectilePool* Pool);
+
+	/** Launches a parked projectile from Location along Rotation for shot ShotId. Server only. */
+	void ActivateFromPool(const FVector& Location, const FRotator& Rotation, AActor* NewOwner, APawn* NewInstigator, uint16 InShotId);
+
+	/** Stops, hides and disables collision on the projectile so it can sit in the pool. Server only. */
+	void DeactivateToPool();
+
+	/** Returns the projectile to its pool, or destroys it if it is not pooled. Server only. */
+	void ReturnToPool();
+
+	/** Returns true if this projectile is owned by a pool. Only meaningful on the server. */
+	FORCEINLINE bool IsPooled() const { return OwningPool.IsValid(); }
+
+	/** Returns true while the projectile is in flight. */
+	FORCEINLINE bool IsActive() const { return PoolState.bActive; }
+
+	/** Sets the fire command sequence this projectile was spawned for. Server only, before the projectile first replicates. */
+	void SetShotId(uint16 InShotId);
+
+	/** Sets the server time at which the shooter fired, as reported in its fire command. Impacts are judged against where characters were at that time plus the flight time. Server only. */
+	void SetShooterTime(float InShooterTime);
+
+	/** Returns the fire command sequence this projectile was spawned for. */
+	FORCEINLINE uint16 GetShotId() const { return ShotId; }
+
+	/** Returns true for a cosmetic copy spawned locally by the owning client ahead of the server's projectile. */
+	FORCEINLINE bool IsPredicted() const { return bIsPredicted; }
+
+	/** Turns a freshly spawned local projectile into a cosmetic prediction of shot InShotId fired from Origin, removed without exploding after Timeout seconds if the server never confirms it. Call before FinishSpawning. */
+	void InitPredicted(uint16 InShotId, const FVector& Origin, float Timeout);
+
+	/** Removes a predicted copy without playing its explosion, for a shot the server rejected. */
+	void CancelPrediction();
+
+	/** Replaces Predicted with this authoritative copy on the owning client, fast-forwarding along the server's path and blending out the difference. */
+	void TakeOverFromPrediction(AThirdPersonMPProjectile* Predicted);
+
+	/**
+	 * Damages DamagedActor, if any, for a hit at DamageHit on a flight launched from FromLocation, with this projectile's range falloff and damage over time, and records the impact.
+	 * Shared with the batched simulation, which calls it on the class default object. Server only.
+	 */
+	void ApplyImpactDamage(AActor* DamageCauser, AActor* Shooter, AController* InstigatorController, AActor* DamagedActor, const FHitResult& DamageHit, const FVector& HitFromDirection, const FVector& FromLocation) const;
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	virtual void Destroyed() override;
 
+	virtual void PostInitializeComponents() override;
+	virtual void PostNetInit() override;
+
 	UFUNCTION(Category = "Projectile")
 	void OnProjectileImpact(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
 
+	/** Returns the lag compensation of the server this projectile flies on, or nullptr on clients and for predictions. */
+	ALagCompensationManager* GetLagCompensation() const;
+
+	/** Sweeps the last stretch of the flight up to End, at most MaxRewindSweepDistance long, against the characters as the shooter saw them. Server only. */
+	bool SweepRewoundPath(const FVector& End, FLagCompensatedHit& OutHit) const;
+
+	/** Resolves a hit found by SweepRewoundPath short of where the projectile is, at the point on the flight where it happened. Server only. */
+	void ResolveRewoundHit(const FLagCompensatedHit& RewoundHit);
+
+	/** Damages DamagedActor, if any, for a hit at DamageHit, records the impact, and returns the projectile to its pool. Server only. */
+	void ResolveImpact(AActor* DamagedActor, const FHitResult& DamageHit, const FVector& HitFromDirection);
+
+	/** Replicated launch state, set once for unpooled projectiles and on every launch and park for pooled ones. Push-model replicated, so mark it dirty wherever it is written. */
+	UPROPERTY(ReplicatedUsing = OnRep_PoolState)
+	FProjectilePoolState PoolState;
+
+	/** RepNotify for PoolState. */
+	UFUNCTION()
+	void OnRep_PoolState();
+
+	/** Brings the local copy in line with PoolState, playing the explosion for a shot that ended. */
+	void ApplyPoolState();
+
+	/** Spawns the explosion effect at the current location. */
+	void PlayExplosionEffect();
+
+	/** Puts MeshAsset on StaticMesh once it has loaded. */
+	void OnMeshLoaded();
+
+	/** Timer callback for MaxLifetime. */
+	void OnLifetimeExpired();
+
+	/** Lets the owning local character match this authoritative copy against its prediction. Client only. */
+	void ReconcileWithPrediction();
+
+	/** Hides a predicted copy where it hit, after playing its explosion, until the server's copy arrives or it times out. */
+	void OnPredictedImpact();
+
+	/** Offsets the visible mesh by WorldOffset from where the collision sphere is. */
+	void ApplyCorrectionOffset(const FVector& WorldOffset);
+
+	/** Seconds over which the owning client blends from its predicted projectile to the authoritative one. */
+	UPROPERTY(EditDefaultsOnly, Category = "Projectile")
+	float PredictionCorrectionTime;
+
+	/** Fire command sequence this projectile was spawned for. Only the owning client needs it, to match its prediction. */
+	UPROPERTY(Replicated)
+	uint16 ShotId;
+
+	/** Server time at which the shooter fired, and the server time at which this projectile was launched. */
+	float ShooterTime;
+	float LaunchTime;
+
+	/** Where the projectile was launched from, for range falloff. Server only. */
+	FVector LaunchLocation;
+
+	/** True for a local cosmetic prediction, false for the server's projectile and its replicated copies. */
+	bool bIsPredicted;
+
+	/** True once a predicted copy has hit something locally. */
+	bool bPredictedImpacted;
+
+	/** Suppresses the explosion and visuals of the current shot, because its prediction already showed them. */
+	bool bSuppressEffects;
+
+	/** Mesh location relative to the root before any correction offset. */
+	FVector MeshBaseLocation;
+
+	/** Remaining prediction correction, blended to zero over PredictionCorrectionTime. */
+	FVector CorrectionOffset;
+	float CorrectionTimeRemaining;
+
+	/** Pool that owns this projectile, if any. */
+	TWeakObjectPtr<AProjectilePool> OwningPool;
+
+	/** Timer handle for MaxLifetime while the projectile is in flight, or for the confirmation timeout of a prediction. */
+	FTimerHandle LifetimeTimer;
+
+	/** Whether the local copy is currently launched, and for which generation. */
+	bool bAppliedActive;
+	uint8 AppliedGeneration;
+
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
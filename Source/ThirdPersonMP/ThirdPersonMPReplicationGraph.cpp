@@ -0,0 +1,548 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "ThirdPersonMPReplicationGraph.h"
+#include "ThirdPersonMP.h"
+#include "ThirdPersonMPCharacter.h"
+#include "ThirdPersonMPProjectile.h"
+#include "EmbedGameStateBase.h"
+#include "EmbedPlayerState.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/WorldSettings.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Net Throttled Actors"), STAT_ThirdPersonMP_NetThrottledActors, STATGROUP_ThirdPersonMP);
+
+UThirdPersonMPReplicationGraph::UThirdPersonMPReplicationGraph()
+{
+	GridCellSize = 10000.0f;
+	SpatialBiasX = -150000.0f;
+	SpatialBiasY = -200000.0f;
+	CharacterCullDistance = 15000.0f;
+	ProjectileCullDistance = 5000.0f;
+
+	BandwidthBudgetFraction = 0.9f;
+	MinBandwidth = 8000.0f;
+	BandwidthIncreasePerSecond = 2000.0f;
+	BandwidthDecreaseFactor = 0.85f;
+	SaturatedFrameFraction = 0.1f;
+	PrioritizeIntervalFrames = 10;
+	ProtectedDistance = 3000.0f;
+	MaxPeriodMultiplier = 8;
+	InFrontPriorityScale = 2.0f;
+	BehindPriorityScale = 0.5f;
+	RecentDamageTime = 3.0f;
+	RecentDamagePriorityScale = 2.0f;
+	AttackerPriorityScale = 3.0f;
+	OwnedBytesPerUpdate = 40.0f;
+	CharacterBytesPerUpdate = 60.0f;
+	ProjectileBytesPerUpdate = 30.0f;
+}
+
+FClassReplicationInfo UThirdPersonMPReplicationGraph::MakeClassInfo(UClass* Class) const
+{
+	const AActor* ActorCDO = GetDefault<AActor>(Class);
+
+	FClassReplicationInfo ClassInfo;
+	ClassInfo.CullDistanceSquared = ActorCDO->NetCullDistanceSquared;
+	ClassInfo.ReplicationPeriodFrame = GetReplicationPeriodFrame(ActorCDO->NetUpdateFrequency);
+	return ClassInfo;
+}
+
+uint32 UThirdPersonMPReplicationGraph::GetReplicationPeriodFrame(float NetUpdateFrequency) const
+{
+	const float ServerMaxTickRate = NetDriver ? (float)NetDriver->NetServerMaxTickRate : 30.0f;
+	return FMath::Max<uint32>((uint32)FMath::RoundToFloat(ServerMaxTickRate / FMath::Max(NetUpdateFrequency, 1.0f)), 1);
+}
+
+void UThirdPersonMPReplicationGraph::SetActorNetUpdateFrequency(AActor* Actor, float NetUpdateFrequency)
+{
+	Actor->NetUpdateFrequency = NetUpdateFrequency;
+
+	const uint32 ReplicationPeriodFrame = GetReplicationPeriodFrame(NetUpdateFrequency);
+	if (FGlobalActorReplicationInfo* GlobalInfo = GlobalActorReplicationInfoMap.Find(Actor))
+	{
+		GlobalInfo->Settings.ReplicationPeriodFrame = ReplicationPeriodFrame;
+	}
+
+	//Connections copy the period when they first see the actor, so ones that already have must be told too. Their
+	//prioritizers own their periods and keep any slowdown on top.
+	for (const TWeakObjectPtr<UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer>& Prioritizer : BandwidthPrioritizers)
+	{
+		if (Prioritizer.IsValid())
+		{
+			Prioritizer->SetBasePeriod(Actor, ReplicationPeriodFrame);
+		}
+	}
+}
+
+EThirdPersonMPNetCategory UThirdPersonMPReplicationGraph::GetNetCategory(const AActor* Actor, const UNetConnection* Connection) const
+{
+	if (Connection && (Actor == Connection->ViewTarget || Actor->GetNetConnection() == Connection))
+	{
+		return EThirdPersonMPNetCategory::Owned;
+	}
+	if (Actor->IsA<AThirdPersonMPCharacter>())
+	{
+		return EThirdPersonMPNetCategory::Character;
+	}
+	if (Actor->IsA<AThirdPersonMPProjectile>())
+	{
+		return EThirdPersonMPNetCategory::Projectile;
+	}
+	return EThirdPersonMPNetCategory::Other;
+}
+
+float UThirdPersonMPReplicationGraph::GetActorPriority(const AActor* Actor, const FVector& ViewLocation, const FVector& ViewDirection, const AActor* ViewTarget, const APawn* LastAttacker, bool bOwnedByViewer) const
+{
+	if (bOwnedByViewer)
+	{
+		return BIG_NUMBER;
+	}
+
+	float Priority = Actor->NetPriority;
+
+	//Falls off linearly to a fifth at the class's cull distance, as the engine's distance scaling does
+	const FVector ToActor = Actor->GetActorLocation() - ViewLocation;
+	const float CullDistance = Actor->IsA<AThirdPersonMPProjectile>() ? ProjectileCullDistance : CharacterCullDistance;
+	Priority *= FMath::Lerp(1.0f, 0.2f, FMath::Clamp(ToActor.Size() / FMath::Max(CullDistance, 1.0f), 0.0f, 1.0f));
+
+	const float ViewDot = ToActor.GetSafeNormal() | ViewDirection;
+	Priority *= FMath::Lerp(BehindPriorityScale, InFrontPriorityScale, (ViewDot + 1.0f) * 0.5f);
+
+	if (const AThirdPersonMPCharacter* Character = Cast<AThirdPersonMPCharacter>(Actor))
+	{
+		if (Actor->GetWorld()->GetTimeSeconds() - Character->GetLastDamageTakenTime() < RecentDamageTime)
+		{
+			Priority *= RecentDamagePriorityScale;
+		}
+		if (Actor == LastAttacker)
+		{
+			Priority *= AttackerPriorityScale;
+		}
+	}
+
+	return Priority;
+}
+
+float UThirdPersonMPReplicationGraph::GetBytesPerUpdate(EThirdPersonMPNetCategory Category) const
+{
+	switch (Category)
+	{
+	case EThirdPersonMPNetCategory::Owned:
+		return OwnedBytesPerUpdate;
+	case EThirdPersonMPNetCategory::Character:
+		return CharacterBytesPerUpdate;
+	case EThirdPersonMPNetCategory::Projectile:
+		return ProjectileBytesPerUpdate;
+	default:
+		return 0.0f;
+	}
+}
+
+const FThirdPersonMPConnectionBandwidth* UThirdPersonMPReplicationGraph::GetConnectionBandwidth(const UNetConnection* Connection) const
+{
+	for (const TWeakObjectPtr<UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer>& Prioritizer : BandwidthPrioritizers)
+	{
+		if (Prioritizer.IsValid() && Prioritizer->NetConnection == Connection)
+		{
+			return &Prioritizer->GetBandwidth();
+		}
+	}
+	return nullptr;
+}
+
+void UThirdPersonMPReplicationGraph::InitGlobalActorClassSettings()
+{
+	Super::InitGlobalActorClassSettings();
+
+	//Explicit routing for the classes this project cares about. Everything else is derived from its CDO in GetMappingPolicy.
+	ClassRepNodePolicies.Set(AThirdPersonMPCharacter::StaticClass(), EThirdPersonMPClassRepNodeMapping::Spatialize_Dynamic);
+	ClassRepNodePolicies.Set(AThirdPersonMPProjectile::StaticClass(), EThirdPersonMPClassRepNodeMapping::Spatialize_Dormancy);
+	ClassRepNodePolicies.Set(AEmbedGameStateBase::StaticClass(), EThirdPersonMPClassRepNodeMapping::AlwaysRelevant);
+	ClassRepNodePolicies.Set(AWorldSettings::StaticClass(), EThirdPersonMPClassRepNodeMapping::AlwaysRelevant);
+	//Every client needs every player state for GameState->PlayerArray, player names and remote pawns' PlayerState. They update at 1 Hz and stay dormant between changes, so the global list costs little.
+	ClassRepNodePolicies.Set(APlayerState::StaticClass(), EThirdPersonMPClassRepNodeMapping::AlwaysRelevant);
+	ClassRepNodePolicies.Set(APlayerController::StaticClass(), EThirdPersonMPClassRepNodeMapping::NotRouted);
+
+	GlobalActorReplicationInfoMap.SetClassInfo(AActor::StaticClass(), MakeClassInfo(AActor::StaticClass()));
+
+	FClassReplicationInfo CharacterClassInfo = MakeClassInfo(AThirdPersonMPCharacter::StaticClass());
+	CharacterClassInfo.CullDistanceSquared = FMath::Square(CharacterCullDistance);
+	GlobalActorReplicationInfoMap.SetClassInfo(AThirdPersonMPCharacter::StaticClass(), CharacterClassInfo);
+
+	FClassReplicationInfo ProjectileClassInfo = MakeClassInfo(AThirdPersonMPProjectile::StaticClass());
+	ProjectileClassInfo.CullDistanceSquared = FMath::Square(ProjectileCullDistance);
+	GlobalActorReplicationInfoMap.SetClassInfo(AThirdPersonMPProjectile::StaticClass(), ProjectileClassInfo);
+
+	GlobalActorReplicationInfoMap.SetClassInfo(AEmbedGameStateBase::StaticClass(), MakeClassInfo(AEmbedGameStateBase::StaticClass()));
+	GlobalActorReplicationInfoMap.SetClassInfo(AEmbedPlayerState::StaticClass(), MakeClassInfo(AEmbedPlayerState::StaticClass()));
+}
+
+void UThirdPersonMPReplicationGraph::InitGlobalGraphNodes()
+{
+	GridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D>();
+	GridNode->CellSize = GridCellSize;
+	GridNode->SpatialBias = FVector2D(SpatialBiasX, SpatialBiasY);
+	AddGlobalGraphNode(GridNode);
+
+	AlwaysRelevantNode = CreateNewNode<UReplicationGraphNode_ActorList>();
+	AddGlobalGraphNode(AlwaysRelevantNode);
+}
+
+void UThirdPersonMPReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+{
+	Super::InitConnectionGraphNodes(RepGraphConnection);
+
+	UThirdPersonMPReplicationGraphNode_AlwaysRelevant_ForConnection* OwnerNode = CreateNewNode<UThirdPersonMPReplicationGraphNode_AlwaysRelevant_ForConnection>();
+	AddConnectionGraphNode(OwnerNode, RepGraphConnection);
+
+	UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer* PrioritizerNode = CreateNewNode<UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer>();
+	PrioritizerNode->Graph = this;
+	PrioritizerNode->NetConnection = RepGraphConnection->NetConnection;
+	PrioritizerNode->ConnectionManager = RepGraphConnection;
+	AddConnectionGraphNode(PrioritizerNode, RepGraphConnection);
+
+	BandwidthPrioritizers.RemoveAll([](const TWeakObjectPtr<UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer>& Prioritizer) { return !Prioritizer.IsValid(); });
+	BandwidthPrioritizers.Add(PrioritizerNode);
+}
+
+EThirdPersonMPClassRepNodeMapping UThirdPersonMPReplicationGraph::GetMappingPolicy(UClass* Class)
+{
+	if (const EThirdPersonMPClassRepNodeMapping* Policy = ClassRepNodePolicies.Get(Class))
+	{
+		return *Policy;
+	}
+
+	const AActor* ActorCDO = GetDefault<AActor>(Class);
+	EThirdPersonMPClassRepNodeMapping Policy = EThirdPersonMPClassRepNodeMapping::Spatialize_Dynamic;
+	if (ActorCDO->bAlwaysRelevant)
+	{
+		Policy = EThirdPersonMPClassRepNodeMapping::AlwaysRelevant;
+	}
+	else if (ActorCDO->bOnlyRelevantToOwner)
+	{
+		Policy = EThirdPersonMPClassRepNodeMapping::NotRouted;
+	}
+	else if (ActorCDO->GetRootComponent() && ActorCDO->GetRootComponent()->Mobility == EComponentMobility::Static)
+	{
+		Policy = EThirdPersonMPClassRepNodeMapping::Spatialize_Static;
+	}
+
+	ClassRepNodePolicies.Set(Class, Policy);
+	return Policy;
+}
+
+void UThirdPersonMPReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	switch (GetMappingPolicy(ActorInfo.Class))
+	{
+	case EThirdPersonMPClassRepNodeMapping::AlwaysRelevant:
+		AlwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
+		break;
+
+	case EThirdPersonMPClassRepNodeMapping::Spatialize_Static:
+		GridNode->AddActor_Static(ActorInfo, GlobalInfo);
+		break;
+
+	case EThirdPersonMPClassRepNodeMapping::Spatialize_Dynamic:
+		GridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+		break;
+
+	case EThirdPersonMPClassRepNodeMapping::Spatialize_Dormancy:
+		GridNode->AddActor_Dormancy(ActorInfo, GlobalInfo);
+		break;
+
+	default:
+		break;
+	}
+}
+
+void UThirdPersonMPReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	switch (GetMappingPolicy(ActorInfo.Class))
+	{
+	case EThirdPersonMPClassRepNodeMapping::AlwaysRelevant:
+		AlwaysRelevantNode->NotifyRemoveNetworkActor(ActorInfo);
+		break;
+
+	case EThirdPersonMPClassRepNodeMapping::Spatialize_Static:
+		GridNode->RemoveActor_Static(ActorInfo);
+		break;
+
+	case EThirdPersonMPClassRepNodeMapping::Spatialize_Dynamic:
+		GridNode->RemoveActor_Dynamic(ActorInfo);
+		break;
+
+	case EThirdPersonMPClassRepNodeMapping::Spatialize_Dormancy:
+		GridNode->RemoveActor_Dormancy(ActorInfo);
+		break;
+
+	default:
+		break;
+	}
+}
+
+void UThirdPersonMPReplicationGraphNode_AlwaysRelevant_ForConnection::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
+{
+	//Player states, the connection's own included, come from the global always-relevant list.
+	OwnedActorList.Reset();
+
+	if (UNetConnection* NetConnection = Params.ConnectionManager.NetConnection)
+	{
+		if (APlayerController* PlayerController = NetConnection->PlayerController)
+		{
+			OwnedActorList.ConditionalAdd(PlayerController);
+		}
+		OwnedActorList.ConditionalAdd(NetConnection->ViewTarget);
+	}
+
+	Params.OutGatheredReplicationLists.AddReplicationActorList(OwnedActorList);
+}
+
+UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer::UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer()
+	: Graph(nullptr)
+	, ConnectionManager(nullptr)
+	, NumFrames(0)
+	, NumSaturatedFrames(0)
+	, WindowStartTime(0.0)
+{
+	FMemory::Memzero(UpdateCounts);
+}
+
+void UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
+{
+	UNetConnection* Connection = Params.ConnectionManager.NetConnection;
+	if (Graph == nullptr || Connection == nullptr || Connection->Driver == nullptr)
+	{
+		return;
+	}
+
+	//Gathering comes before this frame's sends, so the connection's actors show what went out last frame
+	CountUpdates(Params.ConnectionManager, Params.ReplicationFrameNum);
+
+	++NumFrames;
+	if (!Connection->IsNetReady(false))
+	{
+		++NumSaturatedFrames;
+	}
+
+	const double Now = Connection->Driver->GetElapsedTime();
+	if (Bandwidth.EstimatedBytesPerSecond <= 0.0f)
+	{
+		Bandwidth.EstimatedBytesPerSecond = FMath::Max((float)Connection->CurrentNetSpeed, Graph->MinBandwidth);
+		WindowStartTime = Now;
+	}
+	else if (Now - WindowStartTime >= 1.0)
+	{
+		UpdateBandwidth(Connection, (float)(Now - WindowStartTime));
+		WindowStartTime = Now;
+	}
+
+	//Connections are staggered so their re-ranking spreads over frames. This node is added last, so the lists gathered
+	//so far hold everything the grid and the connection's own node have for it.
+	if ((Params.ReplicationFrameNum + GetUniqueID()) % (uint32)FMath::Max(Graph->PrioritizeIntervalFrames, 1) == 0)
+	{
+		Prioritize(Params.ConnectionManager, Params.OutGatheredReplicationLists);
+	}
+
+	INC_DWORD_STAT_BY(STAT_ThirdPersonMP_NetThrottledActors, Bandwidth.NumThrottledActors);
+}
+
+void UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer::CountUpdates(UNetReplicationGraphConnection& InConnectionManager, uint32 FrameNum)
+{
+	for (const FTrackedActor& Tracked : TrackedActors)
+	{
+		AActor* Actor = Tracked.Actor.Get();
+		const FConnectionReplicationActorInfo* ConnectionInfo = Actor ? InConnectionManager.ActorInfoMap.Find(Actor) : nullptr;
+		if (ConnectionInfo && ConnectionInfo->LastRepFrameNum + 1 == FrameNum)
+		{
+			++UpdateCounts[(int32)Tracked.Category];
+		}
+	}
+}
+
+void UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer::UpdateBandwidth(UNetConnection* Connection, float ElapsedSeconds)
+{
+	const float NetSpeed = FMath::Max((float)Connection->CurrentNetSpeed, Graph->MinBandwidth);
+	Bandwidth.OutBytesPerSecond = Connection->OutBytesPerSecond;
+
+	//Back off below what actually got through when data kept queuing, otherwise probe upwards
+	if (NumSaturatedFrames > Graph->SaturatedFrameFraction * NumFrames)
+	{
+		const float Delivered = FMath::Min(Bandwidth.EstimatedBytesPerSecond, (float)Bandwidth.OutBytesPerSecond);
+		Bandwidth.EstimatedBytesPerSecond = Delivered * Graph->BandwidthDecreaseFactor;
+	}
+	else
+	{
+		Bandwidth.EstimatedBytesPerSecond += Graph->BandwidthIncreasePerSecond * ElapsedSeconds;
+	}
+	Bandwidth.EstimatedBytesPerSecond = FMath::Clamp(Bandwidth.EstimatedBytesPerSecond, Graph->MinBandwidth, NetSpeed);
+
+	//Split the measured total by each category's estimated share. Whatever the estimates leave is Other.
+	float EstimatedTotal = 0.0f;
+	for (int32 Category = 0; Category < (int32)EThirdPersonMPNetCategory::Other; ++Category)
+	{
+		Bandwidth.CategoryBytesPerSecond[Category] = UpdateCounts[Category] * Graph->GetBytesPerUpdate((EThirdPersonMPNetCategory)Category) / ElapsedSeconds;
+		EstimatedTotal += Bandwidth.CategoryBytesPerSecond[Category];
+	}
+
+	const float Scale = EstimatedTotal > Bandwidth.OutBytesPerSecond ? Bandwidth.OutBytesPerSecond / EstimatedTotal : 1.0f;
+	for (int32 Category = 0; Category < (int32)EThirdPersonMPNetCategory::Other; ++Category)
+	{
+		Bandwidth.CategoryBytesPerSecond[Category] *= Scale;
+	}
+	Bandwidth.CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Other] = FMath::Max(Bandwidth.OutBytesPerSecond - EstimatedTotal * Scale, 0.0f);
+
+	CSV_CUSTOM_STAT(ThirdPersonMP, NetOwnedBytesPerSec, Bandwidth.CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Owned], ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(ThirdPersonMP, NetCharacterBytesPerSec, Bandwidth.CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Character], ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(ThirdPersonMP, NetProjectileBytesPerSec, Bandwidth.CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Projectile], ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(ThirdPersonMP, NetOtherBytesPerSec, Bandwidth.CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Other], ECsvCustomStatOp::Accumulate);
+
+	FMemory::Memzero(UpdateCounts);
+	NumFrames = 0;
+	NumSaturatedFrames = 0;
+}
+
+void UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer::SetBasePeriod(AActor* Actor, uint32 BasePeriod)
+{
+	FConnectionReplicationActorInfo* ConnectionInfo = ConnectionManager ? ConnectionManager->ActorInfoMap.Find(Actor) : nullptr;
+	if (ConnectionInfo)
+	{
+		const uint32* Multiplier = PeriodMultipliers.Find(Actor);
+		ConnectionInfo->ReplicationPeriodFrame = BasePeriod * (Multiplier ? *Multiplier : 1);
+	}
+}
+
+void UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer::Prioritize(UNetReplicationGraphConnection& InConnectionManager, const FGatheredReplicationActorLists& GatheredLists)
+{
+	UNetConnection* Connection = InConnectionManager.NetConnection;
+	AActor* ViewTarget = Connection->ViewTarget;
+	if (ViewTarget == nullptr)
+	{
+		return;
+	}
+
+	APlayerController* PlayerController = Connection->PlayerController;
+	const FVector ViewLocation = ViewTarget->GetActorLocation();
+	const FVector ViewDirection = PlayerController ? PlayerController->GetControlRotation().Vector() : ViewTarget->GetActorForwardVector();
+	const AThirdPersonMPCharacter* ViewCharacter = Cast<AThirdPersonMPCharacter>(ViewTarget);
+	const AController* LastAttackerController = ViewCharacter ? ViewCharacter->GetLastDamageInstigator() : nullptr;
+	const APawn* LastAttacker = LastAttackerController ? LastAttackerController->GetPawn() : nullptr;
+
+	struct FRankedActor
+	{
+		AActor* Actor;
+		EThirdPersonMPNetCategory Category;
+		float Priority;
+		float DistanceSquared;
+	};
+
+	TArray<FRankedActor, TInlineAllocator<128>> Ranked;
+	for (const FActorRepListConstView& List : GatheredLists.GetLists(EActorRepListTypeFlags::Default))
+	{
+		for (AActor* Actor : List)
+		{
+			if (Actor == nullptr || Actor->IsPendingKillPending())
+			{
+				continue;
+			}
+
+			const EThirdPersonMPNetCategory Category = Graph->GetNetCategory(Actor, Connection);
+			const bool bOwned = Category == EThirdPersonMPNetCategory::Owned;
+			if (!bOwned && Category != EThirdPersonMPNetCategory::Character && Category != EThirdPersonMPNetCategory::Projectile)
+			{
+				continue;
+			}
+
+			const float CullDistance = Category == EThirdPersonMPNetCategory::Projectile ? Graph->ProjectileCullDistance : Graph->CharacterCullDistance;
+			const float DistanceSquared = FVector::DistSquared(Actor->GetActorLocation(), ViewLocation);
+			if (!bOwned && DistanceSquared > FMath::Square(CullDistance))
+			{
+				continue;
+			}
+
+			const float Priority = Graph->GetActorPriority(Actor, ViewLocation, ViewDirection, ViewTarget, LastAttacker, bOwned);
+			Ranked.Add({ Actor, Category, Priority, DistanceSquared });
+		}
+	}
+
+	Ranked.Sort([](const FRankedActor& A, const FRankedActor& B) { return A.Priority > B.Priority; });
+
+	//Owned traffic and everything the prioritizer does not pace come off the budget first, at last second's rates
+	const float TickRate = (float)Connection->Driver->NetServerMaxTickRate;
+	float RemainingBytesPerSecond = Bandwidth.EstimatedBytesPerSecond * Graph->BandwidthBudgetFraction
+		- Bandwidth.CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Owned]
+		- Bandwidth.CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Other];
+
+	const float ProtectedDistanceSquared = FMath::Square(Graph->ProtectedDistance);
+	const uint32 MaxPeriodMultiplier = (uint32)FMath::Max(Graph->MaxPeriodMultiplier, 1);
+
+	TrackedActors.Reset();
+	PeriodMultipliers.Reset();
+	for (const FRankedActor& Entry : Ranked)
+	{
+		TrackedActors.Add({ Entry.Actor, Entry.Category });
+
+		FConnectionReplicationActorInfo& ConnectionInfo = InConnectionManager.ActorInfoMap.FindOrAdd(Entry.Actor);
+		const uint32 BasePeriod = Graph->GetReplicationPeriodFrame(Entry.Actor->NetUpdateFrequency);
+		if (Entry.Category == EThirdPersonMPNetCategory::Owned)
+		{
+			ConnectionInfo.ReplicationPeriodFrame = BasePeriod;
+			continue;
+		}
+
+		const float BytesPerSecond = Graph->GetBytesPerUpdate(Entry.Category) * TickRate / BasePeriod;
+		uint32 Multiplier = 1;
+		if (Entry.Category != EThirdPersonMPNetCategory::Character || Entry.DistanceSquared > ProtectedDistanceSquared)
+		{
+			while (BytesPerSecond / Multiplier > RemainingBytesPerSecond && Multiplier < MaxPeriodMultiplier)
+			{
+				Multiplier *= 2;
+			}
+		}
+
+		RemainingBytesPerSecond -= BytesPerSecond / Multiplier;
+		ConnectionInfo.ReplicationPeriodFrame = BasePeriod * Multiplier;
+		if (Multiplier > 1)
+		{
+			PeriodMultipliers.Add(Entry.Actor, Multiplier);
+		}
+	}
+	Bandwidth.NumThrottledActors = PeriodMultipliers.Num();
+}
+
+//Logs every client connection's bandwidth estimate, the bytes it sent per category, and how many actors are slowed down for it.
+static void DumpConnectionBandwidth(const TArray<FString>& Args, UWorld* World)
+{
+	UNetDriver* NetDriver = World ? World->GetNetDriver() : nullptr;
+	const UThirdPersonMPReplicationGraph* Graph = NetDriver ? Cast<UThirdPersonMPReplicationGraph>(NetDriver->GetReplicationDriver()) : nullptr;
+	if (Graph == nullptr)
+	{
+		UE_LOG(LogThirdPersonMP, Warning, TEXT("Connection bandwidth must be dumped on a server using UThirdPersonMPReplicationGraph."));
+		return;
+	}
+
+	for (UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		const FThirdPersonMPConnectionBandwidth* Bandwidth = Connection ? Graph->GetConnectionBandwidth(Connection) : nullptr;
+		if (Bandwidth)
+		{
+			UE_LOG(LogThirdPersonMP, Display, TEXT("%s: estimate %.0f B/s, sent %d B/s (owned %.0f, characters %.0f, projectiles %.0f, other %.0f), %d actors throttled"),
+				*Connection->LowLevelGetRemoteAddress(true), Bandwidth->EstimatedBytesPerSecond, Bandwidth->OutBytesPerSecond,
+				Bandwidth->CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Owned],
+				Bandwidth->CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Character],
+				Bandwidth->CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Projectile],
+				Bandwidth->CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Other],
+				Bandwidth->NumThrottledActors);
+		}
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs DumpConnectionBandwidthCommand(
+	TEXT("ThirdPersonMP.Net.Bandwidth"),
+	TEXT("Logs each client connection's bandwidth estimate, bytes sent per category, and throttled actor count."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&DumpConnectionBandwidth));
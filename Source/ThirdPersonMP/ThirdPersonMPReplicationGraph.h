@@ -0,0 +1,300 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ReplicationGraph.h"
+#include "ThirdPersonMPReplicationGraph.generated.h"
+
+class UReplicationGraphNode_GridSpatialization2D;
+class UReplicationGraphNode_ActorList;
+class UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer;
+
+/** How actors of a given class are routed into the graph. */
+enum class EThirdPersonMPClassRepNodeMapping : uint8
+{
+	/** Not routed to a global node. Replicated through the owning connection's node, or not at all. */
+	NotRouted,
+	/** Replicated to every connection. */
+	AlwaysRelevant,
+	/** Placed in the spatial grid once and never moved. */
+	Spatialize_Static,
+	/** Placed in the spatial grid and re-bucketed every frame. */
+	Spatialize_Dynamic,
+	/** Treated as static while dormant and dynamic while awake. */
+	Spatialize_Dormancy,
+};
+
+/** Traffic class that a connection's replication bytes are counted under. */
+enum class EThirdPersonMPNetCategory : uint8
+{
+	/** The connection's own player controller, pawn and player state. */
+	Owned,
+	/** Other characters. */
+	Character,
+	Projectile,
+	/** Everything else, including the game state, RPCs and packet overhead. */
+	Other,
+
+	Num
+};
+
+/** A connection's bandwidth estimate, and what it sent over the last second. */
+struct FThirdPersonMPConnectionBandwidth
+{
+	/** Bytes per second the connection is estimated to carry without queuing. */
+	float EstimatedBytesPerSecond;
+
+	/** Bytes per second the connection sent. */
+	int32 OutBytesPerSecond;
+
+	/** OutBytesPerSecond split by category. Estimated from the updates sent in each category, scaled to the measured total. */
+	float CategoryBytesPerSecond[(int32)EThirdPersonMPNetCategory::Num];
+
+	/** Actors whose update rate is currently lowered for this connection. */
+	int32 NumThrottledActors;
+
+	FThirdPersonMPConnectionBandwidth()
+		: EstimatedBytesPerSecond(0.0f)
+		, OutBytesPerSecond(0)
+		, NumThrottledActors(0)
+	{
+		FMemory::Memzero(CategoryBytesPerSecond);
+	}
+};
+
+/**
+ * Replication graph for ThirdPersonMP. Characters and projectiles live in a 2D spatial grid so each connection only
+ * considers actors in nearby cells; the game state, every player state and other always-relevant actors are in a single
+ * global list; each connection's own player controller and view target come from a per-connection node. Projectiles use
+ * a short cull distance. Enabled through ReplicationDriverClassName in DefaultEngine.ini.
+ *
+ * Each connection also gets a bandwidth prioritizer node. It estimates how much the connection can carry, ranks the
+ * characters and projectiles gathered for it, and lowers the update rate of the lowest ranked ones until their estimated
+ * cost fits the budget. The engine then sends the actors that are due best-first as before. AGameplaySignificanceManager
+ * sets each actor's base rate through SetActorNetUpdateFrequency, and the prioritizer's slowdown multiplies it.
+ */
+UCLASS(transient, config=Engine)
+class UThirdPersonMPReplicationGraph : public UReplicationGraph
+{
+	GENERATED_BODY()
+
+public:
+	UThirdPersonMPReplicationGraph();
+
+	virtual void InitGlobalActorClassSettings() override;
+	virtual void InitGlobalGraphNodes() override;
+	virtual void InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection) override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+
+	/**
+	 * Sets Actor's NetUpdateFrequency, and the replication period the graph derived from it. Connections that already hold
+	 * the actor get the new period through their prioritizer, which keeps its own slowdown on top, so each connection's
+	 * period has a single owner.
+	 */
+	void SetActorNetUpdateFrequency(AActor* Actor, float NetUpdateFrequency);
+
+	/** Returns the category Actor's replication to Connection is counted under. */
+	EThirdPersonMPNetCategory GetNetCategory(const AActor* Actor, const UNetConnection* Connection) const;
+
+	/**
+	 * Returns how much Actor matters to a viewer at ViewLocation looking along ViewDirection, higher first. Like
+	 * AActor::GetNetPriority, scales the actor's NetPriority by distance and view direction, and also favours recently
+	 * damaged characters and the character that last damaged the viewer. Actors owned by the viewer rank above all.
+	 */
+	float GetActorPriority(const AActor* Actor, const FVector& ViewLocation, const FVector& ViewDirection, const AActor* ViewTarget, const APawn* LastAttacker, bool bOwnedByViewer) const;
+
+	/** Returns the estimated cost of one replication of an actor in Category, in bytes. */
+	float GetBytesPerUpdate(EThirdPersonMPNetCategory Category) const;
+
+	/** Returns Connection's bandwidth estimate and traffic, or nullptr if it has no prioritizer. */
+	const FThirdPersonMPConnectionBandwidth* GetConnectionBandwidth(const UNetConnection* Connection) const;
+
+	/** Spatial grid holding characters, projectiles and other movable actors. */
+	UPROPERTY()
+	UReplicationGraphNode_GridSpatialization2D* GridNode;
+
+	/** Actors replicated to every connection, such as AEmbedGameStateBase and the player states. */
+	UPROPERTY()
+	UReplicationGraphNode_ActorList* AlwaysRelevantNode;
+
+protected:
+	friend class UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer;
+
+	/** Returns how actors of Class are routed, deriving and caching a policy for classes without an explicit one. */
+	EThirdPersonMPClassRepNodeMapping GetMappingPolicy(UClass* Class);
+
+	/** Builds replication settings for Class from its class default object. */
+	FClassReplicationInfo MakeClassInfo(UClass* Class) const;
+
+	/** Returns the number of server frames between replications at NetUpdateFrequency. */
+	uint32 GetReplicationPeriodFrame(float NetUpdateFrequency) const;
+
+	/** Routing policy per class. */
+	TClassMap<EThirdPersonMPClassRepNodeMapping> ClassRepNodePolicies;
+
+	/** Size of a grid cell, in cm. */
+	UPROPERTY(Config)
+	float GridCellSize;
+
+	/** Offset of the grid's origin. Should put the most negative corner of the playable area at 0,0. */
+	UPROPERTY(Config)
+	float SpatialBiasX;
+
+	UPROPERTY(Config)
+	float SpatialBiasY;
+
+	/** Distance beyond which characters stop replicating to a connection. */
+	UPROPERTY(Config)
+	float CharacterCullDistance;
+
+	/** Distance beyond which projectiles stop replicating to a connection. */
+	UPROPERTY(Config)
+	float ProjectileCullDistance;
+
+	/** Fraction of a connection's estimated bandwidth the prioritizer plans to fill. */
+	UPROPERTY(Config)
+	float BandwidthBudgetFraction;
+
+	/** Lowest bandwidth estimate for any connection, in bytes per second. */
+	UPROPERTY(Config)
+	float MinBandwidth;
+
+	/** Bytes per second added to the estimate each second the connection kept up. */
+	UPROPERTY(Config)
+	float BandwidthIncreasePerSecond;
+
+	/** Factor applied to the measured rate when the connection could not keep up. */
+	UPROPERTY(Config)
+	float BandwidthDecreaseFactor;
+
+	/** Fraction of a second's frames with data still queued at which the connection counts as saturated. */
+	UPROPERTY(Config)
+	float SaturatedFrameFraction;
+
+	/** Frames between re-ranking a connection's actors. */
+	UPROPERTY(Config)
+	int32 PrioritizeIntervalFrames;
+
+	/** Characters closer than this to the viewer are never slowed down. */
+	UPROPERTY(Config)
+	float ProtectedDistance;
+
+	/** Largest factor the prioritizer may stretch an actor's replication period by. */
+	UPROPERTY(Config)
+	int32 MaxPeriodMultiplier;
+
+	/** Priority scale for actors in front of the viewer, and for those behind. */
+	UPROPERTY(Config)
+	float InFrontPriorityScale;
+
+	UPROPERTY(Config)
+	float BehindPriorityScale;
+
+	/** Seconds a character counts as recently damaged, and its priority scale while it does. */
+	UPROPERTY(Config)
+	float RecentDamageTime;
+
+	UPROPERTY(Config)
+	float RecentDamagePriorityScale;
+
+	/** Priority scale for the character that last damaged the viewer. */
+	UPROPERTY(Config)
+	float AttackerPriorityScale;
+
+	/** Estimated size of one update, in bytes, by category. Other is whatever the measured total leaves. */
+	UPROPERTY(Config)
+	float OwnedBytesPerUpdate;
+
+	UPROPERTY(Config)
+	float CharacterBytesPerUpdate;
+
+	UPROPERTY(Config)
+	float ProjectileBytesPerUpdate;
+
+	/** Every connection's prioritizer, for stats. */
+	TArray<TWeakObjectPtr<UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer>> BandwidthPrioritizers;
+};
+
+/** Per-connection node replicating the connection's own player controller and view target every frame. */
+UCLASS()
+class UThirdPersonMPReplicationGraphNode_AlwaysRelevant_ForConnection : public UReplicationGraphNode_AlwaysRelevant_ForConnection
+{
+	GENERATED_BODY()
+
+public:
+	virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
+
+private:
+	FActorRepListRefView OwnedActorList;
+};
+
+/**
+ * Per-connection node that adds no actors, but paces the ones the grid gives the connection. Estimates the connection's
+ * bandwidth once a second: it backs off to below the measured rate when data was still queued on more than
+ * SaturatedFrameFraction of frames, and otherwise grows by BandwidthIncreasePerSecond up to the connection's net speed.
+ * Every PrioritizeIntervalFrames it ranks the characters and projectiles in range among those the other nodes gathered
+ * for the connection by GetActorPriority, and walks them best-first, spending the budget on each actor's estimated bytes
+ * per second. Once the budget runs out, each actor's replication period for this connection is doubled until it fits,
+ * up to MaxPeriodMultiplier. Owned actors and characters within ProtectedDistance always keep their full rate. This
+ * node is the only thing that writes the connection's replication periods.
+ */
+UCLASS()
+class UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer : public UReplicationGraphNode
+{
+	GENERATED_BODY()
+
+public:
+	UThirdPersonMPReplicationGraphNode_BandwidthPrioritizer();
+
+	virtual void NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo) override {}
+	virtual bool NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound = true) override { return false; }
+	virtual void NotifyResetAllNetworkActors() override {}
+	virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
+
+	FORCEINLINE const FThirdPersonMPConnectionBandwidth& GetBandwidth() const { return Bandwidth; }
+
+	/** Sets Actor's replication period for this connection to BasePeriod, slowed down as much as the last prioritization decided. */
+	void SetBasePeriod(AActor* Actor, uint32 BasePeriod);
+
+	/** Graph this node paces replication for. */
+	UPROPERTY()
+	UThirdPersonMPReplicationGraph* Graph;
+
+	/** Connection this node belongs to, and the graph's state for it. */
+	TWeakObjectPtr<UNetConnection> NetConnection;
+
+	UPROPERTY()
+	UNetReplicationGraphConnection* ConnectionManager;
+
+private:
+	/** Updates the bandwidth estimate and the per-category traffic from the last second. */
+	void UpdateBandwidth(UNetConnection* Connection, float ElapsedSeconds);
+
+	/** Ranks the actors in range among GatheredLists and sets each one's replication period for this connection. */
+	void Prioritize(UNetReplicationGraphConnection& InConnectionManager, const FGatheredReplicationActorLists& GatheredLists);
+
+	/** Counts the updates sent to this connection last frame, by category. */
+	void CountUpdates(UNetReplicationGraphConnection& InConnectionManager, uint32 FrameNum);
+
+	struct FTrackedActor
+	{
+		TWeakObjectPtr<AActor> Actor;
+		EThirdPersonMPNetCategory Category;
+	};
+
+	/** Actors ranked at the last prioritization, plus the connection's own, whose updates are counted each frame. */
+	TArray<FTrackedActor> TrackedActors;
+
+	/** Actors slowed down at the last prioritization, and the factor their replication period is multiplied by. */
+	TMap<TWeakObjectPtr<AActor>, uint32> PeriodMultipliers;
+
+	FThirdPersonMPConnectionBandwidth Bandwidth;
+
+	/** Counts over the current second. */
+	int32 UpdateCounts[(int32)EThirdPersonMPNetCategory::Num];
+	int32 NumFrames;
+	int32 NumSaturatedFrames;
+	double WindowStartTime;
+};
@@ -0,0 +1,404 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "WorldGridStreamingManager.h"
+#include "ThirdPersonMP.h"
+#include "MyWorldSettings.h"
+#include "Engine/LevelStreaming.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("UpdateGridStreaming"), STAT_ThirdPersonMP_UpdateGridStreaming, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Grid Cells Loaded"), STAT_ThirdPersonMP_GridCellsLoaded, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Grid Loads Pending"), STAT_ThirdPersonMP_GridLoadsPending, STATGROUP_ThirdPersonMP);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Grid Streaming Stalls"), STAT_ThirdPersonMP_GridStreamingStalls, STATGROUP_ThirdPersonMP);
+
+AWorldGridStreamingManager::AWorldGridStreamingManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+	bReplicates = false;
+
+	UpdateInterval = 0.2f;
+	MaxPendingLoads = 2;
+	MaxLoadedCells = 64;
+
+	NumStalls = 0;
+	StallSeconds = 0.0f;
+	bWarnedCollisionOverCap = false;
+}
+
+void AWorldGridStreamingManager::AddStreamingSource(AActor* Source)
+{
+	if (Source)
+	{
+		ExtraSources.AddUnique(Source);
+	}
+}
+
+void AWorldGridStreamingManager::RemoveStreamingSource(AActor* Source)
+{
+	ExtraSources.Remove(Source);
+}
+
+void AWorldGridStreamingManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	const AMyWorldSettings* Settings = AMyWorldSettings::GetGridStreamingSettings(GetWorld());
+	if (Settings == nullptr)
+	{
+		SetActorTickEnabled(false);
+		return;
+	}
+
+	InitializeCells(*Settings);
+	SetActorTickInterval(UpdateInterval);
+
+	UE_LOG(LogThirdPersonMP, Log, TEXT("Grid streaming: %d cells of %.0f cm, %s."), Cells.Num(), Settings->CellSize,
+		GetNetMode() == NM_DedicatedServer ? TEXT("collision only") : TEXT("full cells near local players"));
+}
+
+void AWorldGridStreamingManager::InitializeCells(const AMyWorldSettings& Settings)
+{
+	//Clients in PIE see the sub-levels under prefixed package names, so match them without the prefix
+	TMap<FString, ULevelStreaming*> StreamingLevels;
+	for (ULevelStreaming* StreamingLevel : GetWorld()->GetStreamingLevels())
+	{
+		if (StreamingLevel)
+		{
+			StreamingLevels.Add(UWorld::RemovePIEPrefix(StreamingLevel->GetWorldAssetPackageName()), StreamingLevel);
+		}
+	}
+
+	auto FindLevel = [&StreamingLevels, &Settings](const TSoftObjectPtr<UWorld>& Level, const FIntPoint& Coordinates) -> ULevelStreaming*
+	{
+		if (Level.IsNull())
+		{
+			return nullptr;
+		}
+
+		ULevelStreaming* const* StreamingLevel = StreamingLevels.Find(Level.GetLongPackageName());
+		if (StreamingLevel == nullptr)
+		{
+			UE_LOG(LogThirdPersonMP, Warning, TEXT("Grid streaming: cell (%d, %d) uses %s, which is not a sub-level of this map."), Coordinates.X, Coordinates.Y, *Level.GetLongPackageName());
+			return nullptr;
+		}
+		return *StreamingLevel;
+	};
+
+	Cells.Reset(Settings.GridCells.Num());
+	CellIndices.Reset();
+	for (const FWorldGridCell& GridCell : Settings.GridCells)
+	{
+		if (CellIndices.Contains(GridCell.Coordinates))
+		{
+			UE_LOG(LogThirdPersonMP, Warning, TEXT("Grid streaming: cell (%d, %d) is listed twice; using the first."), GridCell.Coordinates.X, GridCell.Coordinates.Y);
+			continue;
+		}
+
+		FStreamingCell& Cell = Cells.AddDefaulted_GetRef();
+		Cell.Coordinates = GridCell.Coordinates;
+		Cell.Level = FindLevel(GridCell.Level, GridCell.Coordinates);
+		Cell.CollisionLevel = FindLevel(GridCell.CollisionLevel, GridCell.Coordinates);
+		Cell.bCollisionRelevant = GridCell.bCollisionRelevant;
+		Cell.bWantCollision = false;
+		Cell.bWantVisuals = false;
+		Cell.StallTime = 0.0f;
+		CellIndices.Add(Cell.Coordinates, Cells.Num() - 1);
+	}
+}
+
+void AWorldGridStreamingManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	const AMyWorldSettings* Settings = AMyWorldSettings::GetGridStreamingSettings(GetWorld());
+	if (Settings == nullptr)
+	{
+		return;
+	}
+
+	THIRDPERSONMP_SCOPE(UpdateGridStreaming);
+
+	TArray<FStreamingSource> Sources;
+	GatherSources(Sources);
+
+	UpdateCells(*Settings, Sources);
+	UpdateStalls(*Settings, Sources, DeltaSeconds);
+
+	SET_DWORD_STAT(STAT_ThirdPersonMP_GridCellsLoaded, GetNumLoadedCells());
+	SET_DWORD_STAT(STAT_ThirdPersonMP_GridLoadsPending, GetNumPendingLoads());
+	CSV_CUSTOM_STAT(ThirdPersonMP, GridCellsLoaded, GetNumLoadedCells(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ThirdPersonMP, GridLoadsPending, GetNumPendingLoads(), ECsvCustomStatOp::Set);
+}
+
+void AWorldGridStreamingManager::GatherSources(TArray<FStreamingSource>& OutSources) const
+{
+	//A local player needs everything it can see; a remote player, only what its movement can collide with
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+		if (PlayerController == nullptr)
+		{
+			continue;
+		}
+
+		APawn* Pawn = PlayerController->GetPawnOrSpectator();
+		FStreamingSource& Source = OutSources.AddDefaulted_GetRef();
+		Source.Location = Pawn ? Pawn->GetActorLocation() : PlayerController->GetFocalLocation();
+		Source.Velocity = Pawn ? Pawn->GetVelocity() : FVector::ZeroVector;
+		Source.bCollisionOnly = !PlayerController->IsLocalController();
+	}
+
+	const bool bDedicatedServer = GetNetMode() == NM_DedicatedServer;
+	for (const TWeakObjectPtr<AActor>& ExtraSource : ExtraSources)
+	{
+		if (AActor* Actor = ExtraSource.Get())
+		{
+			FStreamingSource& Source = OutSources.AddDefaulted_GetRef();
+			Source.Location = Actor->GetActorLocation();
+			Source.Velocity = Actor->GetVelocity();
+			Source.bCollisionOnly = bDedicatedServer;
+		}
+	}
+}
+
+void AWorldGridStreamingManager::UpdateCells(const AMyWorldSettings& Settings, const TArray<FStreamingSource>& Sources)
+{
+	//Nearest distance from any source needing visuals, and from any source needing collision, of every cell in reach
+	TMap<int32, FVector2D> NearestDistances;
+	const float Reach = FMath::Max(Settings.ClientUnloadRadius, Settings.ServerUnloadRadius);
+	for (const FStreamingSource& Source : Sources)
+	{
+		const FVector Points[] = { Source.Location, Source.Location + Source.Velocity * Settings.LookAheadSeconds };
+		for (const FVector& Point : Points)
+		{
+			const FIntPoint Min = Settings.GetCellCoordinates(Point - FVector(Reach, Reach, 0.0f));
+			const FIntPoint Max = Settings.GetCellCoordinates(Point + FVector(Reach, Reach, 0.0f));
+			for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+			{
+				for (int32 X = Min.X; X <= Max.X; ++X)
+				{
+					const int32* CellIndex = CellIndices.Find(FIntPoint(X, Y));
+					if (CellIndex == nullptr)
+					{
+						continue;
+					}
+
+					const float Distance = Settings.GetDistanceToCell(Point, FIntPoint(X, Y));
+					FVector2D* Nearest = NearestDistances.Find(*CellIndex);
+					if (Nearest == nullptr)
+					{
+						Nearest = &NearestDistances.Add(*CellIndex, FVector2D(MAX_flt, MAX_flt));
+					}
+					float& NearestForSource = Source.bCollisionOnly ? Nearest->Y : Nearest->X;
+					NearestForSource = FMath::Min(NearestForSource, Distance);
+				}
+			}
+		}
+	}
+
+	//Cells already wanted are kept out to the unload radius, so cells near the edge do not flicker in and out
+	struct FWantedCell
+	{
+		int32 Index;
+		float Distance;
+		bool bVisuals;
+		bool bCollision;
+	};
+	TArray<FWantedCell> Wanted;
+	for (const TPair<int32, FVector2D>& Pair : NearestDistances)
+	{
+		const FStreamingCell& Cell = Cells[Pair.Key];
+		const bool bVisuals = Pair.Value.X <= (Cell.bWantVisuals ? Settings.ClientUnloadRadius : Settings.ClientLoadRadius);
+		const bool bCollision = Cell.bCollisionRelevant && Pair.Value.Y <= (Cell.bWantCollision ? Settings.ServerUnloadRadius : Settings.ServerLoadRadius);
+		if (bVisuals || bCollision)
+		{
+			Wanted.Add({ Pair.Key, FMath::Min(Pair.Value.X, Pair.Value.Y), bVisuals, bCollision });
+		}
+	}
+
+	//The cap only ever drops visuals. Collision a player stands on, or is about to, is kept past it, or they would fall through the world
+	Wanted.Sort([](const FWantedCell& A, const FWantedCell& B) { return A.Distance < B.Distance; });
+	if (MaxLoadedCells > 0 && Wanted.Num() > MaxLoadedCells)
+	{
+		int32 NumKept = 0;
+		int32 NumCollisionOverCap = 0;
+		for (int32 Rank = 0; Rank < Wanted.Num(); ++Rank)
+		{
+			FWantedCell WantedCell = Wanted[Rank];
+			if (NumKept >= MaxLoadedCells)
+			{
+				if (!WantedCell.bCollision)
+				{
+					continue;
+				}
+				WantedCell.bVisuals = false;
+				++NumCollisionOverCap;
+			}
+			Wanted[NumKept++] = WantedCell;
+		}
+		Wanted.SetNum(NumKept);
+
+		if (NumCollisionOverCap > 0 && !bWarnedCollisionOverCap)
+		{
+			UE_LOG(LogThirdPersonMP, Warning, TEXT("Grid streaming: %d cells past MaxLoadedCells (%d) are loaded anyway for the collision players need. Raise MaxLoadedCells or lower ServerLoadRadius."), NumCollisionOverCap, MaxLoadedCells);
+			bWarnedCollisionOverCap = true;
+		}
+	}
+
+	TArray<bool> bIsWanted;
+	bIsWanted.SetNumZeroed(Cells.Num());
+	for (const FWantedCell& WantedCell : Wanted)
+	{
+		bIsWanted[WantedCell.Index] = true;
+	}
+
+	//Unload first, so a player moving fast frees memory before asking for more
+	for (int32 Index = 0; Index < Cells.Num(); ++Index)
+	{
+		FStreamingCell& Cell = Cells[Index];
+		if (!bIsWanted[Index] && (Cell.bWantVisuals || Cell.bWantCollision))
+		{
+			RequestLevel(Cell.Level.Get(), false, 0);
+			RequestLevel(Cell.CollisionLevel.Get(), false, 0);
+			Cell.bWantVisuals = false;
+			Cell.bWantCollision = false;
+		}
+	}
+
+	//Then load, nearest first, as long as there is a free slot; cells left out are asked for again next update
+	int32 NumPendingLoads = GetNumPendingLoads();
+	for (int32 Rank = 0; Rank < Wanted.Num(); ++Rank)
+	{
+		const FWantedCell& WantedCell = Wanted[Rank];
+		FStreamingCell& Cell = Cells[WantedCell.Index];
+		const bool bHasCollisionLevel = Cell.CollisionLevel.IsValid();
+		const bool bLoadLevel = WantedCell.bVisuals || !bHasCollisionLevel;
+		const int32 Priority = Wanted.Num() - Rank;
+
+		const bool bIsNewLoad = (bLoadLevel && Cell.Level.IsValid() && !Cell.Level->ShouldBeLoaded()) || (bHasCollisionLevel && !Cell.CollisionLevel->ShouldBeLoaded());
+		if (bIsNewLoad && NumPendingLoads >= MaxPendingLoads)
+		{
+			continue;
+		}
+
+		RequestLevel(Cell.Level.Get(), bLoadLevel, Priority);
+		RequestLevel(Cell.CollisionLevel.Get(), true, Priority);
+		Cell.bWantVisuals = WantedCell.bVisuals;
+		Cell.bWantCollision = true;
+		NumPendingLoads += bIsNewLoad ? 1 : 0;
+	}
+}
+
+void AWorldGridStreamingManager::UpdateStalls(const AMyWorldSettings& Settings, const TArray<FStreamingSource>& Sources, float DeltaSeconds)
+{
+	TArray<bool> bIsStalled;
+	bIsStalled.SetNumZeroed(Cells.Num());
+	for (const FStreamingSource& Source : Sources)
+	{
+		const int32* CellIndex = CellIndices.Find(Settings.GetCellCoordinates(Source.Location));
+		if (CellIndex == nullptr)
+		{
+			continue;
+		}
+
+		const FStreamingCell& Cell = Cells[*CellIndex];
+		const bool bNeeded = Source.bCollisionOnly ? Cell.bCollisionRelevant : true;
+		const bool bRequested = Source.bCollisionOnly ? Cell.bWantCollision : Cell.bWantVisuals;
+		if (bNeeded && (!bRequested || !IsCellVisible(Cell)))
+		{
+			bIsStalled[*CellIndex] = true;
+		}
+	}
+
+	for (int32 Index = 0; Index < Cells.Num(); ++Index)
+	{
+		FStreamingCell& Cell = Cells[Index];
+		if (bIsStalled[Index])
+		{
+			Cell.StallTime += DeltaSeconds;
+		}
+		else if (Cell.StallTime > 0.0f)
+		{
+			EndStall(Cell);
+		}
+	}
+}
+
+void AWorldGridStreamingManager::FlushStalls()
+{
+	for (FStreamingCell& Cell : Cells)
+	{
+		if (Cell.StallTime > 0.0f)
+		{
+			EndStall(Cell);
+		}
+	}
+}
+
+void AWorldGridStreamingManager::EndStall(FStreamingCell& Cell)
+{
+	++NumStalls;
+	StallSeconds += Cell.StallTime;
+	INC_DWORD_STAT(STAT_ThirdPersonMP_GridStreamingStalls);
+	UE_LOG(LogThirdPersonMP, Verbose, TEXT("Grid streaming: stalled %.2f s in cell (%d, %d)."), Cell.StallTime, Cell.Coordinates.X, Cell.Coordinates.Y);
+
+	OnStall.Broadcast(Cell.Coordinates, Cell.StallTime);
+	Cell.StallTime = 0.0f;
+}
+
+int32 AWorldGridStreamingManager::GetNumLoadedCells() const
+{
+	int32 NumLoaded = 0;
+	for (const FStreamingCell& Cell : Cells)
+	{
+		NumLoaded += ((Cell.bWantVisuals || Cell.bWantCollision) && IsCellVisible(Cell)) ? 1 : 0;
+	}
+	return NumLoaded;
+}
+
+int32 AWorldGridStreamingManager::GetNumPendingLoads() const
+{
+	auto IsPending = [](const TWeakObjectPtr<ULevelStreaming>& StreamingLevel)
+	{
+		return StreamingLevel.IsValid() && StreamingLevel->ShouldBeLoaded() && !(StreamingLevel->IsLevelLoaded() && StreamingLevel->IsLevelVisible());
+	};
+
+	int32 NumPending = 0;
+	for (const FStreamingCell& Cell : Cells)
+	{
+		NumPending += (IsPending(Cell.Level) ? 1 : 0) + (IsPending(Cell.CollisionLevel) ? 1 : 0);
+	}
+	return NumPending;
+}
+
+bool AWorldGridStreamingManager::IsCellVisible(const FStreamingCell& Cell)
+{
+	auto IsReady = [](const TWeakObjectPtr<ULevelStreaming>& StreamingLevel)
+	{
+		return !StreamingLevel.IsValid() || !StreamingLevel->ShouldBeLoaded() || StreamingLevel->IsLevelVisible();
+	};
+	return IsReady(Cell.Level) && IsReady(Cell.CollisionLevel);
+}
+
+void AWorldGridStreamingManager::RequestLevel(ULevelStreaming* StreamingLevel, bool bLoad, int32 Priority)
+{
+	if (StreamingLevel == nullptr)
+	{
+		return;
+	}
+
+	//The engine loads the package asynchronously and adds the level to the world over several frames
+	if (StreamingLevel->ShouldBeLoaded() != bLoad)
+	{
+		StreamingLevel->SetShouldBeLoaded(bLoad);
+		StreamingLevel->SetShouldBeVisible(bLoad);
+	}
+	if (bLoad)
+	{
+		StreamingLevel->SetPriority(Priority);
+	}
+}
@@ -0,0 +1,127 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "WorldGridStreamingManager.generated.h"
+
+class AMyWorldSettings;
+class ULevelStreaming;
+
+/** Broadcast when a streaming source leaves a stall: the cell it was in, and the seconds it waited for it. */
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnWorldGridStall, const FIntPoint& /*Cell*/, float /*Seconds*/);
+
+/**
+ * Streams the cells of a grid-streamed map (see AMyWorldSettings) in and out around the players. The levels of the
+ * cells near a local view are loaded and made visible; on a server, only the collision levels of cells near any
+ * player, since a server renders nothing. Requests are asynchronous, nearest first, with at most MaxPendingLoads in
+ * flight so a fast player does not queue a wall of loads, and look ahead along each player's velocity so cells are
+ * usually in before the player arrives. A source standing in a cell that is not visible yet is stalled; stalls are
+ * counted and reported through OnStall.
+ *
+ * Owned and spawned by AEmbedGameStateBase on every machine whose map has grid streaming enabled.
+ */
+UCLASS(config=Game, notplaceable)
+class THIRDPERSONMP_API AWorldGridStreamingManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AWorldGridStreamingManager();
+
+	/** Streams cells around Source as it would around a player on this machine, until it is removed or destroyed. */
+	void AddStreamingSource(AActor* Source);
+	void RemoveStreamingSource(AActor* Source);
+
+	/** Returns the number of cells whose levels are all visible. */
+	int32 GetNumLoadedCells() const;
+
+	/** Returns the number of level loads requested and not yet complete. */
+	int32 GetNumPendingLoads() const;
+
+	/** Returns the number of stalls that have ended, and the seconds spent in them. */
+	FORCEINLINE int32 GetNumStalls() const { return NumStalls; }
+	FORCEINLINE float GetStallSeconds() const { return StallSeconds; }
+
+	/** Ends every stall still open as if its cell had become visible now, so a report taken now counts it. */
+	void FlushStalls();
+
+	FOnWorldGridStall OnStall;
+
+	/** Seconds between updates of the wanted cells. */
+	UPROPERTY(Config, EditAnywhere, Category = "Streaming")
+	float UpdateInterval;
+
+	/** Most level loads in flight at once. Further cells wait for a slot, nearest first. */
+	UPROPERTY(Config, EditAnywhere, Category = "Streaming")
+	int32 MaxPendingLoads;
+
+	/**
+	 * Most cells kept loaded at once. Past it, the furthest cells wanted only for their visuals are left out, bounding
+	 * client memory whatever the radii. Collision a server needs around a player is never left out, so a server past
+	 * the cap loads it anyway and warns.
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Streaming")
+	int32 MaxLoadedCells;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void Tick(float DeltaSeconds) override;
+
+private:
+	/** A place cells are streamed around, and whether it needs whole cells or only their collision. */
+	struct FStreamingSource
+	{
+		FVector Location;
+		FVector Velocity;
+		bool bCollisionOnly;
+	};
+
+	/** Runtime state of an AMyWorldSettings cell. */
+	struct FStreamingCell
+	{
+		FIntPoint Coordinates;
+		TWeakObjectPtr<ULevelStreaming> Level;
+		TWeakObjectPtr<ULevelStreaming> CollisionLevel;
+		bool bCollisionRelevant;
+
+		/** What the cell was last asked to load: nothing, collision only, or everything. */
+		bool bWantCollision;
+		bool bWantVisuals;
+
+		/** Seconds a source has been waiting in the cell for it to become visible, or zero. */
+		float StallTime;
+	};
+
+	/** Matches the cells in Settings to the map's streaming levels. */
+	void InitializeCells(const AMyWorldSettings& Settings);
+
+	void GatherSources(TArray<FStreamingSource>& OutSources) const;
+
+	/** Decides which cells each source wants, and requests loads and unloads. */
+	void UpdateCells(const AMyWorldSettings& Settings, const TArray<FStreamingSource>& Sources);
+
+	/** Counts stall time for every source standing in a cell that is not visible yet. */
+	void UpdateStalls(const AMyWorldSettings& Settings, const TArray<FStreamingSource>& Sources, float DeltaSeconds);
+
+	/** Counts and broadcasts Cell's stall, and clears it. */
+	void EndStall(FStreamingCell& Cell);
+
+	/** Returns true if Cell's levels that it currently wants are loaded and visible. */
+	static bool IsCellVisible(const FStreamingCell& Cell);
+
+	/** Sets the streaming level's load and visibility request, nearer cells first when Priority is higher. */
+	static void RequestLevel(ULevelStreaming* StreamingLevel, bool bLoad, int32 Priority);
+
+	TArray<FStreamingCell> Cells;
+	TMap<FIntPoint, int32> CellIndices;
+
+	TArray<TWeakObjectPtr<AActor>> ExtraSources;
+
+	int32 NumStalls;
+	float StallSeconds;
+
+	/** Whether the warning for collision past MaxLoadedCells has been logged. */
+	bool bWarnedCollisionOverCap;
+};
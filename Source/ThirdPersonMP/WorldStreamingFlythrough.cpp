@@ -0,0 +1,195 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+
+#include "WorldStreamingFlythrough.h"
+#include "ThirdPersonMP.h"
+#include "EmbedGameStateBase.h"
+#include "LoadTestMetricsRecorder.h"
+#include "MyWorldSettings.h"
+#include "WorldGridStreamingManager.h"
+#include "Components/SceneComponent.h"
+#include "Engine/World.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+
+AWorldStreamingFlythrough::AWorldStreamingFlythrough()
+{
+	//A movable root, so the streaming manager can read our velocity
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+	RootComponent->SetMobility(EComponentMobility::Movable);
+
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+	bReplicates = false;
+
+	FlySpeed = 2000.0f;
+	FlyHeight = 5000.0f;
+	MaxStartWait = 60.0f;
+	HitchThresholdMs = 50.0f;
+
+	Distance = 0.0f;
+	WaitTime = 0.0f;
+	FlyTime = 0.0f;
+	bFlying = false;
+	NumHitches = 0;
+	PeakLoadedCells = 0;
+	PeakUsedPhysical = 0;
+}
+
+bool AWorldStreamingFlythrough::GetOutputPath(FString& OutPath)
+{
+	return FParse::Value(FCommandLine::Get(), TEXT("StreamingFlythrough="), OutPath) && !OutPath.IsEmpty();
+}
+
+void AWorldStreamingFlythrough::BeginPlay()
+{
+	Super::BeginPlay();
+
+	GetOutputPath(OutputPath);
+	FParse::Value(FCommandLine::Get(), TEXT("StreamingFlythroughSpeed="), FlySpeed);
+
+	const AMyWorldSettings* Settings = AMyWorldSettings::GetGridStreamingSettings(GetWorld());
+	AEmbedGameStateBase* GameState = GetWorld()->GetGameState<AEmbedGameStateBase>();
+	StreamingManager = GameState ? GameState->GetGridStreamingManager() : nullptr;
+	if (Settings == nullptr || !StreamingManager.IsValid() || FlySpeed <= 0.0f)
+	{
+		UE_LOG(LogThirdPersonMP, Error, TEXT("Streaming flythrough: %s does not use grid streaming, exiting."), *GetWorld()->GetMapName());
+		FPlatformMisc::RequestExit(false);
+		return;
+	}
+
+	//Corner to corner through the middle of the grid, which crosses the most cells
+	FIntPoint Min(MAX_int32, MAX_int32);
+	FIntPoint Max(MIN_int32, MIN_int32);
+	for (const FWorldGridCell& Cell : Settings->GridCells)
+	{
+		Min = FIntPoint(FMath::Min(Min.X, Cell.Coordinates.X), FMath::Min(Min.Y, Cell.Coordinates.Y));
+		Max = FIntPoint(FMath::Max(Max.X, Cell.Coordinates.X), FMath::Max(Max.Y, Cell.Coordinates.Y));
+	}
+	const FVector2D HalfCell(Settings->CellSize * 0.5f, Settings->CellSize * 0.5f);
+	const FVector2D StartCenter = Settings->GridOrigin + FVector2D(Min.X, Min.Y) * Settings->CellSize + HalfCell;
+	const FVector2D EndCenter = Settings->GridOrigin + FVector2D(Max.X, Max.Y) * Settings->CellSize + HalfCell;
+	Start = FVector(StartCenter, FlyHeight);
+	End = FVector(EndCenter, FlyHeight);
+	Distance = FVector::Dist(Start, End);
+
+	SetActorLocation(Start);
+	StreamingManager->AddStreamingSource(this);
+	StallHandle = StreamingManager->OnStall.AddUObject(this, &AWorldStreamingFlythrough::OnStall);
+
+	UE_LOG(LogThirdPersonMP, Log, TEXT("Streaming flythrough: %.0f m across %d cells at %.0f cm/s."), Distance / 100.0f, Settings->GridCells.Num(), FlySpeed);
+}
+
+void AWorldStreamingFlythrough::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (AWorldGridStreamingManager* Manager = StreamingManager.Get())
+	{
+		Manager->OnStall.Remove(StallHandle);
+		Manager->RemoveStreamingSource(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AWorldStreamingFlythrough::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	AWorldGridStreamingManager* Manager = StreamingManager.Get();
+	if (Manager == nullptr)
+	{
+		return;
+	}
+
+	//The player would spawn into loaded cells, so the wait at the start is not part of the test
+	if (!bFlying)
+	{
+		WaitTime += DeltaSeconds;
+		if ((Manager->GetNumLoadedCells() > 0 && Manager->GetNumPendingLoads() == 0) || WaitTime >= MaxStartWait)
+		{
+			UE_LOG(LogThirdPersonMP, Log, TEXT("Streaming flythrough: %d cells loaded after %.1f s, flying."), Manager->GetNumLoadedCells(), WaitTime);
+			bFlying = true;
+		}
+		return;
+	}
+
+	//Game thread time of the last frame, which includes adding streamed levels to the world
+	const float FrameMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+	FrameTimes.Add(FrameMs);
+	NumHitches += FrameMs > HitchThresholdMs ? 1 : 0;
+	PeakLoadedCells = FMath::Max(PeakLoadedCells, Manager->GetNumLoadedCells());
+	PeakUsedPhysical = FMath::Max<uint64>(PeakUsedPhysical, FPlatformMemory::GetStats().UsedPhysical);
+
+	FlyTime += DeltaSeconds;
+	const float Alpha = Distance > 0.0f ? FMath::Min(FlyTime * FlySpeed / Distance, 1.0f) : 1.0f;
+	SetActorLocation(FMath::Lerp(Start, End, Alpha));
+	RootComponent->ComponentVelocity = Alpha < 1.0f ? (End - Start).GetSafeNormal() * FlySpeed : FVector::ZeroVector;
+
+	if (Alpha >= 1.0f)
+	{
+		Finish();
+	}
+}
+
+void AWorldStreamingFlythrough::OnStall(const FIntPoint& Cell, float Seconds)
+{
+	if (bFlying)
+	{
+		Stalls.Add({ FlyTime, Cell, Seconds });
+	}
+}
+
+void AWorldStreamingFlythrough::Finish()
+{
+	SetActorTickEnabled(false);
+
+	//A stall still open at the end of the path is the worst kind, so it goes in the report rather than being lost
+	if (AWorldGridStreamingManager* Manager = StreamingManager.Get())
+	{
+		Manager->FlushStalls();
+	}
+
+	TArray<float> Sorted = FrameTimes;
+	Sorted.Sort();
+
+	float StallSeconds = 0.0f;
+	FString StallList;
+	for (int32 Index = 0; Index < Stalls.Num(); ++Index)
+	{
+		const FStallRecord& Stall = Stalls[Index];
+		StallSeconds += Stall.Seconds;
+		StallList += FString::Printf(TEXT("%s\t\t{ \"time\": %.2f, \"cell\": [%d, %d], \"seconds\": %.3f }"),
+			Index == 0 ? TEXT("\n") : TEXT(",\n"), Stall.Time, Stall.Cell.X, Stall.Cell.Y, Stall.Seconds);
+	}
+
+	FString Json;
+	Json += TEXT("{\n");
+	Json += FString::Printf(TEXT("\t\"map\": \"%s\",\n"), *GetWorld()->GetMapName());
+	Json += FString::Printf(TEXT("\t\"netMode\": \"%s\",\n"), GetNetMode() == NM_DedicatedServer ? TEXT("server") : TEXT("client"));
+	Json += FString::Printf(TEXT("\t\"distanceCm\": %.0f,\n"), Distance);
+	Json += FString::Printf(TEXT("\t\"flySpeed\": %.0f,\n"), FlySpeed);
+	Json += FString::Printf(TEXT("\t\"startWaitSeconds\": %.2f,\n"), WaitTime);
+	Json += FString::Printf(TEXT("\t\"flySeconds\": %.2f,\n"), FlyTime);
+	Json += TEXT("\t\"summary\": {\n");
+	Json += FString::Printf(TEXT("\t\t\"stalls\": %d,\n"), Stalls.Num());
+	Json += FString::Printf(TEXT("\t\t\"stallSeconds\": %.3f,\n"), StallSeconds);
+	Json += FString::Printf(TEXT("\t\t\"hitchFrames\": %d,\n"), NumHitches);
+	Json += FString::Printf(TEXT("\t\t\"hitchThresholdMs\": %.1f,\n"), HitchThresholdMs);
+	Json += FString::Printf(TEXT("\t\t\"frameMsP99\": %.3f,\n"), LoadTestMetrics::Percentile(Sorted, 0.99f));
+	Json += FString::Printf(TEXT("\t\t\"frameMsMax\": %.3f,\n"), LoadTestMetrics::Percentile(Sorted, 1.0f));
+	Json += FString::Printf(TEXT("\t\t\"peakLoadedCells\": %d,\n"), PeakLoadedCells);
+	Json += FString::Printf(TEXT("\t\t\"peakUsedPhysicalMB\": %.1f\n"), PeakUsedPhysical / (1024.0 * 1024.0));
+	Json += TEXT("\t},\n");
+	Json += FString::Printf(TEXT("\t\"stalls\": [%s\n\t]\n"), *StallList);
+	Json += TEXT("}\n");
+
+	if (!FFileHelper::SaveStringToFile(Json, *OutputPath, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+	{
+		UE_LOG(LogThirdPersonMP, Error, TEXT("Streaming flythrough: could not write %s."), *OutputPath);
+	}
+
+	UE_LOG(LogThirdPersonMP, Log, TEXT("Streaming flythrough: %d stalls (%.2f s), %d hitches, report written to %s, exiting."), Stalls.Num(), StallSeconds, NumHitches, *OutputPath);
+	FPlatformMisc::RequestExit(false);
+}
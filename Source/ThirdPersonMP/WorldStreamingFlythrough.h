@@ -0,0 +1,84 @@
+// //Copyright 2020 Edwin Yung. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "WorldStreamingFlythrough.generated.h"
+
+class AWorldGridStreamingManager;
+
+/**
+ * Headless streaming test for grid-streamed maps. Waits for the cells at one corner of the grid to load, then flies
+ * across the map to the opposite corner at FlySpeed as a streaming source of AWorldGridStreamingManager, and writes a
+ * JSON report to <path>: every stall (time, cell and seconds waited), the frames over HitchThresholdMs, the most cells
+ * loaded at once and the peak memory. Exits when it arrives. Run it in a -nullrhi game to test what a client streams,
+ * or on a dedicated server to test collision-only streaming.
+ *
+ * Spawned by AThirdPersonMPGameMode on machines started with -StreamingFlythrough=<path>.
+ */
+UCLASS(config=Game, notplaceable)
+class THIRDPERSONMP_API AWorldStreamingFlythrough : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AWorldStreamingFlythrough();
+
+	/** Returns true and the report path if this process was started with -StreamingFlythrough=<path>. */
+	static bool GetOutputPath(FString& OutPath);
+
+	/** Flying speed in cm per second, overridden by -StreamingFlythroughSpeed=. */
+	UPROPERTY(Config, EditAnywhere, Category = "Streaming")
+	float FlySpeed;
+
+	/** Height above the grid origin to fly at, in cm. */
+	UPROPERTY(Config, EditAnywhere, Category = "Streaming")
+	float FlyHeight;
+
+	/** Most seconds to wait at the start for the first cells to load. */
+	UPROPERTY(Config, EditAnywhere, Category = "Streaming")
+	float MaxStartWait;
+
+	/** Game thread frames longer than this, in milliseconds, are counted as hitches. */
+	UPROPERTY(Config, EditAnywhere, Category = "Streaming")
+	float HitchThresholdMs;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+
+private:
+	void OnStall(const FIntPoint& Cell, float Seconds);
+
+	/** Writes the report and exits. */
+	void Finish();
+
+	TWeakObjectPtr<AWorldGridStreamingManager> StreamingManager;
+	FString OutputPath;
+
+	FVector Start;
+	FVector End;
+	float Distance;
+
+	/** Seconds spent waiting at Start, and flying from it. */
+	float WaitTime;
+	float FlyTime;
+	bool bFlying;
+
+	struct FStallRecord
+	{
+		float Time;
+		FIntPoint Cell;
+		float Seconds;
+	};
+	TArray<FStallRecord> Stalls;
+
+	TArray<float> FrameTimes;
+	int32 NumHitches;
+	int32 PeakLoadedCells;
+	uint64 PeakUsedPhysical;
+
+	FDelegateHandle StallHandle;
+};
@@ -9,6 +9,7 @@ public class ThirdPersonMPEditorTarget : TargetRules
 	{
 		Type = TargetType.Editor;
 		DefaultBuildSettings = BuildSettingsVersion.V2;
+
 		ExtraModuleNames.Add("ThirdPersonMP");
 	}
 }
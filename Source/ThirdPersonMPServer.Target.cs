@@ -0,0 +1,20 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+using UnrealBuildTool;
+using System.Collections.Generic;
+
+public class ThirdPersonMPServerTarget : TargetRules
+{
+	public ThirdPersonMPServerTarget(TargetInfo Target) : base(Target)
+	{
+		Type = TargetType.Server;
+		DefaultBuildSettings = BuildSettingsVersion.V2;
+
+		// Push-model replication changes engine defines, so this target builds its own engine modules (source-built engine only).
+		// Only the dedicated server sends enough to benefit; the game and editor targets keep the shared build environment.
+		bWithPushModel = true;
+		BuildEnvironment = TargetBuildEnvironment.Unique;
+
+		ExtraModuleNames.Add("ThirdPersonMP");
+	}
+}